@@ -50,6 +50,14 @@ public:
      */
     CVector3d normal{0.0f, 0.0f, 0.0f}; ///< Normal vector pointing outward from the facet.
 
+    /**
+     * @brief Replaces the normal by the unit normal of the winding of the triangle.
+     *
+     * The normal of a counter-clockwise triangle points outward (right-hand rule). The normal of
+     * a degenerate triangle is only scaled to the unit length (it stays zero if it's zero).
+     */
+    void computeNormal();
+
 protected:
 
 private:
@@ -12,7 +12,14 @@
 #include <stdlib.h>
 #include "common.h"
 #include "CModel.h"
+#include "CScene.h"
 #include "CRenderer.h"
+#include "CLoadHandle.h"
+#include "CMeshCache.h"
+#include "CFileWatcher.h"
+#include <memory>
+#include <string>
+#include <vector>
 
 /**
  * @class CApp
@@ -73,7 +80,8 @@ public:
      * @brief Initializes the application.
      *
      * This function initializes the application, including creating application window, setting up the renderer
-     * and loading the STL file passed as a command line argument.
+     * and starting the loading of the STL file passed as a command line argument. The file is loaded in the
+     * background, so the model is drawn while it's being loaded.
      *
      * @return An error code indicating the result of the initialization.
      */
@@ -115,13 +123,14 @@ public:
     int updateMessageQueue();
 
     /**
-     * @brief Sets the input file name for the model.
+     * @brief Sets the input file names for the models.
      *
-     * This function stores the name of the input file to be loaded by the application.
+     * This function stores the names of the input files to be loaded by the application.
+     * Every file is loaded into its own model of the scene.
      *
-     * @param sFileName The name of the input file.
+     * @param vFileNames The names of the input files.
      */
-    void setFileName(const std::string & sFileName) { m_sInputFileName = sFileName; }
+    void setFileNames(const std::vector<std::string> &vFileNames) { m_vInputFileNames = vFileNames; }
 
     /**
      * @brief Handles a key press event.
@@ -152,6 +161,142 @@ private:
      */
     Err loadFile();
 
+    /**
+     * @brief Starts loading the models in a background thread.
+     *
+     * A single file is loaded with CStlLoader::loadFileAsync(); many files are loaded concurrently by the scene.
+     * If the thread of a single file can't be created, the model is loaded synchronously.
+     *
+     * @return An error code indicating the result of the synchronous loading, or Err::NoError if the thread was started.
+     */
+    Err startLoading();
+
+    /**
+     * @brief Checks whether the background loading is finished and collects its result.
+     *
+     * The loaded model was prepared by the loading thread (see prepareModel()), so it's only shown here.
+     *
+     * @return The result of the loading, or Err::NoError if it's still in progress.
+     */
+    Err checkLoading();
+
+    /**
+     * @brief Collects the results of loading many files and shows the models which were loaded.
+     *
+     * The models were prepared by the loading thread (see prepareScene()). The files which failed are reported
+     * in the log and left out of the scene.
+     *
+     * @return Err::NoError if any file was loaded; otherwise the error of the first file.
+     */
+    Err finishBatchLoading();
+
+    /**
+     * @brief Prepares the models of a loaded scene for viewing. Called by the loading thread of the scene.
+     *
+     * The models are normalized together and converted to the storages selected by the command line options.
+     *
+     * @param oScene The scene.
+     */
+    void prepareScene(CScene &oScene) const;
+
+    /**
+     * @brief Prepares the loaded model for viewing. Called by the loading thread, unless the model is loaded synchronously.
+     *
+     * The model is normalized and stored in the mesh cache, unless it was loaded from the cache already normalized.
+     *
+     * @param oModel The loaded model.
+     * @param oStats The statistics of the loading.
+     * @param oMeshCache The mesh cache entry of the loaded file.
+     */
+    void prepareModel(CModel &oModel, const CLoadStats &oStats, const CMeshCache &oMeshCache) const;
+
+    /**
+     * @brief Welds the vertices of a normalized model if the --weld option was given.
+     *
+     * @param oModel The model.
+     */
+    void weldModel(CModel &oModel) const;
+
+    /**
+     * @brief Computes the smooth vertex normals of a welded model if the --smooth option was given.
+     *
+     * @param oModel The model.
+     */
+    void smoothModel(CModel &oModel) const;
+
+    /**
+     * @brief Moves the facets of a model to the streams of coordinates if the --soa option was given.
+     *
+     * The --weld option takes precedence, so the model isn't streamed then.
+     *
+     * @param oModel The model.
+     */
+    void streamModel(CModel &oModel) const;
+
+    /**
+     * @brief Moves the facets of a normalized model to the quantized storage if the --quantize option was given.
+     *
+     * The --weld and --soa options take precedence, so the model isn't quantized then.
+     *
+     * @param oModel The model.
+     */
+    void quantizeModel(CModel &oModel) const;
+
+    /**
+     * @brief Builds the bounding volume hierarchy of a model if the --bvh option was given. The build time is logged.
+     *
+     * @param oModel The model.
+     */
+    void bvhModel(CModel &oModel) const;
+
+    /**
+     * @brief Benchmarks the bounding volume hierarchies of the input files if the --bench-bvh option was given.
+     *
+     * Each file is loaded into a model of its own and normalized. The times of building its hierarchy, of
+     * BenchmarkRays ray casts and of BenchmarkBoxes box queries at random positions in the unit cube are logged.
+     */
+    void benchmarkBvh() const;
+
+    /**
+     * @brief Benchmarks the loading of the input files if the --bench-load option was given.
+     *
+     * Each file is loaded BenchmarkLoads times by CStlLoader::loadFile() and a binary file also by the
+     * std::ifstream reference decoder CStlLoader::loadBinaryIfstream(); the best times are logged. The parse
+     * throughput of an ASCII file is logged in MB/s.
+     */
+    void benchmarkLoading() const;
+
+    /**
+     * @brief Parses the value of the --weld command line option.
+     *
+     * @param sValue The text following "--weld": empty or "=<tolerance>".
+     *
+     * @return An error code indicating whether the value is valid.
+     */
+    Err parseWeldOption(const std::string &sValue);
+
+    /**
+     * @brief Parses the value of the --quantize command line option.
+     *
+     * @param sValue The text following "--quantize": empty, "=8" or "=16".
+     *
+     * @return An error code indicating whether the value is valid.
+     */
+    Err parseQuantizeOption(const std::string &sValue);
+
+    /**
+     * @brief Reloads the displayed file when it's modified, e.g. exported again by a CAD application.
+     *
+     * The file is reloaded in the background into a second model, which replaces the displayed one
+     * when it's ready. The view state of the renderer and the orientation of the model are kept.
+     */
+    void checkReload();
+
+    /**
+     * @brief Starts reloading the displayed file in a background thread.
+     */
+    void startReload();
+
     /**
      * @brief Sets the window focus state.
      *
@@ -228,9 +373,34 @@ private:
 
     HWND m_hWindowHandle{nullptr}; ///< Handle to the application window.
     CRenderer m_oRenderer{}; ///< Renderer responsible for displaying the model.
-    CModel m_oModel{}; ///< Model representing the 3D object.
-    std::string m_sInputFileName{}; ///< The file name of the input model.
+    CScene m_oScene{}; ///< The models representing the 3D objects.
+    std::vector<std::string> m_vInputFileNames{}; ///< The file names of the input models.
     bool m_bWindowHasFocus{false}; ///< Flag indicating if the window has focus.
+    std::unique_ptr<CLoadHandle> m_pLoadHandle{}; ///< Handle of the background loading of the model.
+    CFileWatcher m_oFileWatcher{}; ///< Watcher of the displayed file.
+    std::unique_ptr<CModel> m_pReloadModel{}; ///< The model the file is reloaded into; it holds the previous version after a reload.
+    std::unique_ptr<CLoadHandle> m_pReloadHandle{}; ///< Handle of the background reloading of the model.
+    bool m_bWeld{false}; ///< True if the models are welded into indexed meshes.
+    float m_fWeldTolerance{0.0f}; ///< The welding tolerance in the normalized coordinates.
+    bool m_bSmooth{false}; ///< True if the welded models are drawn with smooth vertex normals.
+    bool m_bStream{false}; ///< True if the models are kept in the streams of coordinates.
+    bool m_bQuantize{false}; ///< True if the models are kept in the quantized storage.
+    uint32_t m_u32NormalBits{8}; ///< The number of bits of each coordinate of a quantized normal.
+    bool m_bBvh{false}; ///< True if the bounding volume hierarchies of the models are built and benchmarked.
+    bool m_bBenchLoad{false}; ///< True if the loading of the input files is benchmarked before they are shown.
+    bool m_bBenchBvh{false}; ///< True if the bounding volume hierarchies of the input files are benchmarked before they are shown.
+
+    static constexpr const char *WeldOption = "--weld"; ///< The command line option enabling the welding.
+    static constexpr const char *SmoothOption = "--smooth"; ///< The command line option enabling the welding and the smooth vertex normals.
+    static constexpr const char *StreamOption = "--soa"; ///< The command line option enabling the streams of coordinates.
+    static constexpr const char *QuantizeOption = "--quantize"; ///< The command line option enabling the quantized storage.
+    static constexpr const char *BvhOption = "--bvh"; ///< The command line option enabling the bounding volume hierarchy.
+    static constexpr const char *BenchBvhOption = "--bench-bvh"; ///< The command line option enabling the benchmark of the bounding volume hierarchy.
+    static constexpr uint32_t BenchmarkRays = 10000; ///< Number of rays cast by the benchmark of the bounding volume hierarchy.
+    static constexpr uint32_t BenchmarkBoxes = 1000; ///< Number of boxes queried by the benchmark of the bounding volume hierarchy.
+    static constexpr float BenchmarkBoxSize = 0.05f; ///< The size of the queried boxes in the normalized coordinates.
+    static constexpr const char *BenchLoadOption = "--bench-load"; ///< The command line option enabling the benchmark of the loading.
+    static constexpr uint32_t BenchmarkLoads = 3; ///< Number of times each file is loaded by each decoder of the loading benchmark.
 
     // Flags and positions for mouse dragging behavior.
     bool m_bLmbDragging{false}; ///< Flag for left mouse button dragging.
@@ -0,0 +1,90 @@
+/**
+ * @file CBoundingBox.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CBOUNDINGBOX_H_INCLUDED
+#define STL_VIEWER_CBOUNDINGBOX_H_INCLUDED
+
+#include "C3DFacet.h"
+#include "CVector3d.h"
+
+/**
+ * @class CBoundingBox
+ * @brief Axis-aligned box enclosing a set of points.
+ *
+ * The box is empty (invalid) until the first point is added.
+ */
+class CBoundingBox
+{
+public:
+    /**
+     * @brief Makes the box empty.
+     */
+    void reset() { m_bValid = false; }
+
+    /**
+     * @brief Extends the box to enclose a point.
+     *
+     * @param oPoint The point to enclose.
+     */
+    void add(const CVector3d &oPoint);
+
+    /**
+     * @brief Extends the box to enclose the vertices of a facet (the normal is ignored).
+     *
+     * @param oFacet The facet to enclose.
+     */
+    void add(const C3DFacet &oFacet);
+
+    /**
+     * @brief Extends the box to enclose another box.
+     *
+     * @param oBox The box to enclose.
+     */
+    void add(const CBoundingBox &oBox);
+
+    /**
+     * @brief Checks whether the box encloses any point.
+     *
+     * @return True if at least one point was added; otherwise false.
+     */
+    bool isValid() const { return m_bValid; }
+
+    /**
+     * @brief Gets the corner with the minimal coordinates.
+     *
+     * @return The minimal corner of the box.
+     */
+    const CVector3d &getMin() const { return m_oMin; }
+
+    /**
+     * @brief Gets the corner with the maximal coordinates.
+     *
+     * @return The maximal corner of the box.
+     */
+    const CVector3d &getMax() const { return m_oMax; }
+
+    /**
+     * @brief Gets the center of the box.
+     *
+     * @return The point in the middle of the box.
+     */
+    CVector3d getCenter() const;
+
+    /**
+     * @brief Gets the size of the box in its largest dimension.
+     *
+     * @return The largest of the box dimensions.
+     */
+    float getMaxExtent() const;
+
+private:
+    CVector3d m_oMin{0.0f, 0.0f, 0.0f}; ///< The corner with the minimal coordinates.
+    CVector3d m_oMax{0.0f, 0.0f, 0.0f}; ///< The corner with the maximal coordinates.
+    bool m_bValid{false}; ///< True if the box encloses any point.
+};
+
+#endif // STL_VIEWER_CBOUNDINGBOX_H_INCLUDED
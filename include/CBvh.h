@@ -0,0 +1,174 @@
+/**
+ * @file CBvh.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CBVH_H_INCLUDED
+#define STL_VIEWER_CBVH_H_INCLUDED
+
+#include <stdint.h>
+#include <vector>
+#include <functional>
+#include "common.h"
+#include "C3DFacet.h"
+#include "CVector3d.h"
+#include "CBoundingBox.h"
+
+/**
+ * @class CBvh
+ * @brief Bounding volume hierarchy over the facets of a model, for the ray casts and the box queries.
+ *
+ * Every node is an axis-aligned box enclosing the facets below it. The tree is built top-down: the facets
+ * of a node are split by the plane which minimizes the surface area heuristic (SAH), i.e. the expected cost
+ * of a ray passing the node. The candidate planes are the borders of 16 bins along each axis, so a node is
+ * split in linear time. The bins of large nodes are filled by all threads of the pool and the subtrees are
+ * built in parallel.
+ *
+ * A node takes 32 bytes, so two nodes share a cache line. The children of a node are stored next to each
+ * other, so they are tested together, and a leaf refers to a range of the facet indices sorted by the leaves.
+ * The facets aren't copied; they are read through a function given by the owner (see FacetGetter).
+ *
+ * When the facets move, the boxes are refitted without changing the tree (see refit()). A translation with
+ * a scale and a rotation by multiples of 90 degrees are applied to the boxes directly.
+ */
+class CBvh
+{
+public:
+    /**
+     * @brief The function reading a facet of the model: C3DFacet getFacet(uint32_t u32Facet).
+     *
+     * The function is called by many threads at once while the tree is built or refitted.
+     */
+    using FacetGetter = std::function<C3DFacet(uint32_t)>;
+
+    /**
+     * @struct Hit
+     * @brief The nearest facet hit by a ray.
+     */
+    struct Hit
+    {
+        float fDistance{0.0f}; ///< The distance of the hit point from the origin of the ray in the lengths of the direction vector.
+        uint32_t u32Facet{0}; ///< The index of the facet.
+        float fU{0.0f}; ///< The barycentric coordinate of the hit point related to the second corner of the facet.
+        float fV{0.0f}; ///< The barycentric coordinate of the hit point related to the third corner of the facet.
+    };
+
+    /**
+     * @brief Builds the tree over the facets.
+     *
+     * @param u32Facets The number of facets.
+     * @param getFacet The function reading a facet.
+     *
+     * @return An error code indicating the result of the operation; Err::MemAlloc if the tree can't be allocated.
+     */
+    Err build(uint32_t u32Facets, const FacetGetter &getFacet);
+
+    /**
+     * @brief Recomputes the boxes of the nodes after the facets moved; the tree isn't changed.
+     *
+     * The leaves are refitted in parallel, then the boxes of the inner nodes are merged bottom-up.
+     * The tree may become less efficient if the facets move much.
+     *
+     * @param getFacet The function reading a facet.
+     */
+    void refit(const FacetGetter &getFacet);
+
+    /**
+     * @brief Moves and scales the boxes like the facets: p' = (p - oShift) * fScale.
+     *
+     * The boxes are widened by the rounding error, so they enclose the facets transformed by the same formula.
+     *
+     * @param oShift The vector subtracted from the corners.
+     * @param fScale The scale applied after the shift; not negative.
+     */
+    void transform(const CVector3d &oShift, float fScale);
+
+    /**
+     * @brief Rotates the boxes like the facets by a rotation which maps every axis to an axis.
+     *
+     * @param afMatrix The row-major 3x3 matrix; every row has a single element equal to 1 or -1.
+     */
+    void reorient(const float afMatrix[9]);
+
+    /**
+     * @brief Removes the tree.
+     */
+    void clear();
+
+    /**
+     * @brief Checks whether the tree is built.
+     *
+     * @return True if there's no tree; otherwise false.
+     */
+    bool isEmpty() const { return m_vNodes.empty(); }
+
+    /**
+     * @brief Gets the number of nodes.
+     *
+     * @return The number of nodes, inner nodes and leaves.
+     */
+    uint32_t getNodeCount() const { return static_cast<uint32_t>(m_vNodes.size()); }
+
+    /**
+     * @brief Gets the number of levels of the tree.
+     *
+     * @return The number of nodes on the longest path from the root to a leaf.
+     */
+    uint32_t getDepth() const { return m_u32Depth; }
+
+    /**
+     * @brief Gets the size of the memory taken by the tree.
+     *
+     * @return The size in bytes.
+     */
+    uint64_t getMemorySize() const { return m_vNodes.size() * sizeof(Node) + m_vFacets.size() * sizeof(uint32_t); }
+
+    /**
+     * @brief Finds the nearest facet hit by a ray. Both sides of the facets are hit.
+     *
+     * @param oOrigin The origin of the ray.
+     * @param oDirection The direction of the ray; it doesn't have to be a unit vector.
+     * @param getFacet The function reading a facet.
+     * @param oHit Receives the nearest hit.
+     *
+     * @return True if a facet was hit; otherwise false.
+     */
+    bool rayCast(const CVector3d &oOrigin, const CVector3d &oDirection, const FacetGetter &getFacet, Hit &oHit) const;
+
+    /**
+     * @brief Finds the facets whose bounding boxes overlap a box.
+     *
+     * @param oBox The box.
+     * @param getFacet The function reading a facet.
+     * @param vFacets Receives the indices of the facets; the previous content is removed.
+     */
+    void queryBox(const CBoundingBox &oBox, const FacetGetter &getFacet, std::vector<uint32_t> &vFacets) const;
+
+private:
+    /**
+     * @struct Node
+     * @brief A node of the tree: a box and either two children or a range of facets.
+     */
+    struct Node
+    {
+        float afMin[3]{0.0f, 0.0f, 0.0f}; ///< The minimum corner of the box.
+        uint32_t u32Offset{0}; ///< Inner node: the index of the first child, followed by the second one; leaf: the first facet in m_vFacets.
+        float afMax[3]{0.0f, 0.0f, 0.0f}; ///< The maximum corner of the box.
+        uint16_t u16Count{0}; ///< The number of facets of a leaf; 0 for an inner node.
+        uint16_t u16Axis{0}; ///< The axis of the split plane of an inner node: 0 for X, 1 for Y, 2 for Z.
+    };
+
+    class CBuilder;
+
+    static constexpr uint32_t MaxLeafFacets = 16; ///< The largest number of facets in a leaf.
+    static constexpr uint32_t MaxDepth = 64; ///< The largest number of levels, which bounds the stack of the traversal.
+    static constexpr uint32_t ChunkFacets = 16384; ///< Number of facets or nodes processed by one task.
+
+    std::vector<Node> m_vNodes{}; ///< The nodes; the root is the first one.
+    std::vector<uint32_t> m_vFacets{}; ///< The indices of the facets sorted by the leaves.
+    uint32_t m_u32Depth{0}; ///< The number of levels of the tree.
+};
+
+#endif // STL_VIEWER_CBVH_H_INCLUDED
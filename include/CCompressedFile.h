@@ -0,0 +1,284 @@
+/**
+ * @file CCompressedFile.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CCOMPRESSEDFILE_H_INCLUDED
+#define STL_VIEWER_CCOMPRESSEDFILE_H_INCLUDED
+
+#include <windows.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "CCriticalSection.h"
+#include "CMappedFile.h"
+
+/**
+ * @class CCompressedFile
+ * @brief Sequential reader of a gzip or zstd compressed file, or of the data of a pipe.
+ *
+ * The compressed file is read from a mapped file and decompressed by a background thread into
+ * a ring of blocks, so the decompression overlaps the processing of the data. A pipe, which can't
+ * be mapped nor seeked, is read into the blocks by the background thread the same way. The reader gives
+ * the decompressed data through a window: the data which wasn't consumed yet stays at the beginning
+ * of the window when it's filled again, so a record cut by the end of the window is complete
+ * after the next fill().
+ *
+ * The gzip support is compiled with ZLIB_ENABLED (link with -lz) and the zstd support with
+ * ZSTD_ENABLED (link with -lzstd). Without them the compressed files are detected, but open()
+ * fails with Err::UnsupportedCompression.
+ *
+ * The data of a pipe isn't decompressed. A read of a pipe blocks until the writer writes more data,
+ * so close() cancels the pending read; a stalled writer can't keep the reader open. The reader
+ * waiting in fill() is released by the cancel event (see setCancelEvent()).
+ */
+class CCompressedFile
+{
+public:
+    /**
+     * @enum Compression
+     * @brief The compression format of a file.
+     */
+    enum class Compression { none, gzip, zstd };
+
+    /**
+     * @brief Detects the compression format from the magic bytes at the beginning of the file.
+     *
+     * @param oFile The open file.
+     *
+     * @return The compression format of the file.
+     */
+    static Compression detectCompression(const CMappedFile &oFile);
+
+    /**
+     * @brief Default constructor.
+     */
+    CCompressedFile() = default;
+
+    /**
+     * @brief Deleted copy constructor; the object owns the decompression thread.
+     */
+    CCompressedFile(const CCompressedFile &) = delete;
+
+    /**
+     * @brief Deleted assignment operator; the object owns the decompression thread.
+     */
+    CCompressedFile &operator=(const CCompressedFile &) = delete;
+
+    /**
+     * @brief Destructor stopping the decompression.
+     */
+    ~CCompressedFile() { close(); }
+
+    /**
+     * @brief Starts the decompression of a file.
+     *
+     * @param oFile The open compressed file; it must stay open until close().
+     * @param compression The compression format of the file.
+     * @param windowSize The capacity of the window in bytes.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err open(const CMappedFile &oFile, Compression compression, size_t windowSize);
+
+    /**
+     * @brief Starts reading a pipe or another stream which can't be mapped.
+     *
+     * @param hInput The handle of the stream, e.g. the standard input; it must stay open until close().
+     * @param windowSize The capacity of the window in bytes.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err open(HANDLE hInput, size_t windowSize);
+
+    /**
+     * @brief Stops the decompression and releases the buffers.
+     */
+    void close();
+
+    /**
+     * @brief Sets an event which stops fill() waiting for the data, e.g. when the loading is cancelled.
+     *
+     * When the event is signaled, the data ends and getError() returns Err::LoadCancelled. The event
+     * is kept by open() and close().
+     *
+     * @param hCancelEvent The manual-reset event, which must outlive the reading; nullptr if the reading can't be cancelled.
+     */
+    void setCancelEvent(HANDLE hCancelEvent) { m_hCancelEvent = hCancelEvent; }
+
+    /**
+     * @brief Fills the window with decompressed data. The data not consumed yet is kept.
+     *
+     * The function waits for the decompression thread until the window is full or the data ends.
+     */
+    void fill();
+
+    /**
+     * @brief Gets the data of the window which wasn't consumed yet.
+     *
+     * @return Pointer to the first byte not consumed.
+     */
+    const uint8_t *getData() const { return m_vWindow.data() + m_windowBegin; }
+
+    /**
+     * @brief Gets the number of bytes of the window which weren't consumed yet.
+     *
+     * @return Number of bytes available at getData().
+     */
+    size_t getSize() const { return m_windowEnd - m_windowBegin; }
+
+    /**
+     * @brief Marks bytes at the beginning of the window as consumed.
+     *
+     * @param size Number of bytes consumed; must not be bigger than getSize().
+     */
+    void consume(size_t size) { m_windowBegin += size; }
+
+    /**
+     * @brief Checks whether the window holds the end of the decompressed data.
+     *
+     * @return True if no more data will be added to the window; otherwise false.
+     */
+    bool isEnd() const { return m_bEnd; }
+
+    /**
+     * @brief Gets the number of decompressed bytes consumed so far.
+     *
+     * @return The position of getData() in the decompressed data.
+     */
+    uint64_t getPosition() const { return m_u64WindowOffset + m_windowBegin; }
+
+    /**
+     * @brief Gets the number of compressed bytes read by the decompression thread so far.
+     *
+     * @return The position in the compressed file.
+     */
+    uint64_t getInputPosition() const;
+
+    /**
+     * @brief Gets the result of the decompression. The result is final when isEnd() is true.
+     *
+     * @param sText Receives the description of the error.
+     *
+     * @return An error code indicating the result of the decompression.
+     */
+    Err getError(std::string &sText) const;
+
+private:
+    /**
+     * @brief Allocates the buffers and starts the decompression thread.
+     *
+     * @param windowSize The capacity of the window in bytes.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err start(size_t windowSize);
+
+    /**
+     * @brief Main function of the decompression thread.
+     *
+     * @param pParam Pointer to the reader.
+     *
+     * @return The exit code of the thread.
+     */
+    static DWORD WINAPI decompressThread(LPVOID pParam);
+
+    /**
+     * @brief Decompresses a gzip file into the blocks. Concatenated gzip members are supported.
+     *
+     * @return An error code indicating the result of the decompression.
+     */
+    Err decompressGzip();
+
+    /**
+     * @brief Decompresses a zstd file into the blocks. Concatenated zstd frames are supported.
+     *
+     * @return An error code indicating the result of the decompression.
+     */
+    Err decompressZstd();
+
+    /**
+     * @brief Copies the data of the input stream into the blocks.
+     *
+     * @return An error code indicating the result of the reading.
+     */
+    Err readStream();
+
+    /**
+     * @brief Maps the next part of the compressed file. Called by the decompression thread.
+     *
+     * @param oView Receives the mapped part.
+     * @param u64Offset File offset of the part; advanced by the size of the part.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err mapInput(CMappedView &oView, uint64_t &u64Offset);
+
+    /**
+     * @brief Waits for a free block. Called by the decompression thread.
+     *
+     * @return Pointer to the block, or nullptr if the decompression shall stop.
+     */
+    uint8_t *acquireBlock();
+
+    /**
+     * @brief Passes the block acquired last to the reader. Called by the decompression thread.
+     *
+     * @param size Number of bytes written to the block; 0 marks the end of the data.
+     */
+    void commitBlock(size_t size);
+
+    /**
+     * @brief Sets the result of the decompression. Called by the decompression thread.
+     *
+     * @param error The error code.
+     * @param sText The description of the error.
+     */
+    void setError(Err error, const std::string &sText);
+
+    /**
+     * @brief Copies decompressed data from the blocks. Waits for the decompression thread if needed.
+     *
+     * @param pBuffer The destination buffer.
+     * @param size Number of bytes to copy.
+     *
+     * @return Number of bytes copied; less than size only at the end of the data.
+     */
+    size_t read(uint8_t *pBuffer, size_t size);
+
+    static constexpr uint32_t BlockCount = 4; ///< Number of blocks of the ring.
+    static constexpr size_t BlockSize = 1024*1024; ///< Size of one block of decompressed data.
+    static constexpr size_t InputViewSize = 4*1024*1024; ///< Size of one mapped part of the compressed file.
+    static constexpr DWORD StopRetryMs = 100; ///< Interval of cancelling the pending read of a pipe while close() waits for the thread.
+
+    const CMappedFile *m_pFile{nullptr}; ///< The compressed file.
+    HANDLE m_hInput{INVALID_HANDLE_VALUE}; ///< The input stream read without decompression.
+    Compression m_compression{Compression::none}; ///< The compression format of the file.
+    std::vector<uint8_t> m_vBlocks{}; ///< The ring of blocks of decompressed data.
+    size_t m_aBlockSizes[BlockCount]{}; ///< Number of bytes in each block.
+    uint32_t m_u32WriteBlock{0}; ///< The block written by the decompression thread.
+    uint32_t m_u32ReadBlock{0}; ///< The block read by the reader.
+    size_t m_blockPos{0}; ///< Position of the reader in its block.
+    bool m_bBlockTaken{false}; ///< True if the reader holds a filled block.
+    std::vector<uint8_t> m_vWindow{}; ///< The window of decompressed data.
+    size_t m_windowBegin{0}; ///< Position of the first byte not consumed.
+    size_t m_windowEnd{0}; ///< Position after the last byte of the window.
+    uint64_t m_u64WindowOffset{0}; ///< Position of the window in the decompressed data.
+    bool m_bEnd{false}; ///< True if the end of the data was read into the window.
+    HANDLE m_hThread{nullptr}; ///< Handle of the decompression thread.
+    HANDLE m_hFreeBlocks{nullptr}; ///< Semaphore counting the blocks free for the decompression thread.
+    HANDLE m_hFilledBlocks{nullptr}; ///< Semaphore counting the blocks filled for the reader.
+    HANDLE m_hCancelEvent{nullptr}; ///< Event stopping the reader waiting for the blocks; not owned.
+    std::atomic<bool> m_bStop{false}; ///< True when the decompression thread shall stop.
+    mutable CCriticalSection m_oLock{}; ///< Lock of the state shared with the decompression thread.
+    uint64_t m_u64InputPosition{0}; ///< Number of compressed bytes read (guarded by m_oLock).
+    Err m_error{Err::NoError}; ///< The result of the decompression (guarded by m_oLock).
+    std::string m_sErrorText{}; ///< The description of the error (guarded by m_oLock).
+};
+
+#endif // STL_VIEWER_CCOMPRESSEDFILE_H_INCLUDED
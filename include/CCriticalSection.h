@@ -0,0 +1,89 @@
+/**
+ * @file CCriticalSection.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CCRITICALSECTION_H_INCLUDED
+#define STL_VIEWER_CCRITICALSECTION_H_INCLUDED
+
+#include <windows.h>
+
+/**
+ * @class CCriticalSection
+ * @brief Owner of a Win32 critical section.
+ *
+ * The critical section is recursive: the thread which entered it may enter it again.
+ */
+class CCriticalSection
+{
+public:
+    /**
+     * @brief Constructor initializing the critical section.
+     */
+    CCriticalSection() : m_criticalSection{} { InitializeCriticalSection(&m_criticalSection); }
+
+    /**
+     * @brief Deleted copy constructor; a critical section can't be copied.
+     */
+    CCriticalSection(const CCriticalSection &) = delete;
+
+    /**
+     * @brief Deleted assignment operator; a critical section can't be copied.
+     */
+    CCriticalSection &operator=(const CCriticalSection &) = delete;
+
+    /**
+     * @brief Destructor deleting the critical section.
+     */
+    ~CCriticalSection() { DeleteCriticalSection(&m_criticalSection); }
+
+    /**
+     * @brief Waits for the ownership of the critical section.
+     */
+    void enter() { EnterCriticalSection(&m_criticalSection); }
+
+    /**
+     * @brief Releases the ownership of the critical section.
+     */
+    void leave() { LeaveCriticalSection(&m_criticalSection); }
+
+private:
+    CRITICAL_SECTION m_criticalSection; ///< The system object.
+};
+
+/**
+ * @class CLockGuard
+ * @brief Holds a critical section for the lifetime of the object.
+ */
+class CLockGuard
+{
+public:
+    /**
+     * @brief Constructor entering the critical section.
+     *
+     * @param oCriticalSection The critical section to hold.
+     */
+    explicit CLockGuard(CCriticalSection &oCriticalSection) : m_oCriticalSection(oCriticalSection) { m_oCriticalSection.enter(); }
+
+    /**
+     * @brief Deleted copy constructor; the ownership can't be shared.
+     */
+    CLockGuard(const CLockGuard &) = delete;
+
+    /**
+     * @brief Deleted assignment operator; the ownership can't be shared.
+     */
+    CLockGuard &operator=(const CLockGuard &) = delete;
+
+    /**
+     * @brief Destructor leaving the critical section.
+     */
+    ~CLockGuard() { m_oCriticalSection.leave(); }
+
+private:
+    CCriticalSection &m_oCriticalSection; ///< The held critical section.
+};
+
+#endif // STL_VIEWER_CCRITICALSECTION_H_INCLUDED
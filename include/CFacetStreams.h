@@ -0,0 +1,160 @@
+/**
+ * @file CFacetStreams.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CFACETSTREAMS_H_INCLUDED
+#define STL_VIEWER_CFACETSTREAMS_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "common.h"
+#include "C3DFacet.h"
+#include "CVector3d.h"
+#include "CBoundingBox.h"
+
+/**
+ * @class CFacetStreams
+ * @brief Facet storage with separate streams of the coordinates (structure of arrays).
+ *
+ * The X, Y and Z coordinates of the corners are kept in three contiguous streams, and the coordinates
+ * of the normals in three more. The corners of the facet i are the elements 3i, 3i+1 and 3i+2 of the
+ * position streams and its normal is the element i of the normal streams. Every stream starts at
+ * a cache line and is padded to a whole cache line with its last value, so the whole-model passes
+ * process four coordinates per SSE instruction without any tail, and the padding doesn't change the
+ * bounding box. The translation and scaling are split among the threads of the pool.
+ *
+ * A rotation by multiples of 90 degrees only permutes the streams and negates some of them.
+ */
+class CFacetStreams
+{
+public:
+    /**
+     * @brief Default constructor.
+     */
+    CFacetStreams() = default;
+
+    /**
+     * @brief Deleted copy constructor; the object owns the memory of the streams.
+     */
+    CFacetStreams(const CFacetStreams &) = delete;
+
+    /**
+     * @brief Deleted assignment operator; the object owns the memory of the streams.
+     */
+    CFacetStreams &operator=(const CFacetStreams &) = delete;
+
+    /**
+     * @brief Destructor releasing the streams.
+     */
+    ~CFacetStreams() { clear(); }
+
+    /**
+     * @brief Fills the streams with the facets.
+     *
+     * @param vFacets The facets of the model.
+     *
+     * @return An error code indicating the result of the operation; Err::MemAlloc if the streams can't be allocated.
+     */
+    Err build(const std::vector<C3DFacet> &vFacets);
+
+    /**
+     * @brief Releases the streams.
+     */
+    void clear();
+
+    /**
+     * @brief Checks whether the streams hold any facets.
+     *
+     * @return True if there are no facets; otherwise false.
+     */
+    bool isEmpty() const { return 0 == m_u32Facets; }
+
+    /**
+     * @brief Gets the number of facets.
+     *
+     * @return The number of facets.
+     */
+    uint32_t getFacetCount() const { return m_u32Facets; }
+
+    /**
+     * @brief Gets a stream of the corner coordinates.
+     *
+     * @param u32Axis The axis: 0 for X, 1 for Y, 2 for Z.
+     *
+     * @return Pointer to the 3 * getFacetCount() coordinates, aligned to a cache line.
+     */
+    const float *getPositions(uint32_t u32Axis) const { return m_apPositions[u32Axis]; }
+
+    /**
+     * @brief Puts a facet together from the streams.
+     *
+     * @param u32Facet The index of the facet.
+     *
+     * @return The facet.
+     */
+    C3DFacet getFacet(uint32_t u32Facet) const;
+
+    /**
+     * @brief Puts a range of facets together from the streams, e.g. to draw them.
+     *
+     * @param u32First The index of the first facet.
+     * @param u32Count The number of facets.
+     * @param pFacets Receives the facets.
+     */
+    void getFacets(uint32_t u32First, uint32_t u32Count, C3DFacet *pFacets) const;
+
+    /**
+     * @brief Stores a facet in the streams.
+     *
+     * @param u32Facet The index of the facet.
+     * @param oFacet The facet.
+     */
+    void setFacet(uint32_t u32Facet, const C3DFacet &oFacet);
+
+    /**
+     * @brief Finds the bounding box of all corners.
+     *
+     * @return The bounding box; invalid if there are no facets.
+     */
+    CBoundingBox getBoundingBox() const;
+
+    /**
+     * @brief Moves and scales all corners: p' = (p - oShift) * fScale. The normals don't change.
+     *
+     * @param oShift The vector subtracted from the corners.
+     * @param fScale The scale applied after the shift.
+     */
+    void transform(const CVector3d &oShift, float fScale);
+
+    /**
+     * @brief Rotates the corners and the normals by a rotation which maps every axis to an axis.
+     *
+     * Such a rotation is a combination of 90-degree rotations, e.g. the model transform of CModel.
+     *
+     * @param afMatrix The row-major 3x3 matrix; every row has a single element equal to 1 or -1.
+     */
+    void reorient(const float afMatrix[9]);
+
+    /**
+     * @brief Gets the size of the memory taken by the streams.
+     *
+     * @return The size in bytes.
+     */
+    uint64_t getMemorySize() const;
+
+private:
+    static constexpr size_t Alignment = 64; ///< The alignment of the streams in bytes; a cache line.
+
+    float *m_pMemory{nullptr}; ///< The memory of all streams.
+    float *m_apPositions[3]{nullptr, nullptr, nullptr}; ///< The streams of the X, Y and Z coordinates of the corners.
+    float *m_apNormals[3]{nullptr, nullptr, nullptr}; ///< The streams of the X, Y and Z coordinates of the normals.
+    uint32_t m_u32Facets{0}; ///< The number of facets.
+    uint32_t m_u32PositionStride{0}; ///< The padded length of a position stream in floats.
+    uint32_t m_u32NormalStride{0}; ///< The padded length of a normal stream in floats.
+};
+
+#endif // STL_VIEWER_CFACETSTREAMS_H_INCLUDED
@@ -0,0 +1,101 @@
+/**
+ * @file CFileWatcher.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CFILEWATCHER_H_INCLUDED
+#define STL_VIEWER_CFILEWATCHER_H_INCLUDED
+
+#include <windows.h>
+#include <stdint.h>
+#include <string>
+#include "common.h"
+#include "CStopwatch.h"
+
+/**
+ * @class CFileWatcher
+ * @brief Detects the modifications of a file, e.g. an STL file exported again by a CAD application.
+ *
+ * The directory of the file is watched with a change notification, so checking for a change doesn't touch
+ * the file system until something in the directory changes. The applications write a file in many steps,
+ * so a modification is reported only when no change was seen for SettleMs milliseconds, and only if the size
+ * or the modification time of the file differ from the ones of the version reported last.
+ *
+ * hasChanged() doesn't block, so it's called from the message loop of the application.
+ */
+class CFileWatcher
+{
+public:
+    /**
+     * @brief Default constructor.
+     */
+    CFileWatcher() = default;
+
+    /**
+     * @brief Deleted copy constructor; the object owns the change notification handle.
+     */
+    CFileWatcher(const CFileWatcher &) = delete;
+
+    /**
+     * @brief Deleted assignment operator; the object owns the change notification handle.
+     */
+    CFileWatcher &operator=(const CFileWatcher &) = delete;
+
+    /**
+     * @brief Destructor stopping the watching.
+     */
+    ~CFileWatcher() { stop(); }
+
+    /**
+     * @brief Starts watching a file. The current version of the file isn't reported as a change.
+     *
+     * @param sFileName The name of the file.
+     *
+     * @return An error code indicating the result of the operation; Err::FileWatch if the file can't be watched.
+     */
+    Err start(const std::string &sFileName);
+
+    /**
+     * @brief Stops watching the file.
+     */
+    void stop();
+
+    /**
+     * @brief Checks whether a file is watched.
+     *
+     * @return True if start() succeeded; otherwise false.
+     */
+    bool isWatching() const { return INVALID_HANDLE_VALUE != m_hChange; }
+
+    /**
+     * @brief Checks whether the file was modified since the last check. The function doesn't block.
+     *
+     * @return True once for every new version of the file; otherwise false.
+     */
+    bool hasChanged();
+
+private:
+    /**
+     * @brief Gets the size and the last modification time of a file.
+     *
+     * @param sFileName The name of the file.
+     * @param u64Size Receives the size of the file.
+     * @param u64Time Receives the last modification time of the file (FILETIME).
+     *
+     * @return True if the attributes of the file were read; otherwise false.
+     */
+    static bool getFileVersion(const std::string &sFileName, uint64_t &u64Size, uint64_t &u64Time);
+
+    static constexpr double SettleMs = 500.0; ///< Time without changes after which the file is checked.
+
+    std::string m_sFileName{}; ///< The full name of the watched file.
+    HANDLE m_hChange{INVALID_HANDLE_VALUE}; ///< Change notification handle of the directory of the file.
+    uint64_t m_u64Size{0}; ///< Size of the version of the file reported last.
+    uint64_t m_u64Time{0}; ///< Modification time of the version of the file reported last.
+    bool m_bPending{false}; ///< True if the directory changed and the file wasn't checked yet.
+    CStopwatch m_oSettleTime{}; ///< Time since the last change of the directory.
+};
+
+#endif // STL_VIEWER_CFILEWATCHER_H_INCLUDED
@@ -0,0 +1,194 @@
+/**
+ * @file CIndexedMesh.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CINDEXEDMESH_H_INCLUDED
+#define STL_VIEWER_CINDEXEDMESH_H_INCLUDED
+
+#include <stdint.h>
+#include <vector>
+#include "common.h"
+#include "C3DFacet.h"
+#include "CVector3d.h"
+
+/**
+ * @class CIndexedMesh
+ * @brief Triangle mesh with welded vertices: the unique vertex positions and three vertex indices per triangle.
+ *
+ * An STL file stores every corner of every triangle separately, so a vertex shared by six triangles is stored
+ * six times. The indexed mesh keeps each position once, which takes about 18 bytes per triangle instead of
+ * the 48 bytes of C3DFacet, and tells which triangles share a vertex.
+ *
+ * The facet normals aren't stored; getFacet() computes them from the winding of the triangles. Smooth vertex
+ * normals can be added by computeVertexNormals(); then the mesh can be drawn straight from its arrays.
+ */
+class CIndexedMesh
+{
+public:
+    /**
+     * @brief Welds the corners of the facets into the indexed mesh.
+     *
+     * With a zero tolerance only the corners with equal coordinates are welded. Otherwise the space is
+     * divided into cubic cells with the edge of the tolerance and the corners in the same cell are welded,
+     * so corners closer than the tolerance are usually welded, and corners in different cells never are.
+     *
+     * The corners are hashed and distributed into buckets, which are deduplicated in parallel. The vertices
+     * are numbered in the order of their first use, so the triangles which are close in the file use
+     * vertices which are close in memory.
+     *
+     * @param vFacets The facets of the model.
+     * @param fTolerance The size of the welding cells; 0 for exact welding.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err build(const std::vector<C3DFacet> &vFacets, float fTolerance);
+
+    /**
+     * @brief Computes the smooth normals of the vertices.
+     *
+     * The normal of a vertex is the sum of the normals of the triangles using it, weighted by their areas,
+     * so a large triangle affects the shading more than a sliver. The normals are stored as unit vectors.
+     * The triangle normals are computed in parallel, then the triangles using each vertex are gathered and
+     * the vertex normals are summed in parallel, so no vertex is written by two threads.
+     *
+     * @return An error code indicating the result of the operation; the mesh is unchanged if it failed.
+     */
+    Err computeVertexNormals();
+
+    /**
+     * @brief Removes all vertices, normals and triangles.
+     */
+    void clear();
+
+    /**
+     * @brief Checks whether the mesh has any triangles.
+     *
+     * @return True if the mesh is empty; otherwise false.
+     */
+    bool isEmpty() const { return m_vIndices.empty(); }
+
+    /**
+     * @brief Gets the number of triangles.
+     *
+     * @return The number of triangles.
+     */
+    uint32_t getTriangleCount() const { return static_cast<uint32_t>(m_vIndices.size() / 3); }
+
+    /**
+     * @brief Gets the number of unique vertices.
+     *
+     * @return The number of vertices.
+     */
+    uint32_t getVertexCount() const { return static_cast<uint32_t>(m_vVertices.size()); }
+
+    /**
+     * @brief Gets the vertex positions, e.g. to transform them.
+     *
+     * @return A reference to the vertices.
+     */
+    std::vector<CVector3d> &getVertices() { return m_vVertices; }
+
+    /**
+     * @brief Gets the vertex positions (const version).
+     *
+     * @return A const reference to the vertices.
+     */
+    const std::vector<CVector3d> &getVertices() const { return m_vVertices; }
+
+    /**
+     * @brief Checks whether the vertices have smooth normals (see computeVertexNormals()).
+     *
+     * @return True if there's a normal for every vertex; otherwise false.
+     */
+    bool hasVertexNormals() const { return !m_vNormals.empty(); }
+
+    /**
+     * @brief Gets the unit normals of the vertices, e.g. to rotate them.
+     *
+     * @return A reference to the normals; empty if they weren't computed.
+     */
+    std::vector<CVector3d> &getNormals() { return m_vNormals; }
+
+    /**
+     * @brief Gets the unit normals of the vertices (const version).
+     *
+     * @return A const reference to the normals; empty if they weren't computed.
+     */
+    const std::vector<CVector3d> &getNormals() const { return m_vNormals; }
+
+    /**
+     * @brief Gets the vertex indices; the triangle t uses the vertices with indices 3t, 3t+1 and 3t+2.
+     *
+     * @return A const reference to the indices.
+     */
+    const std::vector<uint32_t> &getIndices() const { return m_vIndices; }
+
+    /**
+     * @brief Puts a triangle together as a facet.
+     *
+     * @param u32Triangle The index of the triangle.
+     *
+     * @return The facet with the normal computed from the winding of the triangle (zero for a degenerate triangle).
+     */
+    C3DFacet getFacet(uint32_t u32Triangle) const;
+
+    /**
+     * @brief Gets the size of the memory taken by the vertices, their normals and the indices.
+     *
+     * @return The size in bytes.
+     */
+    uint64_t getMemorySize() const { return (m_vVertices.size() + m_vNormals.size()) * sizeof(CVector3d) + m_vIndices.size() * sizeof(uint32_t); }
+
+private:
+    /**
+     * @struct Key
+     * @brief The welding key of a corner: its coordinates or the coordinates of its welding cell.
+     */
+    struct Key
+    {
+        int64_t i64X; ///< X-coordinate of the key.
+        int64_t i64Y; ///< Y-coordinate of the key.
+        int64_t i64Z; ///< Z-coordinate of the key.
+
+        /**
+         * @brief Compares two keys.
+         *
+         * @param o The other key.
+         *
+         * @return True if the keys are equal; otherwise false.
+         */
+        bool operator==(const Key &o) const { return (i64X == o.i64X) && (i64Y == o.i64Y) && (i64Z == o.i64Z); }
+    };
+
+    /**
+     * @brief Gets the welding key of a point.
+     *
+     * @param oPoint The point.
+     * @param dInvTolerance The inverse of the welding tolerance; 0 for exact welding.
+     *
+     * @return The key of the point.
+     */
+    static Key getKey(const CVector3d &oPoint, double dInvTolerance);
+
+    /**
+     * @brief Hashes a welding key.
+     *
+     * @param key The key.
+     *
+     * @return The hash of the key; its highest bits select the bucket.
+     */
+    static uint64_t hashKey(const Key &key);
+
+    static constexpr uint32_t BucketBits = 10; ///< The corners are distributed into 2^BucketBits buckets.
+    static constexpr uint32_t ChunkCorners = 65536; ///< Number of corners hashed by one task.
+    static constexpr uint32_t ChunkTriangles = 65536; ///< Number of triangles or vertices processed by one task of computeVertexNormals().
+
+    std::vector<CVector3d> m_vVertices{}; ///< The unique vertex positions.
+    std::vector<CVector3d> m_vNormals{}; ///< The unit normals of the vertices; empty if they weren't computed.
+    std::vector<uint32_t> m_vIndices{}; ///< Three vertex indices per triangle.
+};
+
+#endif // STL_VIEWER_CINDEXEDMESH_H_INCLUDED
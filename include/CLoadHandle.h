@@ -0,0 +1,164 @@
+/**
+ * @file CLoadHandle.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CLOADHANDLE_H_INCLUDED
+#define STL_VIEWER_CLOADHANDLE_H_INCLUDED
+
+#include <windows.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <string>
+#include "common.h"
+#include "CCriticalSection.h"
+#include "CModel.h"
+#include "CLoadStats.h"
+#include "CMeshCache.h"
+
+/**
+ * @class CLoadHandle
+ * @brief Handle of an STL file loaded in a background thread.
+ *
+ * The handle is created by CStlLoader::loadFileAsync(). It gives the result of the loading
+ * when it's finished, reports the progress and lets the loading be cancelled. The loader checks
+ * the cancellation between the parts of the file it decodes, so the loading stops shortly after
+ * cancel() is called and returns Err::LoadCancelled. A loading waiting for the data of a pipe is
+ * woken by the cancel event. The destructor cancels the loading and waits for the thread.
+ */
+class CLoadHandle
+{
+public:
+    /**
+     * @struct Progress
+     * @brief The amount of work done by the loader.
+     */
+    struct Progress
+    {
+        uint64_t u64BytesProcessed{0}; ///< Number of bytes of the file decoded so far.
+        uint64_t u64BytesTotal{0}; ///< Size of the file.
+        uint32_t u32Facets{0}; ///< Number of facets decoded so far.
+    };
+
+    /**
+     * @brief Function called by the loading thread whenever the progress changes.
+     */
+    using ProgressCallback = std::function<void(const Progress&)>;
+
+    /**
+     * @brief Function called by the loading thread when the model is loaded successfully, before the loading is done.
+     *
+     * It prepares a model which isn't drawn yet, e.g. a reloaded one, without blocking the drawing thread.
+     */
+    using LoadedCallback = std::function<void(CModel&, const CLoadStats&, const CMeshCache&)>;
+
+    /**
+     * @brief Deleted copy constructor; the object owns the loading thread.
+     */
+    CLoadHandle(const CLoadHandle &) = delete;
+
+    /**
+     * @brief Deleted assignment operator; the object owns the loading thread.
+     */
+    CLoadHandle &operator=(const CLoadHandle &) = delete;
+
+    /**
+     * @brief Destructor cancelling the loading and waiting for the loading thread.
+     */
+    ~CLoadHandle();
+
+    /**
+     * @brief Checks whether the loading is finished.
+     *
+     * @return True if the result is available; otherwise false.
+     */
+    bool isDone() const;
+
+    /**
+     * @brief Waits until the loading is finished and gets its result.
+     *
+     * @return An error code indicating the result of the loading.
+     */
+    Err getResult();
+
+    /**
+     * @brief Requests the loading to stop. The function doesn't wait for the loading thread.
+     */
+    void cancel();
+
+    /**
+     * @brief Checks whether the loading was cancelled.
+     *
+     * @return True if cancel() was called; otherwise false.
+     */
+    bool isCancelled() const { return m_bCancelled; }
+
+    /**
+     * @brief Gets the progress of the loading.
+     *
+     * @return The amount of work done so far.
+     */
+    Progress getProgress() const;
+
+    /**
+     * @brief Gets the timings and counters of the loading. They are valid when the loading is finished.
+     *
+     * @return The statistics of the loading.
+     */
+    const CLoadStats &getStats() const { return m_stats; }
+
+    /**
+     * @brief Gets the mesh cache entry of the loaded file. It's valid when the loading is finished.
+     *
+     * @return The mesh cache entry; invalid if the file can't be cached.
+     */
+    const CMeshCache &getMeshCache() const { return m_oMeshCache; }
+
+private:
+    friend class CStlLoader;
+
+    /**
+     * @brief Constructor of the handle. The loading is started by CStlLoader::loadFileAsync().
+     *
+     * @param sFileName The name of the STL file to load.
+     * @param oModel The model object to populate with the loaded data.
+     * @param progressCallback Function called by the loading thread when the progress changes; may be empty.
+     * @param loadedCallback Function called by the loading thread when the model is loaded; may be empty.
+     */
+    CLoadHandle(const std::string &sFileName, CModel &oModel, const ProgressCallback &progressCallback,
+                const LoadedCallback &loadedCallback);
+
+    /**
+     * @brief Updates the progress and calls the progress callback. Called by the loading thread.
+     *
+     * @param u64BytesProcessed Number of bytes of the file decoded so far.
+     * @param u64BytesTotal Size of the file.
+     * @param u32Facets Number of facets decoded so far.
+     */
+    void setProgress(uint64_t u64BytesProcessed, uint64_t u64BytesTotal, uint32_t u32Facets);
+
+    /**
+     * @brief Gets the event signaled by cancel(), so the loading thread can wait for the data and the cancellation together.
+     *
+     * @return The manual-reset event; nullptr if it couldn't be created.
+     */
+    HANDLE getCancelEvent() const { return m_hCancelEvent; }
+
+    std::string m_sFileName; ///< The name of the STL file.
+    CModel &m_oModel; ///< The model populated by the loader.
+    ProgressCallback m_progressCallback; ///< Function called when the progress changes.
+    LoadedCallback m_loadedCallback; ///< Function called when the model is loaded.
+    HANDLE m_hThread{nullptr}; ///< Handle of the loading thread.
+    Err m_result{Err::NoError}; ///< The result of the loading (valid when the thread is finished).
+    std::atomic<bool> m_bCancelled{false}; ///< True when the loading shall stop.
+    HANDLE m_hCancelEvent{nullptr}; ///< Event signaled when the loading shall stop.
+    mutable CCriticalSection m_oLock{}; ///< Lock of the progress.
+    Progress m_progress{}; ///< The progress of the loading (guarded by m_oLock).
+    CLoadStats m_stats{}; ///< The statistics of the loading (valid when the thread is finished).
+    CMeshCache m_oMeshCache{}; ///< The mesh cache entry of the file (valid when the thread is finished).
+};
+
+#endif // STL_VIEWER_CLOADHANDLE_H_INCLUDED
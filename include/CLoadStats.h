@@ -0,0 +1,48 @@
+/**
+ * @file CLoadStats.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CLOADSTATS_H_INCLUDED
+#define STL_VIEWER_CLOADSTATS_H_INCLUDED
+
+#include <stdint.h>
+
+/**
+ * @class CLoadStats
+ * @brief Timings and counters of the stages of loading an STL file.
+ *
+ * The statistics are recorded by CStlLoader. The stages are: format detection,
+ * preview, memory allocation and decoding (loadBinary() or loadAscii()); the total time
+ * includes opening the file and the work between the stages.
+ */
+class CLoadStats
+{
+public:
+    /**
+     * @brief Gets the decoding throughput of the whole load.
+     *
+     * @return The number of decoded megabytes (10^6 bytes) per second of the total time.
+     */
+    double getThroughput() const { return (dTotalMs > 0.0)? (static_cast<double>(u64BytesDecoded) / 1000.0 / dTotalMs) : 0.0; }
+
+    uint64_t u64FileSize{0}; ///< Size of the file in bytes.
+    uint64_t u64BytesRead{0}; ///< Number of bytes of the file read by the decoders.
+    uint64_t u64BytesDecoded{0}; ///< Number of bytes of STL data decoded (bigger than u64BytesRead for compressed files).
+    uint32_t u32Facets{0}; ///< Number of facets decoded.
+    uint32_t u32Threads{1}; ///< Number of threads which decoded the facets.
+    bool bBinary{false}; ///< True for a binary STL file; false for an ASCII one.
+    bool bCompressed{false}; ///< True if the file was decompressed while it was loaded.
+    bool bPaged{false}; ///< True if the model didn't fit in memory and its facets are paged.
+    bool bPiped{false}; ///< True if the file was read from the standard input.
+    bool bCached{false}; ///< True if the normalized model was loaded from the mesh cache instead of the file.
+    double dDetectMs{0.0}; ///< Time of the format detection in milliseconds.
+    double dPreviewMs{0.0}; ///< Time of reading the preview of a big binary file in milliseconds (0 without a preview).
+    double dAllocateMs{0.0}; ///< Time of the memory allocation in milliseconds.
+    double dDecodeMs{0.0}; ///< Time of decoding the facets in milliseconds.
+    double dTotalMs{0.0}; ///< Total time of the loading in milliseconds.
+};
+
+#endif // STL_VIEWER_CLOADSTATS_H_INCLUDED
@@ -42,6 +42,7 @@ enum LogLevel { None=0, Error, Warning, Info, Debug, Trace };
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include "CCriticalSection.h"
 
 /**
  * @class CLogger
@@ -89,10 +90,12 @@ public:
      *
      * The destructor writes the complete log message (header + body) to the log file if
      * a file is set. It also optionally echoes the log message to the console.
+     * The messages of the threads loading files concurrently are written one at a time.
      */
     ~CLogger()
     {
         m_buffer << std::endl;
+        CLockGuard oGuard{m_oLock};
         if (CLogger::m_file)
         {
             CLogger::m_file << m_bufferHeader.str();
@@ -160,6 +163,7 @@ private:
     static LogLevel m_logLevel; ///< The current log level for filtering log messages.
     static bool m_bEchoToCout; ///< Flag to indicate whether to echo log messages to std::cout.
     static std::ofstream m_file; ///< The output file stream for logging to a file.
+    static CCriticalSection m_oLock; ///< Lock serializing the writes of the log messages.
     std::ostringstream m_bufferHeader{}; ///< The header containing file, line, and log level (not printed on the std::cout).
     std::ostringstream m_buffer{}; ///< The main buffer for log message content.
 };
@@ -0,0 +1,196 @@
+/**
+ * @file CMappedFile.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CMAPPEDFILE_H_INCLUDED
+#define STL_VIEWER_CMAPPEDFILE_H_INCLUDED
+
+#include <windows.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include "common.h"
+
+/**
+ * @class CMappedView
+ * @brief A read-only window of a memory-mapped file.
+ *
+ * The view is unmapped automatically when the object is destroyed. Views can be moved
+ * but not copied, so every mapped range has exactly one owner.
+ */
+class CMappedView
+{
+public:
+    /**
+     * @brief Constructs an empty (invalid) view.
+     */
+    CMappedView() = default;
+
+    /**
+     * @brief Deleted copy constructor; a mapped range has exactly one owner.
+     */
+    CMappedView(const CMappedView &) = delete;
+
+    /**
+     * @brief Deleted assignment operator; a mapped range has exactly one owner.
+     */
+    CMappedView &operator=(const CMappedView &) = delete;
+
+    /**
+     * @brief Takes over the mapped range of another view.
+     *
+     * @param oOther The view to move from. It is left empty.
+     */
+    CMappedView(CMappedView &&oOther);
+
+    /**
+     * @brief Unmaps the current range and takes over the mapped range of another view.
+     *
+     * @param oOther The view to move from. It is left empty.
+     * @return A reference to this view.
+     */
+    CMappedView &operator=(CMappedView &&oOther);
+
+    /**
+     * @brief Destructor unmapping the view.
+     */
+    ~CMappedView() { unmap(); }
+
+    /**
+     * @brief Gets the pointer to the first requested byte of the view.
+     *
+     * @return The pointer to the mapped data or nullptr for an invalid view.
+     */
+    const uint8_t *data() const { return m_pData; }
+
+    /**
+     * @brief Gets the number of requested bytes available in the view.
+     *
+     * @return The size of the view in bytes.
+     */
+    size_t size() const { return m_size; }
+
+    /**
+     * @brief Checks whether the view holds mapped data.
+     *
+     * @return True if the view is mapped; otherwise false.
+     */
+    bool isValid() const { return nullptr != m_pData; }
+
+    /**
+     * @brief Unmaps the view. The view becomes invalid.
+     */
+    void unmap();
+
+private:
+    friend class CMappedFile;
+
+    LPVOID m_pBase{nullptr}; ///< Address returned by MapViewOfFile (aligned to the allocation granularity).
+    const uint8_t *m_pData{nullptr}; ///< Address of the first requested byte.
+    size_t m_size{0}; ///< Number of requested bytes.
+};
+
+/**
+ * @class CMappedFile
+ * @brief Read-only memory mapping of a file.
+ *
+ * The file is opened with a sequential access hint and mapped as a whole, but the
+ * address space is consumed only by the views created with mapView(). This allows a
+ * 32-bit process to walk through files much larger than its address space by mapping
+ * one window at a time.
+ */
+class CMappedFile
+{
+public:
+    /**
+     * @brief Constructs a closed file object.
+     */
+    CMappedFile() = default;
+
+    /**
+     * @brief Deleted copy constructor; the object owns system handles.
+     */
+    CMappedFile(const CMappedFile &) = delete;
+
+    /**
+     * @brief Deleted assignment operator; the object owns system handles.
+     */
+    CMappedFile &operator=(const CMappedFile &) = delete;
+
+    /**
+     * @brief Destructor closing the file.
+     */
+    ~CMappedFile() { close(); }
+
+    /**
+     * @brief Opens and maps the specified file for reading.
+     *
+     * @param sFileName The name of the file to open.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err open(const std::string &sFileName);
+
+    /**
+     * @brief Closes the file. Views created before remain valid until they are unmapped.
+     */
+    void close();
+
+    /**
+     * @brief Checks whether the file is open.
+     *
+     * @return True if the file is open; otherwise false.
+     */
+    bool isOpen() const { return INVALID_HANDLE_VALUE != m_hFile; }
+
+    /**
+     * @brief Gets the size of the file.
+     *
+     * @return The size of the file in bytes.
+     */
+    uint64_t getSize() const { return m_u64Size; }
+
+    /**
+     * @brief Maps a range of the file into memory.
+     *
+     * The offset doesn't need to be aligned; the alignment required by the system is handled internally.
+     * The range is clipped to the end of the file.
+     *
+     * @param u64Offset The offset of the first byte to map.
+     * @param size The number of bytes to map.
+     *
+     * @return The view of the requested range. The view is invalid if the range can't be mapped.
+     */
+    CMappedView mapView(uint64_t u64Offset, size_t size) const;
+
+    /**
+     * @brief Reads a range of the file at the given position without mapping it.
+     *
+     * Small reads scattered over the file are cheaper this way than with views, which are
+     * aligned to the allocation granularity. The function may be called by many threads at once.
+     *
+     * @param u64Offset The offset of the first byte to read.
+     * @param pBuffer The destination buffer.
+     * @param size The number of bytes to read.
+     *
+     * @return An error code indicating the result of the operation; reading beyond the end of the file fails.
+     */
+    Err read(uint64_t u64Offset, void *pBuffer, size_t size) const;
+
+private:
+    /**
+     * @brief Gets the granularity of the view start addresses.
+     *
+     * @return The allocation granularity of the system in bytes.
+     */
+    static uint64_t getAllocationGranularity();
+
+    HANDLE m_hFile{INVALID_HANDLE_VALUE}; ///< Handle of the open file.
+    HANDLE m_hMapping{nullptr}; ///< Handle of the file mapping object.
+    uint64_t m_u64Size{0}; ///< Size of the file in bytes.
+};
+
+#endif // STL_VIEWER_CMAPPEDFILE_H_INCLUDED
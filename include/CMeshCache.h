@@ -0,0 +1,108 @@
+/**
+ * @file CMeshCache.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CMESHCACHE_H_INCLUDED
+#define STL_VIEWER_CMESHCACHE_H_INCLUDED
+
+#include <stdint.h>
+#include <string>
+#include "common.h"
+#include "CMappedFile.h"
+#include "CModel.h"
+
+/**
+ * @class CMeshCache
+ * @brief On-disk cache of normalized models for reopening big STL files quickly.
+ *
+ * Every STL file has one cache file in the cache directory of the application, named after the hash
+ * of the full path of the STL file. The cache file holds a header with the key of the STL file (its size,
+ * modification time and a hash of its content) and the bounding box of the model, followed by the facets
+ * of the normalized model in the layout of C3DFacet, so they are copied from the mapped cache file
+ * without decoding, and by the name of the model. A cache file whose key doesn't match the STL file
+ * any more is deleted.
+ *
+ * The content hash is computed from samples spread over the STL file, so it's found in constant time;
+ * together with the size and the modification time it detects the files which were replaced or modified.
+ *
+ * The object keeps only the key of the STL file, so it can be copied from the loading thread.
+ */
+class CMeshCache
+{
+public:
+    /**
+     * @brief Finds the key and the cache file name of an STL file.
+     *
+     * @param sFileName The name of the STL file.
+     * @param oFile The opened STL file.
+     *
+     * @return An error code indicating the result of the operation; Err::MeshCache if the file can't be cached.
+     */
+    Err setSource(const std::string &sFileName, const CMappedFile &oFile);
+
+    /**
+     * @brief Checks whether the key of an STL file is set.
+     *
+     * @return True if setSource() succeeded; otherwise false.
+     */
+    bool isValid() const { return !m_sCacheFileName.empty(); }
+
+    /**
+     * @brief Loads the normalized model from the cache file.
+     *
+     * A cache file which doesn't match the key of the STL file is deleted.
+     *
+     * @param oModel The model to populate; it's cleared first.
+     *
+     * @return An error code indicating the result of the operation; Err::MeshCache if there's no valid cache file.
+     */
+    Err load(CModel &oModel) const;
+
+    /**
+     * @brief Writes the normalized model to the cache file.
+     *
+     * The file is written under a temporary name and renamed, so an interrupted write doesn't leave
+     * a damaged cache file. Paged models aren't cached.
+     *
+     * @param oModel The model which was just normalized.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err store(const CModel &oModel) const;
+
+private:
+    /**
+     * @brief Gets the directory of the cache files and creates it if needed.
+     *
+     * @param sDirectory Receives the name of the directory with a trailing backslash.
+     *
+     * @return True if the directory exists; otherwise false.
+     */
+    static bool getCacheDirectory(std::string &sDirectory);
+
+    /**
+     * @brief Computes the hash of samples spread over the file.
+     *
+     * @param oFile The opened file.
+     * @param u64Hash Receives the hash.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    static Err hashContent(const CMappedFile &oFile, uint64_t &u64Hash);
+
+    static constexpr uint32_t CacheVersion = 1; ///< Version of the layout of the cache file.
+    static constexpr uint32_t HashSamples = 64; ///< Number of samples of the STL file in the content hash.
+    static constexpr size_t HashSampleSize = 4096; ///< Size of one sample of the STL file in bytes.
+    static constexpr uint32_t FacetsPerView = 256*1024; ///< Number of facets copied from one mapped view of the cache file.
+    static constexpr uint32_t MinFacets = 65536; ///< Minimum number of facets of a cached model.
+
+    std::string m_sCacheFileName{}; ///< The name of the cache file; empty if the key isn't set.
+    uint64_t m_u64SourceSize{0}; ///< Size of the STL file.
+    uint64_t m_u64SourceTime{0}; ///< Last modification time of the STL file (FILETIME).
+    uint64_t m_u64ContentHash{0}; ///< Hash of the samples of the STL file.
+};
+
+#endif // STL_VIEWER_CMESHCACHE_H_INCLUDED
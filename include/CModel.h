@@ -13,6 +13,13 @@
 #include "C3DFacet.h"
 #include <string>
 #include "CVector3d.h"
+#include "CBoundingBox.h"
+#include "CCriticalSection.h"
+#include "CPagedFacets.h"
+#include "CIndexedMesh.h"
+#include "CFacetStreams.h"
+#include "CQuantizedFacets.h"
+#include "CBvh.h"
 
  /**
  * @class CModel
@@ -21,6 +28,37 @@
  * The CModel class manages the facets that make up the 3D model. It provides methods for
  * manipulating the model's geometry, including normalizing its coordinates and applying
  * rotations around the X, Y, and Z axes. The model is represented as a collection of 3D facets.
+ *
+ * A model which doesn't fit in memory is kept in the paged storage (see isPaged()), which holds
+ * only a working set of facet blocks in memory and the rest in a temporary file. Then the facets
+ * are accessed block by block with getPagedFacets() and getFacets() is empty.
+ *
+ * A model in memory can be welded into an indexed mesh (see weld()), which keeps every vertex once.
+ * Then getFacets() is empty too and the facets are put together from the indexed mesh.
+ *
+ * Alternatively the facets in memory can be moved to the streams of coordinates (see setStreamed()),
+ * where the bounding box, the normalization and the rotations are processed with SIMD instructions.
+ * Then getFacets() is empty too and the facets are put together from the streams.
+ *
+ * A model can be quantized too (see quantize()): the corners are stored as 16-bit fractions of the
+ * bounding box and the normals in the octahedral encoding, so it takes 20 or 22 bytes per facet instead
+ * of 48. Then getFacets() is empty and the facets are decoded on the fly.
+ *
+ * The normals in the STL files are often zero or wrong, so they are computed again from the winding of the
+ * facets by repairNormals(). Then they are unit vectors (see hasUnitNormals()), and the renderer doesn't
+ * normalize them. A welded model can get smooth vertex normals (see smoothNormals()).
+ *
+ * The geometric queries are answered by a bounding volume hierarchy over the facets (see buildBvh()), which
+ * follows the normalization, the welding, the quantization and bakeTransform() of the model.
+ *
+ * The rotations aren't applied to the facets. They are accumulated in the model transform (see
+ * getTransform()), which the renderer and the users of the facets apply on the fly, so a rotation
+ * takes the same time for any model. The facets are rotated only by bakeTransform().
+ *
+ * The model can be drawn while it's being loaded. The loader thread publishes the facets in
+ * batches and the renderer draws only the published ones. A large binary file may give a preview
+ * first: a sample of facets spread over the file, drawn until the loading is finished. The shared state is guarded by
+ * the lock of the model (see getLock()); the renderer holds it while drawing a frame.
  */
 class CModel
 {
@@ -45,6 +83,193 @@ public:
      */
     const std::vector<C3DFacet> &getFacets() const { return m_vFacets; }
 
+    /**
+     * @brief Checks whether the facets are kept in the paged storage.
+     *
+     * @return True if the model doesn't fit in memory and its facets are paged; otherwise false.
+     */
+    bool isPaged() const { return m_oPagedFacets.isOpen(); }
+
+    /**
+     * @brief Gets the paged storage of the facets.
+     *
+     * The storage is used when isPaged() is true. The lock of the model must be held while it's accessed.
+     *
+     * @return A const reference to the paged storage.
+     */
+    const CPagedFacets &getPagedFacets() const { return m_oPagedFacets; }
+
+    /**
+     * @brief Moves the facets to the paged storage. The following facets are appended there too.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err setPaged();
+
+    /**
+     * @brief Checks whether the model is welded into an indexed mesh.
+     *
+     * @return True if the facets are kept in the indexed mesh; otherwise false.
+     */
+    bool isIndexed() const { return !m_oIndexedMesh.isEmpty(); }
+
+    /**
+     * @brief Gets the indexed mesh of the model.
+     *
+     * The mesh is used when isIndexed() is true. The lock of the model must be held while it's accessed.
+     *
+     * @return A const reference to the indexed mesh.
+     */
+    const CIndexedMesh &getIndexedMesh() const { return m_oIndexedMesh; }
+
+    /**
+     * @brief Welds the identical vertices of the facets and keeps the model as an indexed mesh.
+     *
+     * The facets in memory are replaced by the indexed mesh (see CIndexedMesh::build()). A paged model
+     * isn't welded. The function is called when the model is loaded completely.
+     *
+     * @param fTolerance The size of the welding cells in the coordinates of the model; 0 for exact welding.
+     *
+     * @return An error code indicating the result of the operation; the model is unchanged if it failed.
+     */
+    Err weld(float fTolerance);
+
+    /**
+     * @brief Computes the smooth normals of the vertices of a welded model (see CIndexedMesh::computeVertexNormals()).
+     *
+     * A model which isn't welded keeps the normals of its facets. The function is called when the model is welded.
+     *
+     * @return An error code indicating the result of the operation; the model is unchanged if it failed.
+     */
+    Err smoothNormals();
+
+    /**
+     * @brief Checks whether the facets are kept in the streams of coordinates.
+     *
+     * @return True if the model is streamed; otherwise false.
+     */
+    bool isStreamed() const { return !m_oFacetStreams.isEmpty(); }
+
+    /**
+     * @brief Gets the streams of coordinates of the model.
+     *
+     * The streams are used when isStreamed() is true. The lock of the model must be held while they're accessed.
+     *
+     * @return A const reference to the facet streams.
+     */
+    const CFacetStreams &getFacetStreams() const { return m_oFacetStreams; }
+
+    /**
+     * @brief Moves the facets in memory to the streams of coordinates (see CFacetStreams).
+     *
+     * A paged or welded model isn't streamed. The function is called when the model is loaded completely.
+     *
+     * @return An error code indicating the result of the operation; the model is unchanged if it failed.
+     */
+    Err setStreamed();
+
+    /**
+     * @brief Checks whether the facets are kept in the quantized storage.
+     *
+     * @return True if the model is quantized; otherwise false.
+     */
+    bool isQuantized() const { return !m_oQuantizedFacets.isEmpty(); }
+
+    /**
+     * @brief Gets the quantized storage of the model.
+     *
+     * The storage is used when isQuantized() is true. The lock of the model must be held while it's accessed.
+     *
+     * @return A const reference to the quantized facets.
+     */
+    const CQuantizedFacets &getQuantizedFacets() const { return m_oQuantizedFacets; }
+
+    /**
+     * @brief Moves the facets to the quantized storage (see CQuantizedFacets).
+     *
+     * The facets in memory or in the paged storage are encoded against the bounding box of the model,
+     * so a paged model is brought back to memory if its quantized facets fit there. A welded or streamed
+     * model isn't quantized. The function is called when the model is loaded completely.
+     *
+     * @param u32NormalBits The number of bits of each coordinate of an encoded normal: 8 or 16.
+     *
+     * @return An error code indicating the result of the operation; the model is unchanged if it failed.
+     */
+    Err quantize(uint32_t u32NormalBits);
+
+    /**
+     * @brief Checks whether the given number of facets can be kept in memory.
+     *
+     * The limit is the smaller of MaxInCoreBytes and a half of the physical memory.
+     *
+     * @param u64Facets The number of facets.
+     * @param u32FacetSize The size of a facet in the storage in bytes.
+     *
+     * @return True if the facets fit in memory; false if the paged storage shall be used.
+     */
+    static bool fitsInMemory(uint64_t u64Facets, uint32_t u32FacetSize = sizeof(C3DFacet));
+
+    /**
+     * @brief Replaces the normals of the facets by the unit normals of their winding (see C3DFacet::computeNormal()).
+     *
+     * The facets in memory are processed in chunks by all threads of the pool, the paged facets block by block.
+     * The normals of an indexed or quantized model are unit vectors already. The function is called when the
+     * model is loaded completely.
+     */
+    void repairNormals();
+
+    /**
+     * @brief Checks whether the normals of the model are unit vectors, so the renderer doesn't have to normalize them.
+     *
+     * @return True if the normals were repaired or the model is indexed or quantized; otherwise false.
+     */
+    bool hasUnitNormals() const { return m_bUnitNormals || isIndexed() || isQuantized(); }
+
+    /**
+     * @brief Builds the bounding volume hierarchy over the facets (see CBvh).
+     *
+     * A paged model gets no hierarchy, because its blocks can't be read by many threads at once. The function
+     * is called when the model is loaded completely; the hierarchy is kept in sync with the facets then.
+     *
+     * @return An error code indicating the result of the operation; the model has no hierarchy if it failed.
+     */
+    Err buildBvh();
+
+    /**
+     * @brief Checks whether the model has the bounding volume hierarchy.
+     *
+     * @return True if the hierarchy is built; otherwise false.
+     */
+    bool hasBvh() const { return !m_oBvh.isEmpty(); }
+
+    /**
+     * @brief Gets the bounding volume hierarchy of the model.
+     *
+     * The lock of the model must be held while it's accessed.
+     *
+     * @return A const reference to the hierarchy.
+     */
+    const CBvh &getBvh() const { return m_oBvh; }
+
+    /**
+     * @brief Finds the nearest facet hit by a ray (see CBvh::rayCast()).
+     *
+     * @param oOrigin The origin of the ray in the transformed coordinates.
+     * @param oDirection The direction of the ray in the transformed coordinates.
+     * @param oHit Receives the nearest hit; the facet index is the index in the storage of the model.
+     *
+     * @return True if a facet was hit; false if none was hit or the model has no hierarchy.
+     */
+    bool rayCast(const CVector3d &oOrigin, const CVector3d &oDirection, CBvh::Hit &oHit) const;
+
+    /**
+     * @brief Finds the facets whose bounding boxes overlap a box (see CBvh::queryBox()).
+     *
+     * @param oBox The box in the transformed coordinates.
+     * @param vFacets Receives the indices of the facets; empty if the model has no hierarchy.
+     */
+    void queryBox(const CBoundingBox &oBox, std::vector<uint32_t> &vFacets) const;
+
     /**
      * @brief Sets the name of the model.
      *
@@ -52,7 +277,7 @@ public:
      *
      * @param sName The name to assign to the model.
      */
-    void setModelName(const std::string &sName) { m_sName = sName; }
+    void setModelName(const std::string &sName) { CLockGuard oGuard{m_oLock}; m_sName = sName; }
 
     /**
      * @brief Gets the name of the model.
@@ -63,19 +288,203 @@ public:
      */
     const std::string &getModelName() const { return m_sName; }
 
+    /**
+     * @brief Gets the lock guarding the state shared by the loader and the renderer.
+     *
+     * The lock must be held to read the facets, the name or the loading state while the
+     * model is being loaded. The functions modifying the model hold it internally.
+     *
+     * @return The lock of the model.
+     */
+    CCriticalSection &getLock() const { return m_oLock; }
+
+    /**
+     * @brief Removes all facets and resets the loading state and the model transform.
+     */
+    void clear();
+
+    /**
+     * @brief Appends a batch of facets and publishes them for drawing.
+     *
+     * The model switches to the paged storage when the facets stop fitting in memory.
+     *
+     * @param vFacets The facets to append.
+     * @param fProgress The fraction of the file loaded so far (0.0-1.0).
+     *
+     * @return An error code indicating the result of the memory allocation.
+     */
+    Err appendFacets(const std::vector<C3DFacet> &vFacets, float fProgress);
+
+    /**
+     * @brief Appends a batch of facets whose bounding box is known already.
+     *
+     * @param vFacets The facets to append.
+     * @param fProgress The fraction of the file loaded so far (0.0-1.0).
+     * @param oBox The bounding box of the facets.
+     *
+     * @return An error code indicating the result of the memory allocation.
+     */
+    Err appendFacets(const std::vector<C3DFacet> &vFacets, float fProgress, const CBoundingBox &oBox);
+
+    /**
+     * @brief Publishes facets which were already written to the facet vector by the loader.
+     *
+     * The loader may write to the facets beyond the published ones without holding the lock,
+     * as long as the vector isn't reallocated.
+     *
+     * @param u32Count The number of facets ready for drawing.
+     * @param fProgress The fraction of the file loaded so far (0.0-1.0).
+     */
+    void publishFacets(uint32_t u32Count, float fProgress);
+
+    /**
+     * @brief Publishes facets whose bounding box is known already.
+     *
+     * @param u32Count The number of facets ready for drawing.
+     * @param fProgress The fraction of the file loaded so far (0.0-1.0).
+     * @param oBox The bounding box of the facets.
+     */
+    void publishFacets(uint32_t u32Count, float fProgress, const CBoundingBox &oBox);
+
+    /**
+     * @brief Sets the sample of facets drawn while the model is being loaded.
+     *
+     * The bounding box of the model includes the box of the sample, so the preview is scaled like
+     * the complete model. clear() keeps the preview; it's removed by setLoading().
+     *
+     * @param vFacets The sample of facets; the vector is moved into the model.
+     * @param oBox The bounding box of the sample.
+     */
+    void setPreviewFacets(std::vector<C3DFacet> &&vFacets, const CBoundingBox &oBox);
+
+    /**
+     * @brief Gets the sample of facets drawn while the model is being loaded.
+     *
+     * @return A const reference to the preview facets; empty if there's no preview.
+     */
+    const std::vector<C3DFacet> &getPreviewFacets() const { return m_vPreviewFacets; }
+
+    /**
+     * @brief Gets the number of facets ready for drawing.
+     *
+     * @return The number of published facets.
+     */
+    uint32_t getPublishedFacets() const { return m_u32PublishedFacets; }
+
+    /**
+     * @brief Gets the bounding box of the published facets.
+     *
+     * The box is gathered while the facets are published and kept up to date by the normalization
+     * and the rotations, so it's never found by a pass over the facets. It encloses the transformed model.
+     *
+     * @return The bounding box of the published part of the model.
+     */
+    const CBoundingBox &getBoundingBox() const { return m_oBoundingBox; }
+
+    /**
+     * @brief Marks the beginning or the end of loading. The preview facets are removed.
+     *
+     * @param bLoading True when the loading starts; false when it's finished.
+     */
+    void setLoading(bool bLoading);
+
+    /**
+     * @brief Checks whether the model is being loaded.
+     *
+     * @return True if the loading is in progress; otherwise false.
+     */
+    bool isLoading() const;
+
+    /**
+     * @brief Gets the loading progress.
+     *
+     * @return The fraction of the file loaded so far (0.0-1.0).
+     */
+    float getLoadProgress() const;
+
     /**
      * @brief Normalizes the model coordinates.
      *
      * This function adjusts the vertex coordinates of the model to
      * ensure it is centered and appropriately scaled within the unit cube.
+     * The bounding box gathered while the model was loaded is used (see getBoundingBox()).
      */
     void normalizeModel();
 
+    /**
+     * @brief Normalizes the model coordinates to a given bounding box.
+     *
+     * Used for the models of a scene, which are normalized to the bounding box of the whole scene,
+     * so they keep their positions relative to each other.
+     *
+     * @param oBox The box which is centered and scaled to the unit cube, in the transformed coordinates.
+     */
+    void normalizeModel(const CBoundingBox &oBox);
+
+    /**
+     * @brief Gets the model transform: the rotation of the model since it was loaded or the transform was baked.
+     *
+     * The matrix is row-major; the row i gives the coordinate i of a transformed point. The lock of the model
+     * must be held while the transform is used together with the facets.
+     *
+     * @return The 3x3 rotation matrix.
+     */
+    const float *getTransform() const { return m_afTransform; }
+
+    /**
+     * @brief Sets the model transform, e.g. to keep the orientation of a model replaced by its reloaded version.
+     *
+     * The bounding box is rotated with the transform. The facets aren't modified.
+     *
+     * @param afTransform The 3x3 row-major rotation matrix of 90-degree rotations (see getTransform()).
+     */
+    void setTransform(const float afTransform[9]);
+
+    /**
+     * @brief Gets the model transform as an OpenGL matrix.
+     *
+     * @param afMatrix Receives the 4x4 column-major matrix.
+     */
+    void getTransformMatrix(float afMatrix[16]) const;
+
+    /**
+     * @brief Checks whether the model transform isn't the identity.
+     *
+     * @return True if the facets have to be transformed; otherwise false.
+     */
+    bool hasTransform() const;
+
+    /**
+     * @brief Applies the model transform to a point or a normal of the facets.
+     *
+     * @param oPoint The point.
+     *
+     * @return The transformed point.
+     */
+    CVector3d transformPoint(const CVector3d &oPoint) const;
+
+    /**
+     * @brief Applies the model transform to a facet.
+     *
+     * @param oFacet The facet as it's stored in the model.
+     *
+     * @return The transformed facet.
+     */
+    C3DFacet transformFacet(const C3DFacet &oFacet) const;
+
+    /**
+     * @brief Applies the model transform to the facets and resets it to the identity.
+     *
+     * The function passes over the whole model, so it's called only when the transformed facets
+     * are needed in the storage, e.g. before they are written out.
+     */
+    void bakeTransform();
+
     /**
      * @brief Rotates the model around the X-axis.
      *
      * This function applies a left-hand rotation of 90 degrees around
-     * the X-axis to the model.
+     * the X-axis to the model transform; the facets aren't modified.
      */
     void rotateX();
 
@@ -83,7 +492,7 @@ public:
      * @brief Rotates the model around the Y-axis.
      *
      * This function applies a left-hand rotation of 90 degrees around
-     * the Y-axis to the model.
+     * the Y-axis to the model transform; the facets aren't modified.
      */
     void rotateY();
 
@@ -91,13 +500,83 @@ public:
      * @brief Rotates the model around the Z-axis.
      *
      * This function applies a left-hand rotation of 90 degrees around
-     * the Z-axis to the model.
+     * the Z-axis to the model transform; the facets aren't modified.
      */
     void rotateZ();
 
 private:
+    /**
+     * @brief Calls a function for every facet of the model, block by block if the model is paged.
+     *
+     * The facets of an indexed model are put together with the normals computed from the winding.
+     *
+     * @param function The function called with a const reference to each facet.
+     */
+    template <typename Function>
+    void visitFacets(Function function) const;
+
+    /**
+     * @brief Calls a function modifying every facet of the model, block by block if the model is paged.
+     *
+     * For an indexed model the function is called once for every vertex, passed as all three points
+     * of a facet with the normal of the vertex (zero if there are no vertex normals), so the function
+     * must transform the points independently of each other. The facets of
+     * a quantized model aren't updated; they are moved and rotated by CQuantizedFacets.
+     *
+     * @param function The function called with a reference to each facet.
+     */
+    template <typename Function>
+    void updateFacets(Function function);
+
+    /**
+     * @brief Calls a function modifying ranges of the facets in memory or in the paged storage.
+     *
+     * The facets are split into chunks, which are processed by all threads of the pool; the paged facets
+     * block by block. The facets of an indexed, streamed or quantized model aren't processed.
+     *
+     * @param function The function called with a pointer to the first facet of a chunk and the number of its facets.
+     */
+    template <typename Function>
+    void updateFacetRanges(Function function);
+
+    /**
+     * @brief Gets the function reading a facet of the model as it's stored, for the bounding volume hierarchy.
+     *
+     * The facets are read from the vector, the indexed mesh, the streams or the quantized storage; a paged
+     * model isn't supported.
+     *
+     * @return The function reading a facet.
+     */
+    CBvh::FacetGetter getFacetGetter() const;
+
+    /**
+     * @brief Rotates the model transform and the bounding box by 90 degrees in a plane: new a = -b, new b = a.
+     *
+     * @param u32AxisA The first axis of the plane (0 for X, 1 for Y, 2 for Z).
+     * @param u32AxisB The second axis of the plane.
+     */
+    void rotate(uint32_t u32AxisA, uint32_t u32AxisB);
+
+    static constexpr uint64_t MaxInCoreBytes = 768*1024*1024; ///< Maximum size of the facets kept in memory (the 32-bit address space is 2GB).
+    static constexpr uint64_t PagedResidentBytes = 256*1024*1024; ///< Maximum size of the facet blocks of a paged model kept in memory.
+    static constexpr uint32_t ChunkFacets = 65536; ///< Number of facets processed by one task of updateFacetRanges().
+
     std::vector<C3DFacet> m_vFacets{}; ///< A vector of facets that constitute the 3D model.
+    CPagedFacets m_oPagedFacets{}; ///< The facets of a model which doesn't fit in memory.
+    CIndexedMesh m_oIndexedMesh{}; ///< The facets of a welded model.
+    CFacetStreams m_oFacetStreams{}; ///< The facets of a streamed model.
+    CQuantizedFacets m_oQuantizedFacets{}; ///< The facets of a quantized model.
+    CBvh m_oBvh{}; ///< The bounding volume hierarchy over the facets; empty until buildBvh() is called.
+    std::vector<C3DFacet> m_vPreviewFacets{}; ///< The sample of facets drawn while the model is being loaded.
+    CBoundingBox m_oPreviewBox{}; ///< The bounding box of the preview facets.
     std::string m_sName{}; ///< The name of the 3D model.
+    mutable CCriticalSection m_oLock{}; ///< Lock guarding the state shared by the loader and the renderer.
+    uint32_t m_u32PublishedFacets{0}; ///< The number of facets ready for drawing.
+    CBoundingBox m_oBoundingBox{}; ///< The bounding box of the published facets.
+    bool m_bLoading{false}; ///< True while the model is being loaded.
+    bool m_bUnitNormals{false}; ///< True if the normals of the facets were repaired.
+    float m_fLoadProgress{0.0f}; ///< The fraction of the file loaded so far.
+    float m_afTransform[9]{1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}; ///< The model transform (row-major rotation matrix).
 };
 
 #endif // STL_VIEWER_CMODEL_H_INCLUDED
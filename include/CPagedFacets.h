@@ -0,0 +1,184 @@
+/**
+ * @file CPagedFacets.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CPAGEDFACETS_H_INCLUDED
+#define STL_VIEWER_CPAGEDFACETS_H_INCLUDED
+
+#include <windows.h>
+#include <stdint.h>
+#include <vector>
+#include "common.h"
+#include "C3DFacet.h"
+
+/**
+ * @class CPagedFacets
+ * @brief Facet storage for models which don't fit in memory.
+ *
+ * The facets are stored in blocks of BlockFacets facets. Only a working set of blocks is kept
+ * in memory; when it's full, the least recently used block is evicted to a temporary page file
+ * and read back when it's accessed again. A block which wasn't modified since it was written
+ * to the page file is evicted without writing.
+ *
+ * A pointer to a block is valid until the next call which may load another block, so the
+ * facets are processed one block at a time. The object isn't thread-safe; CModel guards it
+ * with its lock.
+ */
+class CPagedFacets
+{
+public:
+    static constexpr uint32_t BlockFacets = 65536; ///< Number of facets in one block.
+
+    /**
+     * @brief Default constructor.
+     */
+    CPagedFacets() = default;
+
+    /**
+     * @brief Deleted copy constructor; the object owns the page file.
+     */
+    CPagedFacets(const CPagedFacets &) = delete;
+
+    /**
+     * @brief Deleted assignment operator; the object owns the page file.
+     */
+    CPagedFacets &operator=(const CPagedFacets &) = delete;
+
+    /**
+     * @brief Destructor deleting the page file.
+     */
+    ~CPagedFacets() { close(); }
+
+    /**
+     * @brief Creates an empty storage with a new page file.
+     *
+     * @param u64ResidentBytes The memory for the blocks kept in memory; at least two blocks are kept.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err open(uint64_t u64ResidentBytes);
+
+    /**
+     * @brief Removes all facets, releases the memory and deletes the page file.
+     */
+    void close();
+
+    /**
+     * @brief Checks whether the storage is open.
+     *
+     * @return True if open() succeeded and close() wasn't called yet; otherwise false.
+     */
+    bool isOpen() const { return INVALID_HANDLE_VALUE != m_hPageFile; }
+
+    /**
+     * @brief Appends facets at the end of the storage.
+     *
+     * @param pFacets The facets to append.
+     * @param u32Count Number of facets to append.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err append(const C3DFacet *pFacets, uint32_t u32Count);
+
+    /**
+     * @brief Gets the number of facets in the storage.
+     *
+     * @return The number of facets.
+     */
+    uint32_t size() const { return m_u32Size; }
+
+    /**
+     * @brief Gets the number of blocks in the storage.
+     *
+     * @return The number of blocks; the last one may be partially filled.
+     */
+    uint32_t getBlockCount() const { return static_cast<uint32_t>(m_vBlockFrames.size()); }
+
+    /**
+     * @brief Gets the number of facets in a block.
+     *
+     * @param u32Block The index of the block.
+     *
+     * @return The number of facets in the block.
+     */
+    uint32_t getBlockSize(uint32_t u32Block) const;
+
+    /**
+     * @brief Checks whether a block is in memory.
+     *
+     * @param u32Block The index of the block.
+     *
+     * @return True if the block can be accessed without reading the page file; otherwise false.
+     */
+    bool isResident(uint32_t u32Block) const { return NoFrame != m_vBlockFrames[u32Block]; }
+
+    /**
+     * @brief Gets the facets of a block for reading. The block is loaded if needed.
+     *
+     * The block cache isn't a part of the logical state of the storage, so the function is const.
+     *
+     * @param u32Block The index of the block.
+     *
+     * @return Pointer to the facets of the block, or nullptr if the page file can't be accessed.
+     */
+    const C3DFacet *getBlock(uint32_t u32Block) const;
+
+    /**
+     * @brief Gets the facets of a block for modification. The block is loaded if needed.
+     *
+     * @param u32Block The index of the block.
+     *
+     * @return Pointer to the facets of the block, or nullptr if the page file can't be accessed.
+     */
+    C3DFacet *getBlockForWrite(uint32_t u32Block);
+
+private:
+    /**
+     * @class Frame
+     * @brief Memory holding one block.
+     */
+    class Frame
+    {
+    public:
+        std::vector<C3DFacet> vFacets{}; ///< The facets of the block.
+        uint32_t u32Block{0}; ///< The index of the block held by the frame.
+        uint64_t u64LastUse{0}; ///< The value of the use counter when the block was accessed last.
+        bool bDirty{false}; ///< True if the block was modified since it was written to the page file.
+    };
+
+    /**
+     * @brief Finds the frame holding a block and loads the block if it isn't in memory.
+     *
+     * @param u32Block The index of the block.
+     * @param u32Frame Receives the index of the frame.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err pageIn(uint32_t u32Block, uint32_t &u32Frame) const;
+
+    /**
+     * @brief Gets a frame for a new block: a free one or the least recently used one, which is evicted.
+     *
+     * @param u32Frame Receives the index of the frame.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err getFreeFrame(uint32_t &u32Frame) const;
+
+    static constexpr uint32_t NoFrame = 0xFFFFFFFF; ///< Frame index of a block which isn't in memory.
+    static constexpr uint32_t MinFrames = 2; ///< Minimum number of blocks kept in memory.
+
+    HANDLE m_hPageFile{INVALID_HANDLE_VALUE}; ///< Handle of the page file.
+    mutable uint32_t m_u32MaxFrames{MinFrames}; ///< Maximum number of blocks kept in memory.
+    uint32_t m_u32Size{0}; ///< Number of facets in the storage.
+    mutable std::vector<Frame> m_vFrames{}; ///< The blocks kept in memory.
+    mutable std::vector<uint32_t> m_vBlockFrames{}; ///< Frame of each block, or NoFrame.
+    mutable uint64_t m_u64UseCounter{0}; ///< Counter of block accesses, for finding the least recently used block.
+    mutable uint32_t m_u32PageIns{0}; ///< Number of blocks read from the page file.
+    mutable uint32_t m_u32PageOuts{0}; ///< Number of blocks written to the page file.
+};
+
+#endif // STL_VIEWER_CPAGEDFACETS_H_INCLUDED
@@ -0,0 +1,177 @@
+/**
+ * @file CQuantizedFacets.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CQUANTIZEDFACETS_H_INCLUDED
+#define STL_VIEWER_CQUANTIZEDFACETS_H_INCLUDED
+
+#include <stdint.h>
+#include <vector>
+#include "common.h"
+#include "C3DFacet.h"
+#include "CVector3d.h"
+#include "CBoundingBox.h"
+
+/**
+ * @class CQuantizedFacets
+ * @brief Compact facet storage with quantized coordinates and normals.
+ *
+ * Every coordinate of a corner is stored as a 16-bit fraction of the bounding box of the model, so
+ * the position error is at most a half of the box extent divided by 65535. The normals are stored in
+ * the octahedral encoding: the unit vector is projected onto an octahedron, which is unfolded onto
+ * a square, and the two coordinates on the square are stored with 8 or 16 bits each. A facet takes
+ * 20 or 22 bytes instead of the 48 bytes of C3DFacet.
+ *
+ * The facets are decoded on the fly (see getFacets()). The largest errors of the encoding are measured
+ * while the facets are encoded. A zero normal, which some exporters write, is replaced by the normal
+ * of the winding of the corners.
+ */
+class CQuantizedFacets
+{
+public:
+    /**
+     * @brief Allocates the storage for the facets, which are encoded by encode() then.
+     *
+     * @param u32Facets The number of facets.
+     * @param oBox The bounding box of the facets.
+     * @param u32NormalBits The number of bits of each coordinate of an encoded normal: 8 or 16.
+     *
+     * @return An error code indicating the result of the operation; Err::MemAlloc if the storage can't be allocated.
+     */
+    Err create(uint32_t u32Facets, const CBoundingBox &oBox, uint32_t u32NormalBits);
+
+    /**
+     * @brief Encodes a range of facets; the ranges are encoded in parallel by the threads of the pool.
+     *
+     * @param u32First The index of the first facet.
+     * @param pFacets The facets, which must lie in the bounding box given to create().
+     * @param u32Count The number of facets.
+     */
+    void encode(uint32_t u32First, const C3DFacet *pFacets, uint32_t u32Count);
+
+    /**
+     * @brief Releases the storage.
+     */
+    void clear();
+
+    /**
+     * @brief Checks whether the storage holds any facets.
+     *
+     * @return True if there are no facets; otherwise false.
+     */
+    bool isEmpty() const { return 0 == m_u32Facets; }
+
+    /**
+     * @brief Gets the number of facets.
+     *
+     * @return The number of facets.
+     */
+    uint32_t getFacetCount() const { return m_u32Facets; }
+
+    /**
+     * @brief Decodes a facet.
+     *
+     * @param u32Facet The index of the facet.
+     *
+     * @return The facet.
+     */
+    C3DFacet getFacet(uint32_t u32Facet) const;
+
+    /**
+     * @brief Decodes a range of facets, e.g. to draw them.
+     *
+     * @param u32First The index of the first facet.
+     * @param u32Count The number of facets.
+     * @param pFacets Receives the facets.
+     */
+    void getFacets(uint32_t u32First, uint32_t u32Count, C3DFacet *pFacets) const;
+
+    /**
+     * @brief Moves and scales all corners: p' = (p - oShift) * fScale. Only the quantization grid is changed.
+     *
+     * @param oShift The vector subtracted from the corners.
+     * @param fScale The scale applied after the shift.
+     */
+    void transform(const CVector3d &oShift, float fScale);
+
+    /**
+     * @brief Rotates the corners and the normals by a rotation which maps every axis to an axis.
+     *
+     * The positions are rotated exactly; the normals are decoded, rotated and encoded again.
+     *
+     * @param afMatrix The row-major 3x3 matrix; every row has a single element equal to 1 or -1.
+     */
+    void reorient(const float afMatrix[9]);
+
+    /**
+     * @brief Gets the largest distance between an encoded coordinate of a corner and its original value.
+     *
+     * The error is measured when the facets are encoded and scaled by transform(); the rounding of the
+     * floats in the later transforms isn't included.
+     *
+     * @return The error in the coordinates of the model.
+     */
+    float getMaxPositionError() const { return m_fMaxPositionError; }
+
+    /**
+     * @brief Gets the largest angle between an encoded normal and the original one.
+     *
+     * @return The error in degrees.
+     */
+    float getMaxNormalError() const { return m_fMaxNormalError; }
+
+    /**
+     * @brief Gets the size of the memory taken by the encoded facets.
+     *
+     * @return The size in bytes.
+     */
+    uint64_t getMemorySize() const { return m_vPositions.size() * sizeof(uint16_t) + m_vNormals.size() * sizeof(uint16_t); }
+
+    /**
+     * @brief Gets the size of an encoded facet.
+     *
+     * @param u32NormalBits The number of bits of each coordinate of an encoded normal: 8 or 16.
+     *
+     * @return The size in bytes.
+     */
+    static uint32_t getFacetSize(uint32_t u32NormalBits) { return (9 + ((16 == u32NormalBits)? 2 : 1)) * sizeof(uint16_t); }
+
+private:
+    /**
+     * @brief Encodes a unit vector in the octahedral encoding.
+     *
+     * The four nearest points of the grid are tried and the one decoded to the nearest vector is chosen.
+     *
+     * @param oNormal The unit vector.
+     * @param pu16Code Receives the code: 1 word with two 8-bit coordinates or 2 words with 16-bit coordinates.
+     *
+     * @return The angle between the vector and the decoded code in degrees.
+     */
+    float encodeNormal(const CVector3d &oNormal, uint16_t *pu16Code) const;
+
+    /**
+     * @brief Decodes a normal.
+     *
+     * @param pu16Code The code of the normal.
+     *
+     * @return The unit vector.
+     */
+    CVector3d decodeNormal(const uint16_t *pu16Code) const;
+
+    static constexpr uint32_t PositionLevels = 65535; ///< The largest code of a coordinate of a corner.
+    static constexpr uint32_t EncodeChunkFacets = 16384; ///< Number of facets encoded by one task.
+
+    std::vector<uint16_t> m_vPositions{}; ///< Nine codes per facet: x, y and z of the corners 1, 2 and 3.
+    std::vector<uint16_t> m_vNormals{}; ///< The codes of the normals, m_u32NormalWords words per facet.
+    uint32_t m_u32Facets{0}; ///< The number of facets.
+    uint32_t m_u32NormalWords{1}; ///< The number of words of an encoded normal: 1 for 8-bit, 2 for 16-bit coordinates.
+    float m_afOrigin[3]{0.0f, 0.0f, 0.0f}; ///< The position decoded from the code 0 of each axis.
+    float m_afStep[3]{0.0f, 0.0f, 0.0f}; ///< The distance between two codes of each axis.
+    float m_fMaxPositionError{0.0f}; ///< The largest error of an encoded coordinate of a corner.
+    float m_fMaxNormalError{0.0f}; ///< The largest angle between an encoded normal and the original one, in degrees.
+};
+
+#endif // STL_VIEWER_CQUANTIZEDFACETS_H_INCLUDED
@@ -10,8 +10,10 @@
 #include "common.h"
 #include <windows.h>
 #include "CModel.h"
+#include "CScene.h"
 #include "CFpsCounter.h"
 #include "CQuaternion.h"
+#include "CLoadStats.h"
 
 /**
  * @class CRenderer
@@ -41,6 +43,20 @@ public:
      */
     void togglePlayAnimation() { m_bAnime = !m_bAnime; }
 
+    /**
+     * @brief Toggles displaying of the load statistics.
+     *
+     * This function shows or hides the timings and counters of the last loading.
+     */
+    void toggleLoadStats() { m_bShowLoadStats = !m_bShowLoadStats; }
+
+    /**
+     * @brief Sets the load statistics to display.
+     *
+     * @param oStats The timings and counters of the last loading.
+     */
+    void setLoadStats(const CLoadStats &oStats) { m_oLoadStats = oStats; }
+
     /**
      * @brief Gets the window handle of the rendering window.
      *
@@ -89,11 +105,11 @@ public:
      * This function renders the entire scene, including both 3D objects
      * and 2D elements that might be overlaid on top of the scene.
      *
-     * @param oModel The model to render.
+     * @param oScene The models to render.
      *
      * @return An error code indicating the result of the rendering operation.
      */
-    Err redrawWindow(const CModel &oModel);
+    Err redrawWindow(const CScene &oScene);
 
     /**
      * @brief Resets the view state of the renderer.
@@ -197,11 +213,50 @@ private:
     /**
      * @brief Draws the 3D object in the current rendering context.
      *
-     * This function handles the actual drawing of the 3D model using OpenGL.
+     * This function handles the actual drawing of the 3D models using OpenGL.
+     *
+     * @param oScene The models to draw.
+     */
+    void drawObject(const CScene &oScene);
+
+    /**
+     * @brief Draws the facets of one model.
+     *
+     * The model must be locked and the vertex and normal arrays must be enabled.
      *
      * @param oModel The model to draw.
      */
-    void drawObject(const CModel &oModel);
+    void drawModel(const CModel &oModel);
+
+    /**
+     * @brief Draws a range of facets of the model.
+     *
+     * This function draws the facets in the current drawing mode with vertex arrays
+     * pointing to the facet storage, skipping some of them if the skip mode is set.
+     * The vertex and normal arrays must be enabled.
+     *
+     * @param pFacets The facets to draw.
+     * @param u32Count The number of facets.
+     */
+    void drawFacets(const C3DFacet *pFacets, uint32_t u32Count);
+
+    /**
+     * @brief Draws a welded model with smooth shading.
+     *
+     * This function draws the triangles in the current drawing mode with vertex arrays
+     * pointing to the vertices and the vertex normals of the mesh. The vertex and normal
+     * arrays must be enabled.
+     *
+     * @param oMesh The indexed mesh with the vertex normals.
+     */
+    void drawMesh(const CIndexedMesh &oMesh);
+
+    /**
+     * @brief Prepares the indices of the vertices of the facets drawn from one batch.
+     *
+     * This function builds the index list again when the skip mode is changed.
+     */
+    void updateFacetIndices();
 
     /**
      * @brief Draws flat elements and UI text on the screen.
@@ -209,9 +264,19 @@ private:
      * This function renders additional information, such as FPS,
      * model name and statistics, onto the screen.
      *
-     * @param oModel The model used to extract relevant information.
+     * @param oScene The models used to extract relevant information.
+     */
+    void drawFlatElements(const CScene &oScene);
+
+    /**
+     * @brief Draws the load statistics box under the menu.
+     *
+     * This function prints the timings and counters of the last loading and the largest
+     * quantization errors of the models.
+     *
+     * @param oScene The models whose quantization errors are printed.
      */
-    void drawFlatElements(const CModel &oModel);
+    void drawLoadStats(const CScene &oScene);
 
     /**
      * @brief Clears the screen with a specified color.
@@ -235,6 +300,13 @@ private:
     int m_iViewPosY{0}; ///< Y position of the view.
     float m_fZoom{-8.0f}; ///< Zoom level of the view.
     CQuaternion m_oModelViewOrientation{}; ///< Quaternion representing the model's orientation.
+    CLoadStats m_oLoadStats{}; ///< Statistics of the last loading.
+    std::vector<uint16_t> m_vFacetIndices{}; ///< Indices of the vertices of the facets drawn from one batch.
+    uint16_t m_u16IndicesSkip{0}; ///< The skip mode of m_vFacetIndices.
+    std::vector<C3DFacet> m_vBatchFacets{}; ///< The facets of an indexed or streamed model put together for drawing one batch.
+    bool m_bShowLoadStats{false}; ///< Flag to indicate if the load statistics are displayed.
+
+    static constexpr uint32_t DrawBatchFacets = 16384; ///< Number of facets drawn with one call; their vertex indices fit in 16 bits.
 };
 
 
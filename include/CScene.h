@@ -0,0 +1,271 @@
+/**
+ * @file CScene.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CSCENE_H_INCLUDED
+#define STL_VIEWER_CSCENE_H_INCLUDED
+
+#include <windows.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "CModel.h"
+#include "CBoundingBox.h"
+#include "CCriticalSection.h"
+#include "CLoadStats.h"
+
+/**
+ * @class CScene
+ * @brief A set of models displayed together, e.g. the parts of an assembly.
+ *
+ * Every STL file is loaded into its own model. A single file is loaded by CApp with CStlLoader::loadFileAsync();
+ * many files are loaded by startLoading(), which loads them concurrently on the thread pool in a background
+ * thread. The models are normalized together, so the parts keep their positions relative to each other.
+ *
+ * The models are created before the loading and aren't removed until clear(), so the renderer can draw
+ * them while they are being loaded; each model is guarded by its own lock.
+ */
+class CScene
+{
+public:
+    /**
+     * @brief Function called by the loading thread when all files are loaded: void loadedCallback(CScene &oScene).
+     *
+     * It prepares the models for viewing, e.g. normalizes them, so the main thread isn't held up by it.
+     */
+    using LoadedCallback = std::function<void(CScene&)>;
+
+    /**
+     * @brief Default constructor.
+     */
+    CScene() = default;
+
+    /**
+     * @brief Deleted copy constructor; the object owns the loading thread.
+     */
+    CScene(const CScene &) = delete;
+
+    /**
+     * @brief Deleted assignment operator; the object owns the loading thread.
+     */
+    CScene &operator=(const CScene &) = delete;
+
+    /**
+     * @brief Destructor cancelling the loading and waiting for the loading thread.
+     */
+    ~CScene();
+
+    /**
+     * @brief Expands the wildcards (* and ?) of the file names given on the command line.
+     *
+     * The files matching a pattern are sorted by name. A pattern which doesn't match any file is kept,
+     * so loading it reports the missing file.
+     *
+     * @param vPatterns The file names, possibly with wildcards in the last path component.
+     * @param vFileNames Receives the names of the files.
+     */
+    static void expandFileNames(const std::vector<std::string> &vPatterns, std::vector<std::string> &vFileNames);
+
+    /**
+     * @brief Cancels the loading and removes all models.
+     */
+    void clear();
+
+    /**
+     * @brief Adds an empty model to the scene.
+     *
+     * @return A reference to the new model; it's valid until clear().
+     */
+    CModel &addModel();
+
+    /**
+     * @brief Gets the number of models in the scene.
+     *
+     * @return The number of models.
+     */
+    uint32_t getModelCount() const { return static_cast<uint32_t>(m_vModels.size()); }
+
+    /**
+     * @brief Gets a model of the scene.
+     *
+     * @param u32Model The index of the model.
+     *
+     * @return A reference to the model.
+     */
+    CModel &getModel(uint32_t u32Model) { return *m_vModels[u32Model]; }
+
+    /**
+     * @brief Gets a model of the scene (const version).
+     *
+     * @param u32Model The index of the model.
+     *
+     * @return A const reference to the model.
+     */
+    const CModel &getModel(uint32_t u32Model) const { return *m_vModels[u32Model]; }
+
+    /**
+     * @brief Exchanges a model of the scene with another one, e.g. with a reloaded version of it.
+     *
+     * Only the pointers are exchanged, so the new model is drawn completely from the next frame on.
+     * The function must be called by the drawing thread.
+     *
+     * @param u32Model The index of the model.
+     * @param pModel The model to put into the scene; receives the model taken out of it.
+     */
+    void swapModel(uint32_t u32Model, std::unique_ptr<CModel> &pModel) { m_vModels[u32Model].swap(pModel); }
+
+    /**
+     * @brief Starts loading many files concurrently in a background thread.
+     *
+     * One model is added for every file. The models are published for drawing while they are loaded.
+     *
+     * @param vFileNames The names of the STL files.
+     * @param loadedCallback Function called by the loading thread when any file was loaded and the loading
+     *                       wasn't cancelled; may be empty.
+     *
+     * @return An error code indicating whether the loading was started.
+     */
+    Err startLoading(const std::vector<std::string> &vFileNames, const LoadedCallback &loadedCallback = nullptr);
+
+    /**
+     * @brief Checks whether startLoading() was called and its result wasn't collected yet.
+     *
+     * @return True if the files are being loaded or their results are waiting; otherwise false.
+     */
+    bool isBatchLoading() const { return nullptr != m_hThread; }
+
+    /**
+     * @brief Checks whether the loading started by startLoading() is finished.
+     *
+     * @return True if all files are processed; otherwise false.
+     */
+    bool isDone() const;
+
+    /**
+     * @brief Waits until the loading started by startLoading() is finished and collects the results.
+     *
+     * @return Err::NoError if all files were loaded; otherwise the error of the first file which failed.
+     */
+    Err finishLoading();
+
+    /**
+     * @brief Gets the result of loading every file. Valid after finishLoading().
+     *
+     * @return The error codes of the files, in the order of the file names.
+     */
+    const std::vector<Err> &getResults() const { return m_vResults; }
+
+    /**
+     * @brief Gets the names of the files loaded by startLoading().
+     *
+     * @return The file names, in the order of the models.
+     */
+    const std::vector<std::string> &getFileNames() const { return m_vFileNames; }
+
+    /**
+     * @brief Gets the statistics of the loading started by startLoading(). Valid after finishLoading().
+     *
+     * The sizes, counts and stage times are summed over the files; the total time is the time of the whole batch.
+     *
+     * @return The statistics of the loading.
+     */
+    const CLoadStats &getStats() const { return m_stats; }
+
+    /**
+     * @brief Gets the name of the scene.
+     *
+     * @return The name of the model for a single model; otherwise the number of models.
+     */
+    std::string getName() const;
+
+    /**
+     * @brief Gets the number of facets ready for drawing.
+     *
+     * @return The number of published facets of all models.
+     */
+    uint32_t getPublishedFacets() const;
+
+    /**
+     * @brief Gets the bounding box of the published facets of all models.
+     *
+     * @return The bounding box of the scene.
+     */
+    CBoundingBox getBoundingBox() const;
+
+    /**
+     * @brief Marks the beginning or the end of loading of all models.
+     *
+     * @param bLoading True when the loading starts; false when it's finished.
+     */
+    void setLoading(bool bLoading);
+
+    /**
+     * @brief Checks whether any model is being loaded.
+     *
+     * @return True if the loading is in progress; otherwise false.
+     */
+    bool isLoading() const;
+
+    /**
+     * @brief Gets the loading progress.
+     *
+     * @return The average fraction of the files loaded so far (0.0-1.0).
+     */
+    float getLoadProgress() const;
+
+    /**
+     * @brief Normalizes the models together to the bounding box of the scene.
+     */
+    void normalize();
+
+    /**
+     * @brief Rotates all models around the X-axis (see CModel::rotateX()).
+     */
+    void rotateX();
+
+    /**
+     * @brief Rotates all models around the Y-axis (see CModel::rotateY()).
+     */
+    void rotateY();
+
+    /**
+     * @brief Rotates all models around the Z-axis (see CModel::rotateZ()).
+     */
+    void rotateZ();
+
+private:
+    /**
+     * @brief Main function of the thread started by startLoading().
+     *
+     * @param pParam Pointer to the scene.
+     *
+     * @return The exit code of the thread.
+     */
+    static DWORD WINAPI loadThread(LPVOID pParam);
+
+    /**
+     * @brief Loads one file of the batch. Called by the threads of the thread pool.
+     *
+     * @param u32Model The index of the file and of its model.
+     */
+    void loadModel(uint32_t u32Model);
+
+    std::vector<std::unique_ptr<CModel>> m_vModels{}; ///< The models of the scene.
+    std::vector<std::string> m_vFileNames{}; ///< The files loaded by startLoading().
+    std::vector<Err> m_vResults{}; ///< The result of loading every file (guarded by m_oLock while loading).
+    CLoadStats m_stats{}; ///< The statistics of the loading (guarded by m_oLock while loading).
+    HANDLE m_hThread{nullptr}; ///< Handle of the loading thread.
+    LoadedCallback m_loadedCallback{}; ///< Function called by the loading thread when the files are loaded.
+    std::atomic<bool> m_bCancelled{false}; ///< True when the loading shall stop.
+    HANDLE m_hCancelEvent{nullptr}; ///< Event signaled with m_bCancelled, which wakes a loading waiting for the data of a pipe.
+    mutable CCriticalSection m_oLock{}; ///< Lock of the results of the loading.
+};
+
+#endif // STL_VIEWER_CSCENE_H_INCLUDED
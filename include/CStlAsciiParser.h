@@ -0,0 +1,180 @@
+/**
+ * @file CStlAsciiParser.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CSTLASCIIPARSER_H_INCLUDED
+#define STL_VIEWER_CSTLASCIIPARSER_H_INCLUDED
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "C3DFacet.h"
+#include "CVector3d.h"
+
+/**
+ * @class CStlAsciiParser
+ * @brief Parses the text of an ASCII STL file stored in a memory block.
+ *
+ * The parser works directly on the bytes of the block (e.g. a mapped view of the file).
+ * Lines and tokens are only ranges of the block, so no memory is allocated except for the
+ * output facets and the rare numbers which need strtof (see parseFloat()). Keywords are compared
+ * case-insensitively and numbers are converted with a locale-independent parser.
+ *
+ * The block doesn't need to hold the whole file. If the block isn't the last one, a facet
+ * cut off by the end of the block is left unparsed and getPosition() points at its first
+ * line, so the caller can continue with a block starting at that position.
+ */
+class CStlAsciiParser
+{
+public:
+    /**
+     * @brief Constructs the parser of a memory block.
+     *
+     * @param pBegin The first byte of the block.
+     * @param pEnd The byte past the end of the block.
+     * @param bLastBlock True if the block ends at the end of the file.
+     * @param u32LineNo The number of lines of the file preceding the block (0 if unknown).
+     */
+    CStlAsciiParser(const char *pBegin, const char *pEnd, bool bLastBlock, uint32_t u32LineNo);
+
+    /**
+     * @brief Enables or disables logging of parse errors.
+     *
+     * A parser of a block whose position in the file isn't known yet (e.g. a chunk parsed
+     * in parallel with the preceding ones) can't report correct line numbers, so it
+     * shouldn't log the errors. The errors are returned regardless of this setting.
+     *
+     * @param bEnable True to log the parse errors.
+     */
+    void setErrorLog(bool bEnable) { m_bErrorLog = bEnable; }
+
+    /**
+     * @brief Parses the first line of the file ("solid <name>").
+     *
+     * @param sModelName The string receiving the model name (in lowercase).
+     *
+     * @return An error code indicating the result of the parse operation.
+     */
+    Err parseHeader(std::string &sModelName);
+
+    /**
+     * @brief Parses facets until the "endsolid" line or the end of the block.
+     *
+     * The parsed facets are appended to the vector. Parsing stops without an error
+     * when a facet is cut off by the end of a block which isn't the last one.
+     *
+     * @param vFacets The vector receiving the facets.
+     *
+     * @return An error code indicating the result of the parse operation.
+     */
+    Err parseFacets(std::vector<C3DFacet> &vFacets);
+
+    /**
+     * @brief Checks whether the "endsolid" line was found.
+     *
+     * @return True if the end of the model was reached; otherwise false.
+     */
+    bool isEndSolidFound() const { return m_bEndSolid; }
+
+    /**
+     * @brief Gets the position of the first unparsed byte of the block.
+     *
+     * @return The pointer to the beginning of the first unparsed line.
+     */
+    const char *getPosition() const { return m_pPos; }
+
+    /**
+     * @brief Gets the number of the last parsed line.
+     *
+     * @return The number of lines of the file up to the current position.
+     */
+    uint32_t getLineNo() const { return m_u32LineNo; }
+
+    /**
+     * @brief Converts text to a floating-point number.
+     *
+     * The conversion doesn't depend on the locale. The whole range must form a number: an optional
+     * sign, digits with an optional decimal point and an optional exponent. Numbers outside of the
+     * float range are rejected; numbers below it are rounded to subnormal floats or zero.
+     *
+     * The result is the correctly rounded float, like of strtof. Numbers with at most 2^53 as the
+     * significant digits and a decimal exponent within +/-22, i.e. the numbers written by the usual
+     * exporters, are converted without allocating memory. The others, and the results which are
+     * subnormal or too close to the midpoint of two floats, are converted by strtof on a copy of the text.
+     *
+     * @param pBegin The first character of the number.
+     * @param pEnd The character past the end of the number.
+     * @param fNumber The resulting float number.
+     *
+     * @return True if the text was converted; otherwise false.
+     */
+    static bool parseFloat(const char *pBegin, const char *pEnd, float &fNumber);
+
+private:
+    /**
+     * @brief Moves to the next line of the block.
+     *
+     * The line terminator (LF or CRLF) isn't part of the line. If the line is cut off
+     * by the end of a block which isn't the last one, the data is marked as incomplete.
+     *
+     * @return True if a complete line is available; otherwise false.
+     */
+    bool nextLine();
+
+    /**
+     * @brief Checks whether the current line starts with a keyword.
+     *
+     * The indentation is skipped, letters are compared case-insensitively and a space
+     * in the keyword matches any run of spaces and tabs.
+     *
+     * @param szKeyword The lowercase keyword.
+     * @param pPos Receives the position following the keyword.
+     *
+     * @return True if the keyword was found; otherwise false.
+     */
+    bool matchKeyword(const char *szKeyword, const char *&pPos) const;
+
+    /**
+     * @brief Reads a line and checks that it starts with the expected keyword.
+     *
+     * @param szExpected The lowercase keyword.
+     *
+     * @return An error code indicating the result of the read operation.
+     */
+    Err readLineAndCheck(const char *szExpected);
+
+    /**
+     * @brief Parses a facet whose first line is the current line.
+     *
+     * @param facet The facet to populate with the read information.
+     *
+     * @return An error code indicating the result of the parse operation.
+     */
+    Err parseFacet(C3DFacet &facet);
+
+    /**
+     * @brief Parses a vertex from the current line of format "<header> <float> <float> <float>".
+     *
+     * @param szHeader The lowercase header ("facet normal ", "vertex ").
+     * @param oVertex The vertex object to populate.
+     *
+     * @return An error code indicating the result of the parse operation.
+     */
+    Err parseVertex(const char *szHeader, CVector3d &oVertex) const;
+
+    const char *m_pPos; ///< The beginning of the next line.
+    const char *m_pEnd; ///< The end of the block.
+    const char *m_pLineBegin; ///< The beginning of the current line.
+    const char *m_pLineEnd; ///< The end of the current line (without the line terminator).
+    bool m_bLastBlock; ///< True if the block ends at the end of the file.
+    bool m_bNeedMoreData{false}; ///< True if the block ended in the middle of a line.
+    bool m_bEndSolid{false}; ///< True if the "endsolid" line was found.
+    bool m_bErrorLog{true}; ///< True if parse errors are logged.
+    uint32_t m_u32LineNo; ///< The number of the current line.
+};
+
+#endif // STL_VIEWER_CSTLASCIIPARSER_H_INCLUDED
@@ -12,9 +12,16 @@
 #include<string>
 #include<vector>
 #include<utility>
+#include<memory>
+#include<atomic>
 #include "common.h"
 #include "C3DFacet.h"
 #include "CModel.h"
+#include "CMappedFile.h"
+#include "CLoadHandle.h"
+#include "CCompressedFile.h"
+#include "CLoadStats.h"
+#include "CMeshCache.h"
 
 /**
  * @class CStlLoader
@@ -42,7 +49,9 @@ public:
      * @brief Loads a 3D model from a specified STL file.
      *
      * This function reads the content of an STL file (either binary or ASCII),
-     * and populates the provided model object with the data.
+     * and populates the provided model object with the data. Files compressed
+     * with gzip or zstd are decompressed on the fly. The file name StdinFileName
+     * loads the STL data from the standard input, e.g. from a pipe.
      *
      * @param sFileName The name of the STL file to load.
      * @param oModel The model object to populate with the loaded data.
@@ -51,6 +60,24 @@ public:
      */
     Err loadFile(const std::string &sFileName, CModel &oModel);
 
+    /**
+     * @brief Starts loading a 3D model from a specified STL file in a background thread.
+     *
+     * The loading is done like by loadFile(). The returned handle gives the result, the progress
+     * and cancels the loading; the model must not be destroyed before the handle.
+     *
+     * @param sFileName The name of the STL file to load.
+     * @param oModel The model object to populate with the loaded data.
+     * @param pHandle Receives the handle of the loading.
+     * @param progressCallback Function called by the loading thread when the progress changes; may be empty.
+     * @param loadedCallback Function called by the loading thread when the model is loaded; may be empty.
+     *
+     * @return An error code indicating whether the loading was started.
+     */
+    static Err loadFileAsync(const std::string &sFileName, CModel &oModel, std::unique_ptr<CLoadHandle> &pHandle,
+                             const CLoadHandle::ProgressCallback &progressCallback = nullptr,
+                             const CLoadHandle::LoadedCallback &loadedCallback = nullptr);
+
     /**
      * @brief Gets the file type of the loaded STL file.
      *
@@ -60,167 +87,414 @@ public:
      */
     StlFormat getFileType() const { return m_fileFormat; }
 
+    static constexpr const char *StdinFileName = "-"; ///< The file name which stands for the standard input.
+
+    /**
+     * @brief Gets the timings and counters of the last loadFile() call.
+     *
+     * @return The statistics of the loading.
+     */
+    const CLoadStats &getStats() const { return m_stats; }
+
+    /**
+     * @brief Gets the mesh cache entry of the file of the last loadFile() call.
+     *
+     * The normalized model is stored with it, unless it was loaded from the cache (see CLoadStats::bCached).
+     *
+     * @return The mesh cache entry; invalid if the file can't be cached.
+     */
+    const CMeshCache &getMeshCache() const { return m_oMeshCache; }
+
+    /**
+     * @brief Enables or disables loading the models from the mesh cache.
+     *
+     * The cache holds the models normalized alone, so it's disabled for the models which are normalized together.
+     *
+     * @param bEnabled True to look up the mesh cache (the default); false to always decode the file.
+     */
+    void enableMeshCache(bool bEnabled) { m_bMeshCacheEnabled = bEnabled; }
+
+    /**
+     * @brief Sets a flag which cancels loadFile() when it becomes true, like CLoadHandle::cancel() cancels loadFileAsync().
+     *
+     * Used by the loadings which run on the threads of another owner, e.g. the files of a scene.
+     *
+     * @param pCancelled The flag, which must outlive the loading; nullptr if the loading can't be cancelled.
+     * @param hCancelEvent A manual-reset event signaled together with the flag, which wakes a loading waiting
+     *                     for the data of a pipe; nullptr if there is no such event.
+     */
+    void setCancelFlag(const std::atomic<bool> *pCancelled, HANDLE hCancelEvent = nullptr) { m_pCancelled = pCancelled; m_hCancelEvent = hCancelEvent; }
+
+    /**
+     * @brief Decodes a binary STL file through std::ifstream, one facet record at a time.
+     *
+     * This is the reference decoder which loadBinary() replaced; it's kept for the --bench-load
+     * benchmark, which compares it with the memory-mapped decoder on the same file.
+     *
+     * @param sFileName The name of the binary STL file.
+     * @param vFacets Receives the facets of the file.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    static Err loadBinaryIfstream(const std::string &sFileName, std::vector<C3DFacet> &vFacets);
+
 protected:
 
 private:
     /**
-     * @brief Checks if a given file exists.
+     * @brief Main function of the thread started by loadFileAsync().
      *
-     * This function checks the existence of a specified file by
-     * attempting to open it for reading.
+     * @param pParam Pointer to the load handle.
      *
-     * @param sFileName The name of the file to check.
+     * @return The exit code of the thread.
+     */
+    static DWORD WINAPI loadThread(LPVOID pParam);
+
+    /**
+     * @brief Checks whether the asynchronous loading was cancelled. The function may be called by any thread.
      *
-     * @return True if the file exists; otherwise false.
+     * @return True if the loading shall stop; otherwise false.
      */
-    bool fileExists(const std::string& sFileName) const;
+    bool isLoadCancelled() const { return ((nullptr != m_pLoadHandle) && m_pLoadHandle->isCancelled()) || ((nullptr != m_pCancelled) && *m_pCancelled); }
 
     /**
-     * @brief Retrieves the size of the specified file in bytes.
+     * @brief Gets the event signaled when the loading is cancelled, which the readers of the streams wait for with the data.
      *
-     * This function opens the file and determines its size, which allows
-     * for proper validation of STL file data.
+     * @return The event of the asynchronous loading or the one set by setCancelFlag(); nullptr if there is none.
+     */
+    HANDLE getCancelEvent() const { return (nullptr != m_pLoadHandle)? m_pLoadHandle->getCancelEvent() : m_hCancelEvent; }
+
+    /**
+     * @brief Records the progress in the statistics, reports it to the asynchronous loading and checks whether it was cancelled.
      *
-     * @param sFileName The name of the file whose size to retrieve.
+     * @param u64BytesProcessed Number of bytes of the file decoded so far.
+     * @param u32Facets Number of facets decoded so far.
      *
-     * @return The size of the file in bytes.
+     * @return Err::LoadCancelled if the loading shall stop; otherwise Err::NoError.
      */
-    std::streampos getFileSize(const std::string &sFileName) const;
+    Err reportProgress(uint64_t u64BytesProcessed, uint32_t u32Facets);
 
     /**
-     * @brief Reads the format of the specified STL file.
+     * @brief Reads the format of the STL file.
      *
      * This function examines the file to determine whether it is in
      * ASCII or binary format.
      *
-     * @param sFileName The name of the file whose format to read.
+     * @param oFile The open STL file.
      */
-    void readStlFileFormat(const std::string &sFileName);
+    void readStlFileFormat(const CMappedFile &oFile);
+
+    /**
+     * @brief Loads the normalized model from the mesh cache if the cache has a valid copy of the file.
+     *
+     * @param sFileName The name of the STL file.
+     * @param oFile The open STL file.
+     * @param oModel The model to populate.
+     *
+     * @return True if the model was loaded from the cache; false if the file shall be decoded.
+     */
+    bool loadCached(const std::string &sFileName, const CMappedFile &oFile, CModel &oModel);
 
     /**
      * @brief Checks if the given STL file is in ASCII format.
      *
-     * This function determines if the file is ASCII format by searching
-     * for the presence of the "solid " keyword in the file.
+     * This function determines if the file is ASCII format by checking
+     * only the head and the tail of the file: the file must start with
+     * the "solid " keyword, its head must be text and its last line must
+     * contain "endsolid".
      *
-     * @param sFileName The name of the STL file to check.
+     * @param oFile The open STL file.
      *
      * @return True if the file is in ASCII format; false otherwise.
      */
-    bool isStlFileAsciiFormat(const std::string &sFileName);
+    bool isStlFileAsciiFormat(const CMappedFile &oFile);
 
     /**
      * @brief Checks if the given STL file is in binary format.
      *
      * This function checks if the file is a valid binary STL file by
-     * reading its header and verifying its content.
+     * reading its header and verifying it against the file size.
      *
-     * @param sFileName The name of the STL file to check.
-     * @param fileSize The total size of the file in bytes.
+     * @param oFile The open STL file.
      *
      * @return True if the file is in binary format; false otherwise.
      */
-    bool isStlFileBinaryFormat(const std::string &sFileName, std::streampos fileSize);
+    bool isStlFileBinaryFormat(const CMappedFile &oFile);
+
+    /**
+     * @brief Checks whether samples of the data following the binary header are text.
+     *
+     * The facets of a binary file contain control characters (e.g. zero bytes), so a few
+     * samples are enough to tell them from the text of an ASCII file.
+     *
+     * @param oFile The open STL file.
+     *
+     * @return True if all samples are text; false otherwise.
+     */
+    static bool isStlFileTextSampled(const CMappedFile &oFile);
 
     /**
      * @brief Allocates memory for the model based on the triangle count.
      *
      * This function attempts to resize the facets vector based on the
-     * number of triangles read from the STL file.
+     * number of triangles read from the binary STL file. For an ASCII file
+     * the number of triangles is unknown before parsing, so the capacity
+     * is only reserved for the number of facets estimated from the file size.
      *
+     * @param oFile The open STL file.
      * @param oModel The model object for which memory allocation occurs.
      *
      * @return An error code indicating the result of the memory allocation.
      */
-    Err allocateMemory(CModel &oModel);
+    Err allocateMemory(const CMappedFile &oFile, CModel &oModel);
 
     /**
      * @brief Loads a binary STL file.
      *
-     * This function reads a binary STL file and populates the model
-     * data structure with its contents.
+     * This function decodes the facets of a binary STL file straight from
+     * the mapped pages into the model data structure, using SIMD instructions
+     * where available.
      *
-     * @param sFileName The name of the STL file to load.
+     * @param oFile The open STL file.
      * @param oModel The model object to populate with the loaded data.
      *
      * @return An error code indicating the result of the operation.
      */
-    Err loadBinary(const std::string &sFileName, CModel &oModel);
+    Err loadBinary(const CMappedFile &oFile, CModel &oModel);
+
+    /**
+     * @brief Reads a sample of the facets of a binary STL file and sets it as the preview of the model.
+     *
+     * The records of a binary file have a fixed size, so groups of consecutive facets are read at
+     * evenly spaced positions with positional reads, without mapping the file. A failed preview isn't
+     * an error; the problems of the file are reported by loadBinary().
+     *
+     * @param oFile The open STL file.
+     * @param oModel The model receiving the preview.
+     */
+    void loadPreview(const CMappedFile &oFile, CModel &oModel);
+
+    /**
+     * @brief Decodes binary STL facet records and validates their points.
+     *
+     * With SSE2 available the records are converted with vector loads, shuffles and
+     * stores, and the points are validated with a branch-free test of the exponent bits.
+     * Otherwise the records are converted and validated one by one.
+     *
+     * The bounding box of the points is gathered while they are in the registers, so the facets
+     * don't have to be read again to find it.
+     *
+     * @param pRecords The first facet record (50B each).
+     * @param u32Count The number of records.
+     * @param pFacets The facets to populate.
+     * @param oBox Receives the bounding box of the facets; it's valid only if the function succeeded.
+     *
+     * @return True if all points are finite; otherwise false.
+     */
+    static bool decodeBinaryFacets(const uint8_t *pRecords, uint32_t u32Count, C3DFacet *pFacets, CBoundingBox &oBox);
+
+    /**
+     * @brief Finds the first facet with a point which isn't finite.
+     *
+     * @param pFacets The first facet.
+     * @param u32Count The number of facets.
+     *
+     * @return The index of the invalid facet, or u32Count if all facets are valid.
+     */
+    static uint32_t findInvalidBinaryFacet(const C3DFacet *pFacets, uint32_t u32Count);
+
+    /**
+     * @brief Checks whether all points of a facet are finite.
+     *
+     * @param facet The facet to check.
+     *
+     * @return True if no coordinate is infinite or NaN; otherwise false.
+     */
+    static bool isBinaryFacetValid(const C3DFacet &facet);
 
     /**
      * @brief Loads an ASCII STL file.
      *
-     * This function reads an ASCII STL file line by line, extracting
-     * the triangle data and populating the model data structure.
+     * This function parses the text of an ASCII STL file in a single pass,
+     * straight from the mapped pages, and appends the triangle data to the
+     * model data structure. Big files are parsed in chunks by all threads
+     * of the thread pool.
      *
-     * @param sFileName The name of the STL file to load.
+     * @param oFile The open STL file.
+     * @param oModel The model object to populate with the loaded data.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err loadAscii(const CMappedFile &oFile, CModel &oModel);
+
+    /**
+     * @struct AsciiChunk
+     * @brief A part of an ASCII STL file parsed by one thread.
+     */
+    struct AsciiChunk
+    {
+        uint64_t u64Begin{0}; ///< File offset of the first byte of the chunk.
+        std::vector<C3DFacet> vFacets{}; ///< Facets parsed from the chunk.
+        uint32_t u32Lines{0}; ///< Number of lines of the chunk.
+        bool bValid{false}; ///< True if the chunk was parsed to its end without errors.
+        bool bEndSolid{false}; ///< True if the chunk contains the "endsolid" line.
+    };
+
+    /**
+     * @brief Parses the facets of an ASCII STL file serially.
+     *
+     * @param oFile The open STL file.
+     * @param u64Offset File offset of the first line to parse.
+     * @param u32LineNo The number of lines preceding the offset.
+     * @param oModel The model receiving the facets; they are published for drawing window by window.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err parseAsciiFacets(const CMappedFile &oFile, uint64_t u64Offset, uint32_t u32LineNo, CModel &oModel);
+
+    /**
+     * @brief Parses the facets of an ASCII STL file in parallel chunks.
+     *
+     * The result, including the errors and their line numbers, is the same as of parseAsciiFacets().
+     *
+     * @param oFile The open STL file.
+     * @param u64DataOffset File offset of the first line following the header.
+     * @param u32LineNo The number of lines preceding the offset.
+     * @param oModel The model receiving the facets; they are published for drawing wave by wave.
+     *
+     * @return An error code indicating the result of the operation.
+     */
+    Err parseAsciiChunks(const CMappedFile &oFile, uint64_t u64DataOffset, uint32_t u32LineNo, CModel &oModel);
+
+    /**
+     * @brief Parses one chunk of an ASCII STL file. The function is executed by the thread pool.
+     *
+     * @param oFile The open STL file.
+     * @param u64End File offset of the end of the chunk.
+     * @param chunk The chunk with the beginning set; receives the result.
+     */
+    static void parseAsciiChunk(const CMappedFile &oFile, uint64_t u64End, AsciiChunk &chunk);
+
+    /**
+     * @brief Finds the first line starting with the "facet" keyword at or after the offset.
+     *
+     * @param oFile The open STL file.
+     * @param u64Offset The file offset where the search starts.
+     *
+     * @return The file offset of the line, or the file size if the line isn't found nearby.
+     */
+    static uint64_t findAsciiChunkBoundary(const CMappedFile &oFile, uint64_t u64Offset);
+
+    /**
+     * @brief Loads a compressed STL file.
+     *
+     * The file is decompressed by a background thread while the decompressed data is decoded,
+     * so no decompressed copy of the file is created.
+     *
+     * @param oFile The open compressed file.
+     * @param compression The compression format of the file.
      * @param oModel The model object to populate with the loaded data.
      *
      * @return An error code indicating the result of the operation.
      */
-    Err loadAscii(const std::string &sFileName, CModel &oModel);
+    Err loadCompressed(const CMappedFile &oFile, CCompressedFile::Compression compression, CModel &oModel);
 
     /**
-     * @brief Reads a line from the ASCII STL file and checks for expected content.
+     * @brief Loads an STL file from a pipe, e.g. the standard input.
      *
-     * This function reads lines from the file while checking if the content matches
-     * the expected header.
+     * The pipe can't be mapped nor seeked, so the data is read by a background thread and decoded like
+     * decompressed data, while it arrives. Compressed data isn't supported.
      *
-     * @param file The input file stream.
-     * @param sExpected The header string that we expect to find.
-     * @param u32CurrentLineNo The current line number in the file.
+     * @param hInput The handle of the pipe.
+     * @param oModel The model object to populate with the loaded data.
      *
-     * @return An error code indicating the result of the read operation.
+     * @return An error code indicating the result of the operation.
      */
-    Err stlAsciiReadLineAndCheck(std::ifstream &file, const std::string &sExpected, uint32_t &u32CurrentLineNo);
+    Err loadPipe(HANDLE hInput, CModel &oModel);
 
     /**
-     * @brief Reads the triangle data from a facet in the ASCII STL file.
+     * @brief Loads an STL file from a stream opened by loadCompressed() or loadPipe().
+     *
+     * @param oStream The open stream.
+     * @param oModel The model object to populate with the loaded data.
      *
-     * This function processes a facet from the STL file, extracting the
-     * normal and vertices, and checking for correct formatting.
+     * @return An error code indicating the result of the operation.
+     */
+    Err loadStream(CCompressedFile &oStream, CModel &oModel);
+
+    /**
+     * @brief Gets the fraction of the file read from a stream.
      *
-     * @param file The input file stream.
-     * @param facet The facet to populate with the read information.
-     * @param u32CurrentLineNo The current line number in the file.
+     * @param oStream The open stream.
      *
-     * @return An error code indicating the result of the read operation.
+     * @return The fraction of the file read so far (0.0-1.0), or 0 if the size of the file is unknown.
      */
-    Err stlAsciiReadFacet(std::ifstream &file, C3DFacet &facet, uint32_t &u32CurrentLineNo);
+    float getStreamProgress(const CCompressedFile &oStream) const;
 
     /**
-     * @brief Reads a vertex from an ASCII STL file.
+     * @brief Reads the format of the STL file from the head of the decompressed data.
      *
-     * This function extracts a vertex from the STL file line based on
-     * the specified header.
+     * The size of the decompressed data is unknown, so a binary file is recognized by its head only;
+     * the number of facets is verified when the file is decoded.
+     *
+     * @param oStream The decompressed file with the window filled.
+     */
+    void readStlStreamFormat(const CCompressedFile &oStream);
+
+    /**
+     * @brief Loads a binary STL file from the decompressed data.
      *
-     * @param file The input file stream.
-     * @param sHeader The header to search for ("facet normal", "vertex", etc.).
-     * @param u32CurrentLineNo The current line number.
-     * @param oVertex The vertex object to populate.
+     * @param oStream The decompressed file with the window filled.
+     * @param oModel The model object to populate with the loaded data.
      *
-     * @return An error code indicating the result of the read operation.
+     * @return An error code indicating the result of the operation.
      */
-    Err readAsciiVertex(std::ifstream &file, const std::string &sHeader, size_t &u32CurrentLineNo, CVector3d &oVertex);
+    Err loadBinaryStream(CCompressedFile &oStream, CModel &oModel);
 
     /**
-     * @brief Converts a string to a floating-point number.
+     * @brief Loads an ASCII STL file from the decompressed data.
+     *
+     * @param oStream The decompressed file with the window filled.
+     * @param oModel The model object to populate with the loaded data.
      *
-     * This function attempts to convert a string representation of a
-     * number into its float representation.
+     * @return An error code indicating the result of the operation.
+     */
+    Err loadAsciiStream(CCompressedFile &oStream, CModel &oModel);
+
+    /**
+     * @brief Checks whether a block of data looks like text.
      *
-     * @param sStr The string to convert.
-     * @param fNumber The resulting float number.
+     * @param pData The data to check.
+     * @param size Number of bytes to check.
      *
-     * @return An error code indicating the result of the conversion.
+     * @return True if the data contains no control characters other than white spaces; otherwise false.
      */
-    Err stringToFloat(const std::string &sStr, float &fNumber) const;
+    static bool isTextData(const uint8_t *pData, size_t size);
 
     static constexpr int StlBinaryHeaderSize = 80; ///< Size of the STL binary header.
     static constexpr int StlBinaryDataStart = 84; ///< Start position of the binary data in the STL file.
+    static constexpr size_t StlBinaryFacetSize = 3*sizeof(float) + 3*3*sizeof(float) + sizeof(uint16_t); ///< Size of one facet record in the binary STL file (50B).
+    static constexpr uint32_t StlBinaryFacetsPerView = 256*1024; ///< Number of binary facets decoded from one mapped view (12.5MB of the 32-bit address space).
+    static constexpr uint32_t StlPreviewMinFacets = 2*1024*1024; ///< Minimum number of facets of a binary STL file loaded asynchronously with a preview.
+    static constexpr uint32_t StlPreviewReads = 1024; ///< Number of positions of the file read for the preview.
+    static constexpr uint32_t StlPreviewFacetsPerRead = 32; ///< Number of consecutive facets read at each position for the preview (1.6kB).
+    static constexpr size_t StlAsciiProbeSize = 4096; ///< Number of bytes examined at the head and at the tail of a file by the ASCII format detection.
+    static constexpr size_t StlFormatSampleSize = 512; ///< Size of one sample of the facet data checked for text by the format detection.
+    static constexpr size_t StlAsciiViewSize = 16*1024*1024; ///< Size of one mapped window of an ASCII STL file.
+    static constexpr uint64_t StlAsciiChunkSize = 4*1024*1024; ///< Nominal size of an ASCII STL file part parsed by one thread.
+    static constexpr uint32_t StlAsciiChunksPerThread = 4; ///< Number of chunks per thread parsed before the facets are appended to the model.
+    static constexpr size_t StlAsciiBoundaryProbeSize = 64*1024; ///< Number of bytes searched for the "facet" line starting a chunk.
+    static constexpr uint64_t StlAsciiBytesPerFacet = 200; ///< Estimated size of one facet in an ASCII STL file (typical exporters write 200-280B per facet).
 
     StlFormat m_fileFormat{StlFormat::notChecked}; ///< The format of the STL file.
-    uint32_t m_u32TriangleNumber{0}; ///< Number of triangles in the STL file.
+    uint32_t m_u32TriangleNumber{0}; ///< Number of triangles in the STL file (known after parsing for ASCII files).
+    uint64_t m_u64FileSize{0}; ///< Size of the STL file.
+    CLoadHandle *m_pLoadHandle{nullptr}; ///< Handle of the asynchronous loading, or nullptr for loadFile().
+    const std::atomic<bool> *m_pCancelled{nullptr}; ///< The flag cancelling the loading set by setCancelFlag(), or nullptr.
+    HANDLE m_hCancelEvent{nullptr}; ///< The event cancelling the loading set by setCancelFlag(), or nullptr.
+    CLoadStats m_stats{}; ///< Timings and counters of the loading.
+    CMeshCache m_oMeshCache{}; ///< The mesh cache entry of the loaded file.
+    bool m_bMeshCacheEnabled{true}; ///< True if the models may be loaded from the mesh cache.
 };
 
 #endif // STL_VIEWER_CSTLLOADER_H_INCLUDED
@@ -0,0 +1,70 @@
+/**
+ * @file CStopwatch.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CSTOPWATCH_H_INCLUDED
+#define STL_VIEWER_CSTOPWATCH_H_INCLUDED
+
+#include <windows.h>
+#include <stdint.h>
+
+/**
+ * @class CStopwatch
+ * @brief Measures time intervals with the high-resolution performance counter.
+ */
+class CStopwatch
+{
+public:
+    /**
+     * @brief Constructor starting the measurement.
+     */
+    CStopwatch() : m_i64Start{getTicks()} {}
+
+    /**
+     * @brief Starts the measurement again.
+     */
+    void restart() { m_i64Start = getTicks(); }
+
+    /**
+     * @brief Gets the time elapsed since the measurement was started.
+     *
+     * @return The elapsed time in milliseconds.
+     */
+    double getMilliseconds() const { return static_cast<double>(getTicks() - m_i64Start) * 1000.0 / static_cast<double>(getFrequency()); }
+
+private:
+    /**
+     * @brief Reads the performance counter.
+     *
+     * @return The current value of the counter.
+     */
+    static int64_t getTicks()
+    {
+        LARGE_INTEGER ticks{};
+        QueryPerformanceCounter(&ticks);
+        return ticks.QuadPart;
+    }
+
+    /**
+     * @brief Gets the frequency of the performance counter. It's fixed at system boot, so it's read once.
+     *
+     * @return The number of counter ticks per second.
+     */
+    static int64_t getFrequency()
+    {
+        static const int64_t i64Frequency = []()
+        {
+            LARGE_INTEGER frequency{};
+            QueryPerformanceFrequency(&frequency);
+            return (frequency.QuadPart > 0)? frequency.QuadPart : 1;
+        }();
+        return i64Frequency;
+    }
+
+    int64_t m_i64Start; ///< The counter value at the start of the measurement.
+};
+
+#endif // STL_VIEWER_CSTOPWATCH_H_INCLUDED
@@ -0,0 +1,119 @@
+/**
+ * @file CThreadPool.h
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef STL_VIEWER_CTHREADPOOL_H_INCLUDED
+#define STL_VIEWER_CTHREADPOOL_H_INCLUDED
+
+#include <windows.h>
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <vector>
+
+/**
+ * @class CThreadPool
+ * @brief Pool of worker threads executing parallel loops.
+ *
+ * The pool starts one worker thread per additional processor of the machine. The thread
+ * calling parallelFor() takes part in the loop too, so the loop runs on all processors and
+ * parallel loops may be nested: a task can start its own parallel loop.
+ */
+class CThreadPool
+{
+public:
+    /**
+     * @brief Gets the single instance of the thread pool. The worker threads are started on the first call.
+     *
+     * @return Reference to the thread pool.
+     */
+    static CThreadPool &getInstance();
+
+    /**
+     * @brief Deleted copy constructor; the object owns system handles.
+     */
+    CThreadPool(const CThreadPool &) = delete;
+
+    /**
+     * @brief Deleted assignment operator; the object owns system handles.
+     */
+    CThreadPool &operator=(const CThreadPool &) = delete;
+
+    /**
+     * @brief Gets the number of threads executing a parallel loop.
+     *
+     * @return The number of worker threads plus the calling thread.
+     */
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(m_vThreads.size()) + 1; }
+
+    /**
+     * @brief Executes a task for every index of the range [0, u32Count) and waits for completion.
+     *
+     * The indices are distributed dynamically among the threads, so tasks of different duration
+     * are balanced. The task must not throw exceptions.
+     *
+     * @param u32Count The number of indices.
+     * @param task The task to execute for every index.
+     */
+    void parallelFor(uint32_t u32Count, const std::function<void(uint32_t)> &task);
+
+private:
+    /**
+     * @struct Job
+     * @brief A parallel loop shared by the threads.
+     */
+    struct Job
+    {
+        const std::function<void(uint32_t)> *pTask; ///< The task of the loop.
+        uint32_t u32Count; ///< The number of indices.
+        std::atomic<uint32_t> u32NextIdx; ///< The next index to execute.
+        uint32_t u32Workers; ///< The number of worker threads executing the loop (guarded by m_lock).
+        bool bQueued; ///< True while the job is in the queue (guarded by m_lock).
+        HANDLE hIdle; ///< Event set when the last worker left a job removed from the queue.
+    };
+
+    /**
+     * @brief Constructor starting the worker threads.
+     */
+    CThreadPool();
+
+    /**
+     * @brief Destructor stopping the worker threads.
+     */
+    ~CThreadPool();
+
+    /**
+     * @brief Executes the indices of a job until none is left.
+     *
+     * @param job The job to execute.
+     */
+    static void runJob(Job &job);
+
+    /**
+     * @brief Removes a job from the queue. The caller must hold m_lock.
+     *
+     * @param job The job to remove.
+     */
+    void dequeueJob(Job &job);
+
+    /**
+     * @brief Main function of a worker thread.
+     *
+     * @param pParam Pointer to the thread pool.
+     *
+     * @return The exit code of the thread.
+     */
+    static DWORD WINAPI workerThread(LPVOID pParam);
+
+    std::vector<HANDLE> m_vThreads{}; ///< Handles of the worker threads.
+    std::deque<Job*> m_qJobs{}; ///< Loops waiting for free threads (guarded by m_lock).
+    CRITICAL_SECTION m_lock; ///< Lock of the job queue.
+    HANDLE m_hWork{nullptr}; ///< Manual-reset event set while the job queue isn't empty.
+    bool m_bStop{false}; ///< True when the worker threads shall exit (guarded by m_lock).
+};
+
+#endif // STL_VIEWER_CTHREADPOOL_H_INCLUDED
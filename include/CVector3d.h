@@ -49,5 +49,16 @@ public:
  */
 std::ostream& operator<<(std::ostream& stream, const CVector3d& o);
 
+/**
+ * @brief Scales a vector to the unit length.
+ *
+ * The vector is divided by its largest coordinate first, so the squares of tiny vectors, e.g. the
+ * cross products of the edges of small facets, don't underflow.
+ *
+ * @param oVector The vector; it's left unchanged if it's zero.
+ * @return True if the vector was normalized; false if it's zero.
+ */
+bool normalizeVector(CVector3d& oVector);
+
 
 #endif // STL_VIEWER_CVECTOR3D_H_INCLUDED
@@ -53,7 +53,15 @@ enum class Err : int
     StlVertFindNum2Beg,
     StlVertFindNum2End,
     StlVertFindNum3Beg,
-    StlConvertToFloat
+    StlConvertToFloat,
+    MapFile,
+    CantCreateThread,
+    LoadCancelled,
+    UnsupportedCompression,
+    Decompress,
+    PageFile,
+    MeshCache,
+    FileWatch
 };
 
 
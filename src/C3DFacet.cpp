@@ -7,3 +7,22 @@
 
 #include "C3DFacet.h"
 
+void C3DFacet::computeNormal()
+{
+    const float fAX = p2.m_fX - p1.m_fX;
+    const float fAY = p2.m_fY - p1.m_fY;
+    const float fAZ = p2.m_fZ - p1.m_fZ;
+    const float fBX = p3.m_fX - p1.m_fX;
+    const float fBY = p3.m_fY - p1.m_fY;
+    const float fBZ = p3.m_fZ - p1.m_fZ;
+    CVector3d oWinding{fAY * fBZ - fAZ * fBY, fAZ * fBX - fAX * fBZ, fAX * fBY - fAY * fBX};
+    if (normalizeVector(oWinding))
+    {
+        normal = oWinding;
+    }
+    else
+    {
+        normalizeVector(normal);
+    }
+}
+
@@ -9,9 +9,24 @@
 #include "CLogger.h"
 #include "CApp.h"
 #include "CStlLoader.h"
+#include "CStopwatch.h"
+#include <algorithm>
+#include <string.h>
 
 using namespace std::literals::string_literals;
 
+constexpr const char *CApp::WeldOption;
+constexpr const char *CApp::SmoothOption;
+constexpr const char *CApp::StreamOption;
+constexpr const char *CApp::QuantizeOption;
+constexpr const char *CApp::BvhOption;
+constexpr const char *CApp::BenchBvhOption;
+constexpr uint32_t CApp::BenchmarkRays;
+constexpr uint32_t CApp::BenchmarkBoxes;
+constexpr float CApp::BenchmarkBoxSize;
+constexpr const char *CApp::BenchLoadOption;
+constexpr uint32_t CApp::BenchmarkLoads;
+
 Err CApp::getCmdLineArguments()
 {
     Err retVal{Err::NoError};
@@ -20,21 +35,81 @@ Err CApp::getCmdLineArguments()
     auto szaArgList = CommandLineToArgvW(GetCommandLineW(), &iArgCount);
     if (nullptr != szaArgList)
     {
-        if (2 == iArgCount)
+        if (iArgCount >= 2)
         {
             logPrint(Trace) << "Reading command line arguments";
-            int iArg1Len = lstrlenW(szaArgList[1]);
-            int iStringLen = WideCharToMultiByte(CP_ACP, 0, szaArgList[1], iArg1Len, nullptr, 0, nullptr, nullptr);
-            std::string sInputFileName;
-            sInputFileName.resize(iStringLen);
-            WideCharToMultiByte(CP_ACP, 0, szaArgList[1], iArg1Len, &sInputFileName[0], iStringLen, nullptr, nullptr);
+            std::vector<std::string> vArguments;
+            for (int iArg = 1; iArg < iArgCount; ++iArg)
+            {
+                int iArgLen = lstrlenW(szaArgList[iArg]);
+                int iStringLen = WideCharToMultiByte(CP_ACP, 0, szaArgList[iArg], iArgLen, nullptr, 0, nullptr, nullptr);
+                std::string sArgument;
+                sArgument.resize(iStringLen);
+                WideCharToMultiByte(CP_ACP, 0, szaArgList[iArg], iArgLen, &sArgument[0], iStringLen, nullptr, nullptr);
+                if (0 == sArgument.compare(0, strlen(WeldOption), WeldOption))
+                {
+                    const Err result = parseWeldOption(sArgument.substr(strlen(WeldOption)));
+                    retVal = (Err::NoError == retVal)? result : retVal;
+                }
+                else if (SmoothOption == sArgument)
+                {
+                    // the vertex normals are computed on the welded mesh; --weld=<tolerance> may set the tolerance
+                    logPrint(Debug) << "Smoothing the normals of the welded vertices";
+                    m_bWeld = true;
+                    m_bSmooth = true;
+                }
+                else if (StreamOption == sArgument)
+                {
+                    logPrint(Debug) << "Keeping the facets in streams of coordinates";
+                    m_bStream = true;
+                }
+                else if (0 == sArgument.compare(0, strlen(QuantizeOption), QuantizeOption))
+                {
+                    const Err result = parseQuantizeOption(sArgument.substr(strlen(QuantizeOption)));
+                    retVal = (Err::NoError == retVal)? result : retVal;
+                }
+                else if (BvhOption == sArgument)
+                {
+                    logPrint(Debug) << "Building the bounding volume hierarchies";
+                    m_bBvh = true;
+                }
+                else if (BenchBvhOption == sArgument)
+                {
+                    logPrint(Debug) << "Benchmarking the bounding volume hierarchies";
+                    m_bBenchBvh = true;
+                }
+                else if (BenchLoadOption == sArgument)
+                {
+                    logPrint(Debug) << "Benchmarking the loading";
+                    m_bBenchLoad = true;
+                }
+                else
+                {
+                    vArguments.push_back(sArgument);
+                }
+            }
             LocalFree(szaArgList);
-            logPrint(Debug) << "Input file:\"" << sInputFileName << "\"";
-            setFileName(sInputFileName);
+
+            if ((Err::NoError == retVal) && vArguments.empty())
+            {
+                logPrint(Error) << "No input file given";
+                retVal = Err::MissingArg;
+            }
+            else if (Err::NoError == retVal)
+            {
+                // the Windows shell doesn't expand the wildcards
+                std::vector<std::string> vFileNames;
+                CScene::expandFileNames(vArguments, vFileNames);
+                for (const auto &sFileName : vFileNames)
+                {
+                    logPrint(Debug) << "Input file:\"" << sFileName << "\"";
+                }
+                setFileNames(vFileNames);
+            }
         }
         else
         {
-            logPrint(Error) << "One command line argument is expected";
+            logPrint(Error) << "At least one command line argument is expected";
             retVal = Err::MissingArg;
         }
     }
@@ -47,6 +122,47 @@ Err CApp::getCmdLineArguments()
     return retVal;
 }
 
+Err CApp::parseWeldOption(const std::string &sValue)
+{
+    Err retVal{Err::NoError};
+
+    // --weld welds the equal vertices, --weld=<tolerance> the vertices closer than the tolerance
+    m_bWeld = true;
+    m_fWeldTolerance = 0.0f;
+    if (!sValue.empty())
+    {
+        char *pEnd{nullptr};
+        m_fWeldTolerance = strtof(sValue.c_str() + 1, &pEnd);
+        if (('=' != sValue[0]) || (pEnd == sValue.c_str() + 1) || ('\0' != *pEnd) || !(m_fWeldTolerance >= 0.0f))
+        {
+            logPrint(Error) << "Invalid weld option: " << sValue;
+            retVal = Err::MissingArg;
+        }
+    }
+    logPrint(Debug) << "Welding vertices, tolerance " << m_fWeldTolerance;
+    return retVal;
+}
+
+Err CApp::parseQuantizeOption(const std::string &sValue)
+{
+    Err retVal{Err::NoError};
+
+    // --quantize encodes the normals with 8-bit coordinates, --quantize=16 with 16-bit ones
+    m_bQuantize = true;
+    m_u32NormalBits = 8;
+    if ("=16" == sValue)
+    {
+        m_u32NormalBits = 16;
+    }
+    else if (!sValue.empty() && ("=8" != sValue))
+    {
+        logPrint(Error) << "Invalid quantize option: " << sValue;
+        retVal = Err::MissingArg;
+    }
+    logPrint(Debug) << "Quantizing facets, normal bits " << m_u32NormalBits;
+    return retVal;
+}
+
 void CApp::handleErrorCode(Err errorCode) const
 {
     std::string sMessage;
@@ -58,7 +174,7 @@ void CApp::handleErrorCode(Err errorCode) const
     switch (errorCode)
     {
         case Err::MissingArg:
-            MessageBox(nullptr, "USAGE: stl_viewer.exe <file.stl>", "Error", MB_OK);
+            MessageBox(nullptr, "USAGE: stl_viewer.exe [--weld[=<tolerance>] [--smooth] | --soa | --quantize[=8|16]] [--bvh] [--bench-load] [--bench-bvh] <file.stl> [<file.stl> ...]\nMany files or wildcards (e.g. parts\\*.stl) show the models together.\nUse - as the file name to read the STL data from the standard input.\n--weld keeps the models as indexed meshes with the vertices closer than the tolerance (0 by default) welded; the models are normalized to the size 1 first.\n--smooth welds the models and shades them smoothly with the normals of the vertices.\n--soa keeps the coordinates of the models in separate streams, which are rotated faster.\n--quantize keeps the corners as 16-bit fractions of the model size and the normals with 8-bit (by default) or 16-bit coordinates, so the models take 2-2.4x less memory.\n--bvh builds the bounding volume hierarchies of the models and logs the times of their builds.\n--bench-load loads the files before they are shown and logs the times of the memory-mapped and the std::ifstream decoders of the binary files and the parse throughput of the ASCII files.\n--bench-bvh loads the files before they are shown, builds their bounding volume hierarchies and logs the times of ray casts and box queries.", "Error", MB_OK);
             break;
 
         case Err::InvalidStlFile:
@@ -66,7 +182,7 @@ void CApp::handleErrorCode(Err errorCode) const
             break;
 
         case Err::FileNotFound:
-            sMessage = "File not found: "s + m_sInputFileName;
+            sMessage = "File not found: "s + ((1 == m_vInputFileNames.size())? m_vInputFileNames.front() : "none of the files"s);
             MessageBox(nullptr, sMessage.c_str(), "Error:", MB_OK|MB_ICONERROR);
             break;
 
@@ -74,6 +190,18 @@ void CApp::handleErrorCode(Err errorCode) const
             MessageBox(nullptr, "Not enough memory", "Error:", MB_OK|MB_ICONERROR);
             break;
 
+        case Err::UnsupportedCompression:
+            MessageBox(nullptr, "The compression format of the STL file isn't supported by this build", "Error:", MB_OK|MB_ICONERROR);
+            break;
+
+        case Err::Decompress:
+            MessageBox(nullptr, "Compressed STL file is broken", "Error:", MB_OK|MB_ICONERROR);
+            break;
+
+        case Err::PageFile:
+            MessageBox(nullptr, "Can't use temporary file for a model bigger than memory", "Error:", MB_OK|MB_ICONERROR);
+            break;
+
         case Err::NoError:
             break;
 
@@ -89,14 +217,14 @@ Err CApp::init()
 {
     Err retVal{Err::NoError};
 
-    retVal = loadFile();
+    // the window is created first, so the model can be drawn while it's being loaded
+    retVal = m_oRenderer.init(messageHandler);
     if (Err::NoError == retVal)
     {
-        retVal = m_oRenderer.init(messageHandler);
-        if (Err::NoError == retVal)
-        {
-            m_hWindowHandle = m_oRenderer.getWindowHandle();
-        }
+        m_hWindowHandle = m_oRenderer.getWindowHandle();
+        benchmarkLoading();
+        benchmarkBvh();
+        retVal = startLoading();
     }
 
     return retVal;
@@ -185,15 +313,405 @@ Err CApp::loadFile()
     Err retVal{Err::NoError};
     CStlLoader oStlLoader;
 
-    retVal = oStlLoader.loadFile(m_sInputFileName, m_oModel);
+    retVal = oStlLoader.loadFile(m_vInputFileNames.front(), m_oScene.getModel(0));
+    m_oRenderer.setLoadStats(oStlLoader.getStats());
     if (Err::NoError == retVal)
     {
-        m_oModel.normalizeModel();
+        prepareModel(m_oScene.getModel(0), oStlLoader.getStats(), oStlLoader.getMeshCache());
+    }
+
+    return retVal;
+}
+
+Err CApp::startLoading()
+{
+    Err retVal{Err::NoError};
+
+    // the models are prepared by the loading threads, so the drawing isn't held up when the loading is finished
+    m_oScene.clear();
+    if (m_vInputFileNames.size() > 1)
+    {
+        retVal = m_oScene.startLoading(m_vInputFileNames, [this](CScene &oScene) { prepareScene(oScene); });
+    }
+    else
+    {
+        CModel &oModel = m_oScene.addModel();
+        oModel.setLoading(true);
+        const CLoadHandle::LoadedCallback loadedCallback = [this](CModel &oLoadedModel, const CLoadStats &oStats, const CMeshCache &oMeshCache)
+        {
+            prepareModel(oLoadedModel, oStats, oMeshCache);
+        };
+        if (Err::NoError != CStlLoader::loadFileAsync(m_vInputFileNames.front(), oModel, m_pLoadHandle, nullptr, loadedCallback))
+        {
+            logPrint(Warning) << "Can't load in background; loading synchronously";
+            retVal = loadFile();
+            oModel.setLoading(false);
+        }
+        // the changes made while the file is being loaded are picked up when the loading is finished
+        if ((CStlLoader::StdinFileName != m_vInputFileNames.front()) && (Err::NoError != m_oFileWatcher.start(m_vInputFileNames.front())))
+        {
+            logPrint(Warning) << "Can't watch the file; it won't be reloaded when it changes";
+        }
+    }
+
+    return retVal;
+}
+
+Err CApp::checkLoading()
+{
+    Err retVal{Err::NoError};
+
+    if (m_pLoadHandle && m_pLoadHandle->isDone())
+    {
+        retVal = m_pLoadHandle->getResult();
+        const CLoadHandle::Progress progress = m_pLoadHandle->getProgress();
+        logPrint(Debug) << "Loading finished: " << retVal << ", " << progress.u32Facets << " facets, "
+                        << progress.u64BytesProcessed << "/" << progress.u64BytesTotal << "B";
+        m_oRenderer.setLoadStats(m_pLoadHandle->getStats());
+        m_pLoadHandle.reset();
+        m_oScene.setLoading(false);
+    }
+    else if (m_oScene.isBatchLoading() && m_oScene.isDone())
+    {
+        retVal = finishBatchLoading();
     }
 
     return retVal;
 }
 
+Err CApp::finishBatchLoading()
+{
+    Err retVal{Err::NoError};
+
+    retVal = m_oScene.finishLoading();
+    const std::vector<Err> &vResults = m_oScene.getResults();
+    const size_t loaded = static_cast<size_t>(std::count(vResults.begin(), vResults.end(), Err::NoError));
+    logPrint(Debug) << "Loading finished: " << loaded << "/" << vResults.size() << " files, "
+                    << m_oScene.getPublishedFacets() << " facets";
+    m_oRenderer.setLoadStats(m_oScene.getStats());
+    if (loaded > 0)
+    {
+        // the files which failed are only reported, the other models were prepared by the loading thread
+        retVal = Err::NoError;
+    }
+    m_oScene.setLoading(false);
+
+    return retVal;
+}
+
+void CApp::prepareScene(CScene &oScene) const
+{
+    for (uint32_t u32Model = 0; u32Model < oScene.getModelCount(); ++u32Model)
+    {
+        oScene.getModel(u32Model).repairNormals();
+        streamModel(oScene.getModel(u32Model));
+    }
+    oScene.normalize();
+    for (uint32_t u32Model = 0; u32Model < oScene.getModelCount(); ++u32Model)
+    {
+        weldModel(oScene.getModel(u32Model));
+        smoothModel(oScene.getModel(u32Model));
+        quantizeModel(oScene.getModel(u32Model));
+        bvhModel(oScene.getModel(u32Model));
+    }
+}
+
+void CApp::prepareModel(CModel &oModel, const CLoadStats &oStats, const CMeshCache &oMeshCache) const
+{
+    // the cache holds the model normalized already; the normals are repaired before it's stored
+    if (!oStats.bCached)
+    {
+        oModel.normalizeModel();
+    }
+    oModel.repairNormals();
+    if (!oStats.bCached)
+    {
+        oMeshCache.store(oModel);
+    }
+    weldModel(oModel);
+    smoothModel(oModel);
+    streamModel(oModel);
+    quantizeModel(oModel);
+    bvhModel(oModel);
+}
+
+void CApp::weldModel(CModel &oModel) const
+{
+    if (m_bWeld && (oModel.getPublishedFacets() > 0) && (Err::NoError != oModel.weld(m_fWeldTolerance)))
+    {
+        logPrint(Warning) << "Can't weld the model; keeping the facets";
+    }
+}
+
+void CApp::smoothModel(CModel &oModel) const
+{
+    if (m_bSmooth && oModel.isIndexed() && (Err::NoError != oModel.smoothNormals()))
+    {
+        logPrint(Warning) << "Can't smooth the model; keeping the flat normals";
+    }
+}
+
+void CApp::streamModel(CModel &oModel) const
+{
+    if (m_bStream && !m_bWeld && (oModel.getPublishedFacets() > 0) && (Err::NoError != oModel.setStreamed()))
+    {
+        logPrint(Warning) << "Can't stream the model; keeping the facets";
+    }
+}
+
+void CApp::quantizeModel(CModel &oModel) const
+{
+    if (m_bQuantize && !m_bWeld && !m_bStream && (oModel.getPublishedFacets() > 0))
+    {
+        if (Err::NoError != oModel.quantize(m_u32NormalBits))
+        {
+            logPrint(Warning) << "Can't quantize the model; keeping the facets";
+        }
+        else if (oModel.isQuantized())
+        {
+            CLockGuard oGuard{oModel.getLock()};
+            logPrint(Info) << "Quantized " << oModel.getModelName() << ": max position error " << oModel.getQuantizedFacets().getMaxPositionError()
+                           << ", max normal error " << oModel.getQuantizedFacets().getMaxNormalError() << " deg";
+        }
+    }
+}
+
+void CApp::bvhModel(CModel &oModel) const
+{
+    if (m_bBvh && (oModel.getPublishedFacets() > 0))
+    {
+        const CStopwatch oTime;
+        if (Err::NoError != oModel.buildBvh())
+        {
+            logPrint(Warning) << "Can't build the BVH of the model";
+        }
+        else if (oModel.hasBvh())
+        {
+            const double dBuildTime = oTime.getMilliseconds();
+            CLockGuard oGuard{oModel.getLock()};
+            logPrint(Info) << "BVH of " << oModel.getModelName() << ": " << oModel.getBvh().getNodeCount() << " nodes, depth "
+                           << oModel.getBvh().getDepth() << ", " << oModel.getBvh().getMemorySize() << "B, built in " << dBuildTime << "ms";
+        }
+    }
+}
+
+void CApp::benchmarkBvh() const
+{
+    if (m_bBenchBvh)
+    {
+        for (const auto &sFileName : m_vInputFileNames)
+        {
+            if (CStlLoader::StdinFileName == sFileName)
+            {
+                logPrint(Warning) << "The standard input can't be loaded more than once; not benchmarked";
+            }
+            else
+            {
+                // the file is loaded into a model of its own, so the benchmark doesn't delay the loading of the displayed models
+                CModel oModel;
+                CStlLoader oLoader;
+                oLoader.enableMeshCache(false);
+                Err result = oLoader.loadFile(sFileName, oModel);
+                CStopwatch oTime;
+                if (Err::NoError == result)
+                {
+                    oModel.normalizeModel();
+                    oTime.restart();
+                    result = oModel.buildBvh();
+                }
+                const double dBuildTime = oTime.getMilliseconds();
+                if ((Err::NoError != result) || !oModel.hasBvh())
+                {
+                    // e.g. a paged model, which gets no hierarchy
+                    logPrint(Warning) << "Can't benchmark the BVH of " << sFileName << ": " << result;
+                }
+                else
+                {
+                    // the generator is fixed, so the benchmark casts the same rays and queries the same boxes in every run
+                    uint32_t u32Seed{1};
+                    auto random = [&u32Seed]()
+                    {
+                        u32Seed = u32Seed * 1664525u + 1013904223u;
+                        return static_cast<float>(u32Seed >> 8) / 16777216.0f - 0.5f;
+                    };
+
+                    // the rays go from a sphere around the unit cube to random points in it
+                    oTime.restart();
+                    uint32_t u32Hits{0};
+                    for (uint32_t u32Ray = 0; u32Ray < BenchmarkRays; ++u32Ray)
+                    {
+                        CVector3d oOrigin{random(), random(), random()};
+                        if (!normalizeVector(oOrigin))
+                        {
+                            oOrigin = CVector3d{0.0f, 0.0f, 1.0f};
+                        }
+                        oOrigin = CVector3d{2.0f * oOrigin.m_fX, 2.0f * oOrigin.m_fY, 2.0f * oOrigin.m_fZ};
+                        const CVector3d oTarget{random(), random(), random()};
+                        CBvh::Hit oHit;
+                        if (oModel.rayCast(oOrigin, CVector3d{oTarget.m_fX - oOrigin.m_fX, oTarget.m_fY - oOrigin.m_fY, oTarget.m_fZ - oOrigin.m_fZ}, oHit))
+                        {
+                            ++u32Hits;
+                        }
+                    }
+                    const double dRayTime = oTime.getMilliseconds();
+
+                    oTime.restart();
+                    uint64_t u64Found{0};
+                    std::vector<uint32_t> vFacets;
+                    for (uint32_t u32Box = 0; u32Box < BenchmarkBoxes; ++u32Box)
+                    {
+                        const CVector3d oCenter{random(), random(), random()};
+                        CBoundingBox oBox;
+                        oBox.add(CVector3d{oCenter.m_fX - 0.5f * BenchmarkBoxSize, oCenter.m_fY - 0.5f * BenchmarkBoxSize, oCenter.m_fZ - 0.5f * BenchmarkBoxSize});
+                        oBox.add(CVector3d{oCenter.m_fX + 0.5f * BenchmarkBoxSize, oCenter.m_fY + 0.5f * BenchmarkBoxSize, oCenter.m_fZ + 0.5f * BenchmarkBoxSize});
+                        oModel.queryBox(oBox, vFacets);
+                        u64Found += vFacets.size();
+                    }
+                    const double dBoxTime = oTime.getMilliseconds();
+
+                    CLockGuard oGuard{oModel.getLock()};
+                    logPrint(Info) << "BVH benchmark of " << sFileName << ": " << oModel.getBvh().getNodeCount() << " nodes, depth "
+                                   << oModel.getBvh().getDepth() << ", " << oModel.getBvh().getMemorySize() << "B, built in " << dBuildTime << "ms";
+                    logPrint(Info) << "BVH benchmark of " << sFileName << ": " << BenchmarkRays << " rays, " << u32Hits << " hits in " << dRayTime
+                                   << "ms; " << BenchmarkBoxes << " boxes, " << u64Found << " facets in " << dBoxTime << "ms";
+                }
+            }
+        }
+    }
+}
+
+void CApp::benchmarkLoading() const
+{
+    if (m_bBenchLoad)
+    {
+        for (const auto &sFileName : m_vInputFileNames)
+        {
+            if (CStlLoader::StdinFileName == sFileName)
+            {
+                logPrint(Warning) << "The standard input can't be loaded more than once; not benchmarked";
+            }
+            else
+            {
+                // The best time of the runs is taken, so both decoders read the file from the system cache.
+                // The mesh cache is disabled, so the file is decoded in every run.
+                Err result{Err::NoError};
+                double dMappedMs{0.0};
+                CLoadStats oStats;
+                for (uint32_t u32Run = 0; (Err::NoError == result) && (u32Run < BenchmarkLoads); ++u32Run)
+                {
+                    CModel oModel;
+                    CStlLoader oLoader;
+                    oLoader.enableMeshCache(false);
+                    const CStopwatch oTime;
+                    result = oLoader.loadFile(sFileName, oModel);
+                    const double dTime = oTime.getMilliseconds();
+                    if ((0 == u32Run) || (dTime < dMappedMs))
+                    {
+                        dMappedMs = dTime;
+                        oStats = oLoader.getStats();
+                    }
+                }
+                if (Err::NoError != result)
+                {
+                    logPrint(Warning) << "Can't benchmark the loading of " << sFileName << ": " << result;
+                }
+                else
+                {
+                    logPrint(Info) << "Load benchmark of " << sFileName << ": " << oStats.u32Facets << " facets, " << oStats.u64FileSize
+                                   << "B, memory-mapped loadFile() " << dMappedMs << "ms";
+                    if (!oStats.bBinary && (oStats.dDecodeMs > 0.0))
+                    {
+                        logPrint(Info) << "Load benchmark of " << sFileName << ": ASCII parse " << oStats.dDecodeMs << "ms, "
+                                       << (static_cast<double>(oStats.u64BytesDecoded) / 1000.0 / oStats.dDecodeMs) << "MB/s, "
+                                       << oStats.u32Threads << " thread(s)";
+                    }
+                }
+
+                if ((Err::NoError == result) && oStats.bBinary && !oStats.bCompressed)
+                {
+                    double dIfstreamMs{0.0};
+                    for (uint32_t u32Run = 0; (Err::NoError == result) && (u32Run < BenchmarkLoads); ++u32Run)
+                    {
+                        std::vector<C3DFacet> vFacets; // allocated in every run, like the facets of the model
+                        const CStopwatch oTime;
+                        result = CStlLoader::loadBinaryIfstream(sFileName, vFacets);
+                        const double dTime = oTime.getMilliseconds();
+                        dIfstreamMs = (0 == u32Run)? dTime : std::min(dIfstreamMs, dTime);
+                    }
+                    if (Err::NoError != result)
+                    {
+                        logPrint(Warning) << "Can't benchmark the std::ifstream decoder on " << sFileName << ": " << result;
+                    }
+                    else
+                    {
+                        logPrint(Info) << "Load benchmark of " << sFileName << ": loadBinaryIfstream() " << dIfstreamMs << "ms, "
+                                       << ((dMappedMs > 0.0)? (dIfstreamMs / dMappedMs) : 0.0) << "x the memory-mapped time";
+                    }
+                }
+            }
+        }
+    }
+}
+
+void CApp::checkReload()
+{
+    if (m_pReloadHandle)
+    {
+        if (m_pReloadHandle->isDone())
+        {
+            const Err result = m_pReloadHandle->getResult();
+            if (Err::NoError == result)
+            {
+                // The reloaded model is complete and normalized, so it replaces the displayed one between two frames.
+                // The previous version becomes the target of the next reload, which reuses its memory.
+                // The orientation set by the user, also during the reload, is kept.
+                m_pReloadModel->setTransform(m_oScene.getModel(0).getTransform());
+                m_pReloadModel->setLoading(false);
+                m_oScene.swapModel(0, m_pReloadModel);
+                m_oRenderer.setLoadStats(m_pReloadHandle->getStats());
+                logPrint(Debug) << "Model reloaded: " << m_oScene.getPublishedFacets() << " facets";
+            }
+            else
+            {
+                // e.g. the file is still being written; the next change of the file starts another reload
+                logPrint(Warning) << "Can't reload the file, error " << result << "; keeping the previous version";
+            }
+            m_pReloadHandle.reset();
+        }
+    }
+    else if (!m_pLoadHandle && !m_oScene.isLoading() && m_oFileWatcher.hasChanged())
+    {
+        startReload();
+    }
+}
+
+void CApp::startReload()
+{
+    logPrint(Debug) << "Reloading " << m_vInputFileNames.front();
+    try
+    {
+        if (!m_pReloadModel)
+        {
+            m_pReloadModel.reset(new CModel());
+        }
+    }
+    catch(...)
+    {
+        logPrint(Trace) << "Can't allocate memory";
+    }
+
+    // the model is normalized by the loading thread, so the drawing isn't held up by the reload
+    const CLoadHandle::LoadedCallback loadedCallback = [this](CModel &oModel, const CLoadStats &oStats, const CMeshCache &oMeshCache)
+    {
+        prepareModel(oModel, oStats, oMeshCache);
+    };
+    if (m_pReloadModel && (Err::NoError != CStlLoader::loadFileAsync(m_vInputFileNames.front(), *m_pReloadModel, m_pReloadHandle,
+                                                                      nullptr, loadedCallback)))
+    {
+        logPrint(Warning) << "Can't reload the file in background";
+    }
+}
+
 Err CApp::run()
 {
     Err retVal{Err::NoError};
@@ -230,7 +748,15 @@ Err CApp::run()
                 handleRMBReleased();
             }
         }
-        retVal = m_oRenderer.redrawWindow(m_oModel);
+        retVal = m_oRenderer.redrawWindow(m_oScene);
+        if (Err::NoError == retVal)
+        {
+            retVal = checkLoading();
+        }
+        if (Err::NoError == retVal)
+        {
+            checkReload();
+        }
         if (Err::NoError != retVal)
         {
             logPrint(Debug) << "Closing window due to an error";
@@ -238,6 +764,23 @@ Err CApp::run()
         }
     }
 
+    // the window was closed during the loading; the loading is cancelled and its result doesn't matter any more
+    if (m_pLoadHandle)
+    {
+        logPrint(Debug) << "Cancelling the loading";
+        m_pLoadHandle.reset();
+    }
+    if (m_pReloadHandle)
+    {
+        logPrint(Debug) << "Cancelling the reload";
+        m_pReloadHandle.reset();
+    }
+    if (m_oScene.isBatchLoading())
+    {
+        logPrint(Debug) << "Cancelling the loading";
+        m_oScene.clear();
+    }
+
 	return retVal;
 }
 
@@ -261,15 +804,40 @@ void CApp::handleKeyPressed(int iKey)
             break;
 
 		case 0x58: // 'x'
-			m_oModel.rotateX();
+			if (m_oScene.isLoading())
+			{
+			    logPrint(Debug) << "Rotation ignored while loading";
+			}
+			else
+			{
+			    m_oScene.rotateX();
+			}
             break;
 
 		case 0x59: // 'y'
-			m_oModel.rotateY();
+			if (m_oScene.isLoading())
+			{
+			    logPrint(Debug) << "Rotation ignored while loading";
+			}
+			else
+			{
+			    m_oScene.rotateY();
+			}
             break;
 
 		case 0x5A: // 'z'
-			m_oModel.rotateZ();
+			if (m_oScene.isLoading())
+			{
+			    logPrint(Debug) << "Rotation ignored while loading";
+			}
+			else
+			{
+			    m_oScene.rotateZ();
+			}
+            break;
+
+		case 0x49: // 'i'
+			m_oRenderer.toggleLoadStats();
             break;
 
 		case VK_TAB: //TAB:
@@ -0,0 +1,56 @@
+/**
+ * @file CBoundingBox.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#include "CBoundingBox.h"
+#include <algorithm>
+
+void CBoundingBox::add(const CVector3d &oPoint)
+{
+    if (m_bValid)
+    {
+        m_oMin.m_fX = std::min(m_oMin.m_fX, oPoint.m_fX);
+        m_oMin.m_fY = std::min(m_oMin.m_fY, oPoint.m_fY);
+        m_oMin.m_fZ = std::min(m_oMin.m_fZ, oPoint.m_fZ);
+        m_oMax.m_fX = std::max(m_oMax.m_fX, oPoint.m_fX);
+        m_oMax.m_fY = std::max(m_oMax.m_fY, oPoint.m_fY);
+        m_oMax.m_fZ = std::max(m_oMax.m_fZ, oPoint.m_fZ);
+    }
+    else
+    {
+        m_oMin = oPoint;
+        m_oMax = oPoint;
+        m_bValid = true;
+    }
+}
+
+void CBoundingBox::add(const C3DFacet &oFacet)
+{
+    add(oFacet.p1);
+    add(oFacet.p2);
+    add(oFacet.p3);
+}
+
+void CBoundingBox::add(const CBoundingBox &oBox)
+{
+    if (oBox.m_bValid)
+    {
+        add(oBox.m_oMin);
+        add(oBox.m_oMax);
+    }
+}
+
+CVector3d CBoundingBox::getCenter() const
+{
+    return CVector3d{m_oMin.m_fX + 0.5f*(m_oMax.m_fX-m_oMin.m_fX),
+                     m_oMin.m_fY + 0.5f*(m_oMax.m_fY-m_oMin.m_fY),
+                     m_oMin.m_fZ + 0.5f*(m_oMax.m_fZ-m_oMin.m_fZ)};
+}
+
+float CBoundingBox::getMaxExtent() const
+{
+    return std::max({m_oMax.m_fX-m_oMin.m_fX, m_oMax.m_fY-m_oMin.m_fY, m_oMax.m_fZ-m_oMin.m_fZ});
+}
@@ -0,0 +1,751 @@
+/**
+ * @file CBvh.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#include "CBvh.h"
+#include "CLogger.h"
+#include "CThreadPool.h"
+#include "CStopwatch.h"
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
+
+constexpr uint32_t CBvh::MaxLeafFacets;
+constexpr uint32_t CBvh::MaxDepth;
+constexpr uint32_t CBvh::ChunkFacets;
+
+namespace
+{
+    constexpr uint32_t BinCount = 16; // the candidate split planes of an axis are the borders of the bins
+    constexpr float TraversalCost = 1.0f; // the cost of visiting a node relative to the cost of testing a facet
+    constexpr uint32_t MedianDepth = 32; // the deeper nodes are split at the median, so the depth stays below MaxDepth
+
+    struct Box
+    {
+        float afMin[3]{FLT_MAX, FLT_MAX, FLT_MAX};
+        float afMax[3]{-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    };
+
+    void grow(Box &oBox, const Box &oOther)
+    {
+        for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+        {
+            oBox.afMin[u32Axis] = std::min(oBox.afMin[u32Axis], oOther.afMin[u32Axis]);
+            oBox.afMax[u32Axis] = std::max(oBox.afMax[u32Axis], oOther.afMax[u32Axis]);
+        }
+    }
+
+    void grow(Box &oBox, const float afPoint[3])
+    {
+        for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+        {
+            oBox.afMin[u32Axis] = std::min(oBox.afMin[u32Axis], afPoint[u32Axis]);
+            oBox.afMax[u32Axis] = std::max(oBox.afMax[u32Axis], afPoint[u32Axis]);
+        }
+    }
+
+    // a half of the surface area, which is enough for comparing the costs
+    float getArea(const Box &oBox)
+    {
+        const float fX = oBox.afMax[0] - oBox.afMin[0];
+        const float fY = oBox.afMax[1] - oBox.afMin[1];
+        const float fZ = oBox.afMax[2] - oBox.afMin[2];
+        return ((fX < 0.0f) || (fY < 0.0f) || (fZ < 0.0f))? 0.0f : (fX * fY + fY * fZ + fZ * fX);
+    }
+
+    void getCentroid(const Box &oBox, float afCentroid[3])
+    {
+        for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+        {
+            afCentroid[u32Axis] = 0.5f * (oBox.afMin[u32Axis] + oBox.afMax[u32Axis]);
+        }
+    }
+
+    // the bins split the extent of the centroids of a node evenly; an axis without extent gets the scale 0,
+    // which stands for an axis which can't be split
+    void getBinScales(const Box &oCentroids, float afScales[3])
+    {
+        for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+        {
+            const float fExtent = oCentroids.afMax[u32Axis] - oCentroids.afMin[u32Axis];
+            afScales[u32Axis] = (fExtent > static_cast<float>(BinCount) / FLT_MAX)? (static_cast<float>(BinCount) / fExtent) : 0.0f;
+        }
+    }
+
+    uint32_t getBin(float fCentroid, float fMin, float fScale)
+    {
+        return std::min(BinCount - 1, static_cast<uint32_t>((fCentroid - fMin) * fScale));
+    }
+
+    Box getFacetBox(const C3DFacet &oFacet)
+    {
+        Box oBox;
+        for (const CVector3d *pPoint : {&oFacet.p1, &oFacet.p2, &oFacet.p3})
+        {
+            const float afPoint[3] = {pPoint->m_fX, pPoint->m_fY, pPoint->m_fZ};
+            grow(oBox, afPoint);
+        }
+        return oBox;
+    }
+
+    bool overlaps(const float afMinA[3], const float afMaxA[3], const float afMinB[3], const float afMaxB[3])
+    {
+        return (afMinA[0] <= afMaxB[0]) && (afMinB[0] <= afMaxA[0])
+            && (afMinA[1] <= afMaxB[1]) && (afMinB[1] <= afMaxA[1])
+            && (afMinA[2] <= afMaxB[2]) && (afMinB[2] <= afMaxA[2]);
+    }
+
+    // Moller-Trumbore test of both sides of the facet; a hit nearer than fDistance replaces it
+    bool intersectFacet(const C3DFacet &oFacet, const float afOrigin[3], const float afDirection[3], float &fDistance, float &fU, float &fV)
+    {
+        const float afEdge1[3] = {oFacet.p2.m_fX - oFacet.p1.m_fX, oFacet.p2.m_fY - oFacet.p1.m_fY, oFacet.p2.m_fZ - oFacet.p1.m_fZ};
+        const float afEdge2[3] = {oFacet.p3.m_fX - oFacet.p1.m_fX, oFacet.p3.m_fY - oFacet.p1.m_fY, oFacet.p3.m_fZ - oFacet.p1.m_fZ};
+        const float afP[3] = {afDirection[1] * afEdge2[2] - afDirection[2] * afEdge2[1],
+                              afDirection[2] * afEdge2[0] - afDirection[0] * afEdge2[2],
+                              afDirection[0] * afEdge2[1] - afDirection[1] * afEdge2[0]};
+        const float fDeterminant = afEdge1[0] * afP[0] + afEdge1[1] * afP[1] + afEdge1[2] * afP[2];
+        bool bHit{false};
+        if (fabsf(fDeterminant) > 0.0f)
+        {
+            const float fInverse = 1.0f / fDeterminant;
+            const float afT[3] = {afOrigin[0] - oFacet.p1.m_fX, afOrigin[1] - oFacet.p1.m_fY, afOrigin[2] - oFacet.p1.m_fZ};
+            const float fHitU = (afT[0] * afP[0] + afT[1] * afP[1] + afT[2] * afP[2]) * fInverse;
+            if ((fHitU >= 0.0f) && (fHitU <= 1.0f))
+            {
+                const float afQ[3] = {afT[1] * afEdge1[2] - afT[2] * afEdge1[1],
+                                      afT[2] * afEdge1[0] - afT[0] * afEdge1[2],
+                                      afT[0] * afEdge1[1] - afT[1] * afEdge1[0]};
+                const float fHitV = (afDirection[0] * afQ[0] + afDirection[1] * afQ[1] + afDirection[2] * afQ[2]) * fInverse;
+                const float fHitDistance = (afEdge2[0] * afQ[0] + afEdge2[1] * afQ[1] + afEdge2[2] * afQ[2]) * fInverse;
+                if ((fHitV >= 0.0f) && (fHitU + fHitV <= 1.0f) && (fHitDistance > 0.0f) && (fHitDistance < fDistance))
+                {
+                    fDistance = fHitDistance;
+                    fU = fHitU;
+                    fV = fHitV;
+                    bHit = true;
+                }
+            }
+        }
+        return bHit;
+    }
+}
+
+/**
+ * @class CBvh::CBuilder
+ * @brief Builds the nodes of the tree top-down; the subtrees of large nodes are built in parallel.
+ */
+class CBvh::CBuilder
+{
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param oBvh The tree with the preallocated nodes and the facet indices, which are sorted by the leaves.
+     * @param vBounds The bounding boxes of the facets.
+     */
+    CBuilder(CBvh &oBvh, const std::vector<Box> &vBounds) : m_oBvh(oBvh), m_vBounds(vBounds) {}
+
+    /**
+     * @brief Builds a node and its subtree.
+     *
+     * @param u32Node The index of the node.
+     * @param u32Begin The first facet of the node in m_vFacets.
+     * @param u32End The end of the facets of the node in m_vFacets.
+     * @param oBox The bounding box of the facets.
+     * @param oCentroids The bounding box of the centroids of the facets.
+     * @param u32Depth The level of the node; 1 for the root.
+     */
+    void buildNode(uint32_t u32Node, uint32_t u32Begin, uint32_t u32End, const Box &oBox, const Box &oCentroids, uint32_t u32Depth);
+
+    /**
+     * @brief Gets the number of nodes used so far.
+     *
+     * @return The number of nodes.
+     */
+    uint32_t getNodeCount() const { return m_u32Nodes; }
+
+    /**
+     * @brief Gets the number of levels of the tree built so far.
+     *
+     * @return The number of levels.
+     */
+    uint32_t getDepth() const { return m_u32Depth; }
+
+private:
+    /**
+     * @struct Bin
+     * @brief The facets whose centroids fall into a slab of the node.
+     */
+    struct Bin
+    {
+        Box oBox{}; ///< The bounding box of the facets.
+        Box oCentroids{}; ///< The bounding box of the centroids of the facets.
+        uint32_t u32Count{0}; ///< The number of facets.
+    };
+
+    /**
+     * @struct Split
+     * @brief The split of a node into two children.
+     */
+    struct Split
+    {
+        uint32_t u32Axis{3}; ///< The axis of the split plane; 3 if no split was found.
+        uint32_t u32Bin{0}; ///< The first bin of the second child.
+        uint32_t u32Count{0}; ///< The number of facets of the first child.
+        float fCost{FLT_MAX}; ///< The SAH cost of the split in the costs of a facet test.
+        Box aoBoxes[2]{}; ///< The bounding boxes of the children.
+        Box aoCentroids[2]{}; ///< The bounding boxes of the centroids of the children.
+    };
+
+    /**
+     * @brief Distributes a range of facets into the bins of all three axes.
+     *
+     * @param u32Begin The first facet in m_vFacets.
+     * @param u32End The end of the facets in m_vFacets.
+     * @param oCentroids The bounding box of the centroids of the node.
+     * @param pBins The 3 * BinCount bins, which are added to.
+     */
+    void fillBins(uint32_t u32Begin, uint32_t u32End, const Box &oCentroids, Bin *pBins) const;
+
+    /**
+     * @brief Finds the split of a node with the lowest SAH cost.
+     *
+     * @param u32Begin The first facet of the node in m_vFacets.
+     * @param u32End The end of the facets of the node in m_vFacets.
+     * @param oBox The bounding box of the facets.
+     * @param oCentroids The bounding box of the centroids of the facets.
+     *
+     * @return The best split; its axis is 3 if the centroids don't differ.
+     */
+    Split findSplit(uint32_t u32Begin, uint32_t u32End, const Box &oBox, const Box &oCentroids) const;
+
+    /**
+     * @brief Splits the facets of a node at the median of their centroids along the longest axis.
+     *
+     * @param u32Begin The first facet of the node in m_vFacets.
+     * @param u32End The end of the facets of the node in m_vFacets.
+     * @param oCentroids The bounding box of the centroids of the facets.
+     *
+     * @return The split.
+     */
+    Split splitMedian(uint32_t u32Begin, uint32_t u32End, const Box &oCentroids) const;
+
+    CBvh &m_oBvh; ///< The tree being built.
+    const std::vector<Box> &m_vBounds; ///< The bounding boxes of the facets.
+    std::atomic<uint32_t> m_u32Nodes{1}; ///< The number of nodes used so far; the root is allocated by the tree.
+    std::atomic<uint32_t> m_u32Depth{0}; ///< The number of levels built so far.
+};
+
+void CBvh::CBuilder::fillBins(uint32_t u32Begin, uint32_t u32End, const Box &oCentroids, Bin *pBins) const
+{
+    float afScales[3];
+    getBinScales(oCentroids, afScales);
+    for (uint32_t u32Pos = u32Begin; u32Pos < u32End; ++u32Pos)
+    {
+        const uint32_t u32Facet = m_oBvh.m_vFacets[u32Pos];
+        float afCentroid[3];
+        getCentroid(m_vBounds[u32Facet], afCentroid);
+        for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+        {
+            if (afScales[u32Axis] > 0.0f)
+            {
+                Bin &oBin = pBins[u32Axis * BinCount + getBin(afCentroid[u32Axis], oCentroids.afMin[u32Axis], afScales[u32Axis])];
+                grow(oBin.oBox, m_vBounds[u32Facet]);
+                grow(oBin.oCentroids, afCentroid);
+                ++oBin.u32Count;
+            }
+        }
+    }
+}
+
+CBvh::CBuilder::Split CBvh::CBuilder::findSplit(uint32_t u32Begin, uint32_t u32End, const Box &oBox, const Box &oCentroids) const
+{
+    Bin aBins[3 * BinCount];
+    const uint32_t u32Count = u32End - u32Begin;
+    const uint32_t u32Chunks = (u32Count + ChunkFacets - 1) / ChunkFacets;
+    // the bins of a large node are filled by all threads of the pool, each chunk into its own bins
+    std::unique_ptr<Bin[]> pChunkBins{(u32Chunks > 1)? new (std::nothrow) Bin[u32Chunks * 3 * BinCount] : nullptr};
+    if (nullptr != pChunkBins)
+    {
+        CThreadPool::getInstance().parallelFor(u32Chunks, [&](uint32_t u32Chunk)
+        {
+            const uint32_t u32First = u32Begin + u32Chunk * ChunkFacets;
+            fillBins(u32First, std::min(u32End, u32First + ChunkFacets), oCentroids, &pChunkBins[u32Chunk * 3 * BinCount]);
+        });
+        for (uint32_t u32Chunk = 0; u32Chunk < u32Chunks; ++u32Chunk)
+        {
+            for (uint32_t u32Bin = 0; u32Bin < 3 * BinCount; ++u32Bin)
+            {
+                const Bin &oChunkBin = pChunkBins[u32Chunk * 3 * BinCount + u32Bin];
+                grow(aBins[u32Bin].oBox, oChunkBin.oBox);
+                grow(aBins[u32Bin].oCentroids, oChunkBin.oCentroids);
+                aBins[u32Bin].u32Count += oChunkBin.u32Count;
+            }
+        }
+    }
+    else
+    {
+        fillBins(u32Begin, u32End, oCentroids, aBins);
+    }
+
+    // the cost of a split: visiting the node plus testing the facets of each child weighted by the probability
+    // that a ray hitting the node hits the child, which is the ratio of their surface areas
+    const float fArea = getArea(oBox);
+    const float fInverseArea = (fArea > 0.0f)? (1.0f / fArea) : 0.0f;
+    float afScales[3];
+    getBinScales(oCentroids, afScales);
+    Split oBest;
+    for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+    {
+        if (afScales[u32Axis] > 0.0f)
+        {
+            const Bin *pBins = &aBins[u32Axis * BinCount];
+            float afRightAreas[BinCount];
+            uint32_t au32RightCounts[BinCount];
+            Box oRight;
+            uint32_t u32Right{0};
+            for (uint32_t u32Bin = BinCount - 1; u32Bin > 0; --u32Bin)
+            {
+                if (pBins[u32Bin].u32Count > 0)
+                {
+                    grow(oRight, pBins[u32Bin].oBox);
+                    u32Right += pBins[u32Bin].u32Count;
+                }
+                afRightAreas[u32Bin] = getArea(oRight);
+                au32RightCounts[u32Bin] = u32Right;
+            }
+            Box oLeft;
+            uint32_t u32Left{0};
+            for (uint32_t u32Bin = 1; u32Bin < BinCount; ++u32Bin)
+            {
+                if (pBins[u32Bin - 1].u32Count > 0)
+                {
+                    grow(oLeft, pBins[u32Bin - 1].oBox);
+                    u32Left += pBins[u32Bin - 1].u32Count;
+                }
+                // an empty bin gives the same split as its neighbour
+                if ((u32Left > 0) && (au32RightCounts[u32Bin] > 0) && (pBins[u32Bin - 1].u32Count > 0))
+                {
+                    const float fCost = TraversalCost + (getArea(oLeft) * static_cast<float>(u32Left)
+                                        + afRightAreas[u32Bin] * static_cast<float>(au32RightCounts[u32Bin])) * fInverseArea;
+                    if (fCost < oBest.fCost)
+                    {
+                        oBest.u32Axis = u32Axis;
+                        oBest.u32Bin = u32Bin;
+                        oBest.u32Count = u32Left;
+                        oBest.fCost = fCost;
+                    }
+                }
+            }
+        }
+    }
+
+    if (oBest.u32Axis < 3)
+    {
+        const Bin *pBins = &aBins[oBest.u32Axis * BinCount];
+        for (uint32_t u32Bin = 0; u32Bin < BinCount; ++u32Bin)
+        {
+            if (pBins[u32Bin].u32Count > 0)
+            {
+                const uint32_t u32Child = (u32Bin < oBest.u32Bin)? 0 : 1;
+                grow(oBest.aoBoxes[u32Child], pBins[u32Bin].oBox);
+                grow(oBest.aoCentroids[u32Child], pBins[u32Bin].oCentroids);
+            }
+        }
+    }
+    return oBest;
+}
+
+CBvh::CBuilder::Split CBvh::CBuilder::splitMedian(uint32_t u32Begin, uint32_t u32End, const Box &oCentroids) const
+{
+    Split oSplit;
+    oSplit.u32Axis = 0;
+    for (uint32_t u32Axis = 1; u32Axis < 3; ++u32Axis)
+    {
+        if (oCentroids.afMax[u32Axis] - oCentroids.afMin[u32Axis] > oCentroids.afMax[oSplit.u32Axis] - oCentroids.afMin[oSplit.u32Axis])
+        {
+            oSplit.u32Axis = u32Axis;
+        }
+    }
+    oSplit.u32Count = (u32End - u32Begin) / 2;
+    const uint32_t u32Axis = oSplit.u32Axis;
+    std::vector<uint32_t> &vFacets = m_oBvh.m_vFacets;
+    std::nth_element(vFacets.begin() + u32Begin, vFacets.begin() + u32Begin + oSplit.u32Count, vFacets.begin() + u32End,
+                     [this, u32Axis](uint32_t u32A, uint32_t u32B)
+    {
+        return m_vBounds[u32A].afMin[u32Axis] + m_vBounds[u32A].afMax[u32Axis] < m_vBounds[u32B].afMin[u32Axis] + m_vBounds[u32B].afMax[u32Axis];
+    });
+    for (uint32_t u32Pos = u32Begin; u32Pos < u32End; ++u32Pos)
+    {
+        const uint32_t u32Child = (u32Pos < u32Begin + oSplit.u32Count)? 0 : 1;
+        float afCentroid[3];
+        getCentroid(m_vBounds[vFacets[u32Pos]], afCentroid);
+        grow(oSplit.aoBoxes[u32Child], m_vBounds[vFacets[u32Pos]]);
+        grow(oSplit.aoCentroids[u32Child], afCentroid);
+    }
+    return oSplit;
+}
+
+void CBvh::CBuilder::buildNode(uint32_t u32Node, uint32_t u32Begin, uint32_t u32End, const Box &oBox, const Box &oCentroids, uint32_t u32Depth)
+{
+    uint32_t u32MaxDepth = m_u32Depth.load();
+    while ((u32Depth > u32MaxDepth) && !m_u32Depth.compare_exchange_weak(u32MaxDepth, u32Depth))
+    {
+    }
+
+    const uint32_t u32Count = u32End - u32Begin;
+    Split oSplit;
+    if ((u32Count > 1) && (u32Depth < MedianDepth))
+    {
+        oSplit = findSplit(u32Begin, u32End, oBox, oCentroids);
+    }
+
+    Node &oNode = m_oBvh.m_vNodes[u32Node];
+    std::copy(oBox.afMin, oBox.afMin + 3, oNode.afMin);
+    std::copy(oBox.afMax, oBox.afMax + 3, oNode.afMax);
+    if ((u32Count <= MaxLeafFacets) && (oSplit.fCost >= static_cast<float>(u32Count)))
+    {
+        // testing the facets is cheaper than visiting the children, or the facets can't be split
+        oNode.u32Offset = u32Begin;
+        oNode.u16Count = static_cast<uint16_t>(u32Count);
+        oNode.u16Axis = 0;
+    }
+    else
+    {
+        if (oSplit.u32Axis < 3)
+        {
+            // the bins are computed by the same expressions as in fillBins(), so the facets fall into the same bins
+            const uint32_t u32Axis = oSplit.u32Axis;
+            const uint32_t u32Bin = oSplit.u32Bin;
+            float afScales[3];
+            getBinScales(oCentroids, afScales);
+            std::partition(m_oBvh.m_vFacets.begin() + u32Begin, m_oBvh.m_vFacets.begin() + u32End,
+                           [this, u32Axis, u32Bin, &oCentroids, &afScales](uint32_t u32Facet)
+            {
+                float afCentroid[3];
+                getCentroid(m_vBounds[u32Facet], afCentroid);
+                return getBin(afCentroid[u32Axis], oCentroids.afMin[u32Axis], afScales[u32Axis]) < u32Bin;
+            });
+        }
+        else
+        {
+            // the centroids don't differ or the node is too deep
+            oSplit = splitMedian(u32Begin, u32End, oCentroids);
+        }
+
+        const uint32_t u32Children = m_u32Nodes.fetch_add(2);
+        const uint32_t u32Middle = u32Begin + oSplit.u32Count;
+        oNode.u32Offset = u32Children;
+        oNode.u16Count = 0;
+        oNode.u16Axis = static_cast<uint16_t>(oSplit.u32Axis);
+        if (u32Count > ChunkFacets)
+        {
+            CThreadPool::getInstance().parallelFor(2, [&](uint32_t u32Child)
+            {
+                buildNode(u32Children + u32Child, (0 == u32Child)? u32Begin : u32Middle, (0 == u32Child)? u32Middle : u32End,
+                          oSplit.aoBoxes[u32Child], oSplit.aoCentroids[u32Child], u32Depth + 1);
+            });
+        }
+        else
+        {
+            buildNode(u32Children, u32Begin, u32Middle, oSplit.aoBoxes[0], oSplit.aoCentroids[0], u32Depth + 1);
+            buildNode(u32Children + 1, u32Middle, u32End, oSplit.aoBoxes[1], oSplit.aoCentroids[1], u32Depth + 1);
+        }
+    }
+}
+
+Err CBvh::build(uint32_t u32Facets, const FacetGetter &getFacet)
+{
+    Err retVal{Err::NoError};
+
+    clear();
+    const CStopwatch oTime;
+    const uint32_t u32Chunks = (u32Facets + ChunkFacets - 1) / ChunkFacets;
+    std::vector<Box> vBounds;
+    std::vector<Box> vChunkBoxes; // the bounding box of the facets and of their centroids of each chunk
+    if (u32Facets > 0)
+    {
+        try
+        {
+            // a tree with single-facet leaves has 2n-1 nodes; the unused ones are released at the end
+            vBounds.resize(u32Facets);
+            vChunkBoxes.resize(2 * static_cast<size_t>(u32Chunks));
+            m_vFacets.resize(u32Facets);
+            m_vNodes.resize(2 * static_cast<size_t>(u32Facets) - 1);
+        }
+        catch(...)
+        {
+            logPrint(Debug) << "Can't allocate memory for the BVH of " << u32Facets << " facets";
+            retVal = Err::MemAlloc;
+        }
+    }
+
+    if ((Err::NoError == retVal) && (u32Facets > 0))
+    {
+        CThreadPool::getInstance().parallelFor(u32Chunks, [&](uint32_t u32Chunk)
+        {
+            const uint32_t u32End = std::min(u32Facets, (u32Chunk + 1) * ChunkFacets);
+            for (uint32_t u32Facet = u32Chunk * ChunkFacets; u32Facet < u32End; ++u32Facet)
+            {
+                vBounds[u32Facet] = getFacetBox(getFacet(u32Facet));
+                m_vFacets[u32Facet] = u32Facet;
+                float afCentroid[3];
+                getCentroid(vBounds[u32Facet], afCentroid);
+                grow(vChunkBoxes[2 * u32Chunk], vBounds[u32Facet]);
+                grow(vChunkBoxes[2 * u32Chunk + 1], afCentroid);
+            }
+        });
+        Box oBox;
+        Box oCentroids;
+        for (uint32_t u32Chunk = 0; u32Chunk < u32Chunks; ++u32Chunk)
+        {
+            grow(oBox, vChunkBoxes[2 * u32Chunk]);
+            grow(oCentroids, vChunkBoxes[2 * u32Chunk + 1]);
+        }
+
+        CBuilder oBuilder{*this, vBounds};
+        oBuilder.buildNode(0, 0, u32Facets, oBox, oCentroids, 1);
+        m_u32Depth = oBuilder.getDepth();
+        m_vNodes.resize(oBuilder.getNodeCount());
+        try
+        {
+            m_vNodes.shrink_to_fit();
+        }
+        catch(...)
+        {
+            logPrint(Trace) << "Can't release the unused nodes";
+        }
+        logPrint(Debug) << "BVH: " << u32Facets << " facets, " << m_vNodes.size() << " nodes, depth " << m_u32Depth << ", "
+                        << getMemorySize() << "B, built in " << oTime.getMilliseconds() << "ms";
+    }
+    else
+    {
+        clear();
+    }
+    return retVal;
+}
+
+void CBvh::refit(const FacetGetter &getFacet)
+{
+    // the leaves are refitted by all threads of the pool
+    const uint32_t u32Nodes = getNodeCount();
+    CThreadPool::getInstance().parallelFor((u32Nodes + ChunkFacets - 1) / ChunkFacets, [&](uint32_t u32Chunk)
+    {
+        const uint32_t u32End = std::min(u32Nodes, (u32Chunk + 1) * ChunkFacets);
+        for (uint32_t u32Node = u32Chunk * ChunkFacets; u32Node < u32End; ++u32Node)
+        {
+            Node &oNode = m_vNodes[u32Node];
+            if (oNode.u16Count > 0)
+            {
+                Box oBox;
+                for (uint32_t u32Pos = oNode.u32Offset; u32Pos < oNode.u32Offset + oNode.u16Count; ++u32Pos)
+                {
+                    grow(oBox, getFacetBox(getFacet(m_vFacets[u32Pos])));
+                }
+                std::copy(oBox.afMin, oBox.afMin + 3, oNode.afMin);
+                std::copy(oBox.afMax, oBox.afMax + 3, oNode.afMax);
+            }
+        }
+    });
+
+    // the children are stored after their parent, so the inner nodes are merged from the end
+    for (uint32_t u32Node = u32Nodes; u32Node > 0; --u32Node)
+    {
+        Node &oNode = m_vNodes[u32Node - 1];
+        if (0 == oNode.u16Count)
+        {
+            const Node &oFirst = m_vNodes[oNode.u32Offset];
+            const Node &oSecond = m_vNodes[oNode.u32Offset + 1];
+            for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+            {
+                oNode.afMin[u32Axis] = std::min(oFirst.afMin[u32Axis], oSecond.afMin[u32Axis]);
+                oNode.afMax[u32Axis] = std::max(oFirst.afMax[u32Axis], oSecond.afMax[u32Axis]);
+            }
+        }
+    }
+}
+
+void CBvh::transform(const CVector3d &oShift, float fScale)
+{
+    // the facets may be transformed with a different rounding (SSE or x87), which is covered by
+    // widening the boxes by two units in the last place
+    const float afShift[3] = {oShift.m_fX, oShift.m_fY, oShift.m_fZ};
+    CThreadPool::getInstance().parallelFor((getNodeCount() + ChunkFacets - 1) / ChunkFacets, [&](uint32_t u32Chunk)
+    {
+        const uint32_t u32End = std::min(getNodeCount(), (u32Chunk + 1) * ChunkFacets);
+        for (uint32_t u32Node = u32Chunk * ChunkFacets; u32Node < u32End; ++u32Node)
+        {
+            Node &oNode = m_vNodes[u32Node];
+            for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+            {
+                const float fMin = (oNode.afMin[u32Axis] - afShift[u32Axis]) * fScale;
+                const float fMax = (oNode.afMax[u32Axis] - afShift[u32Axis]) * fScale;
+                oNode.afMin[u32Axis] = nextafterf(nextafterf(fMin, -FLT_MAX), -FLT_MAX);
+                oNode.afMax[u32Axis] = nextafterf(nextafterf(fMax, FLT_MAX), FLT_MAX);
+            }
+        }
+    });
+}
+
+void CBvh::reorient(const float afMatrix[9])
+{
+    uint32_t au32From[3];
+    bool abNegated[3];
+    for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+    {
+        const float *pfRow = afMatrix + 3 * u32Axis;
+        au32From[u32Axis] = (fabsf(pfRow[0]) > 0.5f)? 0 : ((fabsf(pfRow[1]) > 0.5f)? 1 : 2);
+        abNegated[u32Axis] = pfRow[au32From[u32Axis]] < 0.0f;
+    }
+    for (Node &oNode : m_vNodes)
+    {
+        const Node oOld = oNode;
+        for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+        {
+            const uint32_t u32From = au32From[u32Axis];
+            oNode.afMin[u32Axis] = (abNegated[u32Axis])? -oOld.afMax[u32From] : oOld.afMin[u32From];
+            oNode.afMax[u32Axis] = (abNegated[u32Axis])? -oOld.afMin[u32From] : oOld.afMax[u32From];
+        }
+        // the split axis only orders the traversal
+        if (0 == oNode.u16Count)
+        {
+            oNode.u16Axis = static_cast<uint16_t>(std::find(au32From, au32From + 3, static_cast<uint32_t>(oOld.u16Axis)) - au32From);
+        }
+    }
+}
+
+void CBvh::clear()
+{
+    std::vector<Node>().swap(m_vNodes);
+    std::vector<uint32_t>().swap(m_vFacets);
+    m_u32Depth = 0;
+}
+
+bool CBvh::rayCast(const CVector3d &oOrigin, const CVector3d &oDirection, const FacetGetter &getFacet, Hit &oHit) const
+{
+    const float afOrigin[3] = {oOrigin.m_fX, oOrigin.m_fY, oOrigin.m_fZ};
+    const float afDirection[3] = {oDirection.m_fX, oDirection.m_fY, oDirection.m_fZ};
+    // a zero coordinate of the direction gives an infinite slab, which fminf and fmaxf handle
+    const float afInverse[3] = {1.0f / afDirection[0], 1.0f / afDirection[1], 1.0f / afDirection[2]};
+    float fDistance{FLT_MAX};
+    bool bHit{false};
+    auto intersectNode = [&afOrigin, &afInverse, &fDistance](const Node &oNode, float &fEntry)
+    {
+        float fNear{0.0f};
+        float fFar{fDistance};
+        for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+        {
+            const float fT1 = (oNode.afMin[u32Axis] - afOrigin[u32Axis]) * afInverse[u32Axis];
+            const float fT2 = (oNode.afMax[u32Axis] - afOrigin[u32Axis]) * afInverse[u32Axis];
+            fNear = fmaxf(fNear, fminf(fT1, fT2));
+            fFar = fminf(fFar, fmaxf(fT1, fT2));
+        }
+        fEntry = fNear;
+        return fNear <= fFar;
+    };
+
+    uint32_t au32Stack[MaxDepth];
+    float afStackEntries[MaxDepth];
+    uint32_t u32Top{0};
+    uint32_t u32Node{0};
+    float fEntry{0.0f};
+    bool bActive = !isEmpty() && intersectNode(m_vNodes[0], fEntry);
+    while (bActive)
+    {
+        const Node &oNode = m_vNodes[u32Node];
+        bool bDescend{false};
+        if (oNode.u16Count > 0)
+        {
+            for (uint32_t u32Pos = oNode.u32Offset; u32Pos < oNode.u32Offset + oNode.u16Count; ++u32Pos)
+            {
+                if (intersectFacet(getFacet(m_vFacets[u32Pos]), afOrigin, afDirection, fDistance, oHit.fU, oHit.fV))
+                {
+                    oHit.u32Facet = m_vFacets[u32Pos];
+                    bHit = true;
+                }
+            }
+        }
+        else
+        {
+            float afEntries[2];
+            const bool bFirst = intersectNode(m_vNodes[oNode.u32Offset], afEntries[0]);
+            const bool bSecond = intersectNode(m_vNodes[oNode.u32Offset + 1], afEntries[1]);
+            if (bFirst && bSecond)
+            {
+                // the nearer child is visited first, so the farther one is often skipped after a hit
+                const uint32_t u32Near = (afEntries[0] <= afEntries[1])? 0 : 1;
+                au32Stack[u32Top] = oNode.u32Offset + 1 - u32Near;
+                afStackEntries[u32Top] = afEntries[1 - u32Near];
+                ++u32Top;
+                u32Node = oNode.u32Offset + u32Near;
+                bDescend = true;
+            }
+            else if (bFirst || bSecond)
+            {
+                u32Node = oNode.u32Offset + ((bFirst)? 0 : 1);
+                bDescend = true;
+            }
+        }
+
+        if (!bDescend)
+        {
+            // the nodes behind the nearest hit found meanwhile are skipped
+            bActive = false;
+            while (!bActive && (u32Top > 0))
+            {
+                --u32Top;
+                u32Node = au32Stack[u32Top];
+                bActive = afStackEntries[u32Top] <= fDistance;
+            }
+        }
+    }
+    oHit.fDistance = fDistance;
+    return bHit;
+}
+
+void CBvh::queryBox(const CBoundingBox &oBox, const FacetGetter &getFacet, std::vector<uint32_t> &vFacets) const
+{
+    vFacets.clear();
+    if (!isEmpty() && oBox.isValid())
+    {
+        const float afMin[3] = {oBox.getMin().m_fX, oBox.getMin().m_fY, oBox.getMin().m_fZ};
+        const float afMax[3] = {oBox.getMax().m_fX, oBox.getMax().m_fY, oBox.getMax().m_fZ};
+        uint32_t au32Stack[MaxDepth];
+        uint32_t u32Top{0};
+        if (overlaps(m_vNodes[0].afMin, m_vNodes[0].afMax, afMin, afMax))
+        {
+            au32Stack[u32Top++] = 0;
+        }
+        while (u32Top > 0)
+        {
+            const Node &oNode = m_vNodes[au32Stack[--u32Top]];
+            if (oNode.u16Count > 0)
+            {
+                for (uint32_t u32Pos = oNode.u32Offset; u32Pos < oNode.u32Offset + oNode.u16Count; ++u32Pos)
+                {
+                    const Box oFacetBox = getFacetBox(getFacet(m_vFacets[u32Pos]));
+                    if (overlaps(oFacetBox.afMin, oFacetBox.afMax, afMin, afMax))
+                    {
+                        vFacets.push_back(m_vFacets[u32Pos]);
+                    }
+                }
+            }
+            else
+            {
+                for (uint32_t u32Child = oNode.u32Offset; u32Child < oNode.u32Offset + 2; ++u32Child)
+                {
+                    if (overlaps(m_vNodes[u32Child].afMin, m_vNodes[u32Child].afMax, afMin, afMax))
+                    {
+                        au32Stack[u32Top++] = u32Child;
+                    }
+                }
+            }
+        }
+    }
+}
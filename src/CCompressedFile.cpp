@@ -0,0 +1,544 @@
+/**
+ * @file CCompressedFile.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600 // CancelSynchronousIo() is available since Windows Vista
+#endif
+#include "CCompressedFile.h"
+#include "CLogger.h"
+#include <string.h>
+#include <algorithm>
+#if defined(ZLIB_ENABLED)
+#include <zlib.h>
+#endif
+#if defined(ZSTD_ENABLED)
+#include <zstd.h>
+#endif
+
+using namespace std::literals::string_literals;
+
+constexpr uint32_t CCompressedFile::BlockCount;
+constexpr size_t CCompressedFile::BlockSize;
+constexpr size_t CCompressedFile::InputViewSize;
+constexpr DWORD CCompressedFile::StopRetryMs;
+
+CCompressedFile::Compression CCompressedFile::detectCompression(const CMappedFile &oFile)
+{
+    Compression retVal{Compression::none};
+
+    CMappedView oView = oFile.mapView(0, 4);
+    if (4 == oView.size())
+    {
+        const uint8_t *pMagic = oView.data();
+        if ((0x1F == pMagic[0]) && (0x8B == pMagic[1]))
+        {
+            retVal = Compression::gzip;
+        }
+        else if ((0x28 == pMagic[0]) && (0xB5 == pMagic[1]) && (0x2F == pMagic[2]) && (0xFD == pMagic[3]))
+        {
+            retVal = Compression::zstd;
+        }
+    }
+    return retVal;
+}
+
+Err CCompressedFile::open(const CMappedFile &oFile, Compression compression, size_t windowSize)
+{
+    Err retVal{Err::NoError};
+
+    close();
+    logPrint(Trace) << "CCompressedFile::open(" << static_cast<int>(compression) << ")";
+#if !defined(ZLIB_ENABLED)
+    if (Compression::gzip == compression)
+    {
+        logPrint(Debug) << "gzip support isn't compiled in (ZLIB_ENABLED)";
+        retVal = Err::UnsupportedCompression;
+    }
+#endif
+#if !defined(ZSTD_ENABLED)
+    if (Compression::zstd == compression)
+    {
+        logPrint(Debug) << "zstd support isn't compiled in (ZSTD_ENABLED)";
+        retVal = Err::UnsupportedCompression;
+    }
+#endif
+    if (Compression::none == compression)
+    {
+        retVal = Err::InternalLoaderError;
+    }
+
+    if (Err::NoError == retVal)
+    {
+        m_pFile = &oFile;
+        m_compression = compression;
+        retVal = start(windowSize);
+    }
+    return retVal;
+}
+
+Err CCompressedFile::open(HANDLE hInput, size_t windowSize)
+{
+    Err retVal{Err::NoError};
+
+    close();
+    logPrint(Trace) << "CCompressedFile::open(stream)";
+    if ((nullptr != hInput) && (INVALID_HANDLE_VALUE != hInput))
+    {
+        m_hInput = hInput;
+        retVal = start(windowSize);
+    }
+    else
+    {
+        logPrint(Debug) << "Invalid input stream";
+        retVal = Err::OpenFile;
+    }
+    return retVal;
+}
+
+Err CCompressedFile::start(size_t windowSize)
+{
+    Err retVal{Err::NoError};
+
+    try
+    {
+        m_vBlocks.resize(BlockCount * BlockSize);
+        m_vWindow.resize(windowSize);
+    }
+    catch(...)
+    {
+        logPrint(Trace) << "Can't allocate memory";
+        retVal = Err::MemAlloc;
+    }
+
+    if (Err::NoError == retVal)
+    {
+        // one more count than the blocks, so close() can always wake the decompression thread
+        m_hFreeBlocks = CreateSemaphore(nullptr, BlockCount, BlockCount + 1, nullptr);
+        m_hFilledBlocks = CreateSemaphore(nullptr, 0, BlockCount, nullptr);
+        if (m_hFreeBlocks && m_hFilledBlocks)
+        {
+            m_hThread = CreateThread(nullptr, 0, decompressThread, this, 0, nullptr);
+        }
+        if (nullptr == m_hThread)
+        {
+            logPrint(Warning) << "Can't create decompression thread, error " << GetLastError();
+            retVal = Err::CantCreateThread;
+        }
+    }
+
+    if (Err::NoError != retVal)
+    {
+        close();
+    }
+    return retVal;
+}
+
+void CCompressedFile::close()
+{
+    if (m_hThread)
+    {
+        m_bStop = true;
+        ReleaseSemaphore(m_hFreeBlocks, 1, nullptr);
+        // a thread reading a pipe is blocked until the writer writes more data, so its read is cancelled;
+        // the read may start just after the cancellation, so it's cancelled again until the thread ends
+        while (WAIT_TIMEOUT == WaitForSingleObject(m_hThread, StopRetryMs))
+        {
+            CancelSynchronousIo(m_hThread);
+        }
+        CloseHandle(m_hThread);
+        m_hThread = nullptr;
+    }
+    if (m_hFreeBlocks)
+    {
+        CloseHandle(m_hFreeBlocks);
+        m_hFreeBlocks = nullptr;
+    }
+    if (m_hFilledBlocks)
+    {
+        CloseHandle(m_hFilledBlocks);
+        m_hFilledBlocks = nullptr;
+    }
+    m_pFile = nullptr;
+    m_hInput = INVALID_HANDLE_VALUE;
+    m_compression = Compression::none;
+    std::vector<uint8_t>().swap(m_vBlocks);
+    std::vector<uint8_t>().swap(m_vWindow);
+    m_u32WriteBlock = 0;
+    m_u32ReadBlock = 0;
+    m_blockPos = 0;
+    m_bBlockTaken = false;
+    m_windowBegin = 0;
+    m_windowEnd = 0;
+    m_u64WindowOffset = 0;
+    m_bEnd = false;
+    m_bStop = false;
+    m_u64InputPosition = 0;
+    m_error = Err::NoError;
+    m_sErrorText.clear();
+}
+
+void CCompressedFile::fill()
+{
+    if (!m_bEnd && m_hThread)
+    {
+        // the bytes not consumed yet are moved to the beginning of the window
+        const size_t remaining = getSize();
+        memmove(m_vWindow.data(), m_vWindow.data() + m_windowBegin, remaining);
+        m_u64WindowOffset += m_windowBegin;
+        m_windowBegin = 0;
+        m_windowEnd = remaining;
+        const size_t wanted = m_vWindow.size() - m_windowEnd;
+        const size_t received = read(m_vWindow.data() + m_windowEnd, wanted);
+        m_windowEnd += received;
+        m_bEnd = (received < wanted);
+    }
+}
+
+uint64_t CCompressedFile::getInputPosition() const
+{
+    CLockGuard oGuard{m_oLock};
+    return m_u64InputPosition;
+}
+
+Err CCompressedFile::getError(std::string &sText) const
+{
+    CLockGuard oGuard{m_oLock};
+    sText = m_sErrorText;
+    return m_error;
+}
+
+size_t CCompressedFile::read(uint8_t *pBuffer, size_t size)
+{
+    size_t copied{0};
+    bool bDataEnd{false};
+
+    while ((copied < size) && !bDataEnd)
+    {
+        if (!m_bBlockTaken)
+        {
+            // a cancelled reading ends the data; the thread filling the blocks is stopped by close()
+            const HANDLE ahEvents[] = {m_hFilledBlocks, m_hCancelEvent};
+            const DWORD dwEvents = (nullptr != m_hCancelEvent)? 2 : 1;
+            if (WAIT_OBJECT_0 == WaitForMultipleObjects(dwEvents, ahEvents, FALSE, INFINITE))
+            {
+                m_bBlockTaken = true;
+                m_blockPos = 0;
+            }
+            else
+            {
+                setError(Err::LoadCancelled, "Reading cancelled");
+                bDataEnd = true;
+            }
+        }
+        const size_t blockSize = (m_bBlockTaken)? m_aBlockSizes[m_u32ReadBlock] : 0; // no block is taken when the reading was cancelled
+        if (0 == blockSize)
+        {
+            // the empty block marks the end; it stays taken, so the next read ends at once
+            bDataEnd = true;
+        }
+        else
+        {
+            const size_t count = std::min(size - copied, blockSize - m_blockPos);
+            memcpy(pBuffer + copied, &m_vBlocks[m_u32ReadBlock * BlockSize + m_blockPos], count);
+            copied += count;
+            m_blockPos += count;
+            if (m_blockPos == blockSize)
+            {
+                m_bBlockTaken = false;
+                m_u32ReadBlock = (m_u32ReadBlock + 1) % BlockCount;
+                ReleaseSemaphore(m_hFreeBlocks, 1, nullptr);
+            }
+        }
+    }
+    return copied;
+}
+
+DWORD WINAPI CCompressedFile::decompressThread(LPVOID pParam)
+{
+    CCompressedFile &oReader = *static_cast<CCompressedFile*>(pParam);
+
+    // the thread doesn't log; the errors are logged by the reader
+    Err retVal{Err::NoError};
+    switch (oReader.m_compression)
+    {
+        case Compression::gzip:
+            retVal = oReader.decompressGzip();
+            break;
+
+        case Compression::zstd:
+            retVal = oReader.decompressZstd();
+            break;
+
+        default:
+            retVal = oReader.readStream();
+            break;
+    }
+    if (Err::NoError != retVal)
+    {
+        CLockGuard oGuard{oReader.m_oLock};
+        if (Err::NoError == oReader.m_error)
+        {
+            oReader.m_error = retVal;
+        }
+    }
+    if (!oReader.m_bStop && (nullptr != oReader.acquireBlock()))
+    {
+        oReader.commitBlock(0);
+    }
+    return 0;
+}
+
+Err CCompressedFile::mapInput(CMappedView &oView, uint64_t &u64Offset)
+{
+    Err retVal{Err::NoError};
+
+    oView = m_pFile->mapView(u64Offset, InputViewSize);
+    if (oView.isValid())
+    {
+        u64Offset += oView.size();
+        CLockGuard oGuard{m_oLock};
+        m_u64InputPosition = u64Offset;
+    }
+    else
+    {
+        setError(Err::ReadFile, "Can't read compressed file at "s + std::to_string(u64Offset) + "B");
+        retVal = Err::ReadFile;
+    }
+    return retVal;
+}
+
+uint8_t *CCompressedFile::acquireBlock()
+{
+    uint8_t *pBlock{nullptr};
+
+    WaitForSingleObject(m_hFreeBlocks, INFINITE);
+    if (!m_bStop)
+    {
+        pBlock = &m_vBlocks[m_u32WriteBlock * BlockSize];
+    }
+    return pBlock;
+}
+
+void CCompressedFile::commitBlock(size_t size)
+{
+    m_aBlockSizes[m_u32WriteBlock] = size;
+    m_u32WriteBlock = (m_u32WriteBlock + 1) % BlockCount;
+    ReleaseSemaphore(m_hFilledBlocks, 1, nullptr);
+}
+
+void CCompressedFile::setError(Err error, const std::string &sText)
+{
+    CLockGuard oGuard{m_oLock};
+    if (Err::NoError == m_error)
+    {
+        m_error = error;
+        m_sErrorText = sText;
+    }
+}
+
+Err CCompressedFile::decompressGzip()
+{
+    Err retVal{Err::NoError};
+#if defined(ZLIB_ENABLED)
+    z_stream stream{};
+    if (Z_OK == inflateInit2(&stream, 16 + MAX_WBITS)) // gzip wrapper only
+    {
+        const uint64_t u64FileSize = m_pFile->getSize();
+        uint64_t u64Offset{0};
+        CMappedView oView;
+        uint8_t *pBlock = acquireBlock();
+        stream.next_out = pBlock;
+        stream.avail_out = BlockSize;
+        bool bDone{false};
+        while ((Err::NoError == retVal) && !bDone && (nullptr != pBlock))
+        {
+            if ((0 == stream.avail_in) && (u64Offset < u64FileSize))
+            {
+                retVal = mapInput(oView, u64Offset);
+                stream.next_in = const_cast<Bytef*>(oView.data());
+                stream.avail_in = oView.size();
+            }
+            if (Err::NoError == retVal)
+            {
+                const int iStatus = inflate(&stream, Z_NO_FLUSH);
+                const bool bInputEnd = (0 == stream.avail_in) && (u64Offset == u64FileSize);
+                if (Z_STREAM_END == iStatus)
+                {
+                    if (bInputEnd)
+                    {
+                        bDone = true;
+                    }
+                    else
+                    {
+                        inflateReset(&stream); // another gzip member follows
+                    }
+                }
+                else if ((Z_OK != iStatus) && (Z_BUF_ERROR != iStatus))
+                {
+                    setError(Err::Decompress, "gzip error "s + std::to_string(iStatus) + " at " + std::to_string(stream.total_in) + "B: " + ((stream.msg)? stream.msg : ""));
+                    retVal = Err::Decompress;
+                }
+                else if (bInputEnd && (0 != stream.avail_out))
+                {
+                    // all input was consumed and the output wasn't filled, so the member can't be finished
+                    setError(Err::Decompress, "gzip data is truncated");
+                    retVal = Err::Decompress;
+                }
+
+                if (bDone)
+                {
+                    if (stream.avail_out < BlockSize)
+                    {
+                        commitBlock(BlockSize - stream.avail_out);
+                    }
+                }
+                else if (0 == stream.avail_out)
+                {
+                    commitBlock(BlockSize);
+                    pBlock = acquireBlock();
+                    stream.next_out = pBlock;
+                    stream.avail_out = BlockSize;
+                }
+            }
+        }
+        inflateEnd(&stream);
+    }
+    else
+    {
+        setError(Err::Decompress, "Can't initialize zlib");
+        retVal = Err::Decompress;
+    }
+#else
+    retVal = Err::UnsupportedCompression;
+#endif
+    return retVal;
+}
+
+Err CCompressedFile::decompressZstd()
+{
+    Err retVal{Err::NoError};
+#if defined(ZSTD_ENABLED)
+    ZSTD_DStream *pStream = ZSTD_createDStream();
+    if ((nullptr != pStream) && !ZSTD_isError(ZSTD_initDStream(pStream)))
+    {
+        const uint64_t u64FileSize = m_pFile->getSize();
+        uint64_t u64Offset{0};
+        CMappedView oView;
+        uint8_t *pBlock = acquireBlock();
+        ZSTD_inBuffer input{nullptr, 0, 0};
+        ZSTD_outBuffer output{pBlock, BlockSize, 0};
+        bool bDone{false};
+        while ((Err::NoError == retVal) && !bDone && (nullptr != pBlock))
+        {
+            if ((input.pos == input.size) && (u64Offset < u64FileSize))
+            {
+                retVal = mapInput(oView, u64Offset);
+                input.src = oView.data();
+                input.size = oView.size();
+                input.pos = 0;
+            }
+            if (Err::NoError == retVal)
+            {
+                // the result is 0 when a frame is complete; the next frame is decoded by the next call
+                const size_t result = ZSTD_decompressStream(pStream, &output, &input);
+                if (ZSTD_isError(result))
+                {
+                    setError(Err::Decompress, "zstd error: "s + ZSTD_getErrorName(result));
+                    retVal = Err::Decompress;
+                }
+                else if ((input.pos == input.size) && (u64Offset == u64FileSize) && (output.pos < output.size))
+                {
+                    // all input was consumed and the decoder flushed everything it could
+                    if (0 == result)
+                    {
+                        bDone = true;
+                    }
+                    else
+                    {
+                        setError(Err::Decompress, "zstd data is truncated");
+                        retVal = Err::Decompress;
+                    }
+                }
+
+                if (bDone)
+                {
+                    if (output.pos > 0)
+                    {
+                        commitBlock(output.pos);
+                    }
+                }
+                else if (output.pos == output.size)
+                {
+                    commitBlock(BlockSize);
+                    pBlock = acquireBlock();
+                    output.dst = pBlock;
+                    output.pos = 0;
+                }
+            }
+        }
+    }
+    else
+    {
+        setError(Err::Decompress, "Can't initialize zstd");
+        retVal = Err::Decompress;
+    }
+    ZSTD_freeDStream(pStream);
+#else
+    retVal = Err::UnsupportedCompression;
+#endif
+    return retVal;
+}
+
+Err CCompressedFile::readStream()
+{
+    Err retVal{Err::NoError};
+
+    // A read from a pipe returns whatever the writer has written so far, so a block is filled by
+    // many reads. The end of the data is reported as a broken pipe or as a read of 0 bytes.
+    uint8_t *pBlock = acquireBlock();
+    size_t blockPos{0};
+    bool bDone{false};
+    while (!bDone && (nullptr != pBlock) && !m_bStop)
+    {
+        DWORD dwRead{0};
+        if (ReadFile(m_hInput, pBlock + blockPos, static_cast<DWORD>(BlockSize - blockPos), &dwRead, nullptr))
+        {
+            bDone = (0 == dwRead);
+        }
+        else if ((ERROR_BROKEN_PIPE == GetLastError()) || ((ERROR_OPERATION_ABORTED == GetLastError()) && m_bStop))
+        {
+            // the pipe was closed by the writer, or the read was cancelled by close()
+            bDone = true;
+        }
+        else
+        {
+            setError(Err::ReadFile, "Can't read input stream, error "s + std::to_string(GetLastError()));
+            retVal = Err::ReadFile;
+            bDone = true;
+        }
+        blockPos += dwRead;
+        {
+            CLockGuard oGuard{m_oLock};
+            m_u64InputPosition += dwRead;
+        }
+
+        if (bDone)
+        {
+            if (blockPos > 0)
+            {
+                commitBlock(blockPos);
+            }
+        }
+        else if (BlockSize == blockPos)
+        {
+            commitBlock(BlockSize);
+            pBlock = acquireBlock();
+            blockPos = 0;
+        }
+    }
+    return retVal;
+}
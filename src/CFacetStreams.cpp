@@ -0,0 +1,252 @@
+/**
+ * @file CFacetStreams.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#include "CFacetStreams.h"
+#include "CLogger.h"
+#include "CThreadPool.h"
+#include <stddef.h>
+#include <math.h>
+#include <mm_malloc.h>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+constexpr size_t CFacetStreams::Alignment;
+
+namespace
+{
+    constexpr uint32_t StreamGranule = 16; // floats in a cache line; the streams are padded to it
+    constexpr uint32_t TransformChunk = 65536; // floats of a stream transformed by one task; a multiple of StreamGranule
+
+    uint32_t getPaddedLength(uint32_t u32Length)
+    {
+        return (u32Length + StreamGranule - 1) / StreamGranule * StreamGranule;
+    }
+
+    // the kernels process the whole padded stream, four floats at a time
+
+    void findRange(const float *pStream, uint32_t u32Length, float &fMin, float &fMax)
+    {
+#if defined(__SSE2__)
+        __m128 min = _mm_load_ps(pStream);
+        __m128 max = min;
+        for (uint32_t u32Idx = 4; u32Idx < u32Length; u32Idx += 4)
+        {
+            const __m128 values = _mm_load_ps(pStream + u32Idx);
+            min = _mm_min_ps(min, values);
+            max = _mm_max_ps(max, values);
+        }
+        min = _mm_min_ps(min, _mm_shuffle_ps(min, min, _MM_SHUFFLE(1, 0, 3, 2)));
+        min = _mm_min_ps(min, _mm_shuffle_ps(min, min, _MM_SHUFFLE(2, 3, 0, 1)));
+        max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(1, 0, 3, 2)));
+        max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(2, 3, 0, 1)));
+        fMin = _mm_cvtss_f32(min);
+        fMax = _mm_cvtss_f32(max);
+#else
+        const auto range = std::minmax_element(pStream, pStream + u32Length);
+        fMin = *range.first;
+        fMax = *range.second;
+#endif
+    }
+
+    void transformStream(float *pStream, uint32_t u32Length, float fShift, float fScale)
+    {
+#if defined(__SSE2__)
+        const __m128 shift = _mm_set1_ps(fShift);
+        const __m128 scale = _mm_set1_ps(fScale);
+        for (uint32_t u32Idx = 0; u32Idx < u32Length; u32Idx += 4)
+        {
+            _mm_store_ps(pStream + u32Idx, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(pStream + u32Idx), shift), scale));
+        }
+#else
+        for (uint32_t u32Idx = 0; u32Idx < u32Length; ++u32Idx)
+        {
+            pStream[u32Idx] = (pStream[u32Idx] - fShift) * fScale;
+        }
+#endif
+    }
+
+    void negateStream(float *pStream, uint32_t u32Length)
+    {
+#if defined(__SSE2__)
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        for (uint32_t u32Idx = 0; u32Idx < u32Length; u32Idx += 4)
+        {
+            _mm_store_ps(pStream + u32Idx, _mm_xor_ps(_mm_load_ps(pStream + u32Idx), signMask));
+        }
+#else
+        for (uint32_t u32Idx = 0; u32Idx < u32Length; ++u32Idx)
+        {
+            pStream[u32Idx] = -pStream[u32Idx];
+        }
+#endif
+    }
+}
+
+Err CFacetStreams::build(const std::vector<C3DFacet> &vFacets)
+{
+    Err retVal{Err::NoError};
+
+    clear();
+    const uint64_t u64Facets = vFacets.size();
+    if (u64Facets > 0)
+    {
+        const uint64_t u64PositionStride = (3 * u64Facets + StreamGranule - 1) / StreamGranule * StreamGranule;
+        const uint64_t u64NormalStride = (u64Facets + StreamGranule - 1) / StreamGranule * StreamGranule;
+        const uint64_t u64Bytes = 3 * (u64PositionStride + u64NormalStride) * sizeof(float);
+        if (u64Bytes <= static_cast<uint64_t>(PTRDIFF_MAX))
+        {
+            m_pMemory = static_cast<float*>(_mm_malloc(static_cast<size_t>(u64Bytes), Alignment));
+        }
+        if (nullptr == m_pMemory)
+        {
+            logPrint(Debug) << "Can't allocate " << u64Bytes << "B for the facet streams";
+            retVal = Err::MemAlloc;
+        }
+    }
+
+    if ((Err::NoError == retVal) && (u64Facets > 0))
+    {
+        m_u32Facets = static_cast<uint32_t>(u64Facets);
+        m_u32PositionStride = getPaddedLength(3 * m_u32Facets);
+        m_u32NormalStride = getPaddedLength(m_u32Facets);
+        for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+        {
+            m_apPositions[u32Axis] = m_pMemory + u32Axis * m_u32PositionStride;
+            m_apNormals[u32Axis] = m_pMemory + 3 * m_u32PositionStride + u32Axis * m_u32NormalStride;
+        }
+        for (uint32_t u32Facet = 0; u32Facet < m_u32Facets; ++u32Facet)
+        {
+            setFacet(u32Facet, vFacets[u32Facet]);
+        }
+
+        // the padding repeats the last value, so it doesn't change the results of the kernels
+        for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+        {
+            float *pPositions = m_apPositions[u32Axis];
+            std::fill(pPositions + 3 * m_u32Facets, pPositions + m_u32PositionStride, pPositions[3 * m_u32Facets - 1]);
+            float *pNormals = m_apNormals[u32Axis];
+            std::fill(pNormals + m_u32Facets, pNormals + m_u32NormalStride, pNormals[m_u32Facets - 1]);
+        }
+        logPrint(Debug) << "Facet streams: " << m_u32Facets << " facets, " << getMemorySize() << "B";
+    }
+    return retVal;
+}
+
+void CFacetStreams::clear()
+{
+    if (nullptr != m_pMemory)
+    {
+        _mm_free(m_pMemory);
+    }
+    m_pMemory = nullptr;
+    for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+    {
+        m_apPositions[u32Axis] = nullptr;
+        m_apNormals[u32Axis] = nullptr;
+    }
+    m_u32Facets = 0;
+    m_u32PositionStride = 0;
+    m_u32NormalStride = 0;
+}
+
+C3DFacet CFacetStreams::getFacet(uint32_t u32Facet) const
+{
+    C3DFacet oFacet;
+    getFacets(u32Facet, 1, &oFacet);
+    return oFacet;
+}
+
+void CFacetStreams::getFacets(uint32_t u32First, uint32_t u32Count, C3DFacet *pFacets) const
+{
+    const float *pX = m_apPositions[0] + 3 * u32First;
+    const float *pY = m_apPositions[1] + 3 * u32First;
+    const float *pZ = m_apPositions[2] + 3 * u32First;
+    for (uint32_t u32Idx = 0; u32Idx < u32Count; ++u32Idx)
+    {
+        C3DFacet &oFacet = pFacets[u32Idx];
+        oFacet.p1 = CVector3d{pX[3 * u32Idx], pY[3 * u32Idx], pZ[3 * u32Idx]};
+        oFacet.p2 = CVector3d{pX[3 * u32Idx + 1], pY[3 * u32Idx + 1], pZ[3 * u32Idx + 1]};
+        oFacet.p3 = CVector3d{pX[3 * u32Idx + 2], pY[3 * u32Idx + 2], pZ[3 * u32Idx + 2]};
+        oFacet.normal = CVector3d{m_apNormals[0][u32First + u32Idx], m_apNormals[1][u32First + u32Idx], m_apNormals[2][u32First + u32Idx]};
+    }
+}
+
+void CFacetStreams::setFacet(uint32_t u32Facet, const C3DFacet &oFacet)
+{
+    const CVector3d *apPoints[] = {&oFacet.p1, &oFacet.p2, &oFacet.p3};
+    for (uint32_t u32Point = 0; u32Point < 3; ++u32Point)
+    {
+        m_apPositions[0][3 * u32Facet + u32Point] = apPoints[u32Point]->m_fX;
+        m_apPositions[1][3 * u32Facet + u32Point] = apPoints[u32Point]->m_fY;
+        m_apPositions[2][3 * u32Facet + u32Point] = apPoints[u32Point]->m_fZ;
+    }
+    m_apNormals[0][u32Facet] = oFacet.normal.m_fX;
+    m_apNormals[1][u32Facet] = oFacet.normal.m_fY;
+    m_apNormals[2][u32Facet] = oFacet.normal.m_fZ;
+}
+
+CBoundingBox CFacetStreams::getBoundingBox() const
+{
+    CBoundingBox oBox;
+    if (!isEmpty())
+    {
+        float afMin[3];
+        float afMax[3];
+        for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+        {
+            findRange(m_apPositions[u32Axis], m_u32PositionStride, afMin[u32Axis], afMax[u32Axis]);
+        }
+        oBox.add(CVector3d{afMin[0], afMin[1], afMin[2]});
+        oBox.add(CVector3d{afMax[0], afMax[1], afMax[2]});
+    }
+    return oBox;
+}
+
+void CFacetStreams::transform(const CVector3d &oShift, float fScale)
+{
+    if (!isEmpty())
+    {
+        // the streams are split into chunks, which are transformed by all threads of the pool
+        const float afShift[3] = {oShift.m_fX, oShift.m_fY, oShift.m_fZ};
+        const uint32_t u32Chunks = (m_u32PositionStride + TransformChunk - 1) / TransformChunk;
+        CThreadPool::getInstance().parallelFor(3 * u32Chunks, [this, &afShift, fScale, u32Chunks](uint32_t u32Task)
+        {
+            const uint32_t u32Axis = u32Task / u32Chunks;
+            const uint32_t u32First = (u32Task % u32Chunks) * TransformChunk;
+            transformStream(m_apPositions[u32Axis] + u32First, std::min(TransformChunk, m_u32PositionStride - u32First), afShift[u32Axis], fScale);
+        });
+    }
+}
+
+void CFacetStreams::reorient(const float afMatrix[9])
+{
+    // the new stream of an axis is the old stream of the axis selected by the row of the matrix, negated if needed
+    if (!isEmpty())
+    {
+        float *apOldPositions[3] = {m_apPositions[0], m_apPositions[1], m_apPositions[2]};
+        float *apOldNormals[3] = {m_apNormals[0], m_apNormals[1], m_apNormals[2]};
+        for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+        {
+            const float *pfRow = afMatrix + 3 * u32Axis;
+            const uint32_t u32From = (fabsf(pfRow[0]) > 0.5f)? 0 : ((fabsf(pfRow[1]) > 0.5f)? 1 : 2);
+            m_apPositions[u32Axis] = apOldPositions[u32From];
+            m_apNormals[u32Axis] = apOldNormals[u32From];
+            if (pfRow[u32From] < 0.0f)
+            {
+                negateStream(m_apPositions[u32Axis], m_u32PositionStride);
+                negateStream(m_apNormals[u32Axis], m_u32NormalStride);
+            }
+        }
+    }
+}
+
+uint64_t CFacetStreams::getMemorySize() const
+{
+    return 3 * (static_cast<uint64_t>(m_u32PositionStride) + m_u32NormalStride) * sizeof(float);
+}
@@ -0,0 +1,108 @@
+/**
+ * @file CFileWatcher.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#include "CFileWatcher.h"
+#include "CLogger.h"
+
+constexpr double CFileWatcher::SettleMs;
+
+Err CFileWatcher::start(const std::string &sFileName)
+{
+    Err retVal{Err::NoError};
+
+    stop();
+    char szFullPath[MAX_PATH];
+    char *pszFilePart{nullptr};
+    const DWORD dwLength = GetFullPathNameA(sFileName.c_str(), MAX_PATH, szFullPath, &pszFilePart);
+    if ((dwLength > 0) && (dwLength < MAX_PATH) && (nullptr != pszFilePart)
+        && getFileVersion(szFullPath, m_u64Size, m_u64Time))
+    {
+        // only directories can be watched; the notification is filtered by the version of the file
+        m_sFileName = szFullPath;
+        const std::string sDirectory(szFullPath, pszFilePart);
+        m_hChange = FindFirstChangeNotificationA(sDirectory.c_str(), FALSE,
+                                                 FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+        if (INVALID_HANDLE_VALUE != m_hChange)
+        {
+            logPrint(Debug) << "Watching " << m_sFileName;
+        }
+        else
+        {
+            logPrint(Debug) << "Can't watch directory " << sDirectory << ", error " << GetLastError();
+            retVal = Err::FileWatch;
+        }
+    }
+    else
+    {
+        logPrint(Debug) << "Can't watch " << sFileName << ", error " << GetLastError();
+        retVal = Err::FileWatch;
+    }
+
+    if (Err::NoError != retVal)
+    {
+        stop();
+    }
+    return retVal;
+}
+
+void CFileWatcher::stop()
+{
+    if (INVALID_HANDLE_VALUE != m_hChange)
+    {
+        FindCloseChangeNotification(m_hChange);
+    }
+    m_hChange = INVALID_HANDLE_VALUE;
+    m_sFileName.clear();
+    m_bPending = false;
+}
+
+bool CFileWatcher::hasChanged()
+{
+    bool bChanged{false};
+
+    if (isWatching())
+    {
+        if (WAIT_OBJECT_0 == WaitForSingleObject(m_hChange, 0))
+        {
+            // every change postpones the check, so a file which is being written isn't checked
+            m_bPending = true;
+            m_oSettleTime.restart();
+            if (!FindNextChangeNotification(m_hChange))
+            {
+                logPrint(Warning) << "Can't watch " << m_sFileName << " any more, error " << GetLastError();
+                FindCloseChangeNotification(m_hChange);
+                m_hChange = INVALID_HANDLE_VALUE;
+            }
+        }
+        if (m_bPending && (m_oSettleTime.getMilliseconds() >= SettleMs))
+        {
+            m_bPending = false;
+            uint64_t u64Size{0};
+            uint64_t u64Time{0};
+            if (getFileVersion(m_sFileName, u64Size, u64Time) && ((u64Size != m_u64Size) || (u64Time != m_u64Time)))
+            {
+                logPrint(Debug) << m_sFileName << " changed: " << u64Size << "B";
+                m_u64Size = u64Size;
+                m_u64Time = u64Time;
+                bChanged = true;
+            }
+        }
+    }
+    return bChanged;
+}
+
+bool CFileWatcher::getFileVersion(const std::string &sFileName, uint64_t &u64Size, uint64_t &u64Time)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes{};
+    const bool bRead = GetFileAttributesExA(sFileName.c_str(), GetFileExInfoStandard, &attributes);
+    if (bRead)
+    {
+        u64Size = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+        u64Time = (static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    }
+    return bRead;
+}
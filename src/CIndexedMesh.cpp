@@ -0,0 +1,387 @@
+/**
+ * @file CIndexedMesh.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#include "CIndexedMesh.h"
+#include "CLogger.h"
+#include "CThreadPool.h"
+#include "CStopwatch.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+
+constexpr uint32_t CIndexedMesh::BucketBits;
+constexpr uint32_t CIndexedMesh::ChunkCorners;
+constexpr uint32_t CIndexedMesh::ChunkTriangles;
+
+namespace
+{
+    constexpr uint32_t NoCorner = 0xFFFFFFFF;
+
+    // the corners of facet i are the corners 3i, 3i+1 and 3i+2
+    const CVector3d &getCorner(const std::vector<C3DFacet> &vFacets, uint32_t u32Corner)
+    {
+        const C3DFacet &oFacet = vFacets[u32Corner / 3];
+        const uint32_t u32Point = u32Corner % 3;
+        return (0 == u32Point)? oFacet.p1 : ((1 == u32Point)? oFacet.p2 : oFacet.p3);
+    }
+
+    int64_t getCell(float fCoordinate, double dInvTolerance)
+    {
+        // the cells far away from the model are merged instead of overflowing
+        constexpr double dMaxCell = 4.0e18;
+        return static_cast<int64_t>(std::max(-dMaxCell, std::min(dMaxCell, floor(static_cast<double>(fCoordinate) * dInvTolerance))));
+    }
+
+    int64_t getBits(float fCoordinate)
+    {
+        // -0.0 and 0.0 are the same coordinate
+        const float fValue = fCoordinate + 0.0f;
+        uint32_t u32Bits{0};
+        memcpy(&u32Bits, &fValue, sizeof(u32Bits));
+        return u32Bits;
+    }
+}
+
+Err CIndexedMesh::build(const std::vector<C3DFacet> &vFacets, float fTolerance)
+{
+    Err retVal{Err::NoError};
+
+    clear();
+    const CStopwatch oTime;
+    constexpr uint32_t u32Buckets = 1u << BucketBits;
+    const uint64_t u64Corners = 3 * static_cast<uint64_t>(vFacets.size());
+    const uint32_t u32Corners = static_cast<uint32_t>(std::min<uint64_t>(u64Corners, NoCorner));
+    const uint32_t u32Chunks = (u32Corners + ChunkCorners - 1) / ChunkCorners;
+    const double dInvTolerance = (fTolerance > 0.0f)? (1.0 / static_cast<double>(fTolerance)) : 0.0;
+    std::vector<uint64_t> vHashes;
+    std::vector<uint32_t> vChunkOffsets; // the number, then the position of the corners of each chunk in each bucket
+    std::vector<uint32_t> vBucketBegin;
+    std::vector<uint32_t> vBucketVertices;
+    std::vector<uint32_t> vOrder; // the corners sorted by bucket, then the first corner of each vertex
+    std::vector<uint32_t> vVertexOf; // the vertex of each corner
+    if (u64Corners >= NoCorner)
+    {
+        logPrint(Debug) << "Too many facets to weld: " << vFacets.size();
+        retVal = Err::MemAlloc;
+    }
+    else
+    {
+        try
+        {
+            vHashes.resize(u32Corners);
+            vChunkOffsets.resize(static_cast<size_t>(u32Chunks) * u32Buckets, 0);
+            vBucketBegin.resize(u32Buckets + 1, 0);
+            vBucketVertices.resize(u32Buckets, 0);
+            vOrder.resize(u32Corners);
+            vVertexOf.resize(u32Corners);
+        }
+        catch(...)
+        {
+            logPrint(Trace) << "Can't allocate memory";
+            retVal = Err::MemAlloc;
+        }
+    }
+
+    std::atomic<bool> bFailed{false};
+    CThreadPool &oPool = CThreadPool::getInstance();
+    if (Err::NoError == retVal)
+    {
+        // 1. the corners are hashed; the highest bits of the hash select the bucket
+        oPool.parallelFor(u32Chunks, [&](uint32_t u32Chunk)
+        {
+            uint32_t *pCounts = &vChunkOffsets[static_cast<size_t>(u32Chunk) * u32Buckets];
+            const uint32_t u32End = std::min(u32Corners, (u32Chunk + 1) * ChunkCorners);
+            for (uint32_t u32Corner = u32Chunk * ChunkCorners; u32Corner < u32End; ++u32Corner)
+            {
+                vHashes[u32Corner] = hashKey(getKey(getCorner(vFacets, u32Corner), dInvTolerance));
+                ++pCounts[vHashes[u32Corner] >> (64 - BucketBits)];
+            }
+        });
+
+        // 2. the buckets are laid out one after another; in a bucket the corners stay in the order of the facets
+        uint32_t u32Offset{0};
+        for (uint32_t u32Bucket = 0; u32Bucket < u32Buckets; ++u32Bucket)
+        {
+            vBucketBegin[u32Bucket] = u32Offset;
+            for (uint32_t u32Chunk = 0; u32Chunk < u32Chunks; ++u32Chunk)
+            {
+                uint32_t &u32Count = vChunkOffsets[static_cast<size_t>(u32Chunk) * u32Buckets + u32Bucket];
+                const uint32_t u32ChunkCorners = u32Count;
+                u32Count = u32Offset;
+                u32Offset += u32ChunkCorners;
+            }
+        }
+        vBucketBegin[u32Buckets] = u32Offset;
+        oPool.parallelFor(u32Chunks, [&](uint32_t u32Chunk)
+        {
+            uint32_t *pOffsets = &vChunkOffsets[static_cast<size_t>(u32Chunk) * u32Buckets];
+            const uint32_t u32End = std::min(u32Corners, (u32Chunk + 1) * ChunkCorners);
+            for (uint32_t u32Corner = u32Chunk * ChunkCorners; u32Corner < u32End; ++u32Corner)
+            {
+                vOrder[pOffsets[vHashes[u32Corner] >> (64 - BucketBits)]++] = u32Corner;
+            }
+        });
+
+        // 3. the equal keys are in the same bucket, so the buckets are deduplicated independently with small hash tables
+        oPool.parallelFor(u32Buckets, [&](uint32_t u32Bucket)
+        {
+            const uint32_t u32Begin = vBucketBegin[u32Bucket];
+            const uint32_t u32End = vBucketBegin[u32Bucket + 1];
+            uint32_t u32TableSize{16};
+            while (u32TableSize < 2 * (u32End - u32Begin))
+            {
+                u32TableSize *= 2;
+            }
+            try
+            {
+                std::vector<uint32_t> vTable(u32TableSize, NoCorner); // the first corner of each vertex
+                uint32_t u32Vertices{0};
+                for (uint32_t u32Pos = u32Begin; u32Pos < u32End; ++u32Pos)
+                {
+                    const uint32_t u32Corner = vOrder[u32Pos];
+                    const uint64_t u64Hash = vHashes[u32Corner];
+                    const Key key = getKey(getCorner(vFacets, u32Corner), dInvTolerance);
+                    uint32_t u32Slot = static_cast<uint32_t>(u64Hash) & (u32TableSize - 1);
+                    while ((NoCorner != vTable[u32Slot]) && ((vHashes[vTable[u32Slot]] != u64Hash)
+                           || !(getKey(getCorner(vFacets, vTable[u32Slot]), dInvTolerance) == key)))
+                    {
+                        u32Slot = (u32Slot + 1) & (u32TableSize - 1);
+                    }
+                    if (NoCorner == vTable[u32Slot])
+                    {
+                        // the positions of the bucket which were read already keep the first corners of the vertices
+                        vTable[u32Slot] = u32Corner;
+                        vVertexOf[u32Corner] = u32Vertices;
+                        vOrder[u32Begin + u32Vertices] = u32Corner;
+                        ++u32Vertices;
+                    }
+                    else
+                    {
+                        vVertexOf[u32Corner] = vVertexOf[vTable[u32Slot]];
+                    }
+                }
+                vBucketVertices[u32Bucket] = u32Vertices;
+            }
+            catch(...)
+            {
+                bFailed = true;
+            }
+        });
+        if (bFailed)
+        {
+            logPrint(Trace) << "Can't allocate memory";
+            retVal = Err::MemAlloc;
+        }
+    }
+
+    std::vector<CVector3d> vVertices;
+    uint32_t u32Vertices{0};
+    if (Err::NoError == retVal)
+    {
+        // 4. the vertices of a bucket follow the vertices of the previous buckets
+        for (uint32_t u32Bucket = 0; u32Bucket < u32Buckets; ++u32Bucket)
+        {
+            const uint32_t u32BucketVertices = vBucketVertices[u32Bucket];
+            vBucketVertices[u32Bucket] = u32Vertices;
+            u32Vertices += u32BucketVertices;
+        }
+        try
+        {
+            vVertices.resize(u32Vertices, CVector3d{0.0f, 0.0f, 0.0f});
+            m_vVertices.reserve(u32Vertices);
+        }
+        catch(...)
+        {
+            logPrint(Trace) << "Can't allocate memory";
+            retVal = Err::MemAlloc;
+        }
+    }
+
+    if (Err::NoError == retVal)
+    {
+        oPool.parallelFor(u32Buckets, [&](uint32_t u32Bucket)
+        {
+            const uint32_t u32First = vBucketVertices[u32Bucket];
+            const uint32_t u32Count = ((u32Bucket + 1 < u32Buckets)? vBucketVertices[u32Bucket + 1] : u32Vertices) - u32First;
+            for (uint32_t u32Vertex = 0; u32Vertex < u32Count; ++u32Vertex)
+            {
+                vVertices[u32First + u32Vertex] = getCorner(vFacets, vOrder[vBucketBegin[u32Bucket] + u32Vertex]);
+            }
+        });
+        oPool.parallelFor(u32Chunks, [&](uint32_t u32Chunk)
+        {
+            const uint32_t u32End = std::min(u32Corners, (u32Chunk + 1) * ChunkCorners);
+            for (uint32_t u32Corner = u32Chunk * ChunkCorners; u32Corner < u32End; ++u32Corner)
+            {
+                vVertexOf[u32Corner] += vBucketVertices[vHashes[u32Corner] >> (64 - BucketBits)];
+            }
+        });
+        std::vector<uint64_t>().swap(vHashes);
+
+        // 5. the vertices are numbered again in the order of their first use, which is serial but touches
+        // the memory sequentially; the order of the buckets is random
+        std::fill(vOrder.begin(), vOrder.begin() + u32Vertices, NoCorner);
+        for (uint32_t u32Corner = 0; u32Corner < u32Corners; ++u32Corner)
+        {
+            uint32_t &u32Vertex = vOrder[vVertexOf[u32Corner]];
+            if (NoCorner == u32Vertex)
+            {
+                u32Vertex = static_cast<uint32_t>(m_vVertices.size());
+                m_vVertices.push_back(vVertices[vVertexOf[u32Corner]]);
+            }
+            vVertexOf[u32Corner] = u32Vertex;
+        }
+        m_vIndices.swap(vVertexOf);
+        logPrint(Debug) << "Welded " << u32Corners << " corners into " << u32Vertices << " vertices in " << oTime.getMilliseconds()
+                        << "ms: " << (vFacets.size() * sizeof(C3DFacet)) << "B -> " << getMemorySize() << "B";
+    }
+    else
+    {
+        clear();
+    }
+    return retVal;
+}
+
+Err CIndexedMesh::computeVertexNormals()
+{
+    Err retVal{Err::NoError};
+
+    const CStopwatch oTime;
+    const uint32_t u32Triangles = getTriangleCount();
+    const uint32_t u32Vertices = getVertexCount();
+    std::vector<CVector3d> vTriangleNormals;
+    std::vector<uint32_t> vFirstUse; // the position of the first triangle of each vertex in vUses
+    std::vector<uint32_t> vUses; // the triangles using each vertex, vertex by vertex
+    std::vector<CVector3d> vNormals;
+    try
+    {
+        vTriangleNormals.resize(u32Triangles, CVector3d{0.0f, 0.0f, 0.0f});
+        vFirstUse.resize(static_cast<size_t>(u32Vertices) + 1, 0);
+        vUses.resize(m_vIndices.size());
+        vNormals.resize(u32Vertices, CVector3d{0.0f, 0.0f, 0.0f});
+    }
+    catch(...)
+    {
+        logPrint(Trace) << "Can't allocate memory";
+        retVal = Err::MemAlloc;
+    }
+
+    if (Err::NoError == retVal)
+    {
+        // 1. the cross product of the edges is twice the area of the triangle long, so it weights the normal by the area
+        CThreadPool &oPool = CThreadPool::getInstance();
+        oPool.parallelFor((u32Triangles + ChunkTriangles - 1) / ChunkTriangles, [&](uint32_t u32Chunk)
+        {
+            const uint32_t u32End = std::min(u32Triangles, (u32Chunk + 1) * ChunkTriangles);
+            for (uint32_t u32Triangle = u32Chunk * ChunkTriangles; u32Triangle < u32End; ++u32Triangle)
+            {
+                const CVector3d &oP1 = m_vVertices[m_vIndices[3 * u32Triangle]];
+                const CVector3d &oP2 = m_vVertices[m_vIndices[3 * u32Triangle + 1]];
+                const CVector3d &oP3 = m_vVertices[m_vIndices[3 * u32Triangle + 2]];
+                const float fAX = oP2.m_fX - oP1.m_fX;
+                const float fAY = oP2.m_fY - oP1.m_fY;
+                const float fAZ = oP2.m_fZ - oP1.m_fZ;
+                const float fBX = oP3.m_fX - oP1.m_fX;
+                const float fBY = oP3.m_fY - oP1.m_fY;
+                const float fBZ = oP3.m_fZ - oP1.m_fZ;
+                vTriangleNormals[u32Triangle] = CVector3d{fAY * fBZ - fAZ * fBY, fAZ * fBX - fAX * fBZ, fAX * fBY - fAY * fBX};
+            }
+        });
+
+        // 2. the triangles using each vertex are gathered; the passes are serial but touch the memory sequentially
+        for (const uint32_t u32Vertex : m_vIndices)
+        {
+            ++vFirstUse[u32Vertex + 1];
+        }
+        for (uint32_t u32Vertex = 0; u32Vertex < u32Vertices; ++u32Vertex)
+        {
+            vFirstUse[u32Vertex + 1] += vFirstUse[u32Vertex];
+        }
+        for (uint32_t u32Corner = 0; u32Corner < static_cast<uint32_t>(m_vIndices.size()); ++u32Corner)
+        {
+            vUses[vFirstUse[m_vIndices[u32Corner]]++] = u32Corner / 3;
+        }
+        // the increments moved the first use of each vertex to the first use of the next one
+        for (uint32_t u32Vertex = u32Vertices; u32Vertex > 0; --u32Vertex)
+        {
+            vFirstUse[u32Vertex] = vFirstUse[u32Vertex - 1];
+        }
+        vFirstUse[0] = 0;
+
+        // 3. every vertex sums the normals of its triangles
+        oPool.parallelFor((u32Vertices + ChunkTriangles - 1) / ChunkTriangles, [&](uint32_t u32Chunk)
+        {
+            const uint32_t u32End = std::min(u32Vertices, (u32Chunk + 1) * ChunkTriangles);
+            for (uint32_t u32Vertex = u32Chunk * ChunkTriangles; u32Vertex < u32End; ++u32Vertex)
+            {
+                CVector3d oSum{0.0f, 0.0f, 0.0f};
+                for (uint32_t u32Use = vFirstUse[u32Vertex]; u32Use < vFirstUse[u32Vertex + 1]; ++u32Use)
+                {
+                    const CVector3d &oNormal = vTriangleNormals[vUses[u32Use]];
+                    oSum.m_fX += oNormal.m_fX;
+                    oSum.m_fY += oNormal.m_fY;
+                    oSum.m_fZ += oNormal.m_fZ;
+                }
+                normalizeVector(oSum); // a vertex of degenerate triangles only keeps a zero normal
+                vNormals[u32Vertex] = oSum;
+            }
+        });
+        m_vNormals.swap(vNormals);
+        logPrint(Debug) << "Computed " << u32Vertices << " vertex normals in " << oTime.getMilliseconds() << "ms";
+    }
+    return retVal;
+}
+
+void CIndexedMesh::clear()
+{
+    std::vector<CVector3d>().swap(m_vVertices);
+    std::vector<CVector3d>().swap(m_vNormals);
+    std::vector<uint32_t>().swap(m_vIndices);
+}
+
+C3DFacet CIndexedMesh::getFacet(uint32_t u32Triangle) const
+{
+    C3DFacet oFacet;
+    oFacet.p1 = m_vVertices[m_vIndices[3 * u32Triangle]];
+    oFacet.p2 = m_vVertices[m_vIndices[3 * u32Triangle + 1]];
+    oFacet.p3 = m_vVertices[m_vIndices[3 * u32Triangle + 2]];
+    oFacet.computeNormal();
+    return oFacet;
+}
+
+CIndexedMesh::Key CIndexedMesh::getKey(const CVector3d &oPoint, double dInvTolerance)
+{
+    Key key{};
+    if (dInvTolerance > 0.0)
+    {
+        key.i64X = getCell(oPoint.m_fX, dInvTolerance);
+        key.i64Y = getCell(oPoint.m_fY, dInvTolerance);
+        key.i64Z = getCell(oPoint.m_fZ, dInvTolerance);
+    }
+    else
+    {
+        key.i64X = getBits(oPoint.m_fX);
+        key.i64Y = getBits(oPoint.m_fY);
+        key.i64Z = getBits(oPoint.m_fZ);
+    }
+    return key;
+}
+
+uint64_t CIndexedMesh::hashKey(const Key &key)
+{
+    // the coordinates are combined and mixed with the finalizer of splitmix64, so all bits of the hash are random
+    uint64_t u64Hash = static_cast<uint64_t>(key.i64X) * 0x9E3779B97F4A7C15ull
+                     + static_cast<uint64_t>(key.i64Y) * 0xC2B2AE3D27D4EB4Full
+                     + static_cast<uint64_t>(key.i64Z) * 0x165667B19E3779F9ull;
+    u64Hash ^= u64Hash >> 30;
+    u64Hash *= 0xBF58476D1CE4E5B9ull;
+    u64Hash ^= u64Hash >> 27;
+    u64Hash *= 0x94D049BB133111EBull;
+    u64Hash ^= u64Hash >> 31;
+    return u64Hash;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file CLoadHandle.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#include "CLoadHandle.h"
+
+CLoadHandle::CLoadHandle(const std::string &sFileName, CModel &oModel, const ProgressCallback &progressCallback,
+                         const LoadedCallback &loadedCallback) :
+    m_sFileName{sFileName}, m_oModel(oModel), m_progressCallback{progressCallback}, m_loadedCallback{loadedCallback}, m_hThread{nullptr},
+    m_result{Err::NoError}, m_bCancelled{false}, m_hCancelEvent{CreateEvent(nullptr, TRUE, FALSE, nullptr)}, m_oLock{}, m_progress{}, m_stats{}, m_oMeshCache{}
+{
+}
+
+CLoadHandle::~CLoadHandle()
+{
+    if (nullptr != m_hThread)
+    {
+        cancel();
+        WaitForSingleObject(m_hThread, INFINITE);
+        CloseHandle(m_hThread);
+    }
+    if (nullptr != m_hCancelEvent)
+    {
+        CloseHandle(m_hCancelEvent);
+    }
+}
+
+void CLoadHandle::cancel()
+{
+    m_bCancelled = true;
+    if (nullptr != m_hCancelEvent)
+    {
+        SetEvent(m_hCancelEvent);
+    }
+}
+
+bool CLoadHandle::isDone() const
+{
+    return (nullptr == m_hThread) || (WAIT_OBJECT_0 == WaitForSingleObject(m_hThread, 0));
+}
+
+Err CLoadHandle::getResult()
+{
+    if (nullptr != m_hThread)
+    {
+        WaitForSingleObject(m_hThread, INFINITE);
+    }
+    return m_result;
+}
+
+CLoadHandle::Progress CLoadHandle::getProgress() const
+{
+    CLockGuard oGuard{m_oLock};
+    return m_progress;
+}
+
+void CLoadHandle::setProgress(uint64_t u64BytesProcessed, uint64_t u64BytesTotal, uint32_t u32Facets)
+{
+    Progress progress;
+    progress.u64BytesProcessed = u64BytesProcessed;
+    progress.u64BytesTotal = u64BytesTotal;
+    progress.u32Facets = u32Facets;
+    {
+        CLockGuard oGuard{m_oLock};
+        m_progress = progress;
+    }
+    if (m_progressCallback)
+    {
+        m_progressCallback(progress);
+    }
+}
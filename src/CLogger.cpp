@@ -13,6 +13,7 @@
 std::ofstream CLogger::m_file{"output.log"};
 LogLevel CLogger::m_logLevel{Trace};
 bool CLogger::m_bEchoToCout{false};
+CCriticalSection CLogger::m_oLock{};
 
 #else // LOGGING_ENABLED
 
@@ -0,0 +1,161 @@
+/**
+ * @file CMappedFile.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#include "CMappedFile.h"
+#include "CLogger.h"
+
+CMappedView::CMappedView(CMappedView &&oOther)
+    : m_pBase{oOther.m_pBase}, m_pData{oOther.m_pData}, m_size{oOther.m_size}
+{
+    oOther.m_pBase = nullptr;
+    oOther.m_pData = nullptr;
+    oOther.m_size = 0;
+}
+
+CMappedView &CMappedView::operator=(CMappedView &&oOther)
+{
+    if (this != &oOther)
+    {
+        unmap();
+        m_pBase = oOther.m_pBase;
+        m_pData = oOther.m_pData;
+        m_size = oOther.m_size;
+        oOther.m_pBase = nullptr;
+        oOther.m_pData = nullptr;
+        oOther.m_size = 0;
+    }
+    return *this;
+}
+
+void CMappedView::unmap()
+{
+    if (m_pBase)
+    {
+        UnmapViewOfFile(m_pBase);
+    }
+    m_pBase = nullptr;
+    m_pData = nullptr;
+    m_size = 0;
+}
+
+Err CMappedFile::open(const std::string &sFileName)
+{
+    Err retVal{Err::NoError};
+
+    close();
+    logPrint(Trace) << "CMappedFile::open(\"" << sFileName << "\")";
+    // The sequential scan hint makes the system read ahead aggressively and drop the pages which were already consumed.
+    m_hFile = CreateFileA(sFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE != m_hFile)
+    {
+        LARGE_INTEGER fileSize{};
+        if (GetFileSizeEx(m_hFile, &fileSize))
+        {
+            m_u64Size = static_cast<uint64_t>(fileSize.QuadPart);
+            if (m_u64Size > 0) // an empty file can't be mapped
+            {
+                m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (!m_hMapping)
+                {
+                    logPrint(Debug) << "Can't create file mapping, error " << GetLastError();
+                    retVal = Err::MapFile;
+                }
+            }
+        }
+        else
+        {
+            logPrint(Debug) << "Can't read file size, error " << GetLastError();
+            retVal = Err::OpenFile;
+        }
+    }
+    else
+    {
+        DWORD dwError = GetLastError();
+        logPrint(Debug) << "Can't open file, error " << dwError;
+        retVal = ((ERROR_FILE_NOT_FOUND == dwError) || (ERROR_PATH_NOT_FOUND == dwError))? Err::FileNotFound : Err::OpenFile;
+    }
+
+    if (Err::NoError != retVal)
+    {
+        close();
+    }
+    return retVal;
+}
+
+void CMappedFile::close()
+{
+    if (m_hMapping)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+    }
+    if (INVALID_HANDLE_VALUE != m_hFile)
+    {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+    m_u64Size = 0;
+}
+
+CMappedView CMappedFile::mapView(uint64_t u64Offset, size_t size) const
+{
+    CMappedView oView;
+
+    if (m_hMapping && (u64Offset < m_u64Size))
+    {
+        if (size > m_u64Size - u64Offset)
+        {
+            size = static_cast<size_t>(m_u64Size - u64Offset);
+        }
+        // the view must start at a multiple of the allocation granularity
+        const uint64_t u64Granularity = getAllocationGranularity();
+        const uint64_t u64Base = u64Offset - (u64Offset % u64Granularity);
+        const size_t delta = static_cast<size_t>(u64Offset - u64Base);
+        LPVOID pBase = MapViewOfFile(m_hMapping, FILE_MAP_READ, static_cast<DWORD>(u64Base >> 32),
+                                     static_cast<DWORD>(u64Base & 0xFFFFFFFFu), delta + size);
+        if (pBase)
+        {
+            oView.m_pBase = pBase;
+            oView.m_pData = static_cast<const uint8_t*>(pBase) + delta;
+            oView.m_size = size;
+        }
+        else
+        {
+            logPrint(Debug) << "Can't map view at " << u64Offset << "B, size " << size << "B, error " << GetLastError();
+        }
+    }
+    return oView;
+}
+
+uint64_t CMappedFile::getAllocationGranularity()
+{
+    static const uint64_t u64Granularity = []()
+    {
+        SYSTEM_INFO systemInfo{};
+        GetSystemInfo(&systemInfo);
+        return static_cast<uint64_t>(systemInfo.dwAllocationGranularity);
+    }();
+    return u64Granularity;
+}
+
+Err CMappedFile::read(uint64_t u64Offset, void *pBuffer, size_t size) const
+{
+    Err retVal{Err::NoError};
+
+    // the position is passed with the call, so the reads of many threads don't share the file pointer
+    OVERLAPPED position{};
+    position.Offset = static_cast<DWORD>(u64Offset);
+    position.OffsetHigh = static_cast<DWORD>(u64Offset >> 32);
+    DWORD dwRead{0};
+    if (!ReadFile(m_hFile, pBuffer, static_cast<DWORD>(size), &dwRead, &position) || (dwRead != size))
+    {
+        logPrint(Debug) << "Can't read " << size << "B at " << u64Offset << "B, error " << GetLastError();
+        retVal = Err::ReadFile;
+    }
+    return retVal;
+}
@@ -0,0 +1,307 @@
+/**
+ * @file CMeshCache.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#include <windows.h>
+#include "CMeshCache.h"
+#include "CLogger.h"
+#include "CBoundingBox.h"
+#include <string.h>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <type_traits>
+
+// the facets are copied between the model and the cache file as raw memory
+static_assert(std::is_trivially_copyable<C3DFacet>::value, "C3DFacet must be trivially copyable");
+
+constexpr uint32_t CMeshCache::CacheVersion;
+constexpr uint32_t CMeshCache::HashSamples;
+constexpr size_t CMeshCache::HashSampleSize;
+constexpr uint32_t CMeshCache::FacetsPerView;
+constexpr uint32_t CMeshCache::MinFacets;
+
+namespace
+{
+    constexpr char CacheMagic[4] = {'S', 'T', 'L', 'M'};
+    constexpr uint32_t MaxNameLength = 1024;
+    constexpr uint64_t FnvOffsetBasis = 0xCBF29CE484222325ull;
+    constexpr uint64_t FnvPrime = 0x100000001B3ull;
+    constexpr DWORD MaxWriteSize = 64*1024*1024;
+
+    // The header at the beginning of the cache file; the facets and the name of the model follow it.
+    class CacheHeader
+    {
+    public:
+        char acMagic[4]{}; // CacheMagic
+        uint32_t u32Version{0}; // CMeshCache::CacheVersion
+        uint32_t u32Facets{0}; // number of facets
+        uint32_t u32NameLength{0}; // length of the name of the model
+        uint64_t u64SourceSize{0}; // key of the STL file
+        uint64_t u64SourceTime{0};
+        uint64_t u64ContentHash{0};
+        float afMin[3]{}; // bounding box of the normalized model
+        float afMax[3]{};
+    };
+    static_assert(sizeof(CacheHeader) == 64, "CacheHeader must have no padding");
+
+    // FNV-1a hash
+    uint64_t hashBytes(const void *pData, size_t size, uint64_t u64Hash)
+    {
+        const uint8_t *pBytes = static_cast<const uint8_t*>(pData);
+        for (size_t idx = 0; idx < size; ++idx)
+        {
+            u64Hash = (u64Hash ^ pBytes[idx]) * FnvPrime;
+        }
+        return u64Hash;
+    }
+
+    // WriteFile writes at most 4GB at once; smaller parts keep the system cache from growing in one step
+    bool writeAll(HANDLE hFile, const void *pData, uint64_t u64Size)
+    {
+        const uint8_t *pBytes = static_cast<const uint8_t*>(pData);
+        bool bWritten{true};
+        while (bWritten && (u64Size > 0))
+        {
+            const DWORD dwPart = static_cast<DWORD>(std::min<uint64_t>(u64Size, MaxWriteSize));
+            DWORD dwWritten{0};
+            bWritten = WriteFile(hFile, pBytes, dwPart, &dwWritten, nullptr) && (dwPart == dwWritten);
+            pBytes += dwPart;
+            u64Size -= dwPart;
+        }
+        return bWritten;
+    }
+}
+
+Err CMeshCache::setSource(const std::string &sFileName, const CMappedFile &oFile)
+{
+    Err retVal{Err::NoError};
+
+    m_sCacheFileName.clear();
+    char szFullPath[MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA attributes{};
+    std::string sDirectory;
+    const DWORD dwLength = GetFullPathNameA(sFileName.c_str(), MAX_PATH, szFullPath, nullptr);
+    if ((dwLength > 0) && (dwLength < MAX_PATH) && GetFileAttributesExA(sFileName.c_str(), GetFileExInfoStandard, &attributes)
+        && getCacheDirectory(sDirectory))
+    {
+        retVal = hashContent(oFile, m_u64ContentHash);
+    }
+    else
+    {
+        logPrint(Debug) << "Can't get the cache key of " << sFileName << ", error " << GetLastError();
+        retVal = Err::MeshCache;
+    }
+
+    if (Err::NoError == retVal)
+    {
+        // the file names are case-insensitive, so the same file has the same cache file regardless of the case
+        std::string sFullPath{szFullPath};
+        strToLower(sFullPath);
+        std::ostringstream stream;
+        stream << sDirectory << std::hex << std::setw(16) << std::setfill('0')
+               << hashBytes(sFullPath.data(), sFullPath.size(), FnvOffsetBasis) << ".mesh";
+        m_sCacheFileName = stream.str();
+        m_u64SourceSize = oFile.getSize();
+        m_u64SourceTime = (static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    }
+    return retVal;
+}
+
+Err CMeshCache::load(CModel &oModel) const
+{
+    Err retVal{Err::MeshCache};
+
+    CMappedFile oCacheFile;
+    CacheHeader header;
+    if (isValid() && (Err::NoError == oCacheFile.open(m_sCacheFileName)) && (oCacheFile.getSize() >= sizeof(header))
+        && (Err::NoError == oCacheFile.read(0, &header, sizeof(header))))
+    {
+        if ((0 == memcmp(header.acMagic, CacheMagic, sizeof(CacheMagic))) && (CacheVersion == header.u32Version)
+            && (m_u64SourceSize == header.u64SourceSize) && (m_u64SourceTime == header.u64SourceTime)
+            && (m_u64ContentHash == header.u64ContentHash) && (header.u32NameLength <= MaxNameLength)
+            && (oCacheFile.getSize() == sizeof(header) + static_cast<uint64_t>(header.u32Facets) * sizeof(C3DFacet) + header.u32NameLength))
+        {
+            retVal = Err::NoError;
+        }
+        else
+        {
+            // the STL file was modified after the cache file was written
+            logPrint(Debug) << "Deleting stale cache file " << m_sCacheFileName;
+            oCacheFile.close();
+            DeleteFileA(m_sCacheFileName.c_str());
+        }
+    }
+
+    std::string sName;
+    if ((Err::NoError == retVal) && CModel::fitsInMemory(header.u32Facets))
+    {
+        logPrint(Debug) << "Loading " << header.u32Facets << " facets from cache file " << m_sCacheFileName;
+        oModel.clear();
+        try
+        {
+            sName.resize(header.u32NameLength);
+            CLockGuard oGuard{oModel.getLock()};
+            oModel.getFacets().resize(header.u32Facets);
+        }
+        catch(...)
+        {
+            logPrint(Debug) << "Can't allocate memory for " << header.u32Facets << " facets";
+            retVal = Err::MeshCache;
+        }
+    }
+    else
+    {
+        retVal = Err::MeshCache;
+    }
+
+    if (Err::NoError == retVal)
+    {
+        // the box of the normalized model is known, so the facets are only copied
+        CBoundingBox oBox;
+        oBox.add(CVector3d{header.afMin[0], header.afMin[1], header.afMin[2]});
+        oBox.add(CVector3d{header.afMax[0], header.afMax[1], header.afMax[2]});
+        C3DFacet *pFacets = oModel.getFacets().data();
+        for (uint32_t u32First = 0; (Err::NoError == retVal) && (u32First < header.u32Facets); u32First += FacetsPerView)
+        {
+            const uint32_t u32Count = std::min(FacetsPerView, header.u32Facets - u32First);
+            const size_t size = u32Count * sizeof(C3DFacet);
+            const CMappedView oView = oCacheFile.mapView(sizeof(header) + static_cast<uint64_t>(u32First) * sizeof(C3DFacet), size);
+            if (oView.isValid() && (size == oView.size()))
+            {
+                memcpy(&pFacets[u32First], oView.data(), size);
+                oModel.publishFacets(u32First + u32Count, static_cast<float>(u32First + u32Count) / static_cast<float>(header.u32Facets), oBox);
+            }
+            else
+            {
+                retVal = Err::MeshCache;
+            }
+        }
+        if ((Err::NoError == retVal) && !sName.empty())
+        {
+            retVal = oCacheFile.read(sizeof(header) + static_cast<uint64_t>(header.u32Facets) * sizeof(C3DFacet), &sName[0], sName.size());
+        }
+        if (Err::NoError == retVal)
+        {
+            oModel.setModelName(sName);
+        }
+        else
+        {
+            logPrint(Debug) << "Can't read cache file " << m_sCacheFileName;
+            oModel.clear();
+            retVal = Err::MeshCache;
+        }
+    }
+    return retVal;
+}
+
+Err CMeshCache::store(const CModel &oModel) const
+{
+    Err retVal{Err::NoError};
+
+    CLockGuard oGuard{oModel.getLock()};
+    const std::vector<C3DFacet> &vFacets = oModel.getFacets();
+    const CBoundingBox &oBox = oModel.getBoundingBox();
+    const std::string &sName = oModel.getModelName();
+    if (!isValid() || oModel.isPaged() || (vFacets.size() < MinFacets) || !oBox.isValid() || (sName.size() > MaxNameLength))
+    {
+        // small models are loaded quickly anyway and paged models would make as big cache files as the STL files
+        retVal = Err::MeshCache;
+    }
+    else
+    {
+        CacheHeader header;
+        memcpy(header.acMagic, CacheMagic, sizeof(CacheMagic));
+        header.u32Version = CacheVersion;
+        header.u32Facets = static_cast<uint32_t>(vFacets.size());
+        header.u32NameLength = static_cast<uint32_t>(sName.size());
+        header.u64SourceSize = m_u64SourceSize;
+        header.u64SourceTime = m_u64SourceTime;
+        header.u64ContentHash = m_u64ContentHash;
+        header.afMin[0] = oBox.getMin().m_fX;
+        header.afMin[1] = oBox.getMin().m_fY;
+        header.afMin[2] = oBox.getMin().m_fZ;
+        header.afMax[0] = oBox.getMax().m_fX;
+        header.afMax[1] = oBox.getMax().m_fY;
+        header.afMax[2] = oBox.getMax().m_fZ;
+
+        // the complete file replaces the old one at once, so a half-written file is never loaded
+        const std::string sTempFileName = m_sCacheFileName + ".tmp";
+        HANDLE hFile = CreateFileA(sTempFileName.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (INVALID_HANDLE_VALUE != hFile)
+        {
+            const bool bWritten = writeAll(hFile, &header, sizeof(header))
+                                  && writeAll(hFile, vFacets.data(), static_cast<uint64_t>(vFacets.size()) * sizeof(C3DFacet))
+                                  && writeAll(hFile, sName.data(), sName.size());
+            CloseHandle(hFile);
+            if (bWritten && MoveFileExA(sTempFileName.c_str(), m_sCacheFileName.c_str(), MOVEFILE_REPLACE_EXISTING))
+            {
+                logPrint(Debug) << "Model stored in cache file " << m_sCacheFileName;
+            }
+            else
+            {
+                logPrint(Debug) << "Can't write cache file " << m_sCacheFileName << ", error " << GetLastError();
+                DeleteFileA(sTempFileName.c_str());
+                retVal = Err::MeshCache;
+            }
+        }
+        else
+        {
+            logPrint(Debug) << "Can't create cache file " << sTempFileName << ", error " << GetLastError();
+            retVal = Err::MeshCache;
+        }
+    }
+    return retVal;
+}
+
+bool CMeshCache::getCacheDirectory(std::string &sDirectory)
+{
+    bool bExists{false};
+
+    // the cache survives the cleanups of the temporary directory if it's in the local application data
+    char szPath[MAX_PATH];
+    DWORD dwLength = GetEnvironmentVariableA("LOCALAPPDATA", szPath, MAX_PATH);
+    if ((0 == dwLength) || (dwLength >= MAX_PATH))
+    {
+        dwLength = GetTempPathA(MAX_PATH, szPath);
+    }
+    if ((dwLength > 0) && (dwLength < MAX_PATH))
+    {
+        sDirectory = szPath;
+        if ('\\' != sDirectory.back())
+        {
+            sDirectory += '\\';
+        }
+        sDirectory += "stl_viewer\\";
+        bExists = CreateDirectoryA(sDirectory.c_str(), nullptr) || (ERROR_ALREADY_EXISTS == GetLastError());
+    }
+    return bExists;
+}
+
+Err CMeshCache::hashContent(const CMappedFile &oFile, uint64_t &u64Hash)
+{
+    Err retVal{Err::NoError};
+
+    // The samples are spread evenly from the beginning to the end of the file. A file smaller than
+    // HashSamples samples is covered completely by the overlapping samples.
+    const uint64_t u64FileSize = oFile.getSize();
+    const size_t sampleSize = static_cast<size_t>(std::min<uint64_t>(HashSampleSize, u64FileSize));
+    const uint32_t u32Samples = static_cast<uint32_t>(std::min<uint64_t>(HashSamples, (u64FileSize + HashSampleSize - 1) / HashSampleSize));
+    uint8_t au8Sample[HashSampleSize];
+    u64Hash = FnvOffsetBasis;
+    for (uint32_t u32Sample = 0; (Err::NoError == retVal) && (u32Sample < u32Samples); ++u32Sample)
+    {
+        const uint64_t u64Offset = (u32Samples > 1)? ((u64FileSize - sampleSize) * u32Sample / (u32Samples - 1)) : 0;
+        retVal = oFile.read(u64Offset, au8Sample, sampleSize);
+        u64Hash = hashBytes(au8Sample, sampleSize, u64Hash);
+    }
+    if (Err::NoError != retVal)
+    {
+        retVal = Err::MeshCache;
+    }
+    return retVal;
+}
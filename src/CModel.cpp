@@ -11,39 +11,584 @@
 #include "CStlLoader.h"
 #include "CTriangle.h"
 #include "CVector3d.h"
+#include "CThreadPool.h"
 #include <sstream>
 #include <iomanip>
 #include <GL/freeglut.h>
 #include <map>
 #include <string>
 #include <iostream>
+#include <algorithm>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std::literals::string_literals;
 
+constexpr uint64_t CModel::MaxInCoreBytes;
+constexpr uint64_t CModel::PagedResidentBytes;
+constexpr uint32_t CModel::ChunkFacets;
+
+namespace
+{
+    const float IdentityTransform[9] = {1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+
+    void transformFacetRange(C3DFacet *pFacets, uint32_t u32Count, const CVector3d &oShift, float fScale)
+    {
+#if defined(__SSE2__)
+        // A facet is 3 vectors: p1.x p1.y p1.z p2.x | p2.y p2.z p3.x p3.y | p3.z n.x n.y n.z.
+        // The normal is kept by a zero shift and a unit scale, which don't change any float.
+        static_assert(sizeof(C3DFacet) == 12*sizeof(float), "C3DFacet must consist of 12 packed floats");
+        const __m128 shift1 = _mm_setr_ps(oShift.m_fX, oShift.m_fY, oShift.m_fZ, oShift.m_fX);
+        const __m128 shift2 = _mm_setr_ps(oShift.m_fY, oShift.m_fZ, oShift.m_fX, oShift.m_fY);
+        const __m128 shift3 = _mm_setr_ps(oShift.m_fZ, 0.0f, 0.0f, 0.0f);
+        const __m128 scale = _mm_set1_ps(fScale);
+        const __m128 scale3 = _mm_setr_ps(fScale, 1.0f, 1.0f, 1.0f);
+        float *pData = &pFacets->p1.m_fX;
+        for (uint32_t u32Idx = 0; u32Idx < u32Count; ++u32Idx)
+        {
+            _mm_storeu_ps(pData, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pData), shift1), scale));
+            _mm_storeu_ps(pData + 4, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pData + 4), shift2), scale));
+            _mm_storeu_ps(pData + 8, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pData + 8), shift3), scale3));
+            pData += 12;
+        }
+#else
+        for (uint32_t u32Idx = 0; u32Idx < u32Count; ++u32Idx)
+        {
+            for (CVector3d *pPoint : {&pFacets[u32Idx].p1, &pFacets[u32Idx].p2, &pFacets[u32Idx].p3})
+            {
+                pPoint->m_fX = (pPoint->m_fX - oShift.m_fX) * fScale;
+                pPoint->m_fY = (pPoint->m_fY - oShift.m_fY) * fScale;
+                pPoint->m_fZ = (pPoint->m_fZ - oShift.m_fZ) * fScale;
+            }
+        }
+#endif
+    }
+
+    // the inverse of a rotation is its transpose
+    CVector3d rotateBack(const float afTransform[9], const CVector3d &oPoint)
+    {
+        return CVector3d{afTransform[0] * oPoint.m_fX + afTransform[3] * oPoint.m_fY + afTransform[6] * oPoint.m_fZ,
+                         afTransform[1] * oPoint.m_fX + afTransform[4] * oPoint.m_fY + afTransform[7] * oPoint.m_fZ,
+                         afTransform[2] * oPoint.m_fX + afTransform[5] * oPoint.m_fY + afTransform[8] * oPoint.m_fZ};
+    }
+}
+
+template <typename Function>
+void CModel::visitFacets(Function function) const
+{
+    if (isPaged())
+    {
+        for (uint32_t u32Block = 0; u32Block < m_oPagedFacets.getBlockCount(); ++u32Block)
+        {
+            const C3DFacet *pFacets = m_oPagedFacets.getBlock(u32Block);
+            if (nullptr != pFacets)
+            {
+                std::for_each(pFacets, pFacets + m_oPagedFacets.getBlockSize(u32Block), function);
+            }
+            else
+            {
+                logPrint(Warning) << "Facet block " << u32Block << " isn't accessible";
+            }
+        }
+    }
+    else if (isIndexed())
+    {
+        for (uint32_t u32Triangle = 0; u32Triangle < m_oIndexedMesh.getTriangleCount(); ++u32Triangle)
+        {
+            function(m_oIndexedMesh.getFacet(u32Triangle));
+        }
+    }
+    else if (isStreamed())
+    {
+        for (uint32_t u32Facet = 0; u32Facet < m_oFacetStreams.getFacetCount(); ++u32Facet)
+        {
+            function(m_oFacetStreams.getFacet(u32Facet));
+        }
+    }
+    else if (isQuantized())
+    {
+        for (uint32_t u32Facet = 0; u32Facet < m_oQuantizedFacets.getFacetCount(); ++u32Facet)
+        {
+            function(m_oQuantizedFacets.getFacet(u32Facet));
+        }
+    }
+    else
+    {
+        std::for_each(m_vFacets.begin(), m_vFacets.end(), function);
+    }
+}
+
+template <typename Function>
+void CModel::updateFacets(Function function)
+{
+    if (isPaged())
+    {
+        for (uint32_t u32Block = 0; u32Block < m_oPagedFacets.getBlockCount(); ++u32Block)
+        {
+            C3DFacet *pFacets = m_oPagedFacets.getBlockForWrite(u32Block);
+            if (nullptr != pFacets)
+            {
+                std::for_each(pFacets, pFacets + m_oPagedFacets.getBlockSize(u32Block), function);
+            }
+            else
+            {
+                logPrint(Warning) << "Facet block " << u32Block << " isn't accessible";
+            }
+        }
+    }
+    else if (isIndexed())
+    {
+        // every vertex is transformed once; the facet normals are computed from the vertices anyway
+        std::vector<CVector3d> &vVertices = m_oIndexedMesh.getVertices();
+        std::vector<CVector3d> &vNormals = m_oIndexedMesh.getNormals();
+        for (uint32_t u32Vertex = 0; u32Vertex < static_cast<uint32_t>(vVertices.size()); ++u32Vertex)
+        {
+            C3DFacet oFacet;
+            oFacet.p1 = vVertices[u32Vertex];
+            oFacet.p2 = vVertices[u32Vertex];
+            oFacet.p3 = vVertices[u32Vertex];
+            if (!vNormals.empty())
+            {
+                oFacet.normal = vNormals[u32Vertex];
+            }
+            function(oFacet);
+            vVertices[u32Vertex] = oFacet.p1;
+            if (!vNormals.empty())
+            {
+                vNormals[u32Vertex] = oFacet.normal;
+            }
+        }
+    }
+    else if (isStreamed())
+    {
+        for (uint32_t u32Facet = 0; u32Facet < m_oFacetStreams.getFacetCount(); ++u32Facet)
+        {
+            C3DFacet oFacet = m_oFacetStreams.getFacet(u32Facet);
+            function(oFacet);
+            m_oFacetStreams.setFacet(u32Facet, oFacet);
+        }
+    }
+    else
+    {
+        std::for_each(m_vFacets.begin(), m_vFacets.end(), function);
+    }
+}
+
+template <typename Function>
+void CModel::updateFacetRanges(Function function)
+{
+    // the chunks don't overlap, so they are processed by all threads of the pool
+    auto updateChunks = [&function](C3DFacet *pFacets, uint32_t u32Facets)
+    {
+        const uint32_t u32Chunks = (u32Facets + ChunkFacets - 1) / ChunkFacets;
+        CThreadPool::getInstance().parallelFor(u32Chunks, [&function, pFacets, u32Facets](uint32_t u32Chunk)
+        {
+            const uint32_t u32First = u32Chunk * ChunkFacets;
+            function(pFacets + u32First, std::min(ChunkFacets, u32Facets - u32First));
+        });
+    };
+
+    if (isPaged())
+    {
+        for (uint32_t u32Block = 0; u32Block < m_oPagedFacets.getBlockCount(); ++u32Block)
+        {
+            C3DFacet *pFacets = m_oPagedFacets.getBlockForWrite(u32Block);
+            if (nullptr != pFacets)
+            {
+                updateChunks(pFacets, m_oPagedFacets.getBlockSize(u32Block));
+            }
+            else
+            {
+                logPrint(Warning) << "Facet block " << u32Block << " isn't accessible";
+            }
+        }
+    }
+    else if (!isIndexed() && !isStreamed() && !isQuantized())
+    {
+        updateChunks(m_vFacets.data(), static_cast<uint32_t>(m_vFacets.size()));
+    }
+}
+
+void CModel::clear()
+{
+    CLockGuard oGuard{m_oLock};
+    m_vFacets.clear();
+    m_oPagedFacets.close();
+    m_oIndexedMesh.clear();
+    m_oFacetStreams.clear();
+    m_oQuantizedFacets.clear();
+    m_oBvh.clear();
+    m_u32PublishedFacets = 0;
+    m_bUnitNormals = false;
+    // the loaded facets are published in the storage coordinates, so a reloaded model starts unrotated
+    memcpy(m_afTransform, IdentityTransform, sizeof(m_afTransform));
+    m_oBoundingBox.reset();
+    m_oBoundingBox.add(m_oPreviewBox);
+}
+
+void CModel::setPreviewFacets(std::vector<C3DFacet> &&vFacets, const CBoundingBox &oBox)
+{
+    CLockGuard oGuard{m_oLock};
+    m_vPreviewFacets = std::move(vFacets);
+    m_oPreviewBox = oBox;
+    m_oBoundingBox.add(m_oPreviewBox);
+}
+
+bool CModel::fitsInMemory(uint64_t u64Facets, uint32_t u32FacetSize)
+{
+    uint64_t u64Limit{MaxInCoreBytes};
+    MEMORYSTATUSEX memoryStatus{};
+    memoryStatus.dwLength = sizeof(memoryStatus);
+    if (GlobalMemoryStatusEx(&memoryStatus))
+    {
+        u64Limit = std::min(u64Limit, memoryStatus.ullTotalPhys / 2);
+    }
+    return u64Facets * u32FacetSize <= u64Limit;
+}
+
+Err CModel::setPaged()
+{
+    Err retVal{Err::NoError};
+
+    CLockGuard oGuard{m_oLock};
+    if (!isPaged())
+    {
+        logPrint(Debug) << "Model doesn't fit in memory; paging " << m_vFacets.size() << " facets";
+        retVal = m_oPagedFacets.open(PagedResidentBytes);
+        if (Err::NoError == retVal)
+        {
+            retVal = m_oPagedFacets.append(m_vFacets.data(), static_cast<uint32_t>(m_vFacets.size()));
+        }
+        if (Err::NoError == retVal)
+        {
+            std::vector<C3DFacet>().swap(m_vFacets);
+        }
+        else
+        {
+            m_oPagedFacets.close();
+        }
+    }
+    return retVal;
+}
+
+Err CModel::weld(float fTolerance)
+{
+    Err retVal{Err::NoError};
+
+    CLockGuard oGuard{m_oLock};
+    if (isPaged() || isIndexed() || isStreamed() || isQuantized())
+    {
+        logPrint(Debug) << "Model isn't welded: " << ((isPaged())? "paged" : ((isIndexed())? "welded already" : ((isStreamed())? "streamed" : "quantized")));
+    }
+    else
+    {
+        retVal = m_oIndexedMesh.build(m_vFacets, fTolerance);
+        if (Err::NoError == retVal)
+        {
+            std::vector<C3DFacet>().swap(m_vFacets);
+            // the welded vertices may move by the tolerance
+            if (hasBvh())
+            {
+                m_oBvh.refit(getFacetGetter());
+            }
+        }
+    }
+    return retVal;
+}
+
+Err CModel::smoothNormals()
+{
+    Err retVal{Err::NoError};
+
+    CLockGuard oGuard{m_oLock};
+    if (isIndexed())
+    {
+        retVal = m_oIndexedMesh.computeVertexNormals();
+    }
+    else
+    {
+        logPrint(Debug) << "Model isn't smoothed: not welded";
+    }
+    return retVal;
+}
+
+void CModel::repairNormals()
+{
+    logPrint(Debug) << "repairNormals";
+    CLockGuard oGuard{m_oLock};
+    if (isStreamed())
+    {
+        updateFacets([](C3DFacet &oFacet) { oFacet.computeNormal(); });
+    }
+    else
+    {
+        updateFacetRanges([](C3DFacet *pFacets, uint32_t u32Count)
+        {
+            std::for_each(pFacets, pFacets + u32Count, [](C3DFacet &oFacet) { oFacet.computeNormal(); });
+        });
+    }
+    m_bUnitNormals = true;
+}
+
+Err CModel::setStreamed()
+{
+    Err retVal{Err::NoError};
+
+    CLockGuard oGuard{m_oLock};
+    if (isPaged() || isIndexed() || isStreamed() || isQuantized())
+    {
+        logPrint(Debug) << "Model isn't streamed: " << ((isPaged())? "paged" : ((isIndexed())? "welded" : ((isStreamed())? "streamed already" : "quantized")));
+    }
+    else
+    {
+        retVal = m_oFacetStreams.build(m_vFacets);
+        if (Err::NoError == retVal)
+        {
+            std::vector<C3DFacet>().swap(m_vFacets);
+        }
+    }
+    return retVal;
+}
+
+Err CModel::quantize(uint32_t u32NormalBits)
+{
+    Err retVal{Err::NoError};
+
+    CLockGuard oGuard{m_oLock};
+    const uint32_t u32Facets = (isPaged())? m_oPagedFacets.size() : static_cast<uint32_t>(m_vFacets.size());
+    if (isIndexed() || isStreamed() || isQuantized() || (0 == u32Facets))
+    {
+        logPrint(Debug) << "Model isn't quantized: " << ((isIndexed())? "welded" : ((isStreamed())? "streamed" : ((isQuantized())? "quantized already" : "empty")));
+    }
+    else if (!fitsInMemory(u32Facets, CQuantizedFacets::getFacetSize(u32NormalBits)))
+    {
+        logPrint(Debug) << "Model isn't quantized: " << u32Facets << " facets don't fit in memory";
+        retVal = Err::MemAlloc;
+    }
+    else
+    {
+        // the box is in the transformed coordinates; the inverse of a rotation is its transpose
+        const float *pfT = m_afTransform;
+        CBoundingBox oDataBox;
+        for (const CVector3d &oCorner : {m_oBoundingBox.getMin(), m_oBoundingBox.getMax()})
+        {
+            oDataBox.add(CVector3d{pfT[0] * oCorner.m_fX + pfT[3] * oCorner.m_fY + pfT[6] * oCorner.m_fZ,
+                                   pfT[1] * oCorner.m_fX + pfT[4] * oCorner.m_fY + pfT[7] * oCorner.m_fZ,
+                                   pfT[2] * oCorner.m_fX + pfT[5] * oCorner.m_fY + pfT[8] * oCorner.m_fZ});
+        }
+        retVal = m_oQuantizedFacets.create(u32Facets, oDataBox, u32NormalBits);
+    }
+
+    if ((Err::NoError == retVal) && isQuantized())
+    {
+        if (isPaged())
+        {
+            uint32_t u32First{0};
+            for (uint32_t u32Block = 0; (u32Block < m_oPagedFacets.getBlockCount()) && (Err::NoError == retVal); ++u32Block)
+            {
+                const C3DFacet *pFacets = m_oPagedFacets.getBlock(u32Block);
+                if (nullptr != pFacets)
+                {
+                    m_oQuantizedFacets.encode(u32First, pFacets, m_oPagedFacets.getBlockSize(u32Block));
+                    u32First += m_oPagedFacets.getBlockSize(u32Block);
+                }
+                else
+                {
+                    logPrint(Warning) << "Facet block " << u32Block << " isn't accessible";
+                    retVal = Err::ReadFile;
+                }
+            }
+        }
+        else
+        {
+            m_oQuantizedFacets.encode(0, m_vFacets.data(), u32Facets);
+        }
+
+        if (Err::NoError == retVal)
+        {
+            logPrint(Debug) << "Quantized facets: " << u32Facets << " facets, " << m_oQuantizedFacets.getMemorySize() << "B";
+            m_oPagedFacets.close();
+            std::vector<C3DFacet>().swap(m_vFacets);
+            if (hasBvh())
+            {
+                m_oBvh.refit(getFacetGetter());
+            }
+        }
+        else
+        {
+            m_oQuantizedFacets.clear();
+        }
+    }
+    return retVal;
+}
+
+CBvh::FacetGetter CModel::getFacetGetter() const
+{
+    CBvh::FacetGetter getFacet;
+    if (isIndexed())
+    {
+        getFacet = [this](uint32_t u32Facet) { return m_oIndexedMesh.getFacet(u32Facet); };
+    }
+    else if (isStreamed())
+    {
+        getFacet = [this](uint32_t u32Facet) { return m_oFacetStreams.getFacet(u32Facet); };
+    }
+    else if (isQuantized())
+    {
+        getFacet = [this](uint32_t u32Facet) { return m_oQuantizedFacets.getFacet(u32Facet); };
+    }
+    else
+    {
+        getFacet = [this](uint32_t u32Facet) { return m_vFacets[u32Facet]; };
+    }
+    return getFacet;
+}
+
+Err CModel::buildBvh()
+{
+    Err retVal{Err::NoError};
+
+    CLockGuard oGuard{m_oLock};
+    if (isPaged())
+    {
+        logPrint(Debug) << "Model has no BVH: paged";
+    }
+    else
+    {
+        const uint32_t u32Facets = (isIndexed())? m_oIndexedMesh.getTriangleCount()
+                                 : ((isStreamed())? m_oFacetStreams.getFacetCount()
+                                 : ((isQuantized())? m_oQuantizedFacets.getFacetCount() : static_cast<uint32_t>(m_vFacets.size())));
+        retVal = m_oBvh.build(u32Facets, getFacetGetter());
+    }
+    return retVal;
+}
+
+bool CModel::rayCast(const CVector3d &oOrigin, const CVector3d &oDirection, CBvh::Hit &oHit) const
+{
+    // the hierarchy is in the coordinates of the stored facets, so the ray is rotated back
+    CLockGuard oGuard{m_oLock};
+    return m_oBvh.rayCast(rotateBack(m_afTransform, oOrigin), rotateBack(m_afTransform, oDirection), getFacetGetter(), oHit);
+}
+
+void CModel::queryBox(const CBoundingBox &oBox, std::vector<uint32_t> &vFacets) const
+{
+    CLockGuard oGuard{m_oLock};
+    CBoundingBox oDataBox;
+    if (oBox.isValid())
+    {
+        // the rotations map the axes to the axes, so the rotated box is a box
+        oDataBox.add(rotateBack(m_afTransform, oBox.getMin()));
+        oDataBox.add(rotateBack(m_afTransform, oBox.getMax()));
+    }
+    m_oBvh.queryBox(oDataBox, getFacetGetter(), vFacets);
+}
+
+Err CModel::appendFacets(const std::vector<C3DFacet> &vFacets, float fProgress)
+{
+    // the bounding box of the batch is found before the renderer is blocked
+    CBoundingBox oBatchBox;
+    for (const auto &oFacet : vFacets)
+    {
+        oBatchBox.add(oFacet);
+    }
+    return appendFacets(vFacets, fProgress, oBatchBox);
+}
+
+Err CModel::appendFacets(const std::vector<C3DFacet> &vFacets, float fProgress, const CBoundingBox &oBox)
+{
+    Err retVal{Err::NoError};
+
+    CLockGuard oGuard{m_oLock};
+    bool bInserted{false};
+    if (!isPaged() && fitsInMemory(m_vFacets.size() + vFacets.size()))
+    {
+        try
+        {
+            m_vFacets.insert(m_vFacets.end(), vFacets.begin(), vFacets.end());
+            bInserted = true;
+        }
+        catch(...)
+        {
+            logPrint(Debug) << "Can't allocate memory for " << (m_vFacets.size() + vFacets.size()) << " facets";
+        }
+    }
+    if (!bInserted)
+    {
+        retVal = setPaged(); // nothing to do if the model is paged already
+        if (Err::NoError == retVal)
+        {
+            retVal = m_oPagedFacets.append(vFacets.data(), static_cast<uint32_t>(vFacets.size()));
+        }
+    }
+
+    if (Err::NoError == retVal)
+    {
+        m_u32PublishedFacets = isPaged()? m_oPagedFacets.size() : static_cast<uint32_t>(m_vFacets.size());
+        m_oBoundingBox.add(oBox);
+        m_fLoadProgress = fProgress;
+    }
+    return retVal;
+}
+
+void CModel::publishFacets(uint32_t u32Count, float fProgress)
+{
+    // the facets beyond the published ones are accessed only by the loader thread, so the lock isn't needed yet
+    CBoundingBox oBatchBox;
+    for (uint32_t u32Idx = m_u32PublishedFacets; u32Idx < u32Count; ++u32Idx)
+    {
+        oBatchBox.add(m_vFacets[u32Idx]);
+    }
+    publishFacets(u32Count, fProgress, oBatchBox);
+}
+
+void CModel::publishFacets(uint32_t u32Count, float fProgress, const CBoundingBox &oBox)
+{
+    CLockGuard oGuard{m_oLock};
+    m_u32PublishedFacets = u32Count;
+    m_oBoundingBox.add(oBox);
+    m_fLoadProgress = fProgress;
+}
+
+void CModel::setLoading(bool bLoading)
+{
+    CLockGuard oGuard{m_oLock};
+    m_bLoading = bLoading;
+    m_fLoadProgress = (bLoading)? 0.0f : 1.0f;
+    std::vector<C3DFacet>().swap(m_vPreviewFacets);
+    m_oPreviewBox.reset();
+}
+
+bool CModel::isLoading() const
+{
+    CLockGuard oGuard{m_oLock};
+    return m_bLoading;
+}
+
+float CModel::getLoadProgress() const
+{
+    CLockGuard oGuard{m_oLock};
+    return m_fLoadProgress;
+}
 
 void CModel::normalizeModel()
 {
     logPrint(Debug) << "normalizeModel";
+    CLockGuard oGuard{m_oLock};
+    // the bounding box was gathered while the facets were published, so the facets aren't scanned again;
+    // it's copied because the normalization replaces it
+    const CBoundingBox oBox = m_oBoundingBox;
+    normalizeModel(oBox);
+}
+
+void CModel::normalizeModel(const CBoundingBox &oBox)
+{
+    CLockGuard oGuard{m_oLock};
     // normalize and center the model
-    if (m_vFacets.size() > 0)
-    {
-        // find Min and Max values in all dimensions
-        float fMinX = m_vFacets[0].p1.m_fX;
-        float fMaxX = m_vFacets[0].p1.m_fX;
-        float fMinY = m_vFacets[0].p1.m_fY;
-        float fMaxY = m_vFacets[0].p1.m_fY;
-        float fMinZ = m_vFacets[0].p1.m_fZ;
-        float fMaxZ = m_vFacets[0].p1.m_fZ;
-        for (const auto &oFacet : m_vFacets)
-        {
-            fMinX = std::min({fMinX, oFacet.p1.m_fX, oFacet.p2.m_fX, oFacet.p3.m_fX});
-            fMaxX = std::max({fMaxX, oFacet.p1.m_fX, oFacet.p2.m_fX, oFacet.p3.m_fX});
-            fMinY = std::min({fMinY, oFacet.p1.m_fY, oFacet.p2.m_fY, oFacet.p3.m_fY});
-            fMaxY = std::max({fMaxY, oFacet.p1.m_fY, oFacet.p2.m_fY, oFacet.p3.m_fY});
-            fMinZ = std::min({fMinZ, oFacet.p1.m_fZ, oFacet.p2.m_fZ, oFacet.p3.m_fZ});
-            fMaxZ = std::max({fMaxZ, oFacet.p1.m_fZ, oFacet.p2.m_fZ, oFacet.p3.m_fZ});
-        }
-        float fScale = std::max({fMaxX-fMinX, fMaxY-fMinY, fMaxZ-fMinZ});
+    if ((m_u32PublishedFacets > 0) && oBox.isValid())
+    {
+        float fScale = oBox.getMaxExtent();
         if (fScale > 0.0f)
         {
             fScale = 1.0f / fScale;
@@ -52,9 +597,15 @@ void CModel::normalizeModel()
         {
             fScale = 0.0f;
         }
-        float fShiftX = fMinX + 0.5f*(fMaxX-fMinX);
-        float fShiftY = fMinY + 0.5f*(fMaxY-fMinY);
-        float fShiftZ = fMinZ + 0.5f*(fMaxZ-fMinZ);
+        const CVector3d oCenter = oBox.getCenter();
+        float fShiftX = oCenter.m_fX;
+        float fShiftY = oCenter.m_fY;
+        float fShiftZ = oCenter.m_fZ;
+        // the box is in the transformed coordinates; the inverse of a rotation is its transpose
+        const float *pfT = m_afTransform;
+        const CVector3d oShift{pfT[0] * fShiftX + pfT[3] * fShiftY + pfT[6] * fShiftZ,
+                               pfT[1] * fShiftX + pfT[4] * fShiftY + pfT[7] * fShiftZ,
+                               pfT[2] * fShiftX + pfT[5] * fShiftY + pfT[8] * fShiftZ};
 
         logPrint(Debug) << "Normalizing model:";
         logPrint(Debug) << "scale=" << fScale;
@@ -62,20 +613,162 @@ void CModel::normalizeModel()
         logPrint(Debug) << "shifty=" << fShiftY;
         logPrint(Debug) << "shiftz=" << fShiftZ;
 
-        for (auto &oFacet : m_vFacets)
+        if (isStreamed())
+        {
+            m_oFacetStreams.transform(oShift, fScale);
+        }
+        else if (isQuantized())
         {
-            oFacet.p1.m_fX = (oFacet.p1.m_fX - fShiftX) * fScale;
-            oFacet.p1.m_fY = (oFacet.p1.m_fY - fShiftY) * fScale;
-            oFacet.p1.m_fZ = (oFacet.p1.m_fZ - fShiftZ) * fScale;
+            m_oQuantizedFacets.transform(oShift, fScale);
+        }
+        else if (!isIndexed())
+        {
+            updateFacetRanges([&oShift, fScale](C3DFacet *pFacets, uint32_t u32Count) { transformFacetRange(pFacets, u32Count, oShift, fScale); });
+        }
+        else
+        {
+            updateFacets([&oShift, fScale](C3DFacet &oFacet)
+            {
+                oFacet.p1.m_fX = (oFacet.p1.m_fX - oShift.m_fX) * fScale;
+                oFacet.p1.m_fY = (oFacet.p1.m_fY - oShift.m_fY) * fScale;
+                oFacet.p1.m_fZ = (oFacet.p1.m_fZ - oShift.m_fZ) * fScale;
+
+                oFacet.p2.m_fX = (oFacet.p2.m_fX - oShift.m_fX) * fScale;
+                oFacet.p2.m_fY = (oFacet.p2.m_fY - oShift.m_fY) * fScale;
+                oFacet.p2.m_fZ = (oFacet.p2.m_fZ - oShift.m_fZ) * fScale;
 
-            oFacet.p2.m_fX = (oFacet.p2.m_fX - fShiftX) * fScale;
-            oFacet.p2.m_fY = (oFacet.p2.m_fY - fShiftY) * fScale;
-            oFacet.p2.m_fZ = (oFacet.p2.m_fZ - fShiftZ) * fScale;
+                oFacet.p3.m_fX = (oFacet.p3.m_fX - oShift.m_fX) * fScale;
+                oFacet.p3.m_fY = (oFacet.p3.m_fY - oShift.m_fY) * fScale;
+                oFacet.p3.m_fZ = (oFacet.p3.m_fZ - oShift.m_fZ) * fScale;
+            });
+        }
 
-            oFacet.p3.m_fX = (oFacet.p3.m_fX - fShiftX) * fScale;
-            oFacet.p3.m_fY = (oFacet.p3.m_fY - fShiftY) * fScale;
-            oFacet.p3.m_fZ = (oFacet.p3.m_fZ - fShiftZ) * fScale;
+        // the corners of the quantized facets are decoded from the new grid, so they are rounded differently
+        if (hasBvh() && isQuantized())
+        {
+            m_oBvh.refit(getFacetGetter());
         }
+        else if (hasBvh())
+        {
+            m_oBvh.transform(oShift, fScale);
+        }
+
+        // the box of the normalized model is centered at the origin and its largest dimension is 1
+        m_oBoundingBox.reset();
+        m_oBoundingBox.add(CVector3d{(oBox.getMin().m_fX - fShiftX) * fScale, (oBox.getMin().m_fY - fShiftY) * fScale, (oBox.getMin().m_fZ - fShiftZ) * fScale});
+        m_oBoundingBox.add(CVector3d{(oBox.getMax().m_fX - fShiftX) * fScale, (oBox.getMax().m_fY - fShiftY) * fScale, (oBox.getMax().m_fZ - fShiftZ) * fScale});
+    }
+}
+
+void CModel::rotate(uint32_t u32AxisA, uint32_t u32AxisB)
+{
+    CLockGuard oGuard{m_oLock};
+    // the rows of the transform give the transformed coordinates, so they are rotated like the coordinates
+    for (uint32_t u32Column = 0; u32Column < 3; ++u32Column)
+    {
+        const float fA = m_afTransform[3 * u32AxisA + u32Column];
+        m_afTransform[3 * u32AxisA + u32Column] = -m_afTransform[3 * u32AxisB + u32Column];
+        m_afTransform[3 * u32AxisB + u32Column] = fA;
+    }
+
+    if (m_oBoundingBox.isValid())
+    {
+        float afMin[3] = {m_oBoundingBox.getMin().m_fX, m_oBoundingBox.getMin().m_fY, m_oBoundingBox.getMin().m_fZ};
+        float afMax[3] = {m_oBoundingBox.getMax().m_fX, m_oBoundingBox.getMax().m_fY, m_oBoundingBox.getMax().m_fZ};
+        const float fMinA = afMin[u32AxisA];
+        const float fMaxA = afMax[u32AxisA];
+        afMin[u32AxisA] = -afMax[u32AxisB];
+        afMax[u32AxisA] = -afMin[u32AxisB];
+        afMin[u32AxisB] = fMinA;
+        afMax[u32AxisB] = fMaxA;
+        m_oBoundingBox.reset();
+        m_oBoundingBox.add(CVector3d{afMin[0], afMin[1], afMin[2]});
+        m_oBoundingBox.add(CVector3d{afMax[0], afMax[1], afMax[2]});
+    }
+}
+
+void CModel::getTransformMatrix(float afMatrix[16]) const
+{
+    for (uint32_t u32Row = 0; u32Row < 4; ++u32Row)
+    {
+        for (uint32_t u32Column = 0; u32Column < 4; ++u32Column)
+        {
+            const bool bRotation = (u32Row < 3) && (u32Column < 3);
+            afMatrix[4 * u32Column + u32Row] = (bRotation)? m_afTransform[3 * u32Row + u32Column] : ((u32Row == u32Column)? 1.0f : 0.0f);
+        }
+    }
+}
+
+void CModel::setTransform(const float afTransform[9])
+{
+    CLockGuard oGuard{m_oLock};
+    // the bounding box is in the transformed coordinates; the rotations map the axes to the axes, so the rotated box is a box
+    CBoundingBox oDataBox;
+    if (m_oBoundingBox.isValid())
+    {
+        oDataBox.add(rotateBack(m_afTransform, m_oBoundingBox.getMin()));
+        oDataBox.add(rotateBack(m_afTransform, m_oBoundingBox.getMax()));
+    }
+    memcpy(m_afTransform, afTransform, sizeof(m_afTransform));
+    m_oBoundingBox.reset();
+    if (oDataBox.isValid())
+    {
+        m_oBoundingBox.add(transformPoint(oDataBox.getMin()));
+        m_oBoundingBox.add(transformPoint(oDataBox.getMax()));
+    }
+}
+
+bool CModel::hasTransform() const
+{
+    return 0 != memcmp(m_afTransform, IdentityTransform, sizeof(m_afTransform));
+}
+
+CVector3d CModel::transformPoint(const CVector3d &oPoint) const
+{
+    const float *pfT = m_afTransform;
+    return CVector3d{pfT[0] * oPoint.m_fX + pfT[1] * oPoint.m_fY + pfT[2] * oPoint.m_fZ,
+                     pfT[3] * oPoint.m_fX + pfT[4] * oPoint.m_fY + pfT[5] * oPoint.m_fZ,
+                     pfT[6] * oPoint.m_fX + pfT[7] * oPoint.m_fY + pfT[8] * oPoint.m_fZ};
+}
+
+C3DFacet CModel::transformFacet(const C3DFacet &oFacet) const
+{
+    C3DFacet oTransformed;
+    oTransformed.p1 = transformPoint(oFacet.p1);
+    oTransformed.p2 = transformPoint(oFacet.p2);
+    oTransformed.p3 = transformPoint(oFacet.p3);
+    oTransformed.normal = transformPoint(oFacet.normal);
+    return oTransformed;
+}
+
+void CModel::bakeTransform()
+{
+    logPrint(Debug) << "Model - bakeTransform";
+    CLockGuard oGuard{m_oLock};
+    if (hasTransform())
+    {
+        if (isStreamed())
+        {
+            m_oFacetStreams.reorient(m_afTransform);
+        }
+        else if (isQuantized())
+        {
+            m_oQuantizedFacets.reorient(m_afTransform);
+        }
+        else
+        {
+            updateFacets([this](C3DFacet &oFacet) { oFacet = transformFacet(oFacet); });
+        }
+
+        if (hasBvh() && isQuantized())
+        {
+            m_oBvh.refit(getFacetGetter());
+        }
+        else if (hasBvh())
+        {
+            m_oBvh.reorient(m_afTransform);
+        }
+        memcpy(m_afTransform, IdentityTransform, sizeof(m_afTransform));
     }
 }
 
@@ -86,25 +779,7 @@ void CModel::rotateX() // left-hand rotation by 90 degrees around X-axis
     // new y <- old z
     // new z <- old -y
     logPrint(Debug) << "Model - rotateX";
-    for (auto &oFacet : m_vFacets)
-    {
-        float fTemp;
-        fTemp = oFacet.p1.m_fY;
-        oFacet.p1.m_fY = oFacet.p1.m_fZ;
-        oFacet.p1.m_fZ = -fTemp;
-
-        fTemp = oFacet.p2.m_fY;
-        oFacet.p2.m_fY = oFacet.p2.m_fZ;
-        oFacet.p2.m_fZ = -fTemp;
-
-        fTemp = oFacet.p3.m_fY;
-        oFacet.p3.m_fY = oFacet.p3.m_fZ;
-        oFacet.p3.m_fZ = -fTemp;
-
-        fTemp = oFacet.normal.m_fY;
-        oFacet.normal.m_fY = oFacet.normal.m_fZ;
-        oFacet.normal.m_fZ = -fTemp;
-    }
+    rotate(2, 1);
 }
 
 void CModel::rotateY() // left-hand rotation by 90 degrees around Y-axis
@@ -114,25 +789,7 @@ void CModel::rotateY() // left-hand rotation by 90 degrees around Y-axis
     // new y <- old y
     // new z <- old x
     logPrint(Debug) << "Model - rotateY";
-    for (auto &oFacet : m_vFacets)
-    {
-        float fTemp;
-        fTemp = oFacet.p1.m_fZ;
-        oFacet.p1.m_fZ = oFacet.p1.m_fX;
-        oFacet.p1.m_fX = -fTemp;
-
-        fTemp = oFacet.p2.m_fZ;
-        oFacet.p2.m_fZ = oFacet.p2.m_fX;
-        oFacet.p2.m_fX = -fTemp;
-
-        fTemp = oFacet.p3.m_fZ;
-        oFacet.p3.m_fZ = oFacet.p3.m_fX;
-        oFacet.p3.m_fX = -fTemp;
-
-        fTemp = oFacet.normal.m_fZ;
-        oFacet.normal.m_fZ = oFacet.normal.m_fX;
-        oFacet.normal.m_fX = -fTemp;
-    }
+    rotate(0, 2);
 }
 
 void CModel::rotateZ() // left-hand rotation by 90 degrees around Z-axis
@@ -142,23 +799,5 @@ void CModel::rotateZ() // left-hand rotation by 90 degrees around Z-axis
     // new y <- old -x
     // new z <- old z
     logPrint(Debug) << "Model - rotateZ";
-    for (auto &oFacet : m_vFacets)
-    {
-        float fTemp;
-        fTemp = oFacet.p1.m_fX;
-        oFacet.p1.m_fX = oFacet.p1.m_fY;
-        oFacet.p1.m_fY = -fTemp;
-
-        fTemp = oFacet.p2.m_fX;
-        oFacet.p2.m_fX = oFacet.p2.m_fY;
-        oFacet.p2.m_fY = -fTemp;
-
-        fTemp = oFacet.p3.m_fX;
-        oFacet.p3.m_fX = oFacet.p3.m_fY;
-        oFacet.p3.m_fY = -fTemp;
-
-        fTemp = oFacet.normal.m_fX;
-        oFacet.normal.m_fX = oFacet.normal.m_fY;
-        oFacet.normal.m_fY = -fTemp;
-    }
+    rotate(1, 0);
 }
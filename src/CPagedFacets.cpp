@@ -0,0 +1,274 @@
+/**
+ * @file CPagedFacets.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#include "CPagedFacets.h"
+#include "CLogger.h"
+#include <string.h>
+#include <algorithm>
+#include <type_traits>
+
+// the blocks are written to the page file as raw memory
+static_assert(std::is_trivially_copyable<C3DFacet>::value, "C3DFacet must be trivially copyable");
+
+constexpr uint32_t CPagedFacets::BlockFacets;
+constexpr uint32_t CPagedFacets::NoFrame;
+constexpr uint32_t CPagedFacets::MinFrames;
+
+namespace
+{
+    constexpr DWORD BlockBytes = CPagedFacets::BlockFacets * sizeof(C3DFacet);
+
+    // every block has its fixed place in the page file
+    OVERLAPPED getBlockPosition(uint32_t u32Block)
+    {
+        const uint64_t u64Offset = static_cast<uint64_t>(u32Block) * BlockBytes;
+        OVERLAPPED position{};
+        position.Offset = static_cast<DWORD>(u64Offset);
+        position.OffsetHigh = static_cast<DWORD>(u64Offset >> 32);
+        return position;
+    }
+}
+
+Err CPagedFacets::open(uint64_t u64ResidentBytes)
+{
+    Err retVal{Err::NoError};
+
+    close();
+    char szTempPath[MAX_PATH];
+    char szFileName[MAX_PATH];
+    const DWORD dwPathLength = GetTempPathA(MAX_PATH, szTempPath);
+    if ((dwPathLength > 0) && (dwPathLength < MAX_PATH) && (0 != GetTempFileNameA(szTempPath, "stl", 0, szFileName)))
+    {
+        // the system deletes the page file when it's closed, also when the application crashes
+        m_hPageFile = CreateFileA(szFileName, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                  FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+        if (INVALID_HANDLE_VALUE != m_hPageFile)
+        {
+            m_u32MaxFrames = static_cast<uint32_t>(std::max<uint64_t>(MinFrames, std::min<uint64_t>(u64ResidentBytes / BlockBytes, 0xFFFF)));
+            logPrint(Debug) << "Paging facets to " << szFileName << ", " << m_u32MaxFrames << " blocks in memory";
+        }
+        else
+        {
+            logPrint(Debug) << "Can't create page file, error " << GetLastError();
+            DeleteFileA(szFileName);
+            retVal = Err::PageFile;
+        }
+    }
+    else
+    {
+        logPrint(Debug) << "Can't get temporary file name, error " << GetLastError();
+        retVal = Err::PageFile;
+    }
+    return retVal;
+}
+
+void CPagedFacets::close()
+{
+    if (INVALID_HANDLE_VALUE != m_hPageFile)
+    {
+        logPrint(Debug) << "Closing page file: " << m_u32PageIns << " blocks read, " << m_u32PageOuts << " blocks written";
+        CloseHandle(m_hPageFile);
+    }
+    m_hPageFile = INVALID_HANDLE_VALUE;
+    m_u32Size = 0;
+    std::vector<Frame>().swap(m_vFrames);
+    std::vector<uint32_t>().swap(m_vBlockFrames);
+    m_u64UseCounter = 0;
+    m_u32PageIns = 0;
+    m_u32PageOuts = 0;
+}
+
+Err CPagedFacets::append(const C3DFacet *pFacets, uint32_t u32Count)
+{
+    Err retVal{Err::NoError};
+
+    while ((Err::NoError == retVal) && (u32Count > 0))
+    {
+        const uint32_t u32BlockPos = m_u32Size % BlockFacets;
+        C3DFacet *pBlock{nullptr};
+        if (0 == u32BlockPos)
+        {
+            // the last block is full; the facets go to a new one
+            uint32_t u32Frame{NoFrame};
+            retVal = getFreeFrame(u32Frame);
+            if (Err::NoError == retVal)
+            {
+                try
+                {
+                    m_vBlockFrames.push_back(u32Frame);
+                    Frame &oFrame = m_vFrames[u32Frame];
+                    oFrame.u32Block = getBlockCount() - 1;
+                    oFrame.u64LastUse = ++m_u64UseCounter;
+                    oFrame.bDirty = true;
+                    pBlock = oFrame.vFacets.data();
+                }
+                catch(...)
+                {
+                    logPrint(Trace) << "Can't allocate memory";
+                    retVal = Err::MemAlloc;
+                }
+            }
+        }
+        else
+        {
+            pBlock = getBlockForWrite(getBlockCount() - 1);
+            if (nullptr == pBlock)
+            {
+                retVal = Err::PageFile;
+            }
+        }
+
+        if (Err::NoError == retVal)
+        {
+            const uint32_t u32Copied = std::min(u32Count, BlockFacets - u32BlockPos);
+            memcpy(&pBlock[u32BlockPos], pFacets, u32Copied * sizeof(C3DFacet));
+            m_u32Size += u32Copied;
+            pFacets += u32Copied;
+            u32Count -= u32Copied;
+        }
+    }
+    return retVal;
+}
+
+uint32_t CPagedFacets::getBlockSize(uint32_t u32Block) const
+{
+    return std::min(BlockFacets, m_u32Size - u32Block * BlockFacets);
+}
+
+const C3DFacet *CPagedFacets::getBlock(uint32_t u32Block) const
+{
+    const C3DFacet *pBlock{nullptr};
+    uint32_t u32Frame{NoFrame};
+    if (Err::NoError == pageIn(u32Block, u32Frame))
+    {
+        pBlock = m_vFrames[u32Frame].vFacets.data();
+    }
+    return pBlock;
+}
+
+C3DFacet *CPagedFacets::getBlockForWrite(uint32_t u32Block)
+{
+    C3DFacet *pBlock{nullptr};
+    uint32_t u32Frame{NoFrame};
+    if (Err::NoError == pageIn(u32Block, u32Frame))
+    {
+        m_vFrames[u32Frame].bDirty = true;
+        pBlock = m_vFrames[u32Frame].vFacets.data();
+    }
+    return pBlock;
+}
+
+Err CPagedFacets::pageIn(uint32_t u32Block, uint32_t &u32Frame) const
+{
+    Err retVal{Err::NoError};
+
+    u32Frame = m_vBlockFrames[u32Block];
+    if (NoFrame == u32Frame)
+    {
+        retVal = getFreeFrame(u32Frame);
+        if (Err::NoError == retVal)
+        {
+            Frame &oFrame = m_vFrames[u32Frame];
+            OVERLAPPED position = getBlockPosition(u32Block);
+            DWORD dwRead{0};
+            if (ReadFile(m_hPageFile, oFrame.vFacets.data(), BlockBytes, &dwRead, &position) && (BlockBytes == dwRead))
+            {
+                oFrame.u32Block = u32Block;
+                oFrame.bDirty = false;
+                m_vBlockFrames[u32Block] = u32Frame;
+                ++m_u32PageIns;
+            }
+            else
+            {
+                logPrint(Trace) << "Can't read block " << u32Block << " from page file, error " << GetLastError();
+                retVal = Err::PageFile;
+            }
+        }
+    }
+
+    if (Err::NoError == retVal)
+    {
+        m_vFrames[u32Frame].u64LastUse = ++m_u64UseCounter;
+    }
+    else
+    {
+        u32Frame = NoFrame;
+    }
+    return retVal;
+}
+
+Err CPagedFacets::getFreeFrame(uint32_t &u32Frame) const
+{
+    Err retVal{Err::NoError};
+
+    u32Frame = NoFrame;
+    if (m_vFrames.size() < m_u32MaxFrames)
+    {
+        try
+        {
+            m_vFrames.emplace_back();
+            m_vFrames.back().vFacets.resize(BlockFacets);
+            u32Frame = static_cast<uint32_t>(m_vFrames.size() - 1);
+        }
+        catch(...)
+        {
+            // the working set is limited by the memory which could be allocated
+            if (!m_vFrames.empty() && m_vFrames.back().vFacets.empty())
+            {
+                m_vFrames.pop_back();
+            }
+            m_u32MaxFrames = static_cast<uint32_t>(m_vFrames.size());
+            logPrint(Debug) << "Can't allocate more blocks; keeping " << m_u32MaxFrames << " blocks in memory";
+        }
+    }
+
+    if (NoFrame == u32Frame)
+    {
+        if (m_vFrames.empty())
+        {
+            logPrint(Trace) << "Can't allocate memory";
+            retVal = Err::MemAlloc;
+        }
+        else
+        {
+            // the least recently used frame is evicted; an unmodified block has a valid copy in the page file already
+            u32Frame = 0;
+            for (uint32_t u32Idx = 1; u32Idx < m_vFrames.size(); ++u32Idx)
+            {
+                if (m_vFrames[u32Idx].u64LastUse < m_vFrames[u32Frame].u64LastUse)
+                {
+                    u32Frame = u32Idx;
+                }
+            }
+            Frame &oFrame = m_vFrames[u32Frame];
+            if (oFrame.bDirty)
+            {
+                OVERLAPPED position = getBlockPosition(oFrame.u32Block);
+                DWORD dwWritten{0};
+                if (WriteFile(m_hPageFile, oFrame.vFacets.data(), BlockBytes, &dwWritten, &position) && (BlockBytes == dwWritten))
+                {
+                    oFrame.bDirty = false;
+                    ++m_u32PageOuts;
+                }
+                else
+                {
+                    logPrint(Trace) << "Can't write block " << oFrame.u32Block << " to page file, error " << GetLastError();
+                    retVal = Err::PageFile;
+                }
+            }
+            if (Err::NoError == retVal)
+            {
+                m_vBlockFrames[oFrame.u32Block] = NoFrame;
+            }
+            else
+            {
+                u32Frame = NoFrame;
+            }
+        }
+    }
+    return retVal;
+}
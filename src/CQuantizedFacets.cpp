@@ -0,0 +1,316 @@
+/**
+ * @file CQuantizedFacets.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#include "CQuantizedFacets.h"
+#include "CLogger.h"
+#include "CThreadPool.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+constexpr uint32_t CQuantizedFacets::PositionLevels;
+constexpr uint32_t CQuantizedFacets::EncodeChunkFacets;
+
+namespace
+{
+    constexpr double DegreesPerRadian = 180.0 / 3.14159265358979323846;
+
+    float getSign(float fValue)
+    {
+        return (fValue < 0.0f)? -1.0f : 1.0f;
+    }
+
+    CVector3d getUnit(const CVector3d &oVector, const CVector3d &oFallback)
+    {
+        CVector3d oUnit{oVector};
+        return (normalizeVector(oUnit))? oUnit : oFallback;
+    }
+
+    float getAngle(const CVector3d &oA, const CVector3d &oB)
+    {
+        // the cosine of small angles is too close to 1 for the floats, so the sine is used too
+        const float fX = oA.m_fY * oB.m_fZ - oA.m_fZ * oB.m_fY;
+        const float fY = oA.m_fZ * oB.m_fX - oA.m_fX * oB.m_fZ;
+        const float fZ = oA.m_fX * oB.m_fY - oA.m_fY * oB.m_fX;
+        const float fDot = oA.m_fX * oB.m_fX + oA.m_fY * oB.m_fY + oA.m_fZ * oB.m_fZ;
+        return static_cast<float>(atan2(sqrt(fX * fX + fY * fY + fZ * fZ), fDot) * DegreesPerRadian);
+    }
+
+    CVector3d decodeOctahedral(uint32_t u32U, uint32_t u32V, uint32_t u32MaxCode)
+    {
+        float fX = static_cast<float>(u32U) / static_cast<float>(u32MaxCode) * 2.0f - 1.0f;
+        float fY = static_cast<float>(u32V) / static_cast<float>(u32MaxCode) * 2.0f - 1.0f;
+        const float fZ = 1.0f - fabsf(fX) - fabsf(fY);
+        if (fZ < 0.0f)
+        {
+            // the lower half of the octahedron is folded over the diagonals of the square
+            const float fFoldedX = (1.0f - fabsf(fY)) * getSign(fX);
+            fY = (1.0f - fabsf(fX)) * getSign(fY);
+            fX = fFoldedX;
+        }
+        return getUnit(CVector3d{fX, fY, fZ}, CVector3d{0.0f, 0.0f, 1.0f});
+    }
+
+    // the errors aren't negative, so their bits are ordered like their values
+    void updateMax(std::atomic<uint32_t> &u32MaxBits, float fValue)
+    {
+        uint32_t u32Bits{0};
+        memcpy(&u32Bits, &fValue, sizeof(u32Bits));
+        uint32_t u32Current = u32MaxBits.load();
+        while ((u32Bits > u32Current) && !u32MaxBits.compare_exchange_weak(u32Current, u32Bits))
+        {
+        }
+    }
+
+    float getMax(const std::atomic<uint32_t> &u32MaxBits)
+    {
+        const uint32_t u32Bits = u32MaxBits.load();
+        float fValue{0.0f};
+        memcpy(&fValue, &u32Bits, sizeof(fValue));
+        return fValue;
+    }
+}
+
+Err CQuantizedFacets::create(uint32_t u32Facets, const CBoundingBox &oBox, uint32_t u32NormalBits)
+{
+    Err retVal{Err::NoError};
+
+    clear();
+    m_u32NormalWords = (16 == u32NormalBits)? 2 : 1;
+    try
+    {
+        m_vPositions.resize(9 * static_cast<size_t>(u32Facets));
+        m_vNormals.resize(m_u32NormalWords * static_cast<size_t>(u32Facets));
+    }
+    catch(...)
+    {
+        logPrint(Debug) << "Can't allocate memory for " << u32Facets << " quantized facets";
+        retVal = Err::MemAlloc;
+    }
+
+    if (Err::NoError == retVal)
+    {
+        m_u32Facets = u32Facets;
+        const float afMin[3] = {oBox.getMin().m_fX, oBox.getMin().m_fY, oBox.getMin().m_fZ};
+        const float afMax[3] = {oBox.getMax().m_fX, oBox.getMax().m_fY, oBox.getMax().m_fZ};
+        for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+        {
+            m_afOrigin[u32Axis] = afMin[u32Axis];
+            m_afStep[u32Axis] = (afMax[u32Axis] - afMin[u32Axis]) / static_cast<float>(PositionLevels);
+        }
+    }
+    else
+    {
+        clear();
+    }
+    return retVal;
+}
+
+void CQuantizedFacets::encode(uint32_t u32First, const C3DFacet *pFacets, uint32_t u32Count)
+{
+    std::atomic<uint32_t> u32PositionError{0};
+    std::atomic<uint32_t> u32NormalError{0};
+    updateMax(u32PositionError, m_fMaxPositionError);
+    updateMax(u32NormalError, m_fMaxNormalError);
+    const uint32_t u32Chunks = (u32Count + EncodeChunkFacets - 1) / EncodeChunkFacets;
+    CThreadPool::getInstance().parallelFor(u32Chunks, [&](uint32_t u32Chunk)
+    {
+        float fPositionError{0.0f};
+        float fNormalError{0.0f};
+        const uint32_t u32ChunkFirst = u32Chunk * EncodeChunkFacets;
+        const uint32_t u32ChunkEnd = std::min(u32ChunkFirst + EncodeChunkFacets, u32Count);
+        for (uint32_t u32Idx = u32ChunkFirst; u32Idx < u32ChunkEnd; ++u32Idx)
+        {
+            const C3DFacet &oFacet = pFacets[u32Idx];
+            uint16_t *pu16Position = &m_vPositions[9 * static_cast<size_t>(u32First + u32Idx)];
+            for (const CVector3d *pPoint : {&oFacet.p1, &oFacet.p2, &oFacet.p3})
+            {
+                const float afCoordinates[3] = {pPoint->m_fX, pPoint->m_fY, pPoint->m_fZ};
+                for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+                {
+                    float fCode{0.0f};
+                    if (m_afStep[u32Axis] > 0.0f)
+                    {
+                        fCode = std::max(0.0f, std::min(static_cast<float>(PositionLevels), roundf((afCoordinates[u32Axis] - m_afOrigin[u32Axis]) / m_afStep[u32Axis])));
+                    }
+                    *pu16Position = static_cast<uint16_t>(fCode);
+                    const float fDecoded = m_afOrigin[u32Axis] + static_cast<float>(*pu16Position) * m_afStep[u32Axis];
+                    fPositionError = std::max(fPositionError, fabsf(fDecoded - afCoordinates[u32Axis]));
+                    ++pu16Position;
+                }
+            }
+
+            // some exporters write zero normals, which are replaced by the normal of the winding
+            const CVector3d oEdge1{oFacet.p2.m_fX - oFacet.p1.m_fX, oFacet.p2.m_fY - oFacet.p1.m_fY, oFacet.p2.m_fZ - oFacet.p1.m_fZ};
+            const CVector3d oEdge2{oFacet.p3.m_fX - oFacet.p1.m_fX, oFacet.p3.m_fY - oFacet.p1.m_fY, oFacet.p3.m_fZ - oFacet.p1.m_fZ};
+            const CVector3d oWinding = getUnit(CVector3d{oEdge1.m_fY * oEdge2.m_fZ - oEdge1.m_fZ * oEdge2.m_fY,
+                                                         oEdge1.m_fZ * oEdge2.m_fX - oEdge1.m_fX * oEdge2.m_fZ,
+                                                         oEdge1.m_fX * oEdge2.m_fY - oEdge1.m_fY * oEdge2.m_fX}, CVector3d{0.0f, 0.0f, 1.0f});
+            const CVector3d oNormal = getUnit(oFacet.normal, oWinding);
+            fNormalError = std::max(fNormalError, encodeNormal(oNormal, &m_vNormals[m_u32NormalWords * static_cast<size_t>(u32First + u32Idx)]));
+        }
+        updateMax(u32PositionError, fPositionError);
+        updateMax(u32NormalError, fNormalError);
+    });
+    m_fMaxPositionError = getMax(u32PositionError);
+    m_fMaxNormalError = getMax(u32NormalError);
+}
+
+void CQuantizedFacets::clear()
+{
+    std::vector<uint16_t>().swap(m_vPositions);
+    std::vector<uint16_t>().swap(m_vNormals);
+    m_u32Facets = 0;
+    m_fMaxPositionError = 0.0f;
+    m_fMaxNormalError = 0.0f;
+}
+
+C3DFacet CQuantizedFacets::getFacet(uint32_t u32Facet) const
+{
+    C3DFacet oFacet;
+    getFacets(u32Facet, 1, &oFacet);
+    return oFacet;
+}
+
+void CQuantizedFacets::getFacets(uint32_t u32First, uint32_t u32Count, C3DFacet *pFacets) const
+{
+    const uint16_t *pu16Position = &m_vPositions[9 * static_cast<size_t>(u32First)];
+    const uint16_t *pu16Normal = &m_vNormals[m_u32NormalWords * static_cast<size_t>(u32First)];
+    for (uint32_t u32Idx = 0; u32Idx < u32Count; ++u32Idx)
+    {
+        C3DFacet &oFacet = pFacets[u32Idx];
+        for (CVector3d *pPoint : {&oFacet.p1, &oFacet.p2, &oFacet.p3})
+        {
+            pPoint->m_fX = m_afOrigin[0] + static_cast<float>(pu16Position[0]) * m_afStep[0];
+            pPoint->m_fY = m_afOrigin[1] + static_cast<float>(pu16Position[1]) * m_afStep[1];
+            pPoint->m_fZ = m_afOrigin[2] + static_cast<float>(pu16Position[2]) * m_afStep[2];
+            pu16Position += 3;
+        }
+        oFacet.normal = decodeNormal(pu16Normal);
+        pu16Normal += m_u32NormalWords;
+    }
+}
+
+void CQuantizedFacets::transform(const CVector3d &oShift, float fScale)
+{
+    const float afShift[3] = {oShift.m_fX, oShift.m_fY, oShift.m_fZ};
+    for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+    {
+        m_afOrigin[u32Axis] = (m_afOrigin[u32Axis] - afShift[u32Axis]) * fScale;
+        m_afStep[u32Axis] *= fScale;
+    }
+    m_fMaxPositionError *= fabsf(fScale);
+}
+
+void CQuantizedFacets::reorient(const float afMatrix[9])
+{
+    // a negated axis keeps its grid, counted from the other end
+    uint32_t au32From[3];
+    bool abNegated[3];
+    const float afOldOrigin[3] = {m_afOrigin[0], m_afOrigin[1], m_afOrigin[2]};
+    const float afOldStep[3] = {m_afStep[0], m_afStep[1], m_afStep[2]};
+    for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+    {
+        const float *pfRow = afMatrix + 3 * u32Axis;
+        au32From[u32Axis] = (fabsf(pfRow[0]) > 0.5f)? 0 : ((fabsf(pfRow[1]) > 0.5f)? 1 : 2);
+        abNegated[u32Axis] = pfRow[au32From[u32Axis]] < 0.0f;
+        const uint32_t u32From = au32From[u32Axis];
+        m_afStep[u32Axis] = afOldStep[u32From];
+        m_afOrigin[u32Axis] = (abNegated[u32Axis])? -(afOldOrigin[u32From] + static_cast<float>(PositionLevels) * afOldStep[u32From]) : afOldOrigin[u32From];
+    }
+
+    std::atomic<uint32_t> u32NormalError{0};
+    const uint32_t u32Chunks = (m_u32Facets + EncodeChunkFacets - 1) / EncodeChunkFacets;
+    CThreadPool::getInstance().parallelFor(u32Chunks, [&](uint32_t u32Chunk)
+    {
+        float fNormalError{0.0f};
+        const uint32_t u32ChunkFirst = u32Chunk * EncodeChunkFacets;
+        const uint32_t u32ChunkEnd = std::min(u32ChunkFirst + EncodeChunkFacets, m_u32Facets);
+        for (uint32_t u32Idx = u32ChunkFirst; u32Idx < u32ChunkEnd; ++u32Idx)
+        {
+            uint16_t *pu16Position = &m_vPositions[9 * static_cast<size_t>(u32Idx)];
+            for (uint32_t u32Point = 0; u32Point < 3; ++u32Point)
+            {
+                const uint16_t au16Old[3] = {pu16Position[0], pu16Position[1], pu16Position[2]};
+                for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+                {
+                    const uint16_t u16Code = au16Old[au32From[u32Axis]];
+                    pu16Position[u32Axis] = (abNegated[u32Axis])? static_cast<uint16_t>(PositionLevels - u16Code) : u16Code;
+                }
+                pu16Position += 3;
+            }
+
+            uint16_t *pu16Normal = &m_vNormals[m_u32NormalWords * static_cast<size_t>(u32Idx)];
+            const CVector3d oOld = decodeNormal(pu16Normal);
+            const float afOld[3] = {oOld.m_fX, oOld.m_fY, oOld.m_fZ};
+            float afNew[3];
+            for (uint32_t u32Axis = 0; u32Axis < 3; ++u32Axis)
+            {
+                afNew[u32Axis] = (abNegated[u32Axis])? -afOld[au32From[u32Axis]] : afOld[au32From[u32Axis]];
+            }
+            fNormalError = std::max(fNormalError, encodeNormal(CVector3d{afNew[0], afNew[1], afNew[2]}, pu16Normal));
+        }
+        updateMax(u32NormalError, fNormalError);
+    });
+    // the normals were encoded twice, so the errors may add up
+    m_fMaxNormalError += getMax(u32NormalError);
+}
+
+float CQuantizedFacets::encodeNormal(const CVector3d &oNormal, uint16_t *pu16Code) const
+{
+    const uint32_t u32MaxCode = (1 == m_u32NormalWords)? 0xFF : 0xFFFF;
+    const float fNorm = fabsf(oNormal.m_fX) + fabsf(oNormal.m_fY) + fabsf(oNormal.m_fZ);
+    float fX = oNormal.m_fX / fNorm;
+    float fY = oNormal.m_fY / fNorm;
+    if (oNormal.m_fZ < 0.0f)
+    {
+        const float fFoldedX = (1.0f - fabsf(fY)) * getSign(fX);
+        fY = (1.0f - fabsf(fX)) * getSign(fY);
+        fX = fFoldedX;
+    }
+    const float fU = (fX * 0.5f + 0.5f) * static_cast<float>(u32MaxCode);
+    const float fV = (fY * 0.5f + 0.5f) * static_cast<float>(u32MaxCode);
+
+    // rounding each coordinate separately isn't always the nearest normal, so all four neighbours are tried
+    float fBestAngle{360.0f};
+    uint32_t u32BestU{0};
+    uint32_t u32BestV{0};
+    for (const float fCandidateU : {floorf(fU), ceilf(fU)})
+    {
+        for (const float fCandidateV : {floorf(fV), ceilf(fV)})
+        {
+            const uint32_t u32U = static_cast<uint32_t>(std::max(0.0f, std::min(static_cast<float>(u32MaxCode), fCandidateU)));
+            const uint32_t u32V = static_cast<uint32_t>(std::max(0.0f, std::min(static_cast<float>(u32MaxCode), fCandidateV)));
+            const CVector3d oDecoded = decodeOctahedral(u32U, u32V, u32MaxCode);
+            const float fAngle = getAngle(oDecoded, oNormal);
+            if (fAngle < fBestAngle)
+            {
+                fBestAngle = fAngle;
+                u32BestU = u32U;
+                u32BestV = u32V;
+            }
+        }
+    }
+
+    if (1 == m_u32NormalWords)
+    {
+        pu16Code[0] = static_cast<uint16_t>(u32BestU | (u32BestV << 8));
+    }
+    else
+    {
+        pu16Code[0] = static_cast<uint16_t>(u32BestU);
+        pu16Code[1] = static_cast<uint16_t>(u32BestV);
+    }
+    return fBestAngle;
+}
+
+CVector3d CQuantizedFacets::decodeNormal(const uint16_t *pu16Code) const
+{
+    return (1 == m_u32NormalWords)? decodeOctahedral(pu16Code[0] & 0xFFu, pu16Code[0] >> 8, 0xFF)
+                                  : decodeOctahedral(pu16Code[0], pu16Code[1], 0xFFFF);
+}
@@ -10,6 +10,16 @@
 #include "CLogger.h"
 #include "CTextOutput.h"
 #include <iomanip>
+#include <algorithm>
+
+// the facets are drawn as an array of vectors: p1, p2, p3 and the normal of each facet
+static_assert(sizeof(C3DFacet) == 4 * sizeof(CVector3d), "C3DFacet must consist of 4 packed vectors");
+
+#ifndef GL_RESCALE_NORMAL
+#define GL_RESCALE_NORMAL 0x803A // OpenGL 1.2; the headers of Windows declare only OpenGL 1.1
+#endif
+
+constexpr uint32_t CRenderer::DrawBatchFacets;
 
 using namespace std::literals::string_literals;
 
@@ -172,7 +182,7 @@ void CRenderer::clearScreen() const
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-Err CRenderer::redrawWindow(const CModel &oModel)
+Err CRenderer::redrawWindow(const CScene &oScene)
 {
     Err retVal{Err::NoError};
 
@@ -191,7 +201,7 @@ Err CRenderer::redrawWindow(const CModel &oModel)
         clearScreen();
         glEnable(GL_DEPTH_TEST);
         glPolygonOffset(1.0f, 2); // used for wireframes; see http://www.cs.rit.edu/~ncs/Courses/570/UserGuide/OpenGLonWin-14.html
-        drawObject(oModel);
+        drawObject(oScene);
 
         // draw 2D part of the screen
         glDisable(GL_DEPTH_TEST);
@@ -200,7 +210,7 @@ Err CRenderer::redrawWindow(const CModel &oModel)
         glOrtho(0, m_iWidth, m_iHeight, 0, 0, 1);
         glMatrixMode(GL_MODELVIEW);
         glLoadIdentity();
-        drawFlatElements(oModel);
+        drawFlatElements(oScene);
 
         // let the FPS counter know that we finished rendering a frame
         m_oFpsCounter.nextFrame();
@@ -220,7 +230,7 @@ Err CRenderer::redrawWindow(const CModel &oModel)
     return retVal;
 }
 
-void CRenderer::drawObject(const CModel &oModel)
+void CRenderer::drawObject(const CScene &oScene)
 {
     switch (m_drawMode)
     {
@@ -243,7 +253,6 @@ void CRenderer::drawObject(const CModel &oModel)
 
             // 2. Add positioned light
             glEnable(GL_LIGHT0); //Enable light #0
-            glEnable(GL_NORMALIZE); //Automatically normalize normals
             // material properties
             GLfloat afAmbient[] = {0.25f, 0.148f, 0.06475f, 1.0f};
             glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, afAmbient);
@@ -267,6 +276,18 @@ void CRenderer::drawObject(const CModel &oModel)
     if (m_bAnime)
         ++m_iFrame;
 
+    // The models are normalized when they are loaded completely. Until then the published parts of the models
+    // are scaled and centered on the fly with the bounding box of the scene, which grows as the facets arrive.
+    const bool bLoading = oScene.isLoading();
+    const CBoundingBox oBox = (bLoading)? oScene.getBoundingBox() : CBoundingBox();
+    if (bLoading && oBox.isValid() && (oBox.getMaxExtent() > 0.0f))
+    {
+        const float fScale = 1.0f / oBox.getMaxExtent();
+        const CVector3d oCenter = oBox.getCenter();
+        glScalef(fScale, fScale, fScale);
+        glTranslatef(-oCenter.m_fX, -oCenter.m_fY, -oCenter.m_fZ);
+    }
+
     switch (m_drawMode)
     {
         case DrawMode::wireframe:
@@ -274,6 +295,7 @@ void CRenderer::drawObject(const CModel &oModel)
             break;
 
         case DrawMode::filledWires:
+            glColor3f(0.3f, 0.3f, 0.3f); // dark gray
             break;
 
         default: // SHADING
@@ -281,42 +303,191 @@ void CRenderer::drawObject(const CModel &oModel)
             break;
     }
 
-    int iFacetNum{0};
-    for (const auto &facet : oModel.getFacets())
+    glShadeModel(GL_FLAT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    for (uint32_t u32Model = 0; u32Model < oScene.getModelCount(); ++u32Model)
+    {
+        const CModel &oModel = oScene.getModel(u32Model);
+        CLockGuard oGuard{oModel.getLock()}; // the model may be modified by the loading thread
+        drawModel(oModel);
+    }
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisable(GL_NORMALIZE);
+    glDisable(GL_RESCALE_NORMAL);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_COLOR_MATERIAL);
+}
+
+void CRenderer::drawModel(const CModel &oModel)
+{
+    // the rotations of the model are applied by OpenGL, so the facets are drawn as they are stored
+    float afTransform[16];
+    oModel.getTransformMatrix(afTransform);
+    glPushMatrix();
+    glMultMatrixf(afTransform);
+    // The repaired normals are unit vectors and the view scales them uniformly, so they are only rescaled
+    // by a factor computed once per frame. The normals read from the file are normalized for every vertex.
+    if (oModel.hasUnitNormals())
+    {
+        glDisable(GL_NORMALIZE);
+        glEnable(GL_RESCALE_NORMAL);
+    }
+    else
     {
-        if (m_u16SkipTriangles)
+        glDisable(GL_RESCALE_NORMAL);
+        glEnable(GL_NORMALIZE);
+    }
+    if (oModel.isPaged())
+    {
+        // The blocks in memory are drawn first, so the blocks loaded at the end of the previous frame
+        // are reused before they are evicted by the blocks read from the page file.
+        const CPagedFacets &oPagedFacets = oModel.getPagedFacets();
+        const uint32_t u32Blocks = oPagedFacets.getBlockCount();
+        std::vector<bool> vDrawn(u32Blocks, false);
+        for (uint32_t u32Block = 0; u32Block < u32Blocks; ++u32Block)
         {
-            ++iFacetNum;
-            if (iFacetNum % m_u16SkipTriangles) continue;
+            if (oPagedFacets.isResident(u32Block))
+            {
+                drawFacets(oPagedFacets.getBlock(u32Block), oPagedFacets.getBlockSize(u32Block));
+                vDrawn[u32Block] = true;
+            }
         }
-        const CVector3d &normal = facet.normal;
-        const CVector3d &p1 = facet.p1;
-        const CVector3d &p2 = facet.p2;
-        const CVector3d &p3 = facet.p3;
-        glBegin(GL_TRIANGLES);
-        glNormal3f(normal.m_fX, normal.m_fY, normal.m_fZ);
-        glVertex3f(p1.m_fX, p1.m_fY, p1.m_fZ);
-        glVertex3f(p2.m_fX, p2.m_fY, p2.m_fZ);
-        glVertex3f(p3.m_fX, p3.m_fY, p3.m_fZ);
-        glEnd();
+        for (uint32_t u32Block = 0; u32Block < u32Blocks; ++u32Block)
+        {
+            if (!vDrawn[u32Block])
+            {
+                const C3DFacet *pFacets = oPagedFacets.getBlock(u32Block);
+                if (nullptr != pFacets)
+                {
+                    drawFacets(pFacets, oPagedFacets.getBlockSize(u32Block));
+                }
+            }
+        }
+    }
+    else if (oModel.isIndexed() && oModel.getIndexedMesh().hasVertexNormals() && (m_u16SkipTriangles <= 1))
+    {
+        // the vertices with their smooth normals are drawn straight from the mesh
+        drawMesh(oModel.getIndexedMesh());
+    }
+    else if (oModel.isIndexed())
+    {
+        // the facets of a welded model are put together batch by batch, which costs time but no memory
+        const CIndexedMesh &oMesh = oModel.getIndexedMesh();
+        const uint32_t u32Triangles = oMesh.getTriangleCount();
+        m_vBatchFacets.resize(DrawBatchFacets);
+        for (uint32_t u32First = 0; u32First < u32Triangles; u32First += DrawBatchFacets)
+        {
+            const uint32_t u32BatchFacets = std::min(DrawBatchFacets, u32Triangles - u32First);
+            for (uint32_t u32Idx = 0; u32Idx < u32BatchFacets; ++u32Idx)
+            {
+                m_vBatchFacets[u32Idx] = oMesh.getFacet(u32First + u32Idx);
+            }
+            drawFacets(m_vBatchFacets.data(), u32BatchFacets);
+        }
+    }
+    else if (oModel.isStreamed())
+    {
+        // the streams are interleaved again batch by batch for the vertex arrays
+        const CFacetStreams &oStreams = oModel.getFacetStreams();
+        const uint32_t u32Facets = oStreams.getFacetCount();
+        m_vBatchFacets.resize(DrawBatchFacets);
+        for (uint32_t u32First = 0; u32First < u32Facets; u32First += DrawBatchFacets)
+        {
+            const uint32_t u32BatchFacets = std::min(DrawBatchFacets, u32Facets - u32First);
+            oStreams.getFacets(u32First, u32BatchFacets, m_vBatchFacets.data());
+            drawFacets(m_vBatchFacets.data(), u32BatchFacets);
+        }
+    }
+    else if (oModel.isQuantized())
+    {
+        // the quantized facets are decoded batch by batch for the vertex arrays
+        const CQuantizedFacets &oQuantized = oModel.getQuantizedFacets();
+        const uint32_t u32Facets = oQuantized.getFacetCount();
+        m_vBatchFacets.resize(DrawBatchFacets);
+        for (uint32_t u32First = 0; u32First < u32Facets; u32First += DrawBatchFacets)
+        {
+            const uint32_t u32BatchFacets = std::min(DrawBatchFacets, u32Facets - u32First);
+            oQuantized.getFacets(u32First, u32BatchFacets, m_vBatchFacets.data());
+            drawFacets(m_vBatchFacets.data(), u32BatchFacets);
+        }
+    }
+    else
+    {
+        // only the facets published by the loader are complete
+        drawFacets(oModel.getFacets().data(), oModel.getPublishedFacets());
+    }
+    // the sample of a big file is drawn until the whole file is loaded
+    const std::vector<C3DFacet> &vPreviewFacets = oModel.getPreviewFacets();
+    drawFacets(vPreviewFacets.data(), static_cast<uint32_t>(vPreviewFacets.size()));
+    glPopMatrix();
+}
+
+void CRenderer::drawFacets(const C3DFacet *pFacets, uint32_t u32Count)
+{
+    // The facets are drawn straight from the storage of the model with vertex arrays. A facet consists of
+    // 4 vectors: p1, p2, p3 and the normal, so the points of facet i are the vertices 4i, 4i+1 and 4i+2 of
+    // an array of vectors. The normal array starts one vector later, so the last vertex of each triangle
+    // gets the normal of the facet, and with flat shading the whole triangle is lit with it.
+    updateFacetIndices();
+    const uint32_t u32Step = (m_u16SkipTriangles)? m_u16SkipTriangles : 1;
+    for (uint32_t u32First = 0; u32First < u32Count; u32First += DrawBatchFacets)
+    {
+        const uint32_t u32BatchFacets = std::min(DrawBatchFacets, u32Count - u32First);
+        const GLsizei iIndices = static_cast<GLsizei>(3 * (u32BatchFacets / u32Step));
+        const CVector3d *pVectors = &pFacets[u32First].p1;
+        glVertexPointer(3, GL_FLOAT, sizeof(CVector3d), pVectors);
+        glNormalPointer(GL_FLOAT, sizeof(CVector3d), pVectors + 1);
+        glDrawElements(GL_TRIANGLES, iIndices, GL_UNSIGNED_SHORT, m_vFacetIndices.data());
         if (DrawMode::filledWires == m_drawMode)
         {
             glColor3f(0.9f, 0.9f, 0.5f); // pale yellow
-            glBegin(GL_LINE_LOOP);
-            glVertex3f(p1.m_fX, p1.m_fY, p1.m_fZ);
-            glVertex3f(p2.m_fX, p2.m_fY, p2.m_fZ);
-            glVertex3f(p3.m_fX, p3.m_fY, p3.m_fZ);
-            glEnd();
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            glDrawElements(GL_TRIANGLES, iIndices, GL_UNSIGNED_SHORT, m_vFacetIndices.data());
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
             glColor3f(0.3f, 0.3f, 0.3f); // dark gray
         }
     }
+}
 
-    glDisable(GL_POLYGON_OFFSET_FILL);
-    glDisable(GL_LIGHTING);
-    glDisable(GL_COLOR_MATERIAL);
+void CRenderer::drawMesh(const CIndexedMesh &oMesh)
+{
+    const GLsizei iIndices = static_cast<GLsizei>(oMesh.getIndices().size());
+    glShadeModel(GL_SMOOTH);
+    glVertexPointer(3, GL_FLOAT, sizeof(CVector3d), oMesh.getVertices().data());
+    glNormalPointer(GL_FLOAT, sizeof(CVector3d), oMesh.getNormals().data());
+    glDrawElements(GL_TRIANGLES, iIndices, GL_UNSIGNED_INT, oMesh.getIndices().data());
+    if (DrawMode::filledWires == m_drawMode)
+    {
+        glColor3f(0.9f, 0.9f, 0.5f); // pale yellow
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        glDrawElements(GL_TRIANGLES, iIndices, GL_UNSIGNED_INT, oMesh.getIndices().data());
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glColor3f(0.3f, 0.3f, 0.3f); // dark gray
+    }
+    glShadeModel(GL_FLAT);
 }
 
-void CRenderer::drawFlatElements(const CModel &oModel)
+void CRenderer::updateFacetIndices()
+{
+    if (m_vFacetIndices.empty() || (m_u16IndicesSkip != m_u16SkipTriangles))
+    {
+        // every m_u16SkipTriangles-th facet of a batch is drawn; the batch size is a multiple of all skip values
+        const uint32_t u32Step = (m_u16SkipTriangles)? m_u16SkipTriangles : 1;
+        m_vFacetIndices.clear();
+        for (uint32_t u32Facet = u32Step - 1; u32Facet < DrawBatchFacets; u32Facet += u32Step)
+        {
+            m_vFacetIndices.push_back(static_cast<uint16_t>(4*u32Facet));
+            m_vFacetIndices.push_back(static_cast<uint16_t>(4*u32Facet + 1));
+            m_vFacetIndices.push_back(static_cast<uint16_t>(4*u32Facet + 2));
+        }
+        m_u16IndicesSkip = m_u16SkipTriangles;
+    }
+}
+
+void CRenderer::drawFlatElements(const CScene &oScene)
 {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -337,12 +508,30 @@ void CRenderer::drawFlatElements(const CModel &oModel)
     std::stringstream stream;
     stream << std::fixed << std::setprecision(2) << m_oFpsCounter.getFps() << " FPS";
     to.printLn(stream.str());
-    to.printLn("Name:"s + oModel.getModelName());
-    to.printLn(std::to_string(oModel.getFacets().size()) + " polygons");
+    to.printLn("Name:"s + oScene.getName());
+    to.printLn(std::to_string(oScene.getPublishedFacets()) + " polygons");
     stream.str(std::string());
     stream << "Display mode: "s << m_drawMode;
     to.printLn(stream.str());
-    to.printLn("");
+    if (oScene.isLoading())
+    {
+        // progress bar under the menu box
+        const float fProgress = std::min(std::max(oScene.getLoadProgress(), 0.0f), 1.0f);
+        glBegin(GL_QUADS);
+        glColor3f(0.0f, 0.5f, 0.5f);
+        glVertex2d(0, 222);
+        glVertex2d(200.0f * fProgress, 222);
+        glVertex2d(200.0f * fProgress, 230);
+        glVertex2d(0, 230);
+        glEnd();
+        stream.str(std::string());
+        stream << "Loading: " << static_cast<int>(100.0f * fProgress) << "%";
+        to.printLn(stream.str());
+    }
+    else
+    {
+        to.printLn("");
+    }
     to.printLn("Menu:");
     to.printLn("Esc - Exit");
     to.printLn("LMB - rotate in XY axes");
@@ -355,6 +544,87 @@ void CRenderer::drawFlatElements(const CModel &oModel)
     to.printLn("s - skip displaying some polygons");
     to.printLn("     to navigate faster");
     to.printLn("x,y,z - rotate model");
+    to.printLn("i - show load statistics");
+    if (m_bShowLoadStats && !oScene.isLoading())
+    {
+        drawLoadStats(oScene);
+    }
+}
+
+void CRenderer::drawLoadStats(const CScene &oScene)
+{
+    constexpr int iTop{234};
+    constexpr int iLines{13};
+    constexpr int iLineHeight{12};
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBegin(GL_QUADS);
+    glColor4f(0.0f, 0.5f, 0.5f, 0.3f);
+    glVertex2d(0, iTop);
+    glVertex2d(200, iTop);
+    glVertex2d(200, iTop + iLines*iLineHeight + 4);
+    glVertex2d(0, iTop + iLines*iLineHeight + 4);
+    glEnd();
+    glDisable(GL_BLEND);
+    glColor3f(0.0f, 0.5f, 0.5f);
+    CTextOutput to(m_iWidth, m_iHeight);
+    to.setFont(5);
+    to.setCursorPos(0, iTop);
+    to.setSpacing(0);
+
+    std::stringstream stream;
+    stream << std::fixed << std::setprecision(2);
+    to.printLn("Load statistics:");
+    to.printLn("Format: "s + (m_oLoadStats.bCached? "mesh cache"s : (m_oLoadStats.bBinary? "binary"s : "ASCII"s))
+               + (m_oLoadStats.bCompressed? ", compressed"s : ""s) + (m_oLoadStats.bPiped? ", piped"s : ""s)
+               + (m_oLoadStats.bPaged? ", paged"s : ""s));
+    stream << "File: " << (static_cast<double>(m_oLoadStats.u64FileSize) / 1000000.0) << " MB";
+    to.printLn(stream.str());
+    stream.str(std::string());
+    stream << "Decoded: " << (static_cast<double>(m_oLoadStats.u64BytesDecoded) / 1000000.0) << " MB";
+    to.printLn(stream.str());
+    to.printLn("Facets: "s + std::to_string(m_oLoadStats.u32Facets));
+    stream.str(std::string());
+    stream << "Detect: " << m_oLoadStats.dDetectMs << " ms";
+    to.printLn(stream.str());
+    stream.str(std::string());
+    stream << "Preview: " << m_oLoadStats.dPreviewMs << " ms";
+    to.printLn(stream.str());
+    stream.str(std::string());
+    stream << "Allocate: " << m_oLoadStats.dAllocateMs << " ms";
+    to.printLn(stream.str());
+    stream.str(std::string());
+    stream << "Decode: " << m_oLoadStats.dDecodeMs << " ms";
+    to.printLn(stream.str());
+    stream.str(std::string());
+    stream << "Total: " << m_oLoadStats.dTotalMs << " ms";
+    to.printLn(stream.str());
+    to.printLn("Threads: "s + std::to_string(m_oLoadStats.u32Threads));
+    stream.str(std::string());
+    stream << "Speed: " << m_oLoadStats.getThroughput() << " MB/s";
+    to.printLn(stream.str());
+
+    // the errors are in the normalized coordinates, where the model is 1 unit large
+    bool bQuantized{false};
+    float fPositionError{0.0f};
+    float fNormalError{0.0f};
+    for (uint32_t u32Model = 0; u32Model < oScene.getModelCount(); ++u32Model)
+    {
+        const CModel &oModel = oScene.getModel(u32Model);
+        CLockGuard oGuard{oModel.getLock()};
+        if (oModel.isQuantized())
+        {
+            bQuantized = true;
+            fPositionError = std::max(fPositionError, oModel.getQuantizedFacets().getMaxPositionError());
+            fNormalError = std::max(fNormalError, oModel.getQuantizedFacets().getMaxNormalError());
+        }
+    }
+    stream.str(std::string());
+    if (bQuantized)
+    {
+        stream << std::scientific << std::setprecision(1) << "Quant. error: " << fPositionError << ", " << std::fixed << fNormalError << " deg";
+    }
+    to.printLn(stream.str());
 }
 
 void CRenderer::resetViewState()
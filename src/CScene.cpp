@@ -0,0 +1,309 @@
+/**
+ * @file CScene.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#include "CScene.h"
+#include "CLogger.h"
+#include "CStlLoader.h"
+#include "CThreadPool.h"
+#include "CStopwatch.h"
+#include <algorithm>
+
+void CScene::expandFileNames(const std::vector<std::string> &vPatterns, std::vector<std::string> &vFileNames)
+{
+    vFileNames.clear();
+    for (const auto &sPattern : vPatterns)
+    {
+        std::vector<std::string> vMatches;
+        if (std::string::npos != sPattern.find_first_of("*?"))
+        {
+            // the names found are relative to the directory of the pattern
+            const size_t dirEnd = sPattern.find_last_of("\\/:");
+            const std::string sDirectory = (std::string::npos != dirEnd)? sPattern.substr(0, dirEnd + 1) : std::string();
+            WIN32_FIND_DATAA findData{};
+            HANDLE hFind = FindFirstFileA(sPattern.c_str(), &findData);
+            if (INVALID_HANDLE_VALUE != hFind)
+            {
+                do
+                {
+                    if (0 == (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+                    {
+                        vMatches.push_back(sDirectory + findData.cFileName);
+                    }
+                } while (FindNextFileA(hFind, &findData));
+                FindClose(hFind);
+            }
+            std::sort(vMatches.begin(), vMatches.end());
+            logPrint(Debug) << "\"" << sPattern << "\" matches " << vMatches.size() << " file(s)";
+        }
+        if (vMatches.empty())
+        {
+            vMatches.push_back(sPattern);
+        }
+        vFileNames.insert(vFileNames.end(), vMatches.begin(), vMatches.end());
+    }
+}
+
+CScene::~CScene()
+{
+    clear();
+    if (nullptr != m_hCancelEvent)
+    {
+        CloseHandle(m_hCancelEvent);
+    }
+}
+
+void CScene::clear()
+{
+    if (nullptr != m_hThread)
+    {
+        m_bCancelled = true;
+        if (nullptr != m_hCancelEvent)
+        {
+            SetEvent(m_hCancelEvent);
+        }
+        WaitForSingleObject(m_hThread, INFINITE);
+        CloseHandle(m_hThread);
+        m_hThread = nullptr;
+    }
+    if (nullptr != m_hCancelEvent)
+    {
+        ResetEvent(m_hCancelEvent);
+    }
+    m_vModels.clear();
+    m_vFileNames.clear();
+    m_vResults.clear();
+    m_stats = CLoadStats();
+    m_loadedCallback = nullptr;
+    m_bCancelled = false;
+}
+
+CModel &CScene::addModel()
+{
+    m_vModels.emplace_back(new CModel());
+    return *m_vModels.back();
+}
+
+Err CScene::startLoading(const std::vector<std::string> &vFileNames, const LoadedCallback &loadedCallback)
+{
+    Err retVal{Err::NoError};
+
+    logPrint(Debug) << "Loading " << vFileNames.size() << " files";
+    clear();
+    try
+    {
+        m_vFileNames = vFileNames;
+        m_loadedCallback = loadedCallback;
+        m_vResults.assign(vFileNames.size(), Err::LoadCancelled);
+        for (size_t idx = 0; idx < vFileNames.size(); ++idx)
+        {
+            addModel().setLoading(true);
+        }
+    }
+    catch(...)
+    {
+        logPrint(Trace) << "Can't allocate memory";
+        retVal = Err::MemAlloc;
+    }
+
+    if (Err::NoError == retVal)
+    {
+        if (nullptr == m_hCancelEvent)
+        {
+            m_hCancelEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        }
+        m_hThread = CreateThread(nullptr, 0, loadThread, this, 0, nullptr);
+        if (nullptr == m_hThread)
+        {
+            logPrint(Warning) << "Can't create loading thread, error " << GetLastError();
+            retVal = Err::CantCreateThread;
+        }
+    }
+
+    if (Err::NoError != retVal)
+    {
+        clear();
+    }
+    return retVal;
+}
+
+bool CScene::isDone() const
+{
+    return (nullptr == m_hThread) || (WAIT_OBJECT_0 == WaitForSingleObject(m_hThread, 0));
+}
+
+Err CScene::finishLoading()
+{
+    Err retVal{Err::NoError};
+
+    if (nullptr != m_hThread)
+    {
+        WaitForSingleObject(m_hThread, INFINITE);
+        CloseHandle(m_hThread);
+        m_hThread = nullptr;
+    }
+    for (size_t idx = 0; idx < m_vResults.size(); ++idx)
+    {
+        if (Err::NoError != m_vResults[idx])
+        {
+            logPrint(Warning) << "Can't load \"" << m_vFileNames[idx] << "\": " << m_vResults[idx];
+            if (Err::NoError == retVal)
+            {
+                retVal = m_vResults[idx];
+            }
+        }
+    }
+    return retVal;
+}
+
+DWORD WINAPI CScene::loadThread(LPVOID pParam)
+{
+    CScene &oScene = *static_cast<CScene*>(pParam);
+
+    // The files are distributed dynamically among the threads of the pool, so a big file doesn't hold up the
+    // small ones. The loader of an ASCII file starts its own parallel loop, which the idle threads join.
+    const CStopwatch oTotalTime;
+    CThreadPool &oPool = CThreadPool::getInstance();
+    oPool.parallelFor(oScene.getModelCount(), [&oScene](uint32_t u32Model) { oScene.loadModel(u32Model); });
+    {
+        CLockGuard oGuard{oScene.m_oLock};
+        oScene.m_stats.u32Threads = oPool.getThreadCount();
+        oScene.m_stats.dTotalMs = oTotalTime.getMilliseconds();
+    }
+
+    // all loading threads are finished, so the results are read without the lock
+    const bool bLoaded = std::any_of(oScene.m_vResults.begin(), oScene.m_vResults.end(), [](Err result) { return Err::NoError == result; });
+    if (bLoaded && !oScene.m_bCancelled && oScene.m_loadedCallback)
+    {
+        oScene.m_loadedCallback(oScene);
+    }
+    return 0;
+}
+
+void CScene::loadModel(uint32_t u32Model)
+{
+    if (!m_bCancelled)
+    {
+        // the models of a scene are normalized together, so the models normalized alone can't come from the cache
+        // a big file stops at the next batch when the scene is cleared; the model stays in the loading state
+        // until the whole scene is normalized (see CApp::finishBatchLoading())
+        CStlLoader oLoader;
+        oLoader.enableMeshCache(false);
+        oLoader.setCancelFlag(&m_bCancelled, m_hCancelEvent);
+        CModel &oModel = *m_vModels[u32Model];
+        const Err result = oLoader.loadFile(m_vFileNames[u32Model], oModel);
+        const CLoadStats &oStats = oLoader.getStats();
+        if (Err::NoError != result)
+        {
+            // the facets of a broken file aren't shown
+            oModel.clear();
+        }
+
+        CLockGuard oGuard{m_oLock};
+        m_vResults[u32Model] = result;
+        m_stats.u64FileSize += oStats.u64FileSize;
+        m_stats.u64BytesRead += oStats.u64BytesRead;
+        m_stats.u64BytesDecoded += oStats.u64BytesDecoded;
+        m_stats.u32Facets += oStats.u32Facets;
+        m_stats.bBinary = m_stats.bBinary || oStats.bBinary;
+        m_stats.bCompressed = m_stats.bCompressed || oStats.bCompressed;
+        m_stats.bPaged = m_stats.bPaged || oStats.bPaged;
+        m_stats.dDetectMs += oStats.dDetectMs;
+        m_stats.dAllocateMs += oStats.dAllocateMs;
+        m_stats.dDecodeMs += oStats.dDecodeMs;
+    }
+}
+
+std::string CScene::getName() const
+{
+    std::string sName;
+    if (1 == getModelCount())
+    {
+        sName = m_vModels.front()->getModelName();
+    }
+    else
+    {
+        sName = std::to_string(getModelCount()) + " models";
+    }
+    return sName;
+}
+
+uint32_t CScene::getPublishedFacets() const
+{
+    uint32_t u32Facets{0};
+    for (const auto &pModel : m_vModels)
+    {
+        u32Facets += pModel->getPublishedFacets();
+    }
+    return u32Facets;
+}
+
+CBoundingBox CScene::getBoundingBox() const
+{
+    CBoundingBox oBox;
+    for (const auto &pModel : m_vModels)
+    {
+        CLockGuard oGuard{pModel->getLock()};
+        oBox.add(pModel->getBoundingBox());
+    }
+    return oBox;
+}
+
+void CScene::setLoading(bool bLoading)
+{
+    for (const auto &pModel : m_vModels)
+    {
+        pModel->setLoading(bLoading);
+    }
+}
+
+bool CScene::isLoading() const
+{
+    return std::any_of(m_vModels.begin(), m_vModels.end(), [](const std::unique_ptr<CModel> &pModel) { return pModel->isLoading(); });
+}
+
+float CScene::getLoadProgress() const
+{
+    float fProgress{0.0f};
+    for (const auto &pModel : m_vModels)
+    {
+        fProgress += pModel->getLoadProgress();
+    }
+    return (m_vModels.empty())? 0.0f : (fProgress / static_cast<float>(m_vModels.size()));
+}
+
+void CScene::normalize()
+{
+    const CBoundingBox oBox = getBoundingBox();
+    for (const auto &pModel : m_vModels)
+    {
+        pModel->normalizeModel(oBox);
+    }
+}
+
+void CScene::rotateX()
+{
+    for (const auto &pModel : m_vModels)
+    {
+        pModel->rotateX();
+    }
+}
+
+void CScene::rotateY()
+{
+    for (const auto &pModel : m_vModels)
+    {
+        pModel->rotateY();
+    }
+}
+
+void CScene::rotateZ()
+{
+    for (const auto &pModel : m_vModels)
+    {
+        pModel->rotateZ();
+    }
+}
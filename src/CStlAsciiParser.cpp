@@ -0,0 +1,472 @@
+/**
+ * @file CStlAsciiParser.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#include "CStlAsciiParser.h"
+#include "CLogger.h"
+#include <string.h>
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+#include <locale.h>
+#include <algorithm>
+#include <string>
+#include <initializer_list>
+
+// Parse errors are logged only if the parser knows the line numbers of the file (see setErrorLog()).
+#define parserLog(level) if (m_bErrorLog) logPrint(level)
+
+namespace
+{
+    bool isDigit(char c) { return static_cast<unsigned>(c - '0') < 10u; }
+    bool isBlank(char c) { return (' ' == c) || ('\t' == c); }
+
+    const char *skipBlanks(const char *p, const char *pEnd)
+    {
+        while ((p < pEnd) && isBlank(*p))
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    const char *skipToken(const char *p, const char *pEnd)
+    {
+        while ((p < pEnd) && !isBlank(*p))
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    bool convertFloat(const char *pBegin, const char *pEnd, float &fNumber)
+    {
+        // strtof needs a terminated string and the decimal point of the current locale, so a copy of the number is converted
+        bool bRetVal{false};
+        try
+        {
+            std::string sNumber(pBegin, pEnd);
+            std::replace(sNumber.begin(), sNumber.end(), '.', *localeconv()->decimal_point);
+            char *pNumberEnd{nullptr};
+            const float fValue = strtof(sNumber.c_str(), &pNumberEnd);
+            if ((sNumber.c_str() + sNumber.size() == pNumberEnd) && std::isfinite(fValue)) // an underflow isn't an error
+            {
+                fNumber = fValue;
+                bRetVal = true;
+            }
+        }
+        catch(...)
+        {
+            logPrint(Trace) << "Can't allocate memory";
+        }
+        return bRetVal;
+    }
+}
+
+CStlAsciiParser::CStlAsciiParser(const char *pBegin, const char *pEnd, bool bLastBlock, uint32_t u32LineNo)
+    : m_pPos{pBegin}, m_pEnd{pEnd}, m_pLineBegin{pBegin}, m_pLineEnd{pBegin}, m_bLastBlock{bLastBlock},
+      m_bNeedMoreData{false}, m_bEndSolid{false}, m_bErrorLog{true}, m_u32LineNo{u32LineNo}
+{
+}
+
+Err CStlAsciiParser::parseHeader(std::string &sModelName)
+{
+    Err retVal{Err::NoError};
+
+    if (nextLine())
+    {
+        // the keyword must start at the first column and be followed by a space
+        static const char szKeyword[] = "solid ";
+        const size_t keywordLength = sizeof(szKeyword) - 1;
+        bool bFound = (static_cast<size_t>(m_pLineEnd - m_pLineBegin) >= keywordLength);
+        for (size_t i = 0; bFound && (i < keywordLength); ++i)
+        {
+            bFound = ((m_pLineBegin[i] | 0x20) == szKeyword[i]); // setting the bit 0x20 converts an upper case letter to lower case
+        }
+        if (bFound)
+        {
+            sModelName.assign(m_pLineBegin + keywordLength, m_pLineEnd);
+            strToLower(sModelName);
+        }
+        else
+        {
+            parserLog(Trace) << "Line:" << m_u32LineNo << " 'solid ' expected";
+            retVal = Err::StlSolidExpected; // wrong first line; "solid ....." expected
+        }
+    }
+    else
+    {
+        parserLog(Trace) << "Line:" << (m_u32LineNo + 1) << " Can't read file";
+        retVal = Err::StlGetline5; // can't read first line of the file
+    }
+    return retVal;
+}
+
+Err CStlAsciiParser::parseFacets(std::vector<C3DFacet> &vFacets)
+{
+    Err retVal{Err::NoError};
+
+    while ((Err::NoError == retVal) && !m_bEndSolid && !m_bNeedMoreData)
+    {
+        const char *pFacetBegin = m_pPos;
+        const uint32_t u32FacetLineNo = m_u32LineNo;
+        if (nextLine())
+        {
+            const char *pPos{nullptr};
+            if (matchKeyword("endsolid", pPos))
+            {
+                m_bEndSolid = true;
+            }
+            else
+            {
+                C3DFacet facet;
+                retVal = parseFacet(facet);
+                if (Err::NoError == retVal)
+                {
+                    try
+                    {
+                        vFacets.push_back(facet);
+                    }
+                    catch(...)
+                    {
+                        logPrint(Trace) << "Can't allocate memory";
+                        retVal = Err::MemAlloc;
+                    }
+                }
+                else if (m_bNeedMoreData)
+                {
+                    // the facet continues in the next block; it will be parsed again from its first line
+                    m_pPos = pFacetBegin;
+                    m_u32LineNo = u32FacetLineNo;
+                    retVal = Err::NoError;
+                }
+            }
+        }
+        else if (!m_bNeedMoreData)
+        {
+            parserLog(Trace) << "Line:" << (m_u32LineNo + 1) << " Can't read file";
+            retVal = Err::StlGetline4; // the file ended before "endsolid"
+        }
+    }
+    return retVal;
+}
+
+bool CStlAsciiParser::parseFloat(const char *pBegin, const char *pEnd, float &fNumber)
+{
+    // powers of 10 which are exactly representable as double
+    static const double adPow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    constexpr int MaxExactPow10 = 22;
+    constexpr uint64_t MantissaLimit = 100000000000000000ULL; // more digits would overflow uint64_t
+    constexpr uint64_t MaxExactMantissa = 1ULL << DBL_MANT_DIG; // bigger integers aren't exactly representable as double
+
+    bool bRetVal{false};
+    const char *p = pBegin;
+    bool bNegative{false};
+    if ((p < pEnd) && (('-' == *p) || ('+' == *p)))
+    {
+        bNegative = ('-' == *p);
+        ++p;
+    }
+
+    // the significant digits are collected in an integer, the position of the decimal point in the exponent
+    uint64_t u64Mantissa{0};
+    int iExponent{0};
+    bool bDigits{false};
+    bool bExact{true}; // false if a non-zero digit was dropped
+    for (; (p < pEnd) && isDigit(*p); ++p)
+    {
+        bDigits = true;
+        if (u64Mantissa < MantissaLimit)
+        {
+            u64Mantissa = u64Mantissa * 10 + static_cast<uint64_t>(*p - '0');
+        }
+        else
+        {
+            ++iExponent; // digits beyond the precision only scale the number
+            bExact = bExact && ('0' == *p);
+        }
+    }
+    if ((p < pEnd) && ('.' == *p))
+    {
+        for (++p; (p < pEnd) && isDigit(*p); ++p)
+        {
+            bDigits = true;
+            if (u64Mantissa < MantissaLimit)
+            {
+                u64Mantissa = u64Mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                --iExponent;
+            }
+            else
+            {
+                bExact = bExact && ('0' == *p);
+            }
+        }
+    }
+    if (bDigits && (p < pEnd) && (('e' == *p) || ('E' == *p)))
+    {
+        ++p;
+        bool bNegativeExponent{false};
+        if ((p < pEnd) && (('-' == *p) || ('+' == *p)))
+        {
+            bNegativeExponent = ('-' == *p);
+            ++p;
+        }
+        bDigits = false; // the exponent needs at least one digit
+        int iExplicitExponent{0};
+        for (; (p < pEnd) && isDigit(*p); ++p)
+        {
+            bDigits = true;
+            if (iExplicitExponent < 10000)
+            {
+                iExplicitExponent = iExplicitExponent * 10 + (*p - '0');
+            }
+        }
+        iExponent += (bNegativeExponent)? -iExplicitExponent : iExplicitExponent;
+    }
+
+    if (bDigits && (p == pEnd))
+    {
+        if (0 == u64Mantissa)
+        {
+            fNumber = (bNegative)? -0.0f : 0.0f;
+            bRetVal = true;
+        }
+        else if (bExact && (u64Mantissa <= MaxExactMantissa) && (iExponent >= -MaxExactPow10) && (iExponent <= MaxExactPow10))
+        {
+            // The mantissa and the power of 10 are exact, so a single multiplication or division gives the number
+            // with an error below 1 ulp of double. Rounding it to float gives the correctly rounded float unless
+            // the number is (next to) the midpoint of two floats, i.e. the 29 bits dropped by the rounding are
+            // 0x10000000 +/- 1. Subnormal floats have fewer bits, so they aren't converted here either.
+            const double dNumber = (iExponent >= 0)? (static_cast<double>(u64Mantissa) * adPow10[iExponent])
+                                                   : (static_cast<double>(u64Mantissa) / adPow10[-iExponent]);
+            uint64_t u64Bits{0};
+            memcpy(&u64Bits, &dNumber, sizeof(u64Bits));
+            const uint32_t u32DroppedBits = static_cast<uint32_t>(u64Bits) & 0x1FFFFFFFu;
+            if ((dNumber >= FLT_MIN) && (dNumber <= FLT_MAX) && (u32DroppedBits - 0x0FFFFFFFu > 2u))
+            {
+                fNumber = static_cast<float>((bNegative)? -dNumber : dNumber);
+                bRetVal = true;
+            }
+        }
+
+        if (!bRetVal && (0 != u64Mantissa))
+        {
+            // too many digits, a big exponent or a rounding which may be wrong; strtof rounds correctly
+            bRetVal = convertFloat(pBegin, pEnd, fNumber);
+        }
+    }
+    return bRetVal;
+}
+
+bool CStlAsciiParser::nextLine()
+{
+    bool bRetVal{false};
+
+    if (m_pPos < m_pEnd)
+    {
+        const char *pNewLine = static_cast<const char*>(memchr(m_pPos, '\n', static_cast<size_t>(m_pEnd - m_pPos)));
+        if (pNewLine || m_bLastBlock) // the last line of the file doesn't need to be terminated
+        {
+            m_pLineBegin = m_pPos;
+            m_pLineEnd = (pNewLine)? pNewLine : m_pEnd;
+            m_pPos = (pNewLine)? (pNewLine + 1) : m_pEnd;
+            if ((m_pLineEnd > m_pLineBegin) && ('\r' == m_pLineEnd[-1]))
+            {
+                --m_pLineEnd;
+            }
+            ++m_u32LineNo;
+            bRetVal = true;
+        }
+        else
+        {
+            m_bNeedMoreData = true;
+        }
+    }
+    else if (!m_bLastBlock)
+    {
+        m_bNeedMoreData = true;
+    }
+    return bRetVal;
+}
+
+bool CStlAsciiParser::matchKeyword(const char *szKeyword, const char *&pPos) const
+{
+    const char *p = skipBlanks(m_pLineBegin, m_pLineEnd); // indentation is allowed
+    for (; '\0' != *szKeyword; ++szKeyword)
+    {
+        if (' ' == *szKeyword)
+        {
+            if ((p == m_pLineEnd) || !isBlank(*p))
+            {
+                break;
+            }
+            p = skipBlanks(p, m_pLineEnd);
+        }
+        else
+        {
+            // setting the bit 0x20 converts an upper case letter to lower case
+            if ((p == m_pLineEnd) || ((*p | 0x20) != *szKeyword))
+            {
+                break;
+            }
+            ++p;
+        }
+    }
+    pPos = p;
+    return '\0' == *szKeyword;
+}
+
+Err CStlAsciiParser::readLineAndCheck(const char *szExpected)
+{
+    Err retVal{Err::NoError};
+
+    if (nextLine())
+    {
+        const char *pPos{nullptr};
+        if (!matchKeyword(szExpected, pPos))
+        {
+            parserLog(Error) << "Line:" << m_u32LineNo << " '" << szExpected << "' expected";
+            retVal = Err::StlAscUnexpected;
+        }
+    }
+    else
+    {
+        if (!m_bNeedMoreData)
+        {
+            parserLog(Trace) << "Line:" << (m_u32LineNo + 1) << " Can't read file";
+        }
+        retVal = Err::StlGetline;
+    }
+    return retVal;
+}
+
+Err CStlAsciiParser::parseFacet(C3DFacet &facet)
+{
+    Err retVal{Err::NoError};
+
+    retVal = parseVertex("facet normal ", facet.normal); // expected text: "facet normal ....."
+    if (Err::NoError == retVal)
+    {
+        retVal = readLineAndCheck("outer loop"); // read expected text: "outer loop"
+        for (CVector3d *pVertex: {&facet.p1, &facet.p2, &facet.p3})
+        {
+            if (Err::NoError == retVal)
+            {
+                if (nextLine())
+                {
+                    retVal = parseVertex("vertex ", *pVertex); // read "vertex ...."
+                }
+                else
+                {
+                    if (!m_bNeedMoreData)
+                    {
+                        parserLog(Trace) << "Line:" << (m_u32LineNo + 1) << " Can't read file";
+                    }
+                    retVal = Err::StlVertGetline;
+                }
+            }
+        }
+        if (Err::NoError == retVal)
+        {
+            retVal = readLineAndCheck("endloop"); // read expected text: "endloop"
+        }
+        if (Err::NoError == retVal)
+        {
+            retVal = readLineAndCheck("endfacet"); // look for: "endfacet" in file
+        }
+    }
+    return retVal;
+}
+
+Err CStlAsciiParser::parseVertex(const char *szHeader, CVector3d &oVertex) const
+{
+    // converts a text line of format: "<header> <float> <float> <float>" to a 3D vertex
+    Err retVal{Err::NoError};
+
+    const char *pNumber1Begin{nullptr};
+    if (matchKeyword(szHeader, pNumber1Begin))
+    {
+        if (pNumber1Begin != m_pLineEnd)
+        {
+            const char *pNumber1End = skipToken(pNumber1Begin, m_pLineEnd);
+            if (pNumber1End != m_pLineEnd)
+            {
+                const char *pNumber2Begin = skipBlanks(pNumber1End, m_pLineEnd);
+                if (pNumber2Begin != m_pLineEnd)
+                {
+                    const char *pNumber2End = skipToken(pNumber2Begin, m_pLineEnd);
+                    if (pNumber2End != m_pLineEnd)
+                    {
+                        const char *pNumber3Begin = skipBlanks(pNumber2End, m_pLineEnd);
+                        if (pNumber3Begin != m_pLineEnd)
+                        {
+                            const char *pNumber3End = skipToken(pNumber3Begin, m_pLineEnd);
+                            if (skipBlanks(pNumber3End, m_pLineEnd) != m_pLineEnd)
+                            {
+                                pNumber3End = m_pLineEnd; // anything following the third number makes it invalid
+                            }
+
+                            // now convert strings to floats
+                            if (parseFloat(pNumber1Begin, pNumber1End, oVertex.m_fX))
+                            {
+                                if (parseFloat(pNumber2Begin, pNumber2End, oVertex.m_fY))
+                                {
+                                    if (!parseFloat(pNumber3Begin, pNumber3End, oVertex.m_fZ))
+                                    {
+                                        parserLog(Trace) << "Line:" << m_u32LineNo << " third argument after '" << szHeader << "' conversion to 'float' error";
+                                        retVal = Err::StlConvertToFloat;
+                                    }
+                                }
+                                else
+                                {
+                                    parserLog(Trace) << "Line:" << m_u32LineNo << " second argument after '" << szHeader << "' conversion to 'float' error";
+                                    retVal = Err::StlConvertToFloat;
+                                }
+                            }
+                            else
+                            {
+                                parserLog(Trace) << "Line:" << m_u32LineNo << " first argument after '" << szHeader << "' conversion to 'float' error";
+                                retVal = Err::StlConvertToFloat;
+                            }
+                        }
+                        else
+                        {
+                            parserLog(Trace) << "Line:" << m_u32LineNo << " third argument after '" << szHeader << "' expected";
+                            retVal = Err::StlVertFindNum3Beg;
+                        }
+                    }
+                    else
+                    {
+                        parserLog(Trace) << "Line:" << m_u32LineNo << " third argument after '" << szHeader << "' expected";
+                        retVal = Err::StlVertFindNum2End;
+                    }
+                }
+                else
+                {
+                    parserLog(Trace) << "Line:" << m_u32LineNo << " second argument after '" << szHeader << "' expected";
+                    retVal = Err::StlVertFindNum2Beg;
+                }
+            }
+            else
+            {
+                parserLog(Trace) << "Line:" << m_u32LineNo << " second argument after '" << szHeader << "' expected";
+                retVal = Err::StlVertFindNum1End;
+            }
+        }
+        else
+        {
+            parserLog(Trace) << "Line:" << m_u32LineNo << " first argument after '" << szHeader << "' expected";
+            retVal = Err::StlVertFindNum1Beg;
+        }
+    }
+    else
+    {
+        parserLog(Trace) << "Line:" << m_u32LineNo << " '" << szHeader << "' expected";
+        retVal = Err::StlVertFindSpace;
+    }
+    return retVal;
+}
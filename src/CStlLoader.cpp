@@ -7,6 +7,10 @@
 
 #include "CStlLoader.h"
 #include "CLogger.h"
+#include "CMappedFile.h"
+#include "CStlAsciiParser.h"
+#include "CThreadPool.h"
+#include "CStopwatch.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -17,11 +21,27 @@
 #include <string>
 #include <cstring>
 #include <fstream>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std::literals::string_literals;
 
+constexpr const char *CStlLoader::StdinFileName;
 constexpr int CStlLoader::StlBinaryHeaderSize;
 constexpr int CStlLoader::StlBinaryDataStart;
+constexpr size_t CStlLoader::StlBinaryFacetSize;
+constexpr uint32_t CStlLoader::StlBinaryFacetsPerView;
+constexpr uint32_t CStlLoader::StlPreviewMinFacets;
+constexpr uint32_t CStlLoader::StlPreviewReads;
+constexpr uint32_t CStlLoader::StlPreviewFacetsPerRead;
+constexpr size_t CStlLoader::StlAsciiProbeSize;
+constexpr size_t CStlLoader::StlFormatSampleSize;
+constexpr uint64_t CStlLoader::StlAsciiBytesPerFacet;
+constexpr size_t CStlLoader::StlAsciiViewSize;
+constexpr uint64_t CStlLoader::StlAsciiChunkSize;
+constexpr uint32_t CStlLoader::StlAsciiChunksPerThread;
+constexpr size_t CStlLoader::StlAsciiBoundaryProbeSize;
 
 /**
  * Loads ASCII STL file according to the following specification:
@@ -31,99 +51,203 @@ Err CStlLoader::loadFile(const std::string &sFileName, CModel &oModel)
 {
     Err retVal{Err::NoError};
 
-    if (fileExists(sFileName))
+    // The file is opened only once. Format detection and both decoders work on the same mapping.
+    logPrint(Debug) << "loadFile(\"" << sFileName << "\")";
+    const CStopwatch oTotalTime;
+    m_stats = CLoadStats();
+    CMappedFile oFile;
+    const bool bStdin = (StdinFileName == sFileName);
+    retVal = (bStdin)? loadPipe(GetStdHandle(STD_INPUT_HANDLE), oModel) : oFile.open(sFileName);
+    if ((Err::NoError == retVal) && !bStdin)
     {
-        readStlFileFormat(sFileName);
-
-        if ((StlFormat::binary == m_fileFormat) || (StlFormat::ascii == m_fileFormat))
+        m_u64FileSize = oFile.getSize();
+        m_stats.u64FileSize = m_u64FileSize;
+        CStopwatch oStageTime;
+        const CCompressedFile::Compression compression = CCompressedFile::detectCompression(oFile);
+        if (m_bMeshCacheEnabled && loadCached(sFileName, oFile, oModel))
         {
-            retVal = allocateMemory(oModel);
-            if (Err::NoError == retVal)
+            retVal = reportProgress(m_u64FileSize, oModel.getPublishedFacets());
+            m_stats.u64BytesDecoded = m_stats.u64BytesRead;
+        }
+        else if (CCompressedFile::Compression::none != compression)
+        {
+            m_stats.bCompressed = true;
+            retVal = loadCompressed(oFile, compression, oModel);
+        }
+        else
+        {
+            readStlFileFormat(oFile);
+            m_stats.dDetectMs = oStageTime.getMilliseconds();
+
+            if ((StlFormat::binary == m_fileFormat) || (StlFormat::ascii == m_fileFormat))
             {
-                switch (m_fileFormat)
+                retVal = reportProgress(0, 0);
+                if ((Err::NoError == retVal) && (StlFormat::binary == m_fileFormat) && (nullptr != m_pLoadHandle)
+                    && (m_u32TriangleNumber >= StlPreviewMinFacets))
                 {
-                    case StlFormat::binary:
-                        retVal = loadBinary(sFileName, oModel);
-                        break;
+                    // the preview is drawn while the whole file is loaded in the background
+                    oStageTime.restart();
+                    loadPreview(oFile, oModel);
+                    m_stats.dPreviewMs = oStageTime.getMilliseconds();
+                }
+                if (Err::NoError == retVal)
+                {
+                    oStageTime.restart();
+                    retVal = allocateMemory(oFile, oModel);
+                    m_stats.dAllocateMs = oStageTime.getMilliseconds();
+                }
+                if (Err::NoError == retVal)
+                {
+                    oStageTime.restart();
+                    switch (m_fileFormat)
+                    {
+                        case StlFormat::binary:
+                            retVal = loadBinary(oFile, oModel);
+                            break;
 
-                    case StlFormat::ascii:
-                        retVal = loadAscii(sFileName, oModel);
-                        break;
+                        case StlFormat::ascii:
+                            retVal = loadAscii(oFile, oModel);
+                            break;
 
-                    default:  // the app should never reach this case
-                        retVal = Err::InternalLoaderError;
-                        break;
+                        default:  // the app should never reach this case
+                            retVal = Err::InternalLoaderError;
+                            break;
+                    }
+                    m_stats.dDecodeMs = oStageTime.getMilliseconds();
                 }
+                m_stats.u64BytesDecoded = m_stats.u64BytesRead;
+            }
+            else
+            {
+                retVal = Err::InvalidStlFile;
             }
-        }
-        else
-        {
-            retVal = Err::InvalidStlFile;
         }
     }
-    else
+
+    m_stats.bBinary = (StlFormat::binary == m_fileFormat);
+    m_stats.bPaged = oModel.isPaged();
+    m_stats.dTotalMs = oTotalTime.getMilliseconds();
+    logPrint(Debug) << "Load stats: detect " << m_stats.dDetectMs << "ms, preview " << m_stats.dPreviewMs << "ms, allocate " << m_stats.dAllocateMs << "ms, decode "
+                    << m_stats.dDecodeMs << "ms, total " << m_stats.dTotalMs << "ms; " << m_stats.u32Facets << " facets, "
+                    << m_stats.u64BytesRead << "B read, " << m_stats.u64BytesDecoded << "B decoded, "
+                    << m_stats.getThroughput() << "MB/s, " << m_stats.u32Threads << " thread(s)";
+    return retVal;
+}
+
+Err CStlLoader::loadFileAsync(const std::string &sFileName, CModel &oModel, std::unique_ptr<CLoadHandle> &pHandle,
+                              const CLoadHandle::ProgressCallback &progressCallback,
+                              const CLoadHandle::LoadedCallback &loadedCallback)
+{
+    Err retVal{Err::NoError};
+
+    logPrint(Debug) << "loadFileAsync(\"" << sFileName << "\")";
+    pHandle.reset();
+    try
     {
-        retVal = Err::FileNotFound;
+        pHandle.reset(new CLoadHandle(sFileName, oModel, progressCallback, loadedCallback));
+    }
+    catch(...)
+    {
+        logPrint(Trace) << "Can't allocate memory";
+        retVal = Err::MemAlloc;
+    }
+
+    if (Err::NoError == retVal)
+    {
+        pHandle->m_hThread = CreateThread(nullptr, 0, loadThread, pHandle.get(), 0, nullptr);
+        if (nullptr == pHandle->m_hThread)
+        {
+            logPrint(Warning) << "Can't create loading thread, error " << GetLastError();
+            pHandle.reset();
+            retVal = Err::CantCreateThread;
+        }
     }
 
     return retVal;
 }
 
-bool CStlLoader::fileExists(const std::string& sFileName) const
+DWORD WINAPI CStlLoader::loadThread(LPVOID pParam)
 {
-    std::ifstream file(sFileName);
-    return file.good();
+    CLoadHandle &oHandle = *static_cast<CLoadHandle*>(pParam);
+    CStlLoader oLoader;
+    oLoader.m_pLoadHandle = &oHandle;
+    oHandle.m_result = oLoader.loadFile(oHandle.m_sFileName, oHandle.m_oModel);
+    oHandle.m_stats = oLoader.getStats();
+    oHandle.m_oMeshCache = oLoader.getMeshCache();
+    if ((Err::NoError == oHandle.m_result) && oHandle.m_loadedCallback)
+    {
+        oHandle.m_loadedCallback(oHandle.m_oModel, oHandle.m_stats, oHandle.m_oMeshCache);
+    }
+    return 0;
 }
 
-std::streampos CStlLoader::getFileSize(const std::string &sFileName) const
+Err CStlLoader::reportProgress(uint64_t u64BytesProcessed, uint32_t u32Facets)
 {
-    std::streampos fileSize = 0;
-    std::ifstream file(sFileName, std::ios::binary);
-    if (file)
+    Err retVal{Err::NoError};
+
+    m_stats.u64BytesRead = u64BytesProcessed;
+    m_stats.u32Facets = u32Facets;
+    if (nullptr != m_pLoadHandle)
     {
-        fileSize = file.tellg();
-        file.seekg(0, std::ios::end);
-        fileSize = file.tellg() - fileSize;
+        m_pLoadHandle->setProgress(u64BytesProcessed, m_u64FileSize, u32Facets);
     }
-    else
+    if (isLoadCancelled())
+    {
+        logPrint(Debug) << "Loading cancelled after " << u64BytesProcessed << "B";
+        retVal = Err::LoadCancelled;
+    }
+
+    return retVal;
+}
+
+bool CStlLoader::loadCached(const std::string &sFileName, const CMappedFile &oFile, CModel &oModel)
+{
+    bool bLoaded{false};
+
+    // the cache holds the normalized model, so neither decoding nor normalization is needed
+    const CStopwatch oStageTime;
+    m_oMeshCache = CMeshCache();
+    if ((Err::NoError == m_oMeshCache.setSource(sFileName, oFile)) && (Err::NoError == m_oMeshCache.load(oModel)))
     {
-        logPrint(Debug) << "getFileSize - can't open file";
+        m_stats.bCached = true;
+        m_stats.dDecodeMs = oStageTime.getMilliseconds();
+        bLoaded = true;
     }
-    return fileSize;
+    return bLoaded;
 }
 
-void CStlLoader::readStlFileFormat(const std::string &sFileName)
+void CStlLoader::readStlFileFormat(const CMappedFile &oFile)
 {
     m_u32TriangleNumber = 0;
     m_fileFormat = StlFormat::unknown;
 
-    std::streampos fileSize = getFileSize(sFileName);
-    logPrint(Debug) << "file \"" <<  sFileName << "\" size: " << fileSize << "B";
-    if (fileSize >= 15) // The minimum size of an empty ASCII file is 15 bytes.
+    const uint64_t u64FileSize = oFile.getSize();
+    logPrint(Debug) << "file size: " << u64FileSize << "B";
+    if (u64FileSize >= 15) // The minimum size of an empty ASCII file is 15 bytes.
     {
-        if (isStlFileAsciiFormat(sFileName))
+        // Many exporters write binary files with the header starting with "solid", so the binary size equation
+        // is checked first. An ASCII file fits the equation only by coincidence, so a file fitting it is binary
+        // unless the samples of its facet data are text. Both checks read a few KB regardless of the file size.
+        const bool bBinarySize = (u64FileSize >= StlBinaryDataStart) && isStlFileBinaryFormat(oFile); // the file must be as big as the file header
+        if (bBinarySize && !isStlFileTextSampled(oFile))
         {
-            logPrint(Debug) << "Detected ASCII STL file with " << m_u32TriangleNumber << " triangles inside";
+            logPrint(Debug) << "Detected Binary STL file with " << m_u32TriangleNumber << " triangles inside";
+            m_fileFormat = StlFormat::binary;
+        }
+        else if (isStlFileAsciiFormat(oFile))
+        {
+            logPrint(Debug) << "Detected ASCII STL file";
+            m_u32TriangleNumber = 0;
             m_fileFormat = StlFormat::ascii;
         }
+        else if (bBinarySize)
+        {
+            logPrint(Debug) << "Detected Binary STL file with " << m_u32TriangleNumber << " triangles inside";
+            m_fileFormat = StlFormat::binary;
+        }
         else
         {
-            if (fileSize >= StlBinaryDataStart) // the file must be as big as the file header
-            {
-                if (isStlFileBinaryFormat(sFileName, fileSize))
-                {
-                    logPrint(Debug) << "Detected Binary STL file with " << m_u32TriangleNumber << " triangles inside";
-                    m_fileFormat = StlFormat::binary;
-                }
-                else
-                {
-                    logPrint(Debug) << "Neither ASCII nor Binary STL file";
-                }
-            }
-            else
-            {
-                logPrint(Debug) << "Error: file size < " << StlBinaryDataStart << "B";
-            }
+            logPrint(Debug) << "Neither ASCII nor Binary STL file";
         }
     }
     else
@@ -132,70 +256,85 @@ void CStlLoader::readStlFileFormat(const std::string &sFileName)
     }
 }
 
-bool CStlLoader::isStlFileAsciiFormat(const std::string &sFileName)
+bool CStlLoader::isStlFileAsciiFormat(const CMappedFile &oFile)
 {
     bool bRetVal{false};
-    uint32_t u32TriangleNumber{0};
 
-    logPrint(Trace) << "isStlFileAsciiFormat(\"" << sFileName << "\")";
-    std::ifstream file{sFileName};
-    if (file)
+    logPrint(Trace) << "isStlFileAsciiFormat()";
+    // Only the head and the tail of the file are examined. The facets are counted while the file is parsed.
+    const uint64_t u64FileSize = oFile.getSize();
+    const size_t probeSize = static_cast<size_t>(std::min<uint64_t>(u64FileSize, StlAsciiProbeSize));
+    CMappedView oView = oFile.mapView(0, probeSize);
+    if (oView.isValid())
     {
         // Look for text "solid " in first 6 bytes, indicating the possibility that this is an ASCII STL format.
-        std::string sLine;
-        getline(file, sLine);
-        if (file.good())
+        std::string sLine(reinterpret_cast<const char*>(oView.data()), std::min(oView.size(), sizeof("solid ")-1));
+        strToLower(sLine);
+        if ((0 == sLine.find("solid ")) && isTextData(oView.data(), oView.size()))
         {
-            strToLower(sLine);
-            if (0 == sLine.find("solid "))
+            logPrint(Trace) << "File header 'solid' found";
+            oView = oFile.mapView(u64FileSize - probeSize, probeSize);
+            if (oView.isValid())
             {
-                logPrint(Trace) << "File header 'solid' found";
-                while (file.good())
+                // the last non-empty line of the file must contain "endsolid"
+                const char *pBegin = reinterpret_cast<const char*>(oView.data());
+                const char *pLineEnd = pBegin + oView.size();
+                while ((pLineEnd > pBegin) && (nullptr != strchr(" \t\r\n", pLineEnd[-1])))
                 {
-                    getline(file, sLine);
-                    if (file.good())
-                    {
-                        strToLower(sLine);
-                        if (std::string::npos != sLine.find("endsolid"))
-                        {
-                            logPrint(Trace) << "File footer 'endsolid' found";
-                            logPrint(Trace) << u32TriangleNumber << " triangles detected";
-                            bRetVal = true;
-                            break;
-                        }
-                        else
-                        {
-                            if (std::string::npos != sLine.find("facet normal"))
-                            {
-                                ++u32TriangleNumber;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        logPrint(Trace) << "File reading error";
-                        u32TriangleNumber = 0;
-                        break;
-                    }
+                    --pLineEnd;
+                }
+                const char *pLineBegin = pLineEnd;
+                while ((pLineBegin > pBegin) && ('\n' != pLineBegin[-1]))
+                {
+                    --pLineBegin;
+                }
+                sLine.assign(pLineBegin, pLineEnd);
+                strToLower(sLine);
+                if (std::string::npos != sLine.find("endsolid"))
+                {
+                    logPrint(Trace) << "File footer 'endsolid' found";
+                    bRetVal = true;
+                }
+                else
+                {
+                    logPrint(Trace) << "File footer 'endsolid' not found";
                 }
             }
             else
             {
-                logPrint(Trace) << "File header 'solid' not found";
+                logPrint(Trace) << "File reading error";
             }
         }
         else
         {
-            logPrint(Trace) << "File reading error";
+            logPrint(Trace) << "File header 'solid' not found or the head isn't text";
         }
     }
     else
     {
-        logPrint(Debug) << "Can't open file";
+        logPrint(Trace) << "File reading error";
     }
 
-    logPrint(Trace) << "File is " << ((bRetVal)? "" : "not ") << "ASCII file format" << ((bRetVal)? (" containing "s + std::to_string(u32TriangleNumber) + " triangles"): ""s);
-    m_u32TriangleNumber = u32TriangleNumber;
+    logPrint(Trace) << "File is " << ((bRetVal)? "" : "not ") << "ASCII file format";
+    return bRetVal;
+}
+
+bool CStlLoader::isStlFileTextSampled(const CMappedFile &oFile)
+{
+    bool bRetVal{true};
+
+    // the samples are taken after the binary header, in the middle and at the end of the file
+    const uint64_t u64FileSize = oFile.getSize();
+    const uint64_t au64Offsets[] = {StlBinaryDataStart, u64FileSize / 2, u64FileSize - std::min<uint64_t>(u64FileSize, StlFormatSampleSize)};
+    for (uint64_t u64Offset : au64Offsets)
+    {
+        if (bRetVal && (u64Offset < u64FileSize))
+        {
+            CMappedView oView = oFile.mapView(u64Offset, StlFormatSampleSize);
+            bRetVal = oView.isValid() && isTextData(oView.data(), oView.size());
+        }
+    }
+    logPrint(Trace) << "Facet data samples are " << ((bRetVal)? "" : "not ") << "text";
     return bRetVal;
 }
 
@@ -207,51 +346,34 @@ bool CStlLoader::isStlFileAsciiFormat(const std::string &sFileName)
  *  - AttributeCount: 1 short (2 bytes)
  * Total: 50 bytes per facet
  */
-bool CStlLoader::isStlFileBinaryFormat(const std::string &sFileName, std::streampos fileSize)
+bool CStlLoader::isStlFileBinaryFormat(const CMappedFile &oFile)
 {
     bool bRetVal{false};
     uint32_t u32TriangleNumber{0};
-    constexpr size_t facetSize = 3*sizeof(float) + 3*3*sizeof(float) + sizeof(uint16_t);
 
-    logPrint(Trace) << "isStlFileBinaryFormat(\"" << sFileName << "\"," << fileSize << ")";
-    std::ifstream file(sFileName, std::ios::binary | std::ios::in);
-    if (file)
+    logPrint(Trace) << "isStlFileBinaryFormat(" << oFile.getSize() << ")";
+    // Header is from bytes 0-79; u32TriangleNumber starts at byte offset 80.
+    CMappedView oView = oFile.mapView(StlBinaryHeaderSize, sizeof(uint32_t));
+    if (sizeof(uint32_t) == oView.size())
     {
-        // Header is from bytes 0-79; u32TriangleNumber starts at byte offset 80.
-        file.seekg(80);
-        if (file.good())
+        // Read the number of triangles, uint32_t (4 bytes), little-endian
+        const uint8_t *au8Buffer = oView.data();
+        u32TriangleNumber = (au8Buffer[3] << 24) | (au8Buffer[2] << 16) | (au8Buffer[1] << 8) | au8Buffer[0];
+        // Verify that file size equals the sum of header + nTriangles count(4B) + all triangles
+        if ((StlBinaryDataStart + (static_cast<uint64_t>(u32TriangleNumber) * StlBinaryFacetSize)) == oFile.getSize())
         {
-            // Read the number of triangles, uint32_t (4 bytes), little-endian
-            uint8_t au8Buffer[4];
-            file.read(reinterpret_cast<char*>(au8Buffer), 4);
-            if (file.good())
-            {
-                u32TriangleNumber = (au8Buffer[3] << 24) | (au8Buffer[2] << 16) | (au8Buffer[1] << 8) | au8Buffer[0];
-                // Verify that file size equals the sum of header + nTriangles count(4B) + all triangles
-                if ((StlBinaryDataStart + (u32TriangleNumber * facetSize)) == fileSize)
-                {
-                    logPrint(Trace) << "Binary file with " << u32TriangleNumber << " number of triangles detected";
-                    bRetVal = true;
-                }
-                else
-                {
-                    logPrint(Trace) << "File size doesn't fit " << u32TriangleNumber << " triangles";
-                    u32TriangleNumber = 0;
-                }
-            }
-            else
-            {
-                logPrint(Trace) << "File reading error";
-            }
+            logPrint(Trace) << "Binary file with " << u32TriangleNumber << " number of triangles detected";
+            bRetVal = true;
         }
         else
         {
-            logPrint(Trace) << "File seek error";
+            logPrint(Trace) << "File size doesn't fit " << u32TriangleNumber << " triangles";
+            u32TriangleNumber = 0;
         }
     }
     else
     {
-        logPrint(Debug) << "Can't open file";
+        logPrint(Trace) << "File reading error";
     }
 
     logPrint(Trace) << "File is " << ((bRetVal)? "" : "not ") << "Binary file format" << ((bRetVal)? (" containing "s + std::to_string(u32TriangleNumber) + " triangles"s): ""s);
@@ -259,109 +381,152 @@ bool CStlLoader::isStlFileBinaryFormat(const std::string &sFileName, std::stream
     return bRetVal;
 }
 
-Err CStlLoader::allocateMemory(CModel &oModel)
+Err CStlLoader::allocateMemory(const CMappedFile &oFile, CModel &oModel)
 {
     Err retVal{Err::NoError};
 
-    logPrint(Trace) << "Allocating memory for " << m_u32TriangleNumber << " facets";
-    if (m_u32TriangleNumber > 0)
+    if (StlFormat::ascii == m_fileFormat)
     {
-        try
-        {
-           oModel.getFacets().resize(m_u32TriangleNumber);
-        }
-        catch(...)
+        // The number of facets of an ASCII file is known only after parsing, so the memory is reserved
+        // for the number of facets estimated from the file size. The storage grows if the estimate is too low,
+        // and the model is paged by appendFacets() when the facets stop fitting in memory.
+        const uint64_t u64Estimate = oFile.getSize() / StlAsciiBytesPerFacet;
+        logPrint(Trace) << "Reserving memory for " << u64Estimate << " facets";
+        oModel.clear();
+        if (CModel::fitsInMemory(u64Estimate))
         {
-            logPrint(Trace) << "Can't allocate memory";
-            retVal = Err::MemAlloc;
+            CLockGuard oGuard{oModel.getLock()};
+            try
+            {
+                oModel.getFacets().reserve(static_cast<size_t>(std::min<uint64_t>(u64Estimate, oModel.getFacets().max_size())));
+            }
+            catch(...)
+            {
+                // not an error yet; the estimate may be much bigger than the real number of facets
+                logPrint(Debug) << "Can't reserve memory for " << u64Estimate << " facets";
+            }
         }
     }
     else
     {
-        logPrint(Trace) << "Not allocating memory - 0 triangles";
+        logPrint(Trace) << "Allocating memory for " << m_u32TriangleNumber << " facets";
+        oModel.clear();
+        if (m_u32TriangleNumber > 0)
+        {
+            bool bAllocated{false};
+            if (CModel::fitsInMemory(m_u32TriangleNumber))
+            {
+                CLockGuard oGuard{oModel.getLock()};
+                try
+                {
+                   // A model which is loaded again, e.g. when its file is reloaded, keeps its storage if the size
+                   // of the file is similar; the storage of a much smaller file is allocated anew.
+                   if (oModel.getFacets().capacity() / 2 > m_u32TriangleNumber)
+                   {
+                       std::vector<C3DFacet>().swap(oModel.getFacets());
+                   }
+                   oModel.getFacets().resize(m_u32TriangleNumber);
+                   bAllocated = true;
+                }
+                catch(...)
+                {
+                    logPrint(Debug) << "Can't allocate memory for " << m_u32TriangleNumber << " facets";
+                }
+            }
+            if (!bAllocated)
+            {
+                // the facets are decoded in batches and appended to the paged storage
+                retVal = oModel.setPaged();
+            }
+        }
+        else
+        {
+            logPrint(Trace) << "Not allocating memory - 0 triangles";
+        }
     }
     return retVal;
 }
 
-Err CStlLoader::loadBinary(const std::string &sFileName, CModel &oModel)
+Err CStlLoader::loadBinary(const CMappedFile &oFile, CModel &oModel)
 {
-    struct StlBinaryFacet
-    {
-        float normal[3];
-        float point1[3];
-        float point2[3];
-        float point3[3];
-        uint16_t attributes;
-    };
-    constexpr size_t stlBinaryFacetSize = 3*sizeof(float) + 3*3*sizeof(float) + sizeof(uint16_t);
-
     Err retVal{Err::NoError};
 
-    logPrint(Trace) << "loadBinary(\"" << sFileName << "\")";
+    logPrint(Trace) << "loadBinary()";
     std::vector<C3DFacet> &vFacets = oModel.getFacets();
 
     if (m_u32TriangleNumber > 0)
     {
-        if (vFacets.size() == m_u32TriangleNumber)
+        if (oModel.isPaged() || (vFacets.size() == m_u32TriangleNumber))
         {
-            std::ifstream file(sFileName, std::ios::binary);
-            if (file)
             {
-                char szModelName[StlBinaryHeaderSize+1]; // let's treat file header as a model name and read it
-                file.read(szModelName, StlBinaryHeaderSize);
-                if (file.good())
+                CMappedView oView = oFile.mapView(0, StlBinaryHeaderSize);
+                if (StlBinaryHeaderSize == oView.size())
                 {
+                    char szModelName[StlBinaryHeaderSize+1]; // let's treat file header as a model name and read it
+                    memcpy(szModelName, oView.data(), StlBinaryHeaderSize);
                     szModelName[StlBinaryHeaderSize] = '\0';
                     oModel.setModelName(szModelName);
 
-                    file.seekg(4, std::ios::cur); // skip the number of facets as it is already known (4B)
-                    if (file.good())
+                    // The facets are decoded straight from the mapped pages, one window at a time.
+                    // The number of facets is already known, so the 4B counter after the header is skipped.
+                    // A paged model gets the facets of each window through a batch appended to the storage.
+                    std::vector<C3DFacet> vBatch;
+                    if (oModel.isPaged())
                     {
-                        std::streampos readPos = StlBinaryDataStart;
-                        StlBinaryFacet record;
-                        for (auto &facet: vFacets)
+                        try
+                        {
+                            vBatch.resize(std::min(StlBinaryFacetsPerView, m_u32TriangleNumber));
+                        }
+                        catch(...)
                         {
-                            file.read(reinterpret_cast<char*>(&record), stlBinaryFacetSize); // due to the struct padding stlBinaryFacetSize is used instead of sizeof(record)
-                            if (file.good())
+                            logPrint(Trace) << "Can't allocate memory";
+                            retVal = Err::MemAlloc;
+                        }
+                    }
+                    uint32_t u32FacetIdx{0};
+                    while ((Err::NoError == retVal) && (u32FacetIdx < m_u32TriangleNumber))
+                    {
+                        const uint32_t u32ViewFacets = std::min(StlBinaryFacetsPerView, m_u32TriangleNumber - u32FacetIdx);
+                        const size_t viewSize = static_cast<size_t>(u32ViewFacets) * StlBinaryFacetSize;
+                        if (oModel.isPaged())
+                        {
+                            vBatch.resize(u32ViewFacets); // only the last window is smaller, so the batch isn't reallocated
+                        }
+                        C3DFacet *pFacets = oModel.isPaged()? vBatch.data() : &vFacets[u32FacetIdx];
+                        oView = oFile.mapView(StlBinaryDataStart + static_cast<uint64_t>(u32FacetIdx) * StlBinaryFacetSize, viewSize);
+                        CBoundingBox oViewBox;
+                        if (viewSize == oView.size())
+                        {
+                            if (!decodeBinaryFacets(oView.data(), u32ViewFacets, pFacets, oViewBox))
                             {
-                                readPos += stlBinaryFacetSize;
-                                if (std::isfinite(record.point1[0]) && std::isfinite(record.point1[1]) && std::isfinite(record.point1[2]) &&
-                                    std::isfinite(record.point2[0]) && std::isfinite(record.point2[1]) && std::isfinite(record.point2[2]) &&
-                                    std::isfinite(record.point3[0]) && std::isfinite(record.point3[1]) && std::isfinite(record.point3[2]))
+                                // error in triangle definition; the facets of the view are checked again one by one to find the first bad one
+                                const uint32_t u32InvalidIdx = u32FacetIdx + findInvalidBinaryFacet(pFacets, u32ViewFacets);
+                                logPrint(Trace) << "Data error at " << (StlBinaryDataStart + (static_cast<uint64_t>(u32InvalidIdx) + 1) * StlBinaryFacetSize) << "B";
+                                retVal = Err::TriangleDef;
+                            }
+                            else
+                            {
+                                const float fProgress = static_cast<float>(u32FacetIdx + u32ViewFacets) / m_u32TriangleNumber;
+                                if (oModel.isPaged())
                                 {
-                                    facet.normal.m_fX = record.normal[0]; // normal
-                                    facet.normal.m_fY = record.normal[1];
-                                    facet.normal.m_fZ = record.normal[2];
-                                    facet.p1.m_fX = record.point1[0]; // point 1
-                                    facet.p1.m_fY = record.point1[1];
-                                    facet.p1.m_fZ = record.point1[2];
-                                    facet.p2.m_fX = record.point2[0]; // point 2
-                                    facet.p2.m_fY = record.point2[1];
-                                    facet.p2.m_fZ = record.point2[2];
-                                    facet.p3.m_fX = record.point3[0]; // point 3
-                                    facet.p3.m_fY = record.point3[1];
-                                    facet.p3.m_fZ = record.point3[2];
+                                    retVal = oModel.appendFacets(vBatch, fProgress, oViewBox);
                                 }
                                 else
                                 {
-                                    // error in triangle definition
-                                    logPrint(Trace) << "Data error at " << readPos << "B";
-                                    retVal = Err::TriangleDef;
-                                    break;
+                                    oModel.publishFacets(u32FacetIdx + u32ViewFacets, fProgress, oViewBox);
                                 }
                             }
-                            else
+                            if (Err::NoError == retVal)
                             {
-                                logPrint(Trace) << "Can't read file";
-                                retVal = Err::ReadFile;
-                                break;
+                                retVal = reportProgress(StlBinaryDataStart + static_cast<uint64_t>(u32FacetIdx + u32ViewFacets) * StlBinaryFacetSize, u32FacetIdx + u32ViewFacets);
                             }
+                            u32FacetIdx += u32ViewFacets;
+                        }
+                        else
+                        {
+                            logPrint(Trace) << "Can't read file";
+                            retVal = Err::ReadFile;
                         }
-                    }
-                    else
-                    {
-                        logPrint(Trace) << "File seek error";
-                        retVal = Err::ReadFile2;
                     }
                 }
                 else
@@ -370,11 +535,6 @@ Err CStlLoader::loadBinary(const std::string &sFileName, CModel &oModel)
                     retVal = Err::ReadFile;
                 }
             }
-            else
-            {
-                logPrint(Trace) << "Can't open file";
-                retVal = Err::OpenFile;
-            }
         }
         else
         {
@@ -391,278 +551,772 @@ Err CStlLoader::loadBinary(const std::string &sFileName, CModel &oModel)
     if (Err::NoError != retVal)
     {
         logPrint(Trace) << "Deallocating memory";
-        vFacets.clear();
+        oModel.clear();
         m_u32TriangleNumber = 0;
     }
     return retVal;
 }
 
-Err CStlLoader::loadAscii(const std::string &sFileName, CModel &oModel)
+Err CStlLoader::loadBinaryIfstream(const std::string &sFileName, std::vector<C3DFacet> &vFacets)
 {
-    Err retVal{Err::NoError};
+    struct StlBinaryFacet
+    {
+        float normal[3];
+        float point1[3];
+        float point2[3];
+        float point3[3];
+        uint16_t attributes;
+    };
 
-    logPrint(Trace) << "loadAscii(\"" << sFileName << "\")";
-    std::vector<C3DFacet> &vFacets = oModel.getFacets();
+    Err retVal{Err::NoError};
 
-    if (m_u32TriangleNumber > 0)
+    logPrint(Trace) << "loadBinaryIfstream(\"" << sFileName << "\")";
+    vFacets.clear();
+    std::ifstream file(sFileName, std::ios::binary);
+    if (file)
     {
-        if (vFacets.size() == m_u32TriangleNumber)
+        uint32_t u32TriangleNumber{0};
+        file.seekg(StlBinaryHeaderSize, std::ios::beg); // the header isn't needed by the benchmark
+        file.read(reinterpret_cast<char*>(&u32TriangleNumber), sizeof(u32TriangleNumber));
+        if (file.good())
         {
-            std::ifstream file(sFileName);
-            if (file)
+            try
+            {
+                vFacets.resize(u32TriangleNumber);
+            }
+            catch(...)
+            {
+                logPrint(Trace) << "Can't allocate memory";
+                retVal = Err::MemAlloc;
+            }
+
+            std::streampos readPos = StlBinaryDataStart;
+            StlBinaryFacet record;
+            for (auto &facet: vFacets)
             {
-                uint32_t u32CurrentLineNo{0};
-                std::string sLine;
-                getline(file, sLine);
-                ++u32CurrentLineNo;
+                file.read(reinterpret_cast<char*>(&record), StlBinaryFacetSize); // due to the struct padding StlBinaryFacetSize is used instead of sizeof(record)
                 if (file.good())
                 {
-                    strToLower(sLine);
-                    if (0 == sLine.find("solid ")) // file starts with "solid"
+                    readPos += StlBinaryFacetSize;
+                    if (std::isfinite(record.point1[0]) && std::isfinite(record.point1[1]) && std::isfinite(record.point1[2]) &&
+                        std::isfinite(record.point2[0]) && std::isfinite(record.point2[1]) && std::isfinite(record.point2[2]) &&
+                        std::isfinite(record.point3[0]) && std::isfinite(record.point3[1]) && std::isfinite(record.point3[2]))
                     {
-                        oModel.setModelName(sLine.substr(sizeof("solid ")-1));
-                        for (auto &facet: vFacets)
-                        {
-                            retVal = stlAsciiReadFacet(file, facet, u32CurrentLineNo);
-                            if (Err::NoError != retVal)
-                            {
-                                break;
-                            }
-                        }
-
-                        // look for: "endsolid" in file
-                        if (Err::NoError == retVal) // only if we exited the "for" loop without error
-                        {
-                            getline(file, sLine);
-                            ++u32CurrentLineNo;
-                            if (file.good()) // read last file line
-                            {
-                                strToLower(sLine);
-                                if (0 != sLine.find("endsolid")) // if not found on 0-position
-                                {
-                                    logPrint(Trace) << "Line:" << u32CurrentLineNo << " 'endsolid' expected";
-                                    retVal = Err::StlEndsolid; // "endsolid" expected
-                                }
-                            }
-                            else
-                            {
-                                logPrint(Trace) << "Line:" << u32CurrentLineNo << " Can't read file";
-                                retVal = Err::StlGetline4; // can't read first line of the file
-                            }
-                        }
+                        facet.normal.m_fX = record.normal[0]; // normal
+                        facet.normal.m_fY = record.normal[1];
+                        facet.normal.m_fZ = record.normal[2];
+                        facet.p1.m_fX = record.point1[0]; // point 1
+                        facet.p1.m_fY = record.point1[1];
+                        facet.p1.m_fZ = record.point1[2];
+                        facet.p2.m_fX = record.point2[0]; // point 2
+                        facet.p2.m_fY = record.point2[1];
+                        facet.p2.m_fZ = record.point2[2];
+                        facet.p3.m_fX = record.point3[0]; // point 3
+                        facet.p3.m_fY = record.point3[1];
+                        facet.p3.m_fZ = record.point3[2];
                     }
                     else
                     {
-                        logPrint(Trace) << "Line:" << u32CurrentLineNo << " 'solid ' expected";
-                        retVal = Err::StlSolidExpected; // wrong first line; "solid ....." expected
+                        // error in triangle definition
+                        logPrint(Trace) << "Data error at " << readPos << "B";
+                        retVal = Err::TriangleDef;
+                        break;
                     }
                 }
                 else
                 {
-                    logPrint(Trace) << "Line:" << u32CurrentLineNo << " Can't read file";
-                    retVal = Err::StlGetline5; // can't read first line of the file
+                    logPrint(Trace) << "Can't read file";
+                    retVal = Err::ReadFile;
+                    break;
                 }
             }
-            else
-            {
-                logPrint(Trace) << "Can't open file";
-                retVal = Err::OpenFile;
-            }
         }
         else
         {
-            logPrint(Trace) << "Memory buffer size (" << vFacets.size() << ") and triangles number(" << m_u32TriangleNumber << ") don't match";
-            retVal = Err::InternalLoaderError2;
+            logPrint(Trace) << "Can't read file";
+            retVal = Err::ReadFile;
         }
     }
     else
     {
-        logPrint(Debug) << "File contains empty model";
-        retVal = Err::EmptyModel;
+        logPrint(Trace) << "Can't open file";
+        retVal = Err::OpenFile;
     }
 
     if (Err::NoError != retVal)
     {
-        logPrint(Trace) << "Deallocating memory";
         vFacets.clear();
-        m_u32TriangleNumber = 0;
     }
     return retVal;
 }
 
-Err CStlLoader::stlAsciiReadLineAndCheck(std::ifstream &file, const std::string &sExpected, uint32_t &u32CurrentLineNo)
+void CStlLoader::loadPreview(const CMappedFile &oFile, CModel &oModel)
+{
+    logPrint(Trace) << "loadPreview()";
+    const uint32_t u32Reads = std::min(StlPreviewReads, m_u32TriangleNumber / StlPreviewFacetsPerRead);
+    std::vector<uint8_t> vRecords;
+    std::vector<C3DFacet> vPreview;
+    CBoundingBox oPreviewBox;
+    try
+    {
+        vRecords.resize(StlPreviewFacetsPerRead * StlBinaryFacetSize);
+        vPreview.resize(u32Reads * StlPreviewFacetsPerRead);
+    }
+    catch(...)
+    {
+        logPrint(Debug) << "Can't allocate memory for preview";
+        vPreview.clear();
+    }
+
+    if (!vPreview.empty())
+    {
+        const uint32_t u32Stride = m_u32TriangleNumber / u32Reads;
+        bool bValid{true};
+        for (uint32_t u32Read = 0; bValid && (u32Read < u32Reads) && !isLoadCancelled(); ++u32Read)
+        {
+            const uint64_t u64Offset = StlBinaryDataStart + static_cast<uint64_t>(u32Read) * u32Stride * StlBinaryFacetSize;
+            CBoundingBox oReadBox;
+            bValid = (Err::NoError == oFile.read(u64Offset, vRecords.data(), vRecords.size()))
+                     && decodeBinaryFacets(vRecords.data(), StlPreviewFacetsPerRead, &vPreview[u32Read * StlPreviewFacetsPerRead], oReadBox);
+            oPreviewBox.add(oReadBox);
+        }
+
+        if (bValid && !isLoadCancelled())
+        {
+            logPrint(Debug) << "Preview of " << vPreview.size() << " facets";
+            oModel.setPreviewFacets(std::move(vPreview), oPreviewBox);
+        }
+        else
+        {
+            logPrint(Debug) << "Preview not available";
+        }
+    }
+}
+
+bool CStlLoader::decodeBinaryFacets(const uint8_t *pRecords, uint32_t u32Count, C3DFacet *pFacets, CBoundingBox &oBox)
+{
+    // record layout: normal (3 floats), point 1, point 2, point 3 (3 floats each), attributes (2B)
+    // facet layout: point 1, point 2, point 3, normal
+    static_assert(sizeof(C3DFacet) == 4*sizeof(CVector3d), "C3DFacet must consist of 4 packed vectors");
+#if defined(__SSE2__)
+    // A facet is written with 3 vector stores. The points of a record are contiguous, so the first two vectors
+    // are loaded as they are, and the last one is assembled from the last coordinate and the normal.
+    // A float is infinite or NaN if all bits of its exponent are set; the flags are collected for all facets.
+    // The X, Y and Z lanes of the points 1, 2 and 3 are aligned for the bounding box; the fourth lane is ignored.
+    const __m128i exponentMask = _mm_set1_epi32(0x7F800000);
+    __m128i invalid = _mm_setzero_si128();
+    __m128 boxMin = _mm_set1_ps(INFINITY);
+    __m128 boxMax = _mm_set1_ps(-INFINITY);
+    __m128i *pOut = reinterpret_cast<__m128i*>(pFacets);
+    for (uint32_t u32Idx = 0; u32Idx < u32Count; ++u32Idx)
+    {
+        const __m128i points1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRecords + 12)); // p1.x p1.y p1.z p2.x
+        const __m128i points2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRecords + 28)); // p2.y p2.z p3.x p3.y
+        const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRecords + 32)); // p2.z p3.x p3.y p3.z
+        const __m128i points3 = _mm_srli_si128(tail, 12); // p3.z 0 0 0
+        const __m128i normal = _mm_slli_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pRecords)), 4); // 0 n.x n.y n.z
+        _mm_storeu_si128(pOut, points1);
+        _mm_storeu_si128(pOut + 1, points2);
+        _mm_storeu_si128(pOut + 2, _mm_or_si128(points3, normal));
+        invalid = _mm_or_si128(invalid, _mm_cmpeq_epi32(_mm_and_si128(points1, exponentMask), exponentMask));
+        invalid = _mm_or_si128(invalid, _mm_cmpeq_epi32(_mm_and_si128(points2, exponentMask), exponentMask));
+        invalid = _mm_or_si128(invalid, _mm_cmpeq_epi32(_mm_and_si128(points3, exponentMask), exponentMask));
+        const __m128 point1 = _mm_castsi128_ps(points1); // p1.x p1.y p1.z -
+        const __m128 point2 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pRecords + 24))); // p2.x p2.y p2.z -
+        const __m128 point3 = _mm_castsi128_ps(_mm_shuffle_epi32(tail, _MM_SHUFFLE(3, 3, 2, 1))); // p3.x p3.y p3.z -
+        boxMin = _mm_min_ps(boxMin, _mm_min_ps(point1, _mm_min_ps(point2, point3)));
+        boxMax = _mm_max_ps(boxMax, _mm_max_ps(point1, _mm_max_ps(point2, point3)));
+        pRecords += StlBinaryFacetSize;
+        pOut += 3;
+    }
+    if (u32Count > 0)
+    {
+        float afMin[4];
+        float afMax[4];
+        _mm_storeu_ps(afMin, boxMin);
+        _mm_storeu_ps(afMax, boxMax);
+        oBox.add(CVector3d{afMin[0], afMin[1], afMin[2]});
+        oBox.add(CVector3d{afMax[0], afMax[1], afMax[2]});
+    }
+    return 0 == _mm_movemask_epi8(invalid);
+#else
+    bool bValid{true};
+    for (uint32_t u32Idx = 0; u32Idx < u32Count; ++u32Idx)
+    {
+        C3DFacet &facet = pFacets[u32Idx];
+        memcpy(&facet.p1, pRecords + 1*sizeof(CVector3d), 3*sizeof(CVector3d));
+        memcpy(&facet.normal, pRecords, sizeof(CVector3d));
+        bValid = bValid && isBinaryFacetValid(facet);
+        oBox.add(facet);
+        pRecords += StlBinaryFacetSize;
+    }
+    return bValid;
+#endif
+}
+
+uint32_t CStlLoader::findInvalidBinaryFacet(const C3DFacet *pFacets, uint32_t u32Count)
+{
+    uint32_t u32Idx{0};
+    while ((u32Idx < u32Count) && isBinaryFacetValid(pFacets[u32Idx]))
+    {
+        ++u32Idx;
+    }
+    return u32Idx;
+}
+
+bool CStlLoader::isBinaryFacetValid(const C3DFacet &facet)
+{
+    return std::isfinite(facet.p1.m_fX) && std::isfinite(facet.p1.m_fY) && std::isfinite(facet.p1.m_fZ) &&
+           std::isfinite(facet.p2.m_fX) && std::isfinite(facet.p2.m_fY) && std::isfinite(facet.p2.m_fZ) &&
+           std::isfinite(facet.p3.m_fX) && std::isfinite(facet.p3.m_fY) && std::isfinite(facet.p3.m_fZ);
+}
+
+Err CStlLoader::loadAscii(const CMappedFile &oFile, CModel &oModel)
 {
     Err retVal{Err::NoError};
-    std::string sLine;
 
-    getline(file, sLine);
-    ++u32CurrentLineNo;
-    if (file.good())
+    logPrint(Trace) << "loadAscii()";
+
+    const uint64_t u64FileSize = oFile.getSize();
+    CMappedView oView = oFile.mapView(0, StlAsciiViewSize);
+    if (oView.isValid())
     {
-        strToLower(sLine);
-        size_t pos = sLine.find_first_not_of(" "); // indentation with spaces is allowed
-        if (sLine.find(sExpected, pos) != pos)
+        const char *pBegin = reinterpret_cast<const char*>(oView.data());
+        CStlAsciiParser oParser{pBegin, pBegin + oView.size(), oView.size() == u64FileSize, 0};
+        std::string sModelName;
+        retVal = oParser.parseHeader(sModelName);
+        if (Err::NoError == retVal)
         {
-            logPrint(Error) << "Line:" << u32CurrentLineNo << " '" << sExpected << "' expected";
-            retVal = Err::StlAscUnexpected; // "outer loop" expected
+            oModel.setModelName(sModelName);
+            const uint64_t u64DataOffset = static_cast<uint64_t>(oParser.getPosition() - pBegin);
+            oView.unmap();
+            CThreadPool &oPool = CThreadPool::getInstance();
+            if ((oPool.getThreadCount() > 1) && (u64FileSize - u64DataOffset >= 2*StlAsciiChunkSize))
+            {
+                m_stats.u32Threads = oPool.getThreadCount();
+                retVal = parseAsciiChunks(oFile, u64DataOffset, oParser.getLineNo(), oModel);
+            }
+            else
+            {
+                retVal = parseAsciiFacets(oFile, u64DataOffset, oParser.getLineNo(), oModel);
+            }
+        }
+
+        if (Err::NoError == retVal)
+        {
+            m_u32TriangleNumber = oModel.getPublishedFacets();
+            logPrint(Debug) << "loadAscii: " << m_u32TriangleNumber << " facets parsed by " << m_stats.u32Threads << " thread(s)";
+            if (0 == m_u32TriangleNumber)
+            {
+                logPrint(Debug) << "File contains empty model";
+                retVal = Err::EmptyModel;
+            }
         }
     }
     else
     {
-        logPrint(Trace) << "Line:" << u32CurrentLineNo << " Can't read file";
-        retVal = Err::StlGetline;
+        logPrint(Trace) << "Can't read file";
+        retVal = Err::ReadFile;
     }
 
+    if (Err::NoError != retVal)
+    {
+        logPrint(Trace) << "Deallocating memory";
+        oModel.clear();
+        m_u32TriangleNumber = 0;
+    }
     return retVal;
 }
 
-Err CStlLoader::stlAsciiReadFacet(std::ifstream &file, C3DFacet &facet, uint32_t &u32CurrentLineNo)
+Err CStlLoader::parseAsciiFacets(const CMappedFile &oFile, uint64_t u64Offset, uint32_t u32LineNo, CModel &oModel)
 {
     Err retVal{Err::NoError};
 
-    retVal = readAsciiVertex(file, "facet normal ", u32CurrentLineNo, facet.normal); // read expected text: "facet normal ....."
-    if (Err::NoError == retVal)
+    // The text is parsed straight from the mapped pages, one window at a time. A facet cut off by the end
+    // of a window is parsed again from the beginning of the next window, which starts at the facet's first line.
+    // The facets of a window are parsed into a batch and appended to the model, so they can be drawn at once.
+    const uint64_t u64FileSize = oFile.getSize();
+    std::vector<C3DFacet> vBatch;
+    bool bEndSolid{false};
+    while ((Err::NoError == retVal) && !bEndSolid)
     {
-        retVal = stlAsciiReadLineAndCheck(file, "outer loop", u32CurrentLineNo); // read expected text: "outer loop"
-        if (Err::NoError == retVal)
+        CMappedView oView = oFile.mapView(u64Offset, StlAsciiViewSize);
+        if (oView.isValid() || (u64Offset == u64FileSize))
         {
-            retVal = readAsciiVertex(file, "vertex ", u32CurrentLineNo, facet.p1); // read "vertex ...."
+            const char *pBegin = reinterpret_cast<const char*>(oView.data());
+            CStlAsciiParser oParser{pBegin, pBegin + oView.size(), u64Offset + oView.size() == u64FileSize, u32LineNo};
+            vBatch.clear();
+            retVal = oParser.parseFacets(vBatch);
+            bEndSolid = oParser.isEndSolidFound();
+            const size_t consumed = static_cast<size_t>(oParser.getPosition() - pBegin);
             if (Err::NoError == retVal)
             {
-                retVal = readAsciiVertex(file, "vertex ", u32CurrentLineNo, facet.p2); // read "vertex ...."
+                retVal = oModel.appendFacets(vBatch, static_cast<float>(u64Offset + consumed) / u64FileSize);
+            }
+            if (Err::NoError == retVal)
+            {
+                retVal = reportProgress(u64Offset + consumed, oModel.getPublishedFacets());
+            }
+            if ((Err::NoError == retVal) && !bEndSolid)
+            {
+                if (consumed > 0)
+                {
+                    u64Offset += consumed;
+                    u32LineNo = oParser.getLineNo();
+                }
+                else
+                {
+                    logPrint(Trace) << "Line:" << (oParser.getLineNo() + 1) << " Facet doesn't fit in " << StlAsciiViewSize << "B";
+                    retVal = Err::StlGetline;
+                }
+            }
+        }
+        else
+        {
+            logPrint(Trace) << "Can't read file";
+            retVal = Err::ReadFile;
+        }
+    }
+    return retVal;
+}
+
+Err CStlLoader::parseAsciiChunks(const CMappedFile &oFile, uint64_t u64DataOffset, uint32_t u32LineNo, CModel &oModel)
+{
+    Err retVal{Err::NoError};
+
+    // The text is split into chunks of about StlAsciiChunkSize bytes, each starting at a "facet" line, so every
+    // chunk of a valid file holds whole facets. The chunks are parsed in parallel into separate vectors and
+    // appended in file order, a wave of chunks at a time to bound the memory. The chunks are parsed with line
+    // numbers counted from 0 and without logging; the first chunk which fails is parsed again serially,
+    // when the number of its first line is known, so errors are reported exactly like by the serial parser.
+    CThreadPool &oPool = CThreadPool::getInstance();
+    const uint64_t u64ChunkCount = (oFile.getSize() - u64DataOffset + StlAsciiChunkSize - 1) / StlAsciiChunkSize;
+    const uint32_t u32WaveSize = oPool.getThreadCount() * StlAsciiChunksPerThread;
+    std::vector<AsciiChunk> vChunks(u32WaveSize);
+    bool bDone{false};
+    for (uint64_t u64FirstChunk = 0; !bDone && (u64FirstChunk < u64ChunkCount); u64FirstChunk += u32WaveSize)
+    {
+        const uint32_t u32Chunks = static_cast<uint32_t>(std::min<uint64_t>(u32WaveSize, u64ChunkCount - u64FirstChunk));
+        oPool.parallelFor(u32Chunks, [&](uint32_t u32Idx)
+        {
+            const uint64_t u64Chunk = u64FirstChunk + u32Idx;
+            AsciiChunk &chunk = vChunks[u32Idx];
+            chunk.bValid = false;
+            if (!isLoadCancelled())
+            {
+                chunk.u64Begin = (0 == u64Chunk)? u64DataOffset : findAsciiChunkBoundary(oFile, u64DataOffset + u64Chunk*StlAsciiChunkSize);
+                parseAsciiChunk(oFile, findAsciiChunkBoundary(oFile, u64DataOffset + (u64Chunk + 1)*StlAsciiChunkSize), chunk);
+            }
+        });
+        if (isLoadCancelled())
+        {
+            // the chunks skipped by the threads aren't parsed again
+            retVal = reportProgress(u64DataOffset + u64FirstChunk*StlAsciiChunkSize, oModel.getPublishedFacets());
+            bDone = true;
+        }
+
+        for (uint32_t u32Idx = 0; !bDone && (u32Idx < u32Chunks); ++u32Idx)
+        {
+            AsciiChunk &chunk = vChunks[u32Idx];
+            if (chunk.bValid)
+            {
+                const uint64_t u64ChunkEnd = std::min(u64DataOffset + (u64FirstChunk + u32Idx + 1)*StlAsciiChunkSize, oFile.getSize());
+                retVal = oModel.appendFacets(chunk.vFacets, static_cast<float>(u64ChunkEnd) / oFile.getSize());
                 if (Err::NoError == retVal)
                 {
-                    retVal = readAsciiVertex(file, "vertex ", u32CurrentLineNo, facet.p3); // read "vertex ...."
-                    if (Err::NoError == retVal)
-                    {
-                        retVal = stlAsciiReadLineAndCheck(file, "endloop", u32CurrentLineNo); // read expected text: "endloop"
-                    }
+                    retVal = reportProgress(u64ChunkEnd, oModel.getPublishedFacets());
                 }
+                u32LineNo += chunk.u32Lines;
+                bDone = (Err::NoError != retVal) || chunk.bEndSolid; // anything following "endsolid" is ignored
+            }
+            else
+            {
+                logPrint(Trace) << "Chunk at " << chunk.u64Begin << "B not parsed, parsing serially from line " << (u32LineNo + 1);
+                retVal = parseAsciiFacets(oFile, chunk.u64Begin, u32LineNo, oModel);
+                bDone = true;
             }
         }
-        if (Err::NoError == retVal)
+    }
+    return retVal;
+}
+
+void CStlLoader::parseAsciiChunk(const CMappedFile &oFile, uint64_t u64End, AsciiChunk &chunk)
+{
+    chunk.vFacets.clear();
+    chunk.u32Lines = 0;
+    chunk.bValid = false;
+    chunk.bEndSolid = false;
+    if (chunk.u64Begin < u64End)
+    {
+        CMappedView oView = oFile.mapView(chunk.u64Begin, static_cast<size_t>(u64End - chunk.u64Begin));
+        if (oView.isValid())
+        {
+            const char *pBegin = reinterpret_cast<const char*>(oView.data());
+            const char *pEnd = pBegin + oView.size();
+            CStlAsciiParser oParser{pBegin, pEnd, u64End == oFile.getSize(), 0};
+            oParser.setErrorLog(false);
+            try
+            {
+                chunk.vFacets.reserve(oView.size() / StlAsciiBytesPerFacet);
+            }
+            catch(...)
+            {
+                // not an error yet; the vector grows while parsing
+            }
+            if (Err::NoError == oParser.parseFacets(chunk.vFacets))
+            {
+                chunk.u32Lines = oParser.getLineNo();
+                chunk.bEndSolid = oParser.isEndSolidFound();
+                // any chunk except the last one ends at the first line of a facet, so it must be parsed to the end
+                chunk.bValid = chunk.bEndSolid || (oParser.getPosition() == pEnd);
+            }
+        }
+    }
+    else
+    {
+        chunk.bValid = true; // the boundaries of both ends of the chunk were found at the same line
+    }
+}
+
+uint64_t CStlLoader::findAsciiChunkBoundary(const CMappedFile &oFile, uint64_t u64Offset)
+{
+    uint64_t u64Boundary = oFile.getSize();
+
+    // The boundary is the beginning of the first line starting with "facet" at or after the offset.
+    // The probe starts one byte earlier, so a line starting exactly at the offset is found too.
+    if ((u64Offset > 0) && (u64Offset < u64Boundary))
+    {
+        CMappedView oView = oFile.mapView(u64Offset - 1, StlAsciiBoundaryProbeSize);
+        if (oView.isValid())
         {
-            retVal = stlAsciiReadLineAndCheck(file, "endfacet", u32CurrentLineNo); // look for: "endfacet" in file
+            static const char szKeyword[] = "facet";
+            const char *pBegin = reinterpret_cast<const char*>(oView.data());
+            const char *pEnd = pBegin + oView.size();
+            const char *pLine = pBegin;
+            while (nullptr != (pLine = static_cast<const char*>(memchr(pLine, '\n', static_cast<size_t>(pEnd - pLine)))))
+            {
+                ++pLine;
+                const char *p = pLine;
+                while ((p < pEnd) && ((' ' == *p) || ('\t' == *p)))
+                {
+                    ++p;
+                }
+                bool bFound = (static_cast<size_t>(pEnd - p) >= sizeof(szKeyword) - 1);
+                for (size_t i = 0; bFound && (i < sizeof(szKeyword) - 1); ++i)
+                {
+                    bFound = ((p[i] | 0x20) == szKeyword[i]); // setting the bit 0x20 converts an upper case letter to lower case
+                }
+                if (bFound)
+                {
+                    u64Boundary = u64Offset - 1 + static_cast<uint64_t>(pLine - pBegin);
+                    break;
+                }
+            }
         }
     }
+    return u64Boundary;
+}
+
+Err CStlLoader::loadCompressed(const CMappedFile &oFile, CCompressedFile::Compression compression, CModel &oModel)
+{
+    Err retVal{Err::NoError};
+
+    logPrint(Debug) << "Detected " << ((CCompressedFile::Compression::gzip == compression)? "gzip" : "zstd") << " compressed file";
+    m_u32TriangleNumber = 0;
+    m_fileFormat = StlFormat::unknown;
+    oModel.clear();
+    // the allocation stage covers the buffers of the decompression
+    const CStopwatch oStageTime;
+    CCompressedFile oStream;
+    oStream.setCancelEvent(getCancelEvent());
+    retVal = oStream.open(oFile, compression, StlAsciiViewSize);
+    m_stats.dAllocateMs = oStageTime.getMilliseconds();
+    if (Err::NoError == retVal)
+    {
+        retVal = loadStream(oStream, oModel);
+    }
     return retVal;
 }
 
-Err CStlLoader::stringToFloat(const std::string &sStr, float &fNumber) const
+Err CStlLoader::loadPipe(HANDLE hInput, CModel &oModel)
 {
     Err retVal{Err::NoError};
 
-    try
+    // The size of the data is unknown until the pipe is closed, so the model grows with every decoded batch.
+    logPrint(Debug) << "Reading STL data from standard input";
+    m_u64FileSize = 0;
+    m_u32TriangleNumber = 0;
+    m_fileFormat = StlFormat::unknown;
+    m_stats.bPiped = true;
+    oModel.clear();
+    const CStopwatch oStageTime;
+    CCompressedFile oStream;
+    oStream.setCancelEvent(getCancelEvent());
+    retVal = oStream.open(hInput, StlAsciiViewSize);
+    m_stats.dAllocateMs = oStageTime.getMilliseconds();
+    if (Err::NoError == retVal)
+    {
+        retVal = loadStream(oStream, oModel);
+        m_stats.u64FileSize = oStream.getInputPosition();
+    }
+    return retVal;
+}
+
+Err CStlLoader::loadStream(CCompressedFile &oStream, CModel &oModel)
+{
+    Err retVal{Err::NoError};
+
+    // the detection stage waits for the first window
+    CStopwatch oStageTime;
+    oStream.fill();
+    readStlStreamFormat(oStream);
+    m_stats.dDetectMs = oStageTime.getMilliseconds();
+    oStageTime.restart();
+    switch (m_fileFormat)
     {
-        fNumber = std::stof(sStr);
+        case StlFormat::binary:
+            retVal = reportProgress(0, 0);
+            if (Err::NoError == retVal)
+            {
+                retVal = loadBinaryStream(oStream, oModel);
+            }
+            break;
+
+        case StlFormat::ascii:
+            retVal = reportProgress(0, 0);
+            if (Err::NoError == retVal)
+            {
+                retVal = loadAsciiStream(oStream, oModel);
+            }
+            break;
+
+        default:
+            retVal = Err::InvalidStlFile;
+            break;
     }
-    catch (...)
+    m_stats.dDecodeMs = oStageTime.getMilliseconds();
+    m_stats.u64BytesDecoded = oStream.getPosition();
+
+    // the decoders see broken compressed data as data ending too early, so the stream error is reported instead
+    std::string sErrorText;
+    const Err streamError = oStream.getError(sErrorText);
+    if ((Err::NoError != retVal) && (Err::LoadCancelled != retVal) && (Err::NoError != streamError))
     {
-        logPrint(Debug) << "stringToFloat:" << sStr;
-        retVal = Err::StlConvertToFloat;
+        logPrint(Trace) << "Reading the stream failed: " << sErrorText;
+        retVal = streamError;
     }
 
+    if (Err::NoError != retVal)
+    {
+        logPrint(Trace) << "Deallocating memory";
+        oModel.clear();
+        m_u32TriangleNumber = 0;
+    }
     return retVal;
 }
 
-Err CStlLoader::readAsciiVertex(std::ifstream &file, const std::string &sHeader, size_t &u32CurrentLineNo, CVector3d &oVertex)
+float CStlLoader::getStreamProgress(const CCompressedFile &oStream) const
+{
+    // the size of the data read from a pipe is unknown
+    return (m_u64FileSize > 0)? (static_cast<float>(oStream.getInputPosition()) / m_u64FileSize) : 0.0f;
+}
+
+void CStlLoader::readStlStreamFormat(const CCompressedFile &oStream)
+{
+    m_u32TriangleNumber = 0;
+    m_fileFormat = StlFormat::unknown;
+
+    // Only the head of the data is available. The head of an ASCII file is text starting with "solid ";
+    // the header of a binary file may start with "solid" too, but the facets following it aren't text.
+    const size_t probeSize = std::min(oStream.getSize(), StlAsciiProbeSize);
+    std::string sLine(reinterpret_cast<const char*>(oStream.getData()), std::min(probeSize, sizeof("solid ")-1));
+    strToLower(sLine);
+    if ((probeSize >= 15) && (0 == sLine.find("solid ")) && isTextData(oStream.getData(), probeSize))
+    {
+        logPrint(Debug) << "Detected ASCII STL file";
+        m_fileFormat = StlFormat::ascii;
+    }
+    else if (oStream.getSize() >= StlBinaryDataStart)
+    {
+        const uint8_t *au8Buffer = oStream.getData() + StlBinaryHeaderSize;
+        m_u32TriangleNumber = (au8Buffer[3] << 24) | (au8Buffer[2] << 16) | (au8Buffer[1] << 8) | au8Buffer[0];
+        logPrint(Debug) << "Detected Binary STL file with " << m_u32TriangleNumber << " triangles inside";
+        m_fileFormat = StlFormat::binary;
+    }
+    else
+    {
+        logPrint(Debug) << "Neither ASCII nor Binary STL file";
+    }
+}
+
+Err CStlLoader::loadBinaryStream(CCompressedFile &oStream, CModel &oModel)
 {
-    // converts a text line of format: "<header> <float> <float> <float>" to a 3D vertex
     Err retVal{Err::NoError};
 
-    std::string sLine;
-    getline(file, sLine);
-    ++u32CurrentLineNo;
-    if (file.good())
+    logPrint(Trace) << "loadBinaryStream()";
+    char szModelName[StlBinaryHeaderSize+1]; // let's treat file header as a model name and read it
+    memcpy(szModelName, oStream.getData(), StlBinaryHeaderSize);
+    szModelName[StlBinaryHeaderSize] = '\0';
+    oModel.setModelName(szModelName);
+    oStream.consume(StlBinaryDataStart);
+
+    if (m_u32TriangleNumber > 0)
     {
-        strToLower(sLine);
-        size_t pos = sLine.find_first_not_of(" ");
-        if (sLine.find(sHeader, pos) == pos)
+        // The number of facets can't be verified with the file size, so a failed reservation isn't an error yet.
+        // If the facets don't fit in memory, the model is paged by appendFacets() when they really arrive.
+        if (CModel::fitsInMemory(m_u32TriangleNumber))
+        {
+            try
+            {
+                CLockGuard oGuard{oModel.getLock()};
+                oModel.getFacets().reserve(m_u32TriangleNumber);
+            }
+            catch(...)
+            {
+                logPrint(Debug) << "Can't reserve memory for " << m_u32TriangleNumber << " facets";
+            }
+        }
+
+        std::vector<C3DFacet> vBatch;
+        uint32_t u32FacetIdx{0};
+        while ((Err::NoError == retVal) && (u32FacetIdx < m_u32TriangleNumber))
         {
-            size_t number1Begin = sLine.find_first_not_of(" ", pos+sHeader.length()); // beginning of the first <float>
-            if (std::string::npos != number1Begin)
+            if (oStream.getSize() < StlBinaryFacetSize)
+            {
+                oStream.fill();
+                if (oStream.getSize() < StlBinaryFacetSize)
+                {
+                    logPrint(Trace) << "Data ends after " << u32FacetIdx << " of " << m_u32TriangleNumber << " facets";
+                    retVal = Err::ReadFile;
+                }
+            }
+            else
             {
-                size_t number1End = sLine.find(" ", number1Begin); // end of the first <float>
-                if (std::string::npos != number1End)
+                const uint32_t u32Facets = static_cast<uint32_t>(std::min<size_t>({oStream.getSize() / StlBinaryFacetSize,
+                                                                                  m_u32TriangleNumber - u32FacetIdx,
+                                                                                  StlBinaryFacetsPerView}));
+                try
                 {
-                    --number1End;
-                    size_t number2Begin = sLine.find_first_not_of(" ", number1End+1); // beginning of the second <float>
-                    if (std::string::npos != number2Begin)
+                    vBatch.resize(u32Facets);
+                }
+                catch(...)
+                {
+                    logPrint(Trace) << "Can't allocate memory";
+                    retVal = Err::MemAlloc;
+                }
+                if (Err::NoError == retVal)
+                {
+                    CBoundingBox oBatchBox;
+                    if (!decodeBinaryFacets(oStream.getData(), u32Facets, vBatch.data(), oBatchBox))
                     {
-                        size_t number2End = sLine.find(" ", number2Begin);// end of the second <float>
-                        if (std::string::npos != number2End)
-                        {
-                            --number2End;
-                            size_t number3Begin = sLine.find_first_not_of(" ", number2End+1); // beginning of the third <float>
-                            if (std::string::npos != number3Begin)
-                            {
-                                size_t number3End = sLine.length()-1;// end of the third <float>
-
-                                // now convert strings to floats
-                                retVal = stringToFloat(sLine.substr(number1Begin, number1End-number1Begin+1), oVertex.m_fX);
-                                if (Err::NoError == retVal)
-                                {
-                                    retVal = stringToFloat(sLine.substr(number2Begin, number2End-number2Begin+1), oVertex.m_fY);
-                                    if (Err::NoError == retVal)
-                                    {
-                                        retVal = stringToFloat(sLine.substr(number3Begin, number3End-number3Begin+1), oVertex.m_fZ);
-                                        if (Err::NoError != retVal)
-                                        {
-                                            logPrint(Trace) << "Line:" << u32CurrentLineNo << " third argument after '" << sHeader << "' conversion to 'float' error";
-                                        }
-                                    }
-                                    else
-                                    {
-                                        logPrint(Trace) << "Line:" << u32CurrentLineNo << " second argument after '" << sHeader << "' conversion to 'float' error";
-                                    }
-                                }
-                                else
-                                {
-                                    logPrint(Trace) << "Line:" << u32CurrentLineNo << " first argument after '" << sHeader << "' conversion to 'float' error";
-                                }
-                            }
-                            else
-                            {
-                                logPrint(Trace) << "Line:" << u32CurrentLineNo << " third argument after '" << sHeader << "' expected";
-                                retVal = Err::StlVertFindNum3Beg;
-                            }
-                        }
-                        else
-                        {
-                            logPrint(Trace) << "Line:" << u32CurrentLineNo << " third argument after '" << sHeader << "' expected";
-                            retVal = Err::StlVertFindNum2End;
-                        }
+                        const uint32_t u32InvalidIdx = u32FacetIdx + findInvalidBinaryFacet(vBatch.data(), u32Facets);
+                        logPrint(Trace) << "Data error at " << (StlBinaryDataStart + (static_cast<uint64_t>(u32InvalidIdx) + 1) * StlBinaryFacetSize) << "B";
+                        retVal = Err::TriangleDef;
                     }
                     else
                     {
-                        logPrint(Trace) << "Line:" << u32CurrentLineNo << " second argument after '" << sHeader << "' expected";
-                        retVal = Err::StlVertFindNum2Beg;
+                        oStream.consume(u32Facets * StlBinaryFacetSize);
+                        u32FacetIdx += u32Facets;
+                        retVal = oModel.appendFacets(vBatch, getStreamProgress(oStream), oBatchBox);
                     }
                 }
-                else
+                if (Err::NoError == retVal)
                 {
-                    logPrint(Trace) << "Line:" << u32CurrentLineNo << " second argument after '" << sHeader << "' expected";
-                    retVal = Err::StlVertFindNum1End;
+                    retVal = reportProgress(oStream.getInputPosition(), u32FacetIdx);
                 }
             }
-            else
+        }
+
+        if (Err::NoError == retVal)
+        {
+            // like for an uncompressed file, the size of the data must fit the number of facets
+            oStream.fill();
+            if (oStream.getSize() > 0)
             {
-                logPrint(Trace) << "Line:" << u32CurrentLineNo << " first argument after '" << sHeader << "' expected";
-                retVal = Err::StlVertFindNum1Beg;
+                logPrint(Trace) << "Data size doesn't fit " << m_u32TriangleNumber << " triangles";
+                retVal = Err::InvalidStlFile;
             }
         }
-        else
+    }
+    else
+    {
+        logPrint(Debug) << "File contains empty model";
+        retVal = Err::EmptyModel;
+    }
+    return retVal;
+}
+
+Err CStlLoader::loadAsciiStream(CCompressedFile &oStream, CModel &oModel)
+{
+    Err retVal{Err::NoError};
+
+    logPrint(Trace) << "loadAsciiStream()";
+    // The text is parsed from the window like from the mapped views of parseAsciiFacets(). A facet cut off by
+    // the end of the window stays in the window and is parsed again when the window is filled.
+    const char *pBegin = reinterpret_cast<const char*>(oStream.getData());
+    CStlAsciiParser oHeaderParser{pBegin, pBegin + oStream.getSize(), oStream.isEnd(), 0};
+    std::string sModelName;
+    retVal = oHeaderParser.parseHeader(sModelName);
+    if (Err::NoError == retVal)
+    {
+        oModel.setModelName(sModelName);
+        oStream.consume(static_cast<size_t>(oHeaderParser.getPosition() - pBegin));
+        uint32_t u32LineNo = oHeaderParser.getLineNo();
+        std::vector<C3DFacet> vBatch;
+        bool bEndSolid{false};
+        while ((Err::NoError == retVal) && !bEndSolid)
         {
-            logPrint(Trace) << "Line:" << u32CurrentLineNo << " '" << sHeader << "' expected";
-            retVal = Err::StlVertFindSpace;
+            oStream.fill();
+            pBegin = reinterpret_cast<const char*>(oStream.getData());
+            CStlAsciiParser oParser{pBegin, pBegin + oStream.getSize(), oStream.isEnd(), u32LineNo};
+            vBatch.clear();
+            retVal = oParser.parseFacets(vBatch);
+            bEndSolid = oParser.isEndSolidFound();
+            const size_t consumed = static_cast<size_t>(oParser.getPosition() - pBegin);
+            if (Err::NoError == retVal)
+            {
+                retVal = oModel.appendFacets(vBatch, getStreamProgress(oStream));
+            }
+            if (Err::NoError == retVal)
+            {
+                retVal = reportProgress(oStream.getInputPosition(), oModel.getPublishedFacets());
+            }
+            if (Err::NoError == retVal)
+            {
+                if ((consumed > 0) || bEndSolid)
+                {
+                    oStream.consume(consumed);
+                    u32LineNo = oParser.getLineNo();
+                }
+                else
+                {
+                    logPrint(Trace) << "Line:" << (oParser.getLineNo() + 1) << " Facet doesn't fit in " << StlAsciiViewSize << "B";
+                    retVal = Err::StlGetline;
+                }
+            }
         }
     }
-    else
+
+    if (Err::NoError == retVal)
     {
-        logPrint(Trace) << "Line:" << u32CurrentLineNo << " Can't read file";
-        retVal = Err::StlVertGetline;
+        m_u32TriangleNumber = oModel.getPublishedFacets();
+        if (0 == m_u32TriangleNumber)
+        {
+            logPrint(Debug) << "File contains empty model";
+            retVal = Err::EmptyModel;
+        }
     }
     return retVal;
 }
 
+bool CStlLoader::isTextData(const uint8_t *pData, size_t size)
+{
+    bool bRetVal{true};
 
+    for (size_t i = 0; bRetVal && (i < size); ++i)
+    {
+        // bytes 0x80-0xFF are accepted, so the names written in UTF-8 or in local code pages are text too
+        bRetVal = (pData[i] >= 0x20) || (nullptr != memchr("\t\n\v\f\r", pData[i], 5));
+    }
+    return bRetVal;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file CThreadPool.cpp
+ * @author Grzegorz Pietrusiak <gpsspam2@gmail.com>
+ * @date 2026-10-18
+ * @copyright MIT License
+ */
+
+#include "CThreadPool.h"
+#include "CLogger.h"
+#include <algorithm>
+
+CThreadPool &CThreadPool::getInstance()
+{
+    static CThreadPool oInstance;
+    return oInstance;
+}
+
+CThreadPool::CThreadPool() : m_vThreads{}, m_qJobs{}, m_lock{}, m_hWork{nullptr}, m_bStop{false}
+{
+    InitializeCriticalSection(&m_lock);
+    m_hWork = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+
+    SYSTEM_INFO systemInfo{};
+    GetSystemInfo(&systemInfo);
+    const uint32_t u32Processors = std::max<uint32_t>(systemInfo.dwNumberOfProcessors, 1);
+    if (m_hWork)
+    {
+        for (uint32_t u32Idx = 1; u32Idx < u32Processors; ++u32Idx) // the thread calling parallelFor() is the first one
+        {
+            HANDLE hThread = CreateThread(nullptr, 0, workerThread, this, 0, nullptr);
+            if (hThread)
+            {
+                m_vThreads.push_back(hThread);
+            }
+            else
+            {
+                logPrint(Warning) << "Can't create worker thread, error " << GetLastError();
+                break;
+            }
+        }
+    }
+    logPrint(Debug) << "Thread pool: " << getThreadCount() << " threads";
+}
+
+CThreadPool::~CThreadPool()
+{
+    EnterCriticalSection(&m_lock);
+    m_bStop = true;
+    LeaveCriticalSection(&m_lock);
+    if (m_hWork)
+    {
+        SetEvent(m_hWork);
+    }
+    for (HANDLE hThread: m_vThreads)
+    {
+        WaitForSingleObject(hThread, INFINITE);
+        CloseHandle(hThread);
+    }
+    if (m_hWork)
+    {
+        CloseHandle(m_hWork);
+    }
+    DeleteCriticalSection(&m_lock);
+}
+
+void CThreadPool::parallelFor(uint32_t u32Count, const std::function<void(uint32_t)> &task)
+{
+    if ((u32Count > 1) && !m_vThreads.empty())
+    {
+        Job job;
+        job.pTask = &task;
+        job.u32Count = u32Count;
+        job.u32NextIdx = 0;
+        job.u32Workers = 0;
+        job.bQueued = true;
+        job.hIdle = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        if (job.hIdle)
+        {
+            EnterCriticalSection(&m_lock);
+            m_qJobs.push_back(&job);
+            SetEvent(m_hWork);
+            LeaveCriticalSection(&m_lock);
+
+            runJob(job);
+
+            // all indices are taken; wait for the workers still executing their last index
+            EnterCriticalSection(&m_lock);
+            dequeueJob(job);
+            const bool bWait = (job.u32Workers > 0);
+            LeaveCriticalSection(&m_lock);
+            if (bWait)
+            {
+                WaitForSingleObject(job.hIdle, INFINITE);
+            }
+            CloseHandle(job.hIdle);
+        }
+        else
+        {
+            logPrint(Warning) << "Can't create event, error " << GetLastError();
+            for (uint32_t u32Idx = 0; u32Idx < u32Count; ++u32Idx)
+            {
+                task(u32Idx);
+            }
+        }
+    }
+    else
+    {
+        for (uint32_t u32Idx = 0; u32Idx < u32Count; ++u32Idx)
+        {
+            task(u32Idx);
+        }
+    }
+}
+
+void CThreadPool::runJob(Job &job)
+{
+    for (uint32_t u32Idx = job.u32NextIdx++; u32Idx < job.u32Count; u32Idx = job.u32NextIdx++)
+    {
+        (*job.pTask)(u32Idx);
+    }
+}
+
+void CThreadPool::dequeueJob(Job &job)
+{
+    if (job.bQueued)
+    {
+        m_qJobs.erase(std::find(m_qJobs.begin(), m_qJobs.end(), &job));
+        job.bQueued = false;
+        if (m_qJobs.empty())
+        {
+            ResetEvent(m_hWork);
+        }
+    }
+}
+
+DWORD WINAPI CThreadPool::workerThread(LPVOID pParam)
+{
+    CThreadPool &oPool = *static_cast<CThreadPool*>(pParam);
+    bool bStop{false};
+
+    while (!bStop)
+    {
+        WaitForSingleObject(oPool.m_hWork, INFINITE);
+        Job *pJob{nullptr};
+        EnterCriticalSection(&oPool.m_lock);
+        bStop = oPool.m_bStop;
+        if (!bStop && !oPool.m_qJobs.empty())
+        {
+            pJob = oPool.m_qJobs.front();
+            ++pJob->u32Workers;
+        }
+        LeaveCriticalSection(&oPool.m_lock);
+
+        if (pJob)
+        {
+            runJob(*pJob);
+            // the job has no indices left, so it's taken off the queue to let the next job be picked
+            EnterCriticalSection(&oPool.m_lock);
+            oPool.dequeueJob(*pJob);
+            if (0 == --pJob->u32Workers)
+            {
+                SetEvent(pJob->hIdle);
+            }
+            LeaveCriticalSection(&oPool.m_lock);
+        }
+    }
+    return 0;
+}
@@ -13,4 +13,19 @@ std::ostream& operator<<(std::ostream& stream, const CVector3d& o)
 	return stream;
 }
 
+bool normalizeVector(CVector3d& oVector)
+{
+	const float fMax = fmaxf(fabsf(oVector.m_fX), fmaxf(fabsf(oVector.m_fY), fabsf(oVector.m_fZ)));
+	const bool bNonZero = fMax > 0.0f;
+	if (bNonZero)
+	{
+		const float fX = oVector.m_fX / fMax;
+		const float fY = oVector.m_fY / fMax;
+		const float fZ = oVector.m_fZ / fMax;
+		const float fLength = sqrtf(fX * fX + fY * fY + fZ * fZ);
+		oVector = CVector3d{fX / fLength, fY / fLength, fZ / fLength};
+	}
+	return bNonZero;
+}
+
 
@@ -15,10 +15,12 @@
  *
  * Build the application with -DDEBUG and -DLOGGING_ENABLED switches to enable activity logging to both the "output.log" file and on the console.
  *
- * Recommended (Debug) build switches: -pedantic -Wall -std=c++14 -m32 -g -DDEBUG -DLOGGING_ENABLED
+ * Recommended (Debug) build switches: -pedantic -Wall -std=c++14 -m32 -msse2 -g -DDEBUG -DLOGGING_ENABLED
  *
  * Recommended link switches: -static-libstdc++ -static -m32 -static-libgcc -ggdb  -lopengl32 -lglu32 -lgdi32 -lfreeglut
  *
+ * Build the application with -DZLIB_ENABLED (link with -lz) and/or -DZSTD_ENABLED (link with -lzstd) switches to load gzip and/or zstd compressed STL files.
+ *
  * @see WinMain application entry point
  */
 